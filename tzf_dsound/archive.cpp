@@ -0,0 +1,1123 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "archive.h"
+#include "config.h"
+#include "log.h"
+
+#include "lzma/7zAlloc.h"
+#include "lzma/Lzma2Dec.h"
+
+#include <unordered_map>
+#include <algorithm>
+
+extern iSK_Logger* tex_log;
+
+typedef BOOL(WINAPI *QueryPerformanceCounter_t)(_Out_ LARGE_INTEGER *lpPerformanceCount);
+extern QueryPerformanceCounter_t QueryPerformanceCounter_Original;
+
+struct tzf_archive_map_s {
+  HANDLE        hFile = INVALID_HANDLE_VALUE;
+  HANDLE        hMap  = nullptr;
+  const Byte*   view  = nullptr;
+  UInt64        size  = 0ULL;
+
+  // One reference belongs to the archive table, one to each open stream
+  volatile LONG refs  = 1L;
+};
+
+// Where each block of an archive is packed, and which block each file is in
+struct tzf_archive_blocks_s {
+  std::vector <UInt32> file_to_block;
+  std::vector <UInt64> block_pos;     // One past the last block, too
+};
+
+// Archive index -> mapping;  nullptr means the archive did not fit in the
+//   address-space budget (or failed to map) and is read through buffers.
+static struct {
+  std::unordered_map <unsigned int, tzf_archive_map_s *> table;
+  volatile LONG64                                         mapped_bytes = 0LL;
+
+  std::unordered_map <unsigned int, tzf_archive_blocks_s> blocks;
+
+  CRITICAL_SECTION                                        cs;
+
+  // Bumped whenever the archive list is rebuilt
+  volatile LONG                                           generation   = 0L;
+
+  struct {
+    volatile LONG64 bytes  [3] = { 0LL, 0LL, 0LL };
+    volatile LONG64 ticks  [3] = { 0LL, 0LL, 0LL };
+    volatile LONG   blocks [3] = { 0L,  0L,  0L  };
+
+    volatile LONG   heap_allocs   = 0L;
+    volatile LONG   reused_allocs = 0L;
+    volatile LONG   arc_opens     = 0L;
+  } stats;
+} archive_maps;
+
+static bool
+TZF_InitArchiveMaps (void)
+{
+  InitializeCriticalSectionAndSpinCount (&archive_maps.cs, 1000UL);
+  return true;
+}
+
+static bool archive_maps_init = TZF_InitArchiveMaps ();
+
+
+static SRes
+MappedInStream_Look (void *pp, const void **buf, size_t *size)
+{
+  tzf_mapped_in_stream_s* p = (tzf_mapped_in_stream_s *)pp;
+
+  UInt64 remaining = p->size - p->pos;
+
+  if (*size > remaining)
+    *size = (size_t)remaining;
+
+  *buf = p->base + (p->pos - p->origin);
+
+  return SZ_OK;
+}
+
+static SRes
+MappedInStream_Skip (void *pp, size_t offset)
+{
+  tzf_mapped_in_stream_s* p = (tzf_mapped_in_stream_s *)pp;
+
+  UInt64 remaining = p->size - p->pos;
+
+  // Never past the end, the same as Seek (...); ILookInStream's Skip has no
+  //   way to say how far it got, so skipping short is an error
+  if (offset > remaining)
+  {
+    p->pos = p->size;
+    return SZ_ERROR_INPUT_EOF;
+  }
+
+  p->pos += offset;
+
+  return SZ_OK;
+}
+
+static SRes
+MappedInStream_Read (void *pp, void *buf, size_t *size)
+{
+  tzf_mapped_in_stream_s* p = (tzf_mapped_in_stream_s *)pp;
+
+  UInt64 remaining = p->size - p->pos;
+
+  if (*size > remaining)
+    *size = (size_t)remaining;
+
+  memcpy (buf, p->base + (p->pos - p->origin), *size);
+  p->pos += *size;
+
+  return SZ_OK;
+}
+
+static SRes
+MappedInStream_Seek (void *pp, Int64 *pos, ESzSeek origin)
+{
+  tzf_mapped_in_stream_s* p = (tzf_mapped_in_stream_s *)pp;
+
+  Int64 new_pos = *pos;
+
+  switch (origin)
+  {
+    case SZ_SEEK_SET:                                 break;
+    case SZ_SEEK_CUR: new_pos += (Int64)p->pos;       break;
+    case SZ_SEEK_END: new_pos += (Int64)p->size;      break;
+    default:          return SZ_ERROR_PARAM;
+  }
+
+  // A read-ahead stream has nothing before its block
+  if (new_pos < (Int64)p->origin || (UInt64)new_pos > p->size)
+    return SZ_ERROR_READ;
+
+  p->pos = (UInt64)new_pos;
+  *pos   =        new_pos;
+
+  return SZ_OK;
+}
+
+
+static void
+TZF_ReleaseArchiveMap (tzf_archive_map_s* map)
+{
+  if (InterlockedDecrement (&map->refs) != 0)
+    return;
+
+  InterlockedAdd64 (&archive_maps.mapped_bytes, -(LONG64)map->size);
+
+  UnmapViewOfFile ((LPCVOID)map->view);
+  CloseHandle     (map->hMap);
+  CloseHandle     (map->hFile);
+
+  delete map;
+}
+
+static tzf_archive_map_s*
+TZF_MapArchive (const wchar_t* wszArchive)
+{
+  HANDLE hFile =
+    CreateFileW ( wszArchive,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL |
+                            FILE_FLAG_RANDOM_ACCESS,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  LARGE_INTEGER liSize = { 0 };
+  GetFileSizeEx (hFile, &liSize);
+
+  const LONG64 budget =
+    (LONG64)config.textures.max_mapped_in_mib * 1024LL * 1024LL;
+
+  // The DLL is 32-bit; large archives would fragment what little address
+  //   space the game leaves us, so those go through buffered reads instead.
+  if ( liSize.QuadPart == 0 ||
+       liSize.QuadPart + InterlockedAdd64 (&archive_maps.mapped_bytes, 0) > budget )
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Archive '%s' (%6.2f MiB) exceeds the mapping budget; "
+                   L"using buffered reads.",
+                     wszArchive,
+                       (double)liSize.QuadPart / (1024.0 * 1024.0) );
+
+    CloseHandle (hFile);
+    return nullptr;
+  }
+
+  HANDLE hMap =
+    CreateFileMappingW (hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+  const Byte* view = nullptr;
+
+  if (hMap != nullptr)
+    view = (const Byte *)MapViewOfFile (hMap, FILE_MAP_READ, 0, 0, 0);
+
+  if (view == nullptr)
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Could not map archive '%s' (GetLastError=%x); "
+                   L"using buffered reads.",
+                     wszArchive, GetLastError () );
+
+    if (hMap != nullptr)
+      CloseHandle (hMap);
+
+    CloseHandle (hFile);
+    return nullptr;
+  }
+
+  tzf_archive_map_s* map = new tzf_archive_map_s;
+
+  map->hFile = hFile;
+  map->hMap  = hMap;
+  map->view  = view;
+  map->size  = liSize.QuadPart;
+
+  InterlockedAdd64 (&archive_maps.mapped_bytes, map->size);
+
+  return map;
+}
+
+static tzf_archive_map_s*
+TZF_AcquireArchiveMap (unsigned int archive, const wchar_t* wszArchive)
+{
+  tzf_archive_map_s* map = nullptr;
+
+  EnterCriticalSection (&archive_maps.cs);
+  {
+    auto it = archive_maps.table.find (archive);
+
+    if (it == archive_maps.table.end ())
+    {
+      map = TZF_MapArchive (wszArchive);
+      archive_maps.table [archive] = map;
+    }
+
+    else
+      map = it->second;
+
+    if (map != nullptr)
+      InterlockedIncrement (&map->refs);
+  }
+  LeaveCriticalSection (&archive_maps.cs);
+
+  return map;
+}
+
+
+bool
+TZF_OpenArchiveStream ( unsigned int          archive,
+                        const wchar_t*        wszArchive,
+                        tzf_archive_stream_s* stream )
+{
+  stream->mapped     = false;
+  stream->read_ahead = false;
+  stream->map        = nullptr;
+
+  if (config.textures.map_archives)
+  {
+    tzf_archive_map_s* map =
+      TZF_AcquireArchiveMap (archive, wszArchive);
+
+    if (map != nullptr)
+    {
+      stream->view.s.Look = MappedInStream_Look;
+      stream->view.s.Skip = MappedInStream_Skip;
+      stream->view.s.Read = MappedInStream_Read;
+      stream->view.s.Seek = MappedInStream_Seek;
+
+      stream->view.base   = map->view;
+      stream->view.size   = map->size;
+      stream->view.pos    = 0ULL;
+      stream->view.origin = 0ULL;
+
+      stream->map        = map;
+      stream->mapped     = true;
+      stream->read_ahead = false;
+
+      return true;
+    }
+  }
+
+  FileInStream_CreateVTable (&stream->file);
+  LookToRead_CreateVTable   (&stream->look, False);
+
+  stream->look.realStream = &stream->file.s;
+  LookToRead_Init           (&stream->look);
+
+  return InFile_OpenW (&stream->file.file, wszArchive) == 0;
+}
+
+void
+TZF_OpenReadAheadStream ( const Byte*           data,
+                          UInt64                offset,
+                          size_t                length,
+                          tzf_archive_stream_s* stream )
+{
+  stream->view.s.Look = MappedInStream_Look;
+  stream->view.s.Skip = MappedInStream_Skip;
+  stream->view.s.Read = MappedInStream_Read;
+  stream->view.s.Seek = MappedInStream_Seek;
+
+  // Offsets stay those of the archive; SzArEx_Extract (...) seeks to them
+  stream->view.base   = data;
+  stream->view.size   = offset + length;
+  stream->view.pos    = offset;
+  stream->view.origin = offset;
+
+  stream->map        = nullptr;
+  stream->mapped     = true;
+  stream->read_ahead = true;
+}
+
+void
+TZF_CloseArchiveStream (tzf_archive_stream_s* stream)
+{
+  if (stream->mapped)
+  {
+    if (stream->map != nullptr)
+      TZF_ReleaseArchiveMap (stream->map);
+
+    stream->map        = nullptr;
+    stream->mapped     = false;
+    stream->read_ahead = false;
+  }
+
+  else
+    File_Close (&stream->file.file);
+}
+
+size_t
+TZF_GetArchiveBlockSize (const CSzArEx* arc, uint32_t fileno)
+{
+  UInt32 folder = arc->FileToFolder [fileno];
+
+  if (folder == (UInt32)-1)
+    return 0;
+
+  return (size_t)SzAr_GetFolderUnpackSize (&arc->db, folder);
+}
+
+void
+TZF_SetArchiveBlockRanges (unsigned int archive, const CSzArEx* arc)
+{
+  const CSzAr* db = &arc->db;
+
+  tzf_archive_blocks_s blocks;
+
+  blocks.file_to_block.assign (arc->FileToFolder, arc->FileToFolder + arc->NumFiles);
+  blocks.block_pos.resize     (db->NumFolders + 1);
+
+  for (UInt32 i = 0; i <= db->NumFolders; i++)
+  {
+    blocks.block_pos [i] =
+      arc->dataPos + db->PackPositions [db->FoStartPackStreamIndex [i]];
+  }
+
+  EnterCriticalSection (&archive_maps.cs);
+  {
+    archive_maps.blocks [archive] = std::move (blocks);
+  }
+  LeaveCriticalSection (&archive_maps.cs);
+}
+
+bool
+TZF_GetArchiveBlockRange ( unsigned int archive,
+                           uint32_t     fileno,
+                           uint64_t*    offset,
+                           uint64_t*    length )
+{
+  bool found = false;
+
+  EnterCriticalSection (&archive_maps.cs);
+  {
+    auto it = archive_maps.blocks.find (archive);
+
+    if ( it != archive_maps.blocks.end () &&
+         fileno < it->second.file_to_block.size () )
+    {
+      UInt32 block = it->second.file_to_block [fileno];
+
+      if (block != (UInt32)-1 && block + 1 < it->second.block_pos.size ())
+      {
+        *offset = it->second.block_pos [block];
+        *length = it->second.block_pos [block + 1] - *offset;
+
+        found   = *length != 0;
+      }
+    }
+  }
+  LeaveCriticalSection (&archive_maps.cs);
+
+  return found;
+}
+
+void
+TZF_GetArchiveBlockNeighbors ( const CSzArEx*                   arc,
+                               uint32_t                         fileno,
+                               std::vector <tzf_block_file_s>&  files )
+{
+  UInt32 folder = arc->FileToFolder [fileno];
+
+  if (folder == (UInt32)-1)
+    return;
+
+  UInt32 first = arc->FolderToFile [folder];
+  UInt32 last  = arc->FolderToFile [folder + 1];
+
+  for (UInt32 i = first; i < last && i < arc->NumFiles; i++)
+  {
+    if (i == fileno || SzArEx_IsDir (arc, i))
+      continue;
+
+    size_t size = (size_t)SzArEx_GetFileSize (arc, i);
+
+    if (size == 0)
+      continue;
+
+    tzf_block_file_s file;
+
+    file.fileno = i;
+    file.offset = (size_t)(arc->UnpackPositions [i] - arc->UnpackPositions [first]);
+    file.size   = size;
+
+    files.push_back (file);
+  }
+}
+
+SRes
+TZF_ExtractArchiveFile ( tzf_archive_stream_s* stream,
+                         const CSzArEx*        arc,
+                         uint32_t              fileno,
+                         Byte*                 out,
+                         size_t                out_len,
+                         size_t*               offset,
+                         size_t*               decomp_size,
+                         ISzAlloc*             alloc_main,
+                         ISzAlloc*             alloc_temp )
+{
+  LARGE_INTEGER start, end;
+  UInt32        block_idx = 0xFFFFFFFF;
+  SRes          res       = SZ_ERROR_FAIL;
+
+  QueryPerformanceCounter_Original (&start);
+
+  // A mapped archive that shrinks underneath us (or lives on a flaky
+  //   network share) raises an in-page error rather than a read failure.
+  __try
+  {
+    res =
+      SzArEx_Extract ( arc,        stream->get (), fileno,
+                       &block_idx, &out,           &out_len,
+                       offset,     decomp_size,
+                       alloc_main, alloc_temp );
+  }
+
+  __except ( GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ?
+               EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    res = SZ_ERROR_READ;
+  }
+
+  QueryPerformanceCounter_Original (&end);
+
+  if (res == SZ_OK)
+  {
+    int type = stream->read_ahead ? 2 :
+               stream->mapped     ? 1 : 0;
+
+    InterlockedAdd64     (&archive_maps.stats.bytes  [type], TZF_GetArchiveBlockSize (arc, fileno));
+    InterlockedAdd64     (&archive_maps.stats.ticks  [type], end.QuadPart - start.QuadPart);
+    InterlockedIncrement (&archive_maps.stats.blocks [type]);
+  }
+
+  return res;
+}
+
+void
+TZF_UnmapArchives (void)
+{
+  EnterCriticalSection (&archive_maps.cs);
+  {
+    for ( auto it : archive_maps.table )
+    {
+      if (it.second != nullptr)
+        TZF_ReleaseArchiveMap (it.second);
+    }
+
+    archive_maps.table.clear  ();
+    archive_maps.blocks.clear ();
+
+    InterlockedIncrement (&archive_maps.generation);
+  }
+  LeaveCriticalSection (&archive_maps.cs);
+}
+
+void
+TZF_LogArchiveStats (void)
+{
+  LARGE_INTEGER freq;
+  QueryPerformanceFrequency (&freq);
+
+  const wchar_t* names [] = { L"  Buffered", L"    Mapped", L"Read ahead" };
+
+  for (int i = 0; i < 3; i++)
+  {
+    LONG blocks = InterlockedExchangeAdd (&archive_maps.stats.blocks [i], 0);
+
+    if (blocks == 0)
+      continue;
+
+    double mib =
+      (double)InterlockedAdd64 (&archive_maps.stats.bytes [i], 0) / (1024.0 * 1024.0);
+    double ms  =
+      1000.0 * (double)InterlockedAdd64 (&archive_maps.stats.ticks [i], 0) /
+               (double)freq.QuadPart;
+
+    tex_log->Log ( L"[ Arc. I/O ] %s: %6li blocks, %9.2f MiB decoded in %10.2f ms"
+                   L"  (%7.2f MiB/s)",
+                     names [i], blocks, mib, ms,
+                       ms > 0.0 ? mib / (ms / 1000.0) : 0.0 );
+  }
+
+  LONG textures = InterlockedExchangeAdd (&archive_maps.stats.blocks [0], 0) +
+                  InterlockedExchangeAdd (&archive_maps.stats.blocks [1], 0) +
+                  InterlockedExchangeAdd (&archive_maps.stats.blocks [2], 0);
+
+  if (textures > 0)
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Decoder: %5.2f heap / %5.2f reused allocations per"
+                   L" texture, %li archive opens for %li textures (%li KiB cap/thread)",
+                     (double)InterlockedExchangeAdd (&archive_maps.stats.heap_allocs,   0) /
+                     (double)textures,
+                     (double)InterlockedExchangeAdd (&archive_maps.stats.reused_allocs, 0) /
+                     (double)textures,
+                             InterlockedExchangeAdd (&archive_maps.stats.arc_opens,     0),
+                               textures,
+                                 config.textures.max_decoder_cache_in_kib );
+  }
+}
+
+
+// Every retained block carries its size in front of it, since ISzAlloc::Free
+//   does not pass one.  16 bytes keeps the CRT's alignment guarantee intact.
+static const size_t RETAIN_HEADER = 16;
+
+static ISzAlloc main_alloc = { SzAlloc, SzFree };
+
+static __declspec (thread) tzf_decoder_ctx_s* tls_decoder = nullptr;
+
+static void*
+TZF_RetainingAlloc (void *p, size_t size)
+{
+  if (size == 0)
+    return nullptr;
+
+  tzf_decoder_ctx_s* ctx = ((tzf_retaining_alloc_s *)p)->ctx;
+
+  for ( auto it  = ctx->retained.begin ();
+             it != ctx->retained.end   ();
+           ++it )
+  {
+    if (it->size == size)
+    {
+      void* ptr = it->ptr;
+
+      ctx->retained_bytes -= size;
+      ctx->retained.erase (it);
+
+      InterlockedIncrement (&archive_maps.stats.reused_allocs);
+
+      return ptr;
+    }
+  }
+
+  Byte* base = (Byte *)malloc (size + RETAIN_HEADER);
+
+  if (base == nullptr)
+    return nullptr;
+
+  *(size_t *)base = size;
+
+  InterlockedIncrement (&archive_maps.stats.heap_allocs);
+
+  return base + RETAIN_HEADER;
+}
+
+static void
+TZF_RetainingFree (void *p, void *address)
+{
+  if (address == nullptr)
+    return;
+
+  tzf_decoder_ctx_s* ctx  = ((tzf_retaining_alloc_s *)p)->ctx;
+  Byte*              base = (Byte *)address - RETAIN_HEADER;
+  size_t             size = *(size_t *)base;
+
+  const size_t cap =
+    (size_t)std::max (0, config.textures.max_decoder_cache_in_kib) * 1024;
+
+  if (ctx->retained_bytes + size <= cap)
+  {
+    ctx->retained.push_back ({ size, address });
+    ctx->retained_bytes += size;
+  }
+
+  else
+    free (base);
+}
+
+tzf_decoder_ctx_s*
+TZF_GetDecoderContext (void)
+{
+  if (tls_decoder == nullptr)
+  {
+    tls_decoder = new tzf_decoder_ctx_s;
+
+    tls_decoder->alloc.vt.Alloc = TZF_RetainingAlloc;
+    tls_decoder->alloc.vt.Free  = TZF_RetainingFree;
+    tls_decoder->alloc.ctx      = tls_decoder;
+  }
+
+  return tls_decoder;
+}
+
+static void
+TZF_CloseCachedArchive (tzf_decoder_ctx_s* ctx)
+{
+  if (! ctx->open)
+    return;
+
+  SzArEx_Free            (&ctx->arc, &main_alloc);
+  TZF_CloseArchiveStream (&ctx->stream);
+
+  ctx->open    = false;
+  ctx->archive = UINT_MAX;
+}
+
+// Parsing the headers reads the mapped view too; see TZF_ExtractArchiveFile
+static SRes
+TZF_OpenArchiveGuarded (tzf_decoder_ctx_s* ctx)
+{
+  SRes res = SZ_ERROR_FAIL;
+
+  __try
+  {
+    res =
+      SzArEx_Open (&ctx->arc, ctx->stream.get (), &main_alloc, &ctx->alloc.vt);
+  }
+
+  __except ( GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ?
+               EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    res = SZ_ERROR_READ;
+  }
+
+  return res;
+}
+
+const CSzArEx*
+TZF_OpenCachedArchive ( tzf_decoder_ctx_s* ctx,
+                        unsigned int       archive,
+                        const wchar_t*     wszArchive )
+{
+  LONG generation =
+    InterlockedExchangeAdd (&archive_maps.generation, 0);
+
+  // With the cache disabled, behave as before: one SzArEx_Open per texture
+  bool reuse = config.textures.max_decoder_cache_in_kib > 0;
+
+  if ( reuse && ctx->open            &&
+       ctx->archive    == archive    &&
+       ctx->generation == generation )
+  {
+    return &ctx->arc;
+  }
+
+  TZF_CloseCachedArchive (ctx);
+
+  if (! TZF_OpenArchiveStream (archive, wszArchive, &ctx->stream))
+    return nullptr;
+
+  SzArEx_Init (&ctx->arc);
+
+  if (TZF_OpenArchiveGuarded (ctx) != SZ_OK)
+  {
+    SzArEx_Free            (&ctx->arc, &main_alloc);
+    TZF_CloseArchiveStream (&ctx->stream);
+    return nullptr;
+  }
+
+  InterlockedIncrement (&archive_maps.stats.arc_opens);
+
+  ctx->open       = true;
+  ctx->archive    = archive;
+  ctx->generation = generation;
+
+  return &ctx->arc;
+}
+
+void
+TZF_TrimDecoderContext (void)
+{
+  tzf_decoder_ctx_s* ctx = tls_decoder;
+
+  if (ctx == nullptr)
+    return;
+
+  for ( auto it : ctx->retained )
+    free ((Byte *)it.ptr - RETAIN_HEADER);
+
+  ctx->retained.clear ();
+  ctx->retained_bytes = 0;
+}
+
+void
+TZF_ReleaseDecoderContext (void)
+{
+  if (tls_decoder == nullptr)
+    return;
+
+  TZF_CloseCachedArchive (tls_decoder);
+  TZF_TrimDecoderContext ();
+
+  delete tls_decoder;
+         tls_decoder = nullptr;
+}
+
+
+#define TZF_METHOD_LZMA2 0x21
+
+struct tzf_lzma2_segment_s {
+  UInt64 pack_pos;
+  UInt64 pack_size;
+  size_t unpack_size;
+};
+
+//
+// Walks the LZMA2 chunk headers of a folder and cuts it wherever the
+//   dictionary is reset (control byte 0x01, or 0xE0 and up).  Only folders
+//     with a lone LZMA2 coder qualify; a BCJ/Delta filter in front would need
+//       the whole stream anyway.
+//
+static bool
+TZF_FindLzma2Segments ( tzf_decoder_ctx_s*                  ctx,
+                        const CSzArEx*                      arc,
+                        UInt32                              folder,
+                        Byte*                               prop,
+                        std::vector <tzf_lzma2_segment_s>& segments )
+{
+  const CSzAr* db   = &arc->db;
+  const Byte*  data = db->CodersData + db->FoCodersOffsets [folder];
+
+  CSzFolder f;
+  CSzData   sd;
+
+  sd.Data = data;
+  sd.Size = db->FoCodersOffsets [folder + 1] - db->FoCodersOffsets [folder];
+
+  if (SzGetNextFolderItem (&f, &sd) != SZ_OK)
+    return false;
+
+  if ( f.NumCoders            != 1                ||
+       f.Coders [0].MethodID  != TZF_METHOD_LZMA2 ||
+       f.Coders [0].PropsSize != 1 )
+    return false;
+
+  *prop = data [f.Coders [0].PropsOffset];
+
+  UInt32 pack_idx = db->FoStartPackStreamIndex [folder];
+  UInt64 pack_end = arc->dataPos + db->PackPositions [pack_idx + 1];
+  UInt64 pos      = arc->dataPos + db->PackPositions [pack_idx];
+  UInt64 unpacked = 0ULL;
+
+  ILookInStream* stream = ctx->stream.get ();
+
+  tzf_lzma2_segment_s seg = { pos, 0ULL, 0 };
+
+  while (pos < pack_end)
+  {
+    Byte   hdr [6] = { };
+    size_t hdr_len = (size_t)std::min (6ULL, pack_end - pos);
+
+    if ( LookInStream_SeekTo (stream, pos)               != SZ_OK ||
+         LookInStream_Read   (stream, hdr, hdr_len)      != SZ_OK )
+      return false;
+
+    Byte   control = hdr [0];
+    UInt32 chunk_unpacked,
+           chunk_packed,
+           hdr_size;
+    bool   dict_reset;
+
+    if (control == 0x00)
+      break;
+
+    // Stored chunk
+    else if (control == 0x01 || control == 0x02)
+    {
+      chunk_unpacked = ((UInt32)hdr [1] << 8 | hdr [2]) + 1;
+      chunk_packed   = chunk_unpacked;
+      hdr_size       = 3;
+      dict_reset     = (control == 0x01);
+    }
+
+    // LZMA chunk; 0xC0 and up carry a new properties byte
+    else if (control >= 0x80)
+    {
+      chunk_unpacked = ((UInt32)(control & 0x1F) << 16 | (UInt32)hdr [1] << 8 | hdr [2]) + 1;
+      chunk_packed   = ((UInt32)hdr [3] << 8 | hdr [4]) + 1;
+      hdr_size       = (control >= 0xC0) ? 6 : 5;
+      dict_reset     = (control >= 0xE0);
+    }
+
+    else
+      return false;
+
+    if (dict_reset && pos != seg.pack_pos)
+    {
+      seg.pack_size = pos - seg.pack_pos;
+      segments.push_back (seg);
+
+      seg = { pos, 0ULL, 0 };
+    }
+
+    seg.unpack_size += chunk_unpacked;
+    unpacked        += chunk_unpacked;
+    pos             += hdr_size + chunk_packed;
+  }
+
+  seg.pack_size = pos - seg.pack_pos;
+  segments.push_back (seg);
+
+  return unpacked == SzAr_GetFolderUnpackSize (db, folder);
+}
+
+size_t
+TZF_PlanArchiveDecode ( unsigned int                     archive,
+                        const wchar_t*                   wszArchive,
+                        bool                             split_lzma2,
+                        tzf_decoded_file_pfn             keep,
+                        tzf_decode_batch_s*              batch,
+                        std::vector <tzf_decode_job_s*>& jobs )
+{
+  tzf_decoder_ctx_s* ctx = TZF_GetDecoderContext ();
+  const CSzArEx*     arc = TZF_OpenCachedArchive (ctx, archive, wszArchive);
+
+  if (arc == nullptr)
+    return 0;
+
+  size_t planned = 0;
+
+  for (UInt32 folder = 0; folder < arc->db.NumFolders; folder++)
+  {
+    size_t unpack_size =
+      (size_t)SzAr_GetFolderUnpackSize (&arc->db, folder);
+
+    if (unpack_size == 0)
+      continue;
+
+    std::vector <tzf_lzma2_segment_s> segments;
+    Byte                              prop = 0;
+
+    if ( split_lzma2 &&
+         (! TZF_FindLzma2Segments (ctx, arc, folder, &prop, segments)) )
+      segments.clear ();
+
+    if (segments.size () > 1)
+    {
+      UInt64 unpack_pos = 0ULL;
+
+      for ( auto it : segments )
+      {
+        tzf_decode_job_s* job = new tzf_decode_job_s;
+
+        job->archive      = archive;
+        job->archive_name = wszArchive;
+        job->folder       = folder;
+        job->segment      = true;
+        job->lzma2_prop   = prop;
+        job->pack_pos     = it.pack_pos;
+        job->pack_size    = it.pack_size;
+        job->unpack_pos   = unpack_pos;
+        job->unpack_size  = it.unpack_size;
+        job->keep         = keep;
+        job->batch        = batch;
+
+        unpack_pos += it.unpack_size;
+
+        jobs.push_back (job);
+        ++planned;
+      }
+    }
+
+    else
+    {
+      tzf_decode_job_s* job = new tzf_decode_job_s;
+
+      job->archive      = archive;
+      job->archive_name = wszArchive;
+      job->folder       = folder;
+      job->unpack_size  = unpack_size;
+      job->keep         = keep;
+      job->batch        = batch;
+
+      jobs.push_back (job);
+      ++planned;
+    }
+  }
+
+  return planned;
+}
+
+static SRes
+TZF_DecodeLzma2Segment ( ILookInStream* stream,
+                         UInt64         pack_pos,
+                         UInt64         pack_size,
+                         Byte           prop,
+                         Byte*          out,
+                         size_t         out_size,
+                         ISzAlloc*      alloc )
+{
+  CLzma2Dec state;
+
+  Lzma2Dec_Construct (&state);
+
+  RINOK (Lzma2Dec_AllocateProbs (&state, prop, alloc));
+
+  state.decoder.dic        = out;
+  state.decoder.dicBufSize = out_size;
+
+  Lzma2Dec_Init (&state);
+
+  UInt64 in_size = pack_size;
+  SRes   res     = LookInStream_SeekTo (stream, pack_pos);
+
+  while (res == SZ_OK && state.decoder.dicPos < out_size)
+  {
+    const void* in_buf    = nullptr;
+    size_t      lookahead = (1 << 18);
+
+    if (lookahead > in_size)
+      lookahead = (size_t)in_size;
+
+    res = stream->Look (stream, &in_buf, &lookahead);
+
+    if (res != SZ_OK)
+      break;
+
+    SizeT       in_processed = lookahead;
+    SizeT       dic_pos      = state.decoder.dicPos;
+    ELzmaStatus status;
+
+    // The segment ends mid-stream, with no end marker; LZMA_FINISH_ANY
+    res =
+      Lzma2Dec_DecodeToDic ( &state, out_size,
+                               (const Byte *)in_buf, &in_processed,
+                                 LZMA_FINISH_ANY, &status );
+
+    in_size -= in_processed;
+
+    if (res != SZ_OK)
+      break;
+
+    if (in_processed == 0 && dic_pos == state.decoder.dicPos)
+    {
+      res = SZ_ERROR_DATA;
+      break;
+    }
+
+    res = stream->Skip (stream, in_processed);
+  }
+
+  Lzma2Dec_FreeProbs (&state, alloc);
+
+  return res;
+}
+
+static SRes
+TZF_DecodeJobGuarded ( const tzf_decode_job_s* job,
+                       const CSzArEx*          arc,
+                       ILookInStream*          stream,
+                       Byte*                   out,
+                       ISzAlloc*               alloc )
+{
+  SRes res = SZ_ERROR_FAIL;
+
+  __try
+  {
+    if (job->segment)
+    {
+      res =
+        TZF_DecodeLzma2Segment ( stream,
+                                   job->pack_pos, job->pack_size, job->lzma2_prop,
+                                     out, job->unpack_size,
+                                       alloc );
+    }
+
+    else
+    {
+      res =
+        SzAr_DecodeFolder ( &arc->db, job->folder,
+                              stream, arc->dataPos,
+                                out, job->unpack_size,
+                                  alloc );
+    }
+  }
+
+  __except ( GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ?
+               EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    res = SZ_ERROR_READ;
+  }
+
+  return res;
+}
+
+static void
+TZF_KeepDecodedFiles ( const tzf_decode_job_s* job,
+                       const CSzArEx*          arc,
+                       const Byte*             out )
+{
+  UInt32 first = arc->FolderToFile [job->folder];
+  UInt32 last  = arc->FolderToFile [job->folder + 1];
+
+  for (UInt32 i = first; i < last && i < arc->NumFiles; i++)
+  {
+    if (SzArEx_IsDir (arc, i))
+      continue;
+
+    UInt64 size = SzArEx_GetFileSize (arc, i);
+    UInt64 pos  = arc->UnpackPositions [i] - arc->UnpackPositions [first];
+
+    // Starts in an earlier segment
+    if (size == 0 || pos < job->unpack_pos)
+      continue;
+
+    pos -= job->unpack_pos;
+
+    // Ends in a later one
+    if (pos > job->unpack_size || size > job->unpack_size - pos)
+      continue;
+
+    job->keep (job, arc, i, out + (size_t)pos, (size_t)size);
+  }
+}
+
+void
+TZF_RunDecodeJob (tzf_decode_job_s* job)
+{
+  tzf_decode_batch_s* batch = job->batch;
+  tzf_decoder_ctx_s*  ctx   = TZF_GetDecoderContext ();
+  SRes                res   = SZ_ERROR_FAIL;
+
+  const CSzArEx* arc =
+    TZF_OpenCachedArchive (ctx, job->archive, job->archive_name.c_str ());
+
+  if (arc != nullptr)
+  {
+    Byte* out = (Byte *)malloc (job->unpack_size);
+
+    if (out != nullptr)
+    {
+      res =
+        TZF_DecodeJobGuarded (job, arc, ctx->stream.get (), out, &ctx->alloc.vt);
+
+      if (res == SZ_OK && job->keep != nullptr)
+        TZF_KeepDecodedFiles (job, arc, out);
+
+      free (out);
+    }
+
+    else
+      res = SZ_ERROR_MEM;
+  }
+
+  if (res == SZ_OK)
+    InterlockedAdd64     (&batch->bytes, job->unpack_size);
+  else
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Decode of %s %lu in '%s' failed (SRes=%i)",
+                     job->segment ? L"a segment of folder" : L"folder",
+                       job->folder, job->archive_name.c_str (), res );
+
+    InterlockedIncrement (&batch->failures);
+  }
+
+  delete job;
+
+  if (InterlockedDecrement (&batch->remaining) == 0)
+    SetEvent (batch->done);
+}
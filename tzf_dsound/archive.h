@@ -0,0 +1,254 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__ARCHIVE_H__
+#define __TZF__ARCHIVE_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <climits>
+#include <string>
+#include <vector>
+
+#include "lzma/7z.h"
+#include "lzma/7zFile.h"
+
+struct tzf_archive_map_s;
+
+//
+// ILookInStream backed by a read-only mapping of the entire archive.
+//
+//   Look (...) hands the decoder a pointer straight into the mapped view,
+//     so LZMA reads from the page cache without an intermediate copy.
+//
+struct tzf_mapped_in_stream_s {
+  ILookInStream      s;    // Must be first; the 7-Zip SDK casts to this
+  const Byte*        base;
+  UInt64             size;
+  UInt64             pos;
+  UInt64             origin = 0ULL; // Archive offset of base (read ahead)
+};
+
+//
+// A stream over one texture archive; mapped if the address-space budget
+//   allows it, otherwise the classic CFileInStream + CLookToRead pair.
+//
+struct tzf_archive_stream_s {
+  bool                   mapped     = false;
+  bool                   read_ahead = false; // view is over one block only
+  tzf_archive_map_s*     map        = nullptr;
+
+  tzf_mapped_in_stream_s view;
+
+  CFileInStream          file;
+  CLookToRead            look;
+
+  ILookInStream* get (void) {
+    return mapped ? &view.s : &look.s;
+  }
+};
+
+bool
+TZF_OpenArchiveStream  ( unsigned int          archive,
+                         const wchar_t*        wszArchive,
+                         tzf_archive_stream_s* stream );
+
+void
+TZF_CloseArchiveStream (tzf_archive_stream_s* stream);
+
+// A stream over a block the I/O stage read ahead (length bytes from offset
+//   in the archive); it reads nothing else and needs no closing.
+void
+TZF_OpenReadAheadStream ( const Byte*           data,
+                          UInt64                offset,
+                          size_t                length,
+                          tzf_archive_stream_s* stream );
+
+// Size of the (solid) block that must be decoded to reach fileno
+size_t
+TZF_GetArchiveBlockSize (const CSzArEx* arc, uint32_t fileno);
+
+// Remembers where every block of an archive is packed, so that the I/O
+//   stage can read one ahead without the archive being open; called while
+//     the archive list is built (TZF_UnmapArchives (...) forgets them).
+void
+TZF_SetArchiveBlockRanges ( unsigned int archive, const CSzArEx* arc );
+
+// Where the (packed) block that fileno lives in is in the archive
+bool
+TZF_GetArchiveBlockRange  ( unsigned int archive,
+                            uint32_t     fileno,
+                            uint64_t*    offset,
+                            uint64_t*    length );
+
+struct tzf_block_file_s {
+  uint32_t fileno;
+  size_t   offset;   // Within the unpacked block
+  size_t   size;
+};
+
+// Every other non-empty file in fileno's (solid) block, and where
+//   TZF_ExtractArchiveFile (...) leaves it in the block buffer
+void
+TZF_GetArchiveBlockNeighbors ( const CSzArEx*                   arc,
+                               uint32_t                         fileno,
+                               std::vector <tzf_block_file_s>&  files );
+
+// SzArEx_Extract (...) into a caller-supplied block buffer, guarded against
+//   in-page faults on mapped streams and timed for the decode statistics.
+SRes
+TZF_ExtractArchiveFile ( tzf_archive_stream_s* stream,
+                         const CSzArEx*        arc,
+                         uint32_t              fileno,
+                         Byte*                 out,
+                         size_t                out_len,
+                         size_t*               offset,
+                         size_t*               decomp_size,
+                         ISzAlloc*             alloc_main,
+                         ISzAlloc*             alloc_temp );
+
+// Drops the table's reference to every mapping (streams still in use keep
+//   theirs until closed) and invalidates every decoder context's cached
+//     archive; called whenever the archive list is rebuilt.
+void
+TZF_UnmapArchives (void);
+
+void
+TZF_LogArchiveStats (void);
+
+
+struct tzf_decoder_ctx_s;
+
+// ISzAlloc that keeps freed blocks around (up to a per-thread cap) so that
+//   the next extraction with the same coder properties gets its LZMA probs
+//     and 7z header arrays back without a trip through the CRT heap.
+struct tzf_retaining_alloc_s {
+  ISzAlloc           vt;   // Must be first
+  tzf_decoder_ctx_s* ctx;
+};
+
+//
+// Per-thread decoder state; the dictionary is the caller's output buffer,
+//   so what is worth keeping between textures is the allocator's retained
+//     blocks and the last archive that was opened (SzArEx_Open is costly).
+//
+struct tzf_decoder_ctx_s {
+  struct block_s {
+    size_t size;
+    void*  ptr;
+  };
+
+  tzf_retaining_alloc_s  alloc;
+
+  std::vector <block_s>  retained;
+  size_t                 retained_bytes = 0;
+
+  unsigned int           archive        = UINT_MAX;
+  LONG                   generation     = -1;
+  bool                   open           = false;
+
+  CSzArEx                arc;
+  tzf_archive_stream_s   stream;
+};
+
+// Decoder context for the calling thread (created on first use)
+tzf_decoder_ctx_s*
+TZF_GetDecoderContext     (void);
+
+// Returns the archive opened by this context, re-using it if the same
+//   archive was opened last and the archive list has not been rebuilt.
+const CSzArEx*
+TZF_OpenCachedArchive     ( tzf_decoder_ctx_s* ctx,
+                            unsigned int       archive,
+                            const wchar_t*     wszArchive );
+
+// Frees retained allocator blocks, but keeps the archive open
+void
+TZF_TrimDecoderContext    (void);
+
+// Closes everything; called when a worker thread exits
+void
+TZF_ReleaseDecoderContext (void);
+
+
+
+//
+// Bulk decoding (warm-up / prefetch)
+//
+//   Folders in an archive are independent of one another, and so is every
+//     run of LZMA2 chunks that begins with a dictionary reset; 7-Zip's
+//       multi-threaded encoder emits one of those per block.  Each becomes
+//         its own job that any worker thread can decode.
+//
+struct tzf_decode_batch_s {
+  HANDLE          done      = nullptr;  // Signaled when remaining hits 0
+  volatile LONG   remaining = 0L;
+  volatile LONG   failures  = 0L;
+  volatile LONG64 bytes     = 0LL;
+};
+
+struct tzf_decode_job_s;
+
+// Called on the decoding thread for every file a job decoded whole; data
+//   is only valid until it returns
+typedef void (*tzf_decoded_file_pfn)( const tzf_decode_job_s* job,
+                                      const CSzArEx*          arc,
+                                      uint32_t                fileno,
+                                      const Byte*             data,
+                                      size_t                  size );
+
+struct tzf_decode_job_s {
+  unsigned int         archive;
+  std::wstring         archive_name;
+  uint32_t             folder;
+
+  // Segment jobs decode a dictionary-reset run of a plain LZMA2 folder
+  bool                 segment     = false;
+  Byte                 lzma2_prop  = 0;
+  UInt64               pack_pos    = 0ULL;
+  UInt64               pack_size   = 0ULL;
+
+  UInt64               unpack_pos  = 0ULL; // Within the folder
+  size_t               unpack_size = 0;
+
+  tzf_decoded_file_pfn keep        = nullptr;
+  tzf_decode_batch_s*  batch       = nullptr;
+};
+
+// Appends one job per folder (or per LZMA2 segment, if split_lzma2 is set
+//   and the folder has more than one) to jobs; returns the number added.
+//     keep may be nullptr, which throws the output away.
+size_t
+TZF_PlanArchiveDecode ( unsigned int                     archive,
+                        const wchar_t*                   wszArchive,
+                        bool                             split_lzma2,
+                        tzf_decoded_file_pfn             keep,
+                        tzf_decode_batch_s*              batch,
+                        std::vector <tzf_decode_job_s*>& jobs );
+
+// Decodes (and deletes) job on the calling thread, hands what it decoded to
+//   job->keep, then signals its batch.  A file split across two segments
+//     is not handed over; it is left for a regular load to decode.
+void
+TZF_RunDecodeJob (tzf_decode_job_s* job);
+
+#endif /* __TZF__ARCHIVE_H__ */
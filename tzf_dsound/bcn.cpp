@@ -0,0 +1,729 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include "bcn.h"
+
+#include <cstring>
+#include <cmath>
+
+#if defined (_M_X64) || defined (__SSE2__) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+# define TZF_BCN_SSE2
+# include <emmintrin.h>
+#endif
+
+static inline uint32_t
+read32 (const uint8_t* p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof (v));
+  return v;
+}
+
+static inline uint16_t
+read16 (const uint8_t* p)
+{
+  return (uint16_t)(p [0] | (p [1] << 8));
+}
+
+static inline void
+write16 (uint8_t* p, uint16_t v)
+{
+  p [0] = (uint8_t)(v & 0xFF);
+  p [1] = (uint8_t)(v >> 8);
+}
+
+static inline uint32_t
+pack_bgra (uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+  return b | (g << 8) | (r << 16) | (a << 24);
+}
+
+static inline uint32_t
+expand565 (uint16_t c)
+{
+  uint32_t r = (c >> 11) & 0x1F;
+  uint32_t g = (c >>  5) & 0x3F;
+  uint32_t b =  c        & 0x1F;
+
+  return pack_bgra ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0xFF);
+}
+
+#define CH(c, shift) (((c) >> (shift)) & 0xFF)
+
+// Opaque colors interpolate in thirds; BC1 with c0 <= c1 has a midpoint
+//   and transparent black instead.  BC3 color blocks are always 4-color.
+static void
+TZF_GetColorPalette (const uint8_t* block, bool four_color, uint32_t pal [4])
+{
+  uint16_t c0 = read16 (block);
+  uint16_t c1 = read16 (block + 2);
+
+  pal [0] = expand565 (c0);
+  pal [1] = expand565 (c1);
+
+  uint32_t r0 = CH (pal [0], 16), g0 = CH (pal [0], 8), b0 = CH (pal [0], 0);
+  uint32_t r1 = CH (pal [1], 16), g1 = CH (pal [1], 8), b1 = CH (pal [1], 0);
+
+  if (four_color || c0 > c1)
+  {
+    pal [2] = pack_bgra ( (2 * r0 + r1 + 1) / 3, (2 * g0 + g1 + 1) / 3,
+                          (2 * b0 + b1 + 1) / 3, 0xFF );
+    pal [3] = pack_bgra ( (r0 + 2 * r1 + 1) / 3, (g0 + 2 * g1 + 1) / 3,
+                          (b0 + 2 * b1 + 1) / 3, 0xFF );
+  }
+
+  else
+  {
+    pal [2] = pack_bgra ( (r0 + r1 + 1) / 2, (g0 + g1 + 1) / 2,
+                          (b0 + b1 + 1) / 2, 0xFF );
+    pal [3] = 0;
+  }
+}
+
+static void
+TZF_DecodeColorBlock (const uint8_t* block, bool four_color, uint32_t out [16])
+{
+  uint32_t pal [4];
+
+  TZF_GetColorPalette (block, four_color, pal);
+
+  uint32_t bits = read32 (block + 4);
+
+#ifdef TZF_BCN_SSE2
+  // A row of four texels at a time: each palette entry is selected where
+  //   the texel's two index bits compare equal to it
+  const __m128i word = _mm_set1_epi32 ((int)bits);
+
+  const __m128i p0 = _mm_set1_epi32 ((int)pal [0]);
+  const __m128i p1 = _mm_set1_epi32 ((int)pal [1]);
+  const __m128i p2 = _mm_set1_epi32 ((int)pal [2]);
+  const __m128i p3 = _mm_set1_epi32 ((int)pal [3]);
+
+  for (int row = 0; row < 4; row++)
+  {
+    const int     s    = row * 8;
+    const __m128i unit = _mm_set_epi32 ( (int)(1U << (s + 6)), (int)(1U << (s + 4)),
+                                         (int)(1U << (s + 2)), (int)(1U <<  s) );
+    const __m128i two  = _mm_add_epi32 (unit, unit);
+    const __m128i mask = _mm_add_epi32 (two,  unit);
+
+    __m128i idx = _mm_and_si128   (word, mask);
+    __m128i px  = p0;
+
+    __m128i eq  = _mm_cmpeq_epi32 (idx, unit);
+    px = _mm_or_si128 (_mm_andnot_si128 (eq, px), _mm_and_si128 (eq, p1));
+
+    eq = _mm_cmpeq_epi32 (idx, two);
+    px = _mm_or_si128 (_mm_andnot_si128 (eq, px), _mm_and_si128 (eq, p2));
+
+    eq = _mm_cmpeq_epi32 (idx, mask);
+    px = _mm_or_si128 (_mm_andnot_si128 (eq, px), _mm_and_si128 (eq, p3));
+
+    _mm_storeu_si128 ((__m128i *)(out + row * 4), px);
+  }
+#else
+  for (int i = 0; i < 16; i++)
+    out [i] = pal [(bits >> (2 * i)) & 3];
+#endif
+}
+
+static void
+TZF_GetAlphaPalette (uint32_t a0, uint32_t a1, uint32_t pal [8])
+{
+  pal [0] = a0;
+  pal [1] = a1;
+
+  if (a0 > a1)
+  {
+    for (uint32_t i = 1; i < 7; i++)
+      pal [i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+  }
+
+  else
+  {
+    for (uint32_t i = 1; i < 5; i++)
+      pal [i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+
+    pal [6] = 0;
+    pal [7] = 255;
+  }
+}
+
+static void
+TZF_DecodeAlphaBlock (const uint8_t* block, uint32_t out [16])
+{
+  uint32_t pal [8];
+
+  TZF_GetAlphaPalette (block [0], block [1], pal);
+
+  uint64_t bits = 0;
+
+  for (int i = 7; i >= 2; i--)
+    bits = (bits << 8) | block [i];
+
+  for (int i = 0; i < 16; i++)
+    out [i] = (out [i] & 0x00FFFFFF) | (pal [(bits >> (3 * i)) & 7] << 24);
+}
+
+size_t
+TZF_GetBCLevelSize (tzf_bc_format_t fmt, uint32_t width, uint32_t height)
+{
+  size_t blocks_x = (width  + 3) / 4;
+  size_t blocks_y = (height + 3) / 4;
+
+  if (blocks_x == 0) blocks_x = 1;
+  if (blocks_y == 0) blocks_y = 1;
+
+  return blocks_x * blocks_y * (fmt == TZF_BC_FORMAT_BC1 ? 8 : 16);
+}
+
+void
+TZF_DecodeBCImage ( tzf_bc_format_t fmt,
+                    const uint8_t*  blocks,
+                    uint32_t        width,
+                    uint32_t        height,
+                    uint8_t*        pixels )
+{
+  const size_t block_size = fmt == TZF_BC_FORMAT_BC1 ? 8 : 16;
+
+  uint32_t texels [16];
+
+  for (uint32_t by = 0; by < height; by += 4)
+  {
+    for (uint32_t bx = 0; bx < width; bx += 4)
+    {
+      if (fmt == TZF_BC_FORMAT_BC1)
+        TZF_DecodeColorBlock (blocks, false, texels);
+
+      else
+      {
+        TZF_DecodeColorBlock (blocks + 8, true, texels);
+        TZF_DecodeAlphaBlock (blocks,           texels);
+      }
+
+      blocks += block_size;
+
+      for (uint32_t y = 0; y < 4 && by + y < height; y++)
+      {
+        uint32_t cols = width - bx < 4 ? width - bx : 4;
+
+        memcpy ( pixels + ((size_t)(by + y) * width + bx) * 4,
+                   texels + y * 4, cols * 4 );
+      }
+    }
+  }
+}
+
+//
+// Encoder
+//
+
+struct tzf_color_fit_s {
+  float e0 [3];  // R, G, B
+  float e1 [3];
+};
+
+static inline uint16_t
+to565 (const float c [3])
+{
+  auto q = [](float v, float levels) -> uint32_t {
+    v = v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+    return (uint32_t)(v * levels / 255.0f + 0.5f);
+  };
+
+  return (uint16_t)((q (c [0], 31.0f) << 11) | (q (c [1], 63.0f) << 5) | q (c [2], 31.0f));
+}
+
+// Squared RGB distance to each of count palette entries, nearest wins;
+//   returns the summed error
+static uint32_t
+TZF_SelectColorIndices ( const uint32_t px   [16],
+                         const uint32_t pal  [4],
+                         int            count,
+                         uint8_t        idx  [16] )
+{
+  uint32_t total = 0;
+
+#ifdef TZF_BCN_SSE2
+  const __m128i low8  = _mm_set1_epi32 (0xFF);
+  const __m128i low16 = _mm_set1_epi32 (0xFFFF);
+
+  for (int q = 0; q < 4; q++)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(px + q * 4));
+
+    __m128i b = _mm_and_si128 (v,                      low8);
+    __m128i g = _mm_and_si128 (_mm_srli_epi32 (v,  8), low8);
+    __m128i r = _mm_and_si128 (_mm_srli_epi32 (v, 16), low8);
+
+    __m128i best     = _mm_set1_epi32 (0x7FFFFFFF);
+    __m128i best_idx = _mm_setzero_si128 ();
+
+    for (int k = 0; k < count; k++)
+    {
+      __m128i db = _mm_sub_epi32 (b, _mm_set1_epi32 ((int)CH (pal [k],  0)));
+      __m128i dg = _mm_sub_epi32 (g, _mm_set1_epi32 ((int)CH (pal [k],  8)));
+      __m128i dr = _mm_sub_epi32 (r, _mm_set1_epi32 ((int)CH (pal [k], 16)));
+
+      // |d| <= 255, so the low 16 bits of the 16-bit product are d * d
+      __m128i dist =
+        _mm_add_epi32 (
+          _mm_add_epi32 ( _mm_and_si128 (_mm_mullo_epi16 (db, db), low16),
+                          _mm_and_si128 (_mm_mullo_epi16 (dg, dg), low16) ),
+                          _mm_and_si128 (_mm_mullo_epi16 (dr, dr), low16) );
+
+      __m128i closer = _mm_cmplt_epi32 (dist, best);
+
+      best     = _mm_or_si128 ( _mm_andnot_si128 (closer, best),
+                                _mm_and_si128    (closer, dist) );
+      best_idx = _mm_or_si128 ( _mm_andnot_si128 (closer, best_idx),
+                                _mm_and_si128    (closer, _mm_set1_epi32 (k)) );
+    }
+
+    uint32_t d [4], i [4];
+
+    _mm_storeu_si128 ((__m128i *)d, best);
+    _mm_storeu_si128 ((__m128i *)i, best_idx);
+
+    for (int n = 0; n < 4; n++)
+    {
+      idx [q * 4 + n] = (uint8_t)i [n];
+      total          += d [n];
+    }
+  }
+#else
+  for (int n = 0; n < 16; n++)
+  {
+    uint32_t best = 0xFFFFFFFF;
+
+    for (int k = 0; k < count; k++)
+    {
+      int db = (int)CH (px [n],  0) - (int)CH (pal [k],  0);
+      int dg = (int)CH (px [n],  8) - (int)CH (pal [k],  8);
+      int dr = (int)CH (px [n], 16) - (int)CH (pal [k], 16);
+
+      uint32_t dist = (uint32_t)(db * db + dg * dg + dr * dr);
+
+      if (dist < best)
+      {
+        best     = dist;
+        idx [n]  = (uint8_t)k;
+      }
+    }
+
+    total += best;
+  }
+#endif
+
+  return total;
+}
+
+// Endpoints for the texels whose mask entry is set
+static void
+TZF_FitColors ( const uint32_t   px   [16],
+                const bool       used [16],
+                int              quality,
+                tzf_color_fit_s* fit )
+{
+  float c [16][3];
+  int   n = 0;
+
+  float lo [3] = { 255.0f, 255.0f, 255.0f };
+  float hi [3] = {   0.0f,   0.0f,   0.0f };
+
+  for (int i = 0; i < 16; i++)
+  {
+    if (! used [i])
+      continue;
+
+    c [n][0] = (float)CH (px [i], 16);
+    c [n][1] = (float)CH (px [i],  8);
+    c [n][2] = (float)CH (px [i],  0);
+
+    for (int ch = 0; ch < 3; ch++)
+    {
+      lo [ch] = c [n][ch] < lo [ch] ? c [n][ch] : lo [ch];
+      hi [ch] = c [n][ch] > hi [ch] ? c [n][ch] : hi [ch];
+    }
+
+    ++n;
+  }
+
+  if (n == 0)
+  {
+    memset (fit, 0, sizeof (*fit));
+    return;
+  }
+
+  if (quality <= TZF_BC_QUALITY_FAST)
+  {
+    // Pull the box in a little; the extremes are rarely worth an endpoint
+    for (int ch = 0; ch < 3; ch++)
+    {
+      float inset = (hi [ch] - lo [ch]) / 16.0f;
+
+      fit->e0 [ch] = hi [ch] - inset;
+      fit->e1 [ch] = lo [ch] + inset;
+    }
+
+    return;
+  }
+
+  float mean [3] = { };
+
+  for (int i = 0; i < n; i++)
+    for (int ch = 0; ch < 3; ch++)
+      mean [ch] += c [i][ch] / n;
+
+  float cov [6] = { }; // rr rg rb gg gb bb
+
+  for (int i = 0; i < n; i++)
+  {
+    float d [3] = { c [i][0] - mean [0], c [i][1] - mean [1], c [i][2] - mean [2] };
+
+    cov [0] += d [0] * d [0]; cov [1] += d [0] * d [1]; cov [2] += d [0] * d [2];
+    cov [3] += d [1] * d [1]; cov [4] += d [1] * d [2]; cov [5] += d [2] * d [2];
+  }
+
+  // Power iteration from the box diagonal
+  float axis [3] = { hi [0] - lo [0], hi [1] - lo [1], hi [2] - lo [2] };
+
+  for (int iter = 0; iter < 8; iter++)
+  {
+    float x = cov [0] * axis [0] + cov [1] * axis [1] + cov [2] * axis [2];
+    float y = cov [1] * axis [0] + cov [3] * axis [1] + cov [4] * axis [2];
+    float z = cov [2] * axis [0] + cov [4] * axis [1] + cov [5] * axis [2];
+
+    float len = sqrtf (x * x + y * y + z * z);
+
+    if (len < 1e-6f)
+      break;
+
+    axis [0] = x / len; axis [1] = y / len; axis [2] = z / len;
+  }
+
+  float len = sqrtf (axis [0] * axis [0] + axis [1] * axis [1] + axis [2] * axis [2]);
+
+  if (len < 1e-6f)
+  {
+    for (int ch = 0; ch < 3; ch++)
+      fit->e0 [ch] = fit->e1 [ch] = mean [ch];
+
+    return;
+  }
+
+  for (int ch = 0; ch < 3; ch++)
+    axis [ch] /= len;
+
+  float t_min =  1e30f;
+  float t_max = -1e30f;
+
+  for (int i = 0; i < n; i++)
+  {
+    float t = (c [i][0] - mean [0]) * axis [0] +
+              (c [i][1] - mean [1]) * axis [1] +
+              (c [i][2] - mean [2]) * axis [2];
+
+    t_min = t < t_min ? t : t_min;
+    t_max = t > t_max ? t : t_max;
+  }
+
+  for (int ch = 0; ch < 3; ch++)
+  {
+    fit->e0 [ch] = mean [ch] + axis [ch] * t_max;
+    fit->e1 [ch] = mean [ch] + axis [ch] * t_min;
+  }
+}
+
+// Least-squares endpoints for a fixed set of 4-color indices
+static bool
+TZF_RefitColors (const uint32_t px [16], const uint8_t idx [16], tzf_color_fit_s* fit)
+{
+  static const float w0 [4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+  float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+  float ax [3] = { }, bx [3] = { };
+
+  for (int i = 0; i < 16; i++)
+  {
+    float a = w0 [idx [i]];
+    float b = 1.0f - a;
+
+    aa += a * a; bb += b * b; ab += a * b;
+
+    float c [3] = { (float)CH (px [i], 16), (float)CH (px [i], 8), (float)CH (px [i], 0) };
+
+    for (int ch = 0; ch < 3; ch++)
+    {
+      ax [ch] += a * c [ch];
+      bx [ch] += b * c [ch];
+    }
+  }
+
+  float det = aa * bb - ab * ab;
+
+  if (fabsf (det) < 1e-6f)
+    return false;
+
+  for (int ch = 0; ch < 3; ch++)
+  {
+    fit->e0 [ch] = (ax [ch] * bb - bx [ch] * ab) / det;
+    fit->e1 [ch] = (bx [ch] * aa - ax [ch] * ab) / det;
+  }
+
+  return true;
+}
+
+// Returns the error of the block as written
+static uint32_t
+TZF_EmitColorBlock ( const uint32_t         px   [16],
+                     const bool             used [16],
+                     const tzf_color_fit_s& fit,
+                     bool                   three_color,
+                     uint8_t*               out )
+{
+  uint16_t c0 = to565 (fit.e0);
+  uint16_t c1 = to565 (fit.e1);
+
+  // 4-color mode needs c0 > c1, 3-color mode c0 <= c1
+  if ((three_color && c0 > c1) || ((! three_color) && c0 < c1))
+  {
+    uint16_t swap = c0;
+    c0 = c1;
+    c1 = swap;
+  }
+
+  write16 (out,     c0);
+  write16 (out + 2, c1);
+
+  uint32_t pal [4];
+  uint8_t  idx [16];
+  uint32_t err = 0;
+
+  // c0 == c1 decodes as 3-color; index 0 alone is still exact
+  if ((! three_color) && c0 == c1)
+  {
+    memset (out + 4, 0, 4);
+
+    TZF_GetColorPalette (out, false, pal);
+
+    return TZF_SelectColorIndices (px, pal, 1, idx);
+  }
+
+  TZF_GetColorPalette (out, false, pal);
+
+  err = TZF_SelectColorIndices (px, pal, three_color ? 3 : 4, idx);
+
+  uint32_t bits = 0;
+
+  for (int i = 15; i >= 0; i--)
+    bits = (bits << 2) | (used [i] ? idx [i] : 3);
+
+  memcpy (out + 4, &bits, 4);
+
+  return err;
+}
+
+static void
+TZF_EncodeColorBlock ( const uint32_t px [16],
+                       bool           allow_alpha,
+                       int            quality,
+                       uint8_t*       out )
+{
+  bool used [16];
+  bool three_color = false;
+  int  opaque      = 0;
+
+  for (int i = 0; i < 16; i++)
+  {
+    used [i]     = (! allow_alpha) || (px [i] >> 24) >= 128;
+    three_color |= ! used [i];
+    opaque      += used [i] ? 1 : 0;
+  }
+
+  if (opaque == 0)
+  {
+    static const uint8_t transparent [8] = { 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+
+    memcpy (out, transparent, 8);
+    return;
+  }
+
+  tzf_color_fit_s fit;
+
+  TZF_FitColors (px, used, quality, &fit);
+
+  // The transparent texels are scored against the palette too; harmless,
+  //   they get index 3 whatever the score says
+  uint32_t err = TZF_EmitColorBlock (px, used, fit, three_color, out);
+
+  if (quality < TZF_BC_QUALITY_HIGH || three_color)
+    return;
+
+  for (int iter = 0; iter < 2 && err > 0; iter++)
+  {
+    uint32_t pal [4];
+    uint8_t  idx [16];
+    uint8_t  trial [8];
+
+    TZF_GetColorPalette (out, false, pal);
+
+    for (int i = 0; i < 16; i++)
+      idx [i] = (uint8_t)((read32 (out + 4) >> (2 * i)) & 3);
+
+    // Indices refer to the swapped order if EmitColorBlock swapped
+    tzf_color_fit_s refit;
+
+    if (! TZF_RefitColors (px, idx, &refit))
+      break;
+
+    uint32_t trial_err =
+      TZF_EmitColorBlock (px, used, refit, false, trial);
+
+    if (trial_err >= err)
+      break;
+
+    memcpy (out, trial, 8);
+    err = trial_err;
+  }
+}
+
+static uint32_t
+TZF_EmitAlphaBlock (const uint32_t px [16], uint32_t a0, uint32_t a1, uint8_t* out)
+{
+  uint32_t pal [8];
+
+  TZF_GetAlphaPalette (a0, a1, pal);
+
+  uint64_t bits = 0;
+  uint32_t err  = 0;
+
+  for (int i = 15; i >= 0; i--)
+  {
+    int      a    = (int)(px [i] >> 24);
+    uint32_t best = 0xFFFFFFFF;
+    uint32_t sel  = 0;
+
+    for (uint32_t k = 0; k < 8; k++)
+    {
+      uint32_t d = (uint32_t)((a - (int)pal [k]) * (a - (int)pal [k]));
+
+      if (d < best)
+      {
+        best = d;
+        sel  = k;
+      }
+    }
+
+    bits = (bits << 3) | sel;
+    err += best;
+  }
+
+  out [0] = (uint8_t)a0;
+  out [1] = (uint8_t)a1;
+
+  for (int i = 2; i < 8; i++, bits >>= 8)
+    out [i] = (uint8_t)(bits & 0xFF);
+
+  return err;
+}
+
+static void
+TZF_EncodeAlphaBlock (const uint32_t px [16], int quality, uint8_t* out)
+{
+  uint32_t lo = 255, hi = 0;
+  uint32_t inner_lo = 255, inner_hi = 0;
+
+  for (int i = 0; i < 16; i++)
+  {
+    uint32_t a = px [i] >> 24;
+
+    lo = a < lo ? a : lo;
+    hi = a > hi ? a : hi;
+
+    if (a != 0 && a != 255)
+    {
+      inner_lo = a < inner_lo ? a : inner_lo;
+      inner_hi = a > inner_hi ? a : inner_hi;
+    }
+  }
+
+  // 8 interpolated values between the extremes
+  uint32_t err =
+    TZF_EmitAlphaBlock (px, hi, lo, out);
+
+  if (quality < TZF_BC_QUALITY_NORMAL || err == 0 || (lo != 0 && hi != 255))
+    return;
+
+  // 6 between the values that are not fully transparent / opaque, with
+  //   0 and 255 exact
+  if (inner_lo > inner_hi)
+    inner_lo = inner_hi = (lo == 0 ? 0 : 255);
+
+  uint8_t trial [8];
+
+  if (TZF_EmitAlphaBlock (px, inner_lo, inner_hi, trial) < err)
+    memcpy (out, trial, 8);
+}
+
+void
+TZF_EncodeBCImage ( tzf_bc_format_t fmt,
+                    const uint8_t*  pixels,
+                    uint32_t        width,
+                    uint32_t        height,
+                    uint8_t*        blocks,
+                    int             quality )
+{
+  uint32_t px [16];
+
+  for (uint32_t by = 0; by < height; by += 4)
+  {
+    for (uint32_t bx = 0; bx < width; bx += 4)
+    {
+      for (uint32_t y = 0; y < 4; y++)
+      {
+        uint32_t sy = by + y < height ? by + y : height - 1;
+
+        for (uint32_t x = 0; x < 4; x++)
+        {
+          uint32_t sx = bx + x < width ? bx + x : width - 1;
+
+          px [y * 4 + x] = read32 (pixels + ((size_t)sy * width + sx) * 4);
+        }
+      }
+
+      if (fmt == TZF_BC_FORMAT_BC1)
+      {
+        TZF_EncodeColorBlock (px, true, quality, blocks);
+        blocks += 8;
+      }
+
+      else
+      {
+        TZF_EncodeAlphaBlock (px,              quality, blocks);
+        TZF_EncodeColorBlock (px, false,       quality, blocks + 8);
+        blocks += 16;
+      }
+    }
+  }
+}
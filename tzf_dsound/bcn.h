@@ -0,0 +1,71 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__BCN_H__
+#define __TZF__BCN_H__
+
+#include <cstdint>
+#include <cstddef>
+
+//
+// BC1 (DXT1) and BC3 (DXT5) blocks to and from 32-bit pixels laid out
+//   like D3DFMT_A8R8G8B8 (B, G, R, A in memory).  Decoding and the
+//     encoder's index search use SSE2 where the compiler has it.
+//       Shared with tzf_packbuild.
+//
+
+enum tzf_bc_format_t {
+  TZF_BC_FORMAT_BC1 = 1,  // 8 bytes per 4x4 block, 1-bit alpha
+  TZF_BC_FORMAT_BC3 = 3   // 16 bytes per 4x4 block, interpolated alpha
+};
+
+// Encoder effort; each step roughly halves throughput
+enum {
+  TZF_BC_QUALITY_FAST    = 0,  // Bounding box endpoints
+  TZF_BC_QUALITY_NORMAL  = 1,  // Principal axis endpoints
+  TZF_BC_QUALITY_HIGH    = 2   // Principal axis, then least-squares refit
+};
+
+// One mip level; partial blocks at the right and bottom edges count as whole
+size_t
+TZF_GetBCLevelSize  (tzf_bc_format_t fmt, uint32_t width, uint32_t height);
+
+// blocks -> width x height pixels, rows tightly packed
+void
+TZF_DecodeBCImage   ( tzf_bc_format_t fmt,
+                      const uint8_t*  blocks,
+                      uint32_t        width,
+                      uint32_t        height,
+                      uint8_t*        pixels );
+
+// pixels -> blocks; edge blocks repeat the last row / column.  BC1 blocks
+//   with any alpha below 128 use the 3-color mode with transparent texels.
+void
+TZF_EncodeBCImage   ( tzf_bc_format_t fmt,
+                      const uint8_t*  pixels,
+                      uint32_t        width,
+                      uint32_t        height,
+                      uint8_t*        blocks,
+                      int             quality );
+
+#endif /* __TZF__BCN_H__ */
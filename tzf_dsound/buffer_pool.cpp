@@ -0,0 +1,443 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "buffer_pool.h"
+#include "config.h"
+#include "log.h"
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+extern iSK_Logger* tex_log;
+
+// Free buffers a thread keeps for itself in each size class
+#define TZF_BUFFER_THREAD_SLOTS 2
+
+// Slots are swapped in and out with interlocked operations, so another
+//   thread can take them back when the pool is at its cap
+struct tzf_buffer_cache_s {
+  tzf_buffer_s* volatile slots [TZF_BUFFER_CLASSES][TZF_BUFFER_THREAD_SLOTS] = { };
+};
+
+static __declspec (thread) tzf_buffer_cache_s* tls_buffers = nullptr;
+
+static struct {
+  CRITICAL_SECTION                  cs;
+  std::vector <tzf_buffer_s*>       free [TZF_BUFFER_CLASSES];
+  std::vector <tzf_buffer_cache_s*> caches;  // Every thread's
+
+  struct {
+    volatile LONG64 leases       = 0LL;
+    volatile LONG64 thread_hits  = 0LL;
+    volatile LONG64 shared_hits  = 0LL;
+    volatile LONG64 heap_allocs  = 0LL;
+    volatile LONG64 over_cap     = 0LL;
+
+    volatile LONG64 leased_bytes = 0LL;
+    volatile LONG64 leased_peak  = 0LL;
+    volatile LONG64 total_bytes  = 0LL;
+    volatile LONG64 total_peak   = 0LL;
+  } stats;
+} buffer_pool;
+
+static bool
+TZF_InitBufferPool (void)
+{
+  InitializeCriticalSectionAndSpinCount (&buffer_pool.cs, 1000UL);
+  return true;
+}
+
+static bool buffer_pool_init = TZF_InitBufferPool ();
+
+
+static void
+TZF_RaisePeak (volatile LONG64* peak, LONG64 value)
+{
+  LONG64 seen = *peak;
+
+  while ( value > seen &&
+          InterlockedCompareExchange64 (peak, value, seen) != seen )
+    seen = *peak;
+}
+
+static int
+TZF_GetSizeClass (size_t len)
+{
+  for (int shift = TZF_BUFFER_MIN_SHIFT; shift <= TZF_BUFFER_MAX_SHIFT; shift++)
+  {
+    if (len <= ((size_t)1 << shift))
+      return shift - TZF_BUFFER_MIN_SHIFT;
+  }
+
+  return -1;
+}
+
+static void
+TZF_FreeBuffer (tzf_buffer_s* buf)
+{
+  InterlockedAdd64 (&buffer_pool.stats.total_bytes, -(LONG64)buf->capacity);
+
+  free   (buf->data);
+  delete  buf;
+}
+
+// Frees the largest idle shared buffer; false if there was none
+static bool
+TZF_EvictSharedBuffer (void)
+{
+  tzf_buffer_s* victim = nullptr;
+
+  EnterCriticalSection (&buffer_pool.cs);
+  {
+    for (int cls = TZF_BUFFER_CLASSES - 1; cls >= 0 && victim == nullptr; cls--)
+    {
+      if (! buffer_pool.free [cls].empty ())
+      {
+        victim = buffer_pool.free [cls].back ();
+                 buffer_pool.free [cls].pop_back ();
+      }
+    }
+  }
+  LeaveCriticalSection (&buffer_pool.cs);
+
+  if (victim == nullptr)
+    return false;
+
+  TZF_FreeBuffer (victim);
+
+  return true;
+}
+
+static tzf_buffer_s*
+TZF_TakeSlot (tzf_buffer_s* volatile* slot)
+{
+  return (tzf_buffer_s *)InterlockedExchangePointer ((PVOID volatile *)slot, nullptr);
+}
+
+// Moves what every thread has cached to the shared lists; false if all of
+//   them were empty.  Buffer pool lock held.
+static bool
+TZF_DrainThreadCachesLocked (void)
+{
+  bool moved = false;
+
+  for (auto cache : buffer_pool.caches)
+  {
+    for (int cls = 0; cls < TZF_BUFFER_CLASSES; cls++)
+    {
+      for (auto& slot : cache->slots [cls])
+      {
+        tzf_buffer_s* buf = TZF_TakeSlot (&slot);
+
+        if (buf != nullptr)
+        {
+          buffer_pool.free [cls].push_back (buf);
+          moved = true;
+        }
+      }
+    }
+  }
+
+  return moved;
+}
+
+static bool
+TZF_DrainThreadCaches (void)
+{
+  bool moved;
+
+  EnterCriticalSection (&buffer_pool.cs);
+  {
+    moved = TZF_DrainThreadCachesLocked ();
+  }
+  LeaveCriticalSection (&buffer_pool.cs);
+
+  return moved;
+}
+
+static bool
+TZF_ReserveBufferBytes (size_t bytes)
+{
+  const LONG64 cap =
+    (LONG64)std::max (0, config.textures.max_streaming_buffers_in_mib) * 1024LL * 1024LL;
+
+  for (;;)
+  {
+    LONG64 total = InterlockedAdd64 (&buffer_pool.stats.total_bytes, 0);
+
+    if (total + (LONG64)bytes <= cap)
+    {
+      if ( InterlockedCompareExchange64 ( &buffer_pool.stats.total_bytes,
+                                            total + (LONG64)bytes, total ) == total )
+      {
+        TZF_RaisePeak (&buffer_pool.stats.total_peak, total + (LONG64)bytes);
+        return true;
+      }
+    }
+
+    // Idle buffers parked in other threads' caches count too
+    else if ((! TZF_EvictSharedBuffer ()) && (! TZF_DrainThreadCaches ()))
+      return false;
+  }
+}
+
+tzf_buffer_s*
+TZF_LeaseBuffer (size_t len, bool past_cap)
+{
+  tzf_buffer_s* buf = nullptr;
+  int           cls = TZF_GetSizeClass (len);
+
+  if (cls >= 0)
+  {
+    if (tls_buffers == nullptr)
+    {
+      tls_buffers = new tzf_buffer_cache_s;
+
+      EnterCriticalSection (&buffer_pool.cs);
+      {
+        buffer_pool.caches.push_back (tls_buffers);
+      }
+      LeaveCriticalSection (&buffer_pool.cs);
+    }
+
+    for (auto& slot : tls_buffers->slots [cls])
+    {
+      if ((buf = TZF_TakeSlot (&slot)) != nullptr)
+      {
+        InterlockedIncrement64 (&buffer_pool.stats.thread_hits);
+        break;
+      }
+    }
+
+    if (buf == nullptr)
+    {
+      EnterCriticalSection (&buffer_pool.cs);
+      {
+        if (! buffer_pool.free [cls].empty ())
+        {
+          buf = buffer_pool.free [cls].back ();
+                buffer_pool.free [cls].pop_back ();
+        }
+      }
+      LeaveCriticalSection (&buffer_pool.cs);
+
+      if (buf != nullptr)
+        InterlockedIncrement64 (&buffer_pool.stats.shared_hits);
+    }
+  }
+
+  if (buf == nullptr)
+  {
+    size_t capacity =
+      cls >= 0 ? (size_t)1 << (cls + TZF_BUFFER_MIN_SHIFT) : len;
+
+    // Everything idle is gone and it is still over the cap, so this much is
+    //   leased.  Failing here would fail the texture (and drop it from the
+    //     injectable set); allocate exactly, once, and free it on return.
+    if (! TZF_ReserveBufferBytes (capacity))
+    {
+      if (! past_cap)
+        return nullptr;
+
+      capacity = len;
+      cls      = -1;
+
+      TZF_RaisePeak ( &buffer_pool.stats.total_peak,
+                        InterlockedAdd64 (&buffer_pool.stats.total_bytes, (LONG64)capacity) );
+
+      InterlockedIncrement64 (&buffer_pool.stats.over_cap);
+    }
+
+    void* data = malloc (capacity);
+
+    if (data == nullptr)
+    {
+      InterlockedAdd64 (&buffer_pool.stats.total_bytes, -(LONG64)capacity);
+      return nullptr;
+    }
+
+    buf = new tzf_buffer_s;
+
+    buf->data       = (uint8_t *)data;
+    buf->capacity   = capacity;
+    buf->size_class = cls;
+
+    InterlockedIncrement64 (&buffer_pool.stats.heap_allocs);
+  }
+
+  InterlockedIncrement64 (&buffer_pool.stats.leases);
+
+  TZF_RaisePeak ( &buffer_pool.stats.leased_peak,
+                    InterlockedAdd64 (&buffer_pool.stats.leased_bytes, (LONG64)buf->capacity) );
+
+  return buf;
+}
+
+void
+TZF_ReturnBuffer (tzf_buffer_s* buf)
+{
+  if (buf == nullptr)
+    return;
+
+  InterlockedAdd64 (&buffer_pool.stats.leased_bytes, -(LONG64)buf->capacity);
+
+  if (buf->size_class < 0)
+  {
+    TZF_FreeBuffer (buf);
+    return;
+  }
+
+  buf->returned = GetTickCount ();
+
+  if (tls_buffers != nullptr)
+  {
+    for (auto& slot : tls_buffers->slots [buf->size_class])
+    {
+      if ( InterlockedCompareExchangePointer ( (PVOID volatile *)&slot,
+                                                 buf, nullptr ) == nullptr )
+        return;
+    }
+  }
+
+  EnterCriticalSection (&buffer_pool.cs);
+  {
+    buffer_pool.free [buf->size_class].push_back (buf);
+  }
+  LeaveCriticalSection (&buffer_pool.cs);
+}
+
+static void
+TZF_SurrenderThreadCache (void)
+{
+  if (tls_buffers == nullptr)
+    return;
+
+  EnterCriticalSection (&buffer_pool.cs);
+  {
+    for (int cls = 0; cls < TZF_BUFFER_CLASSES; cls++)
+    {
+      for (auto& slot : tls_buffers->slots [cls])
+      {
+        tzf_buffer_s* buf = TZF_TakeSlot (&slot);
+
+        if (buf != nullptr)
+          buffer_pool.free [cls].push_back (buf);
+      }
+    }
+  }
+  LeaveCriticalSection (&buffer_pool.cs);
+}
+
+void
+TZF_TrimBufferPool (DWORD min_idle_ms)
+{
+  TZF_SurrenderThreadCache ();
+
+  std::vector <tzf_buffer_s *> idle;
+  DWORD                        now = GetTickCount ();
+
+  EnterCriticalSection (&buffer_pool.cs);
+  {
+    for (auto& list : buffer_pool.free)
+    {
+      auto keep =
+        std::partition ( list.begin (), list.end (),
+                           [&](tzf_buffer_s* buf) {
+                             return now - buf->returned < min_idle_ms;
+                           } );
+
+      idle.insert (idle.end (), keep, list.end ());
+      list.erase  (keep, list.end ());
+    }
+  }
+  LeaveCriticalSection (&buffer_pool.cs);
+
+  for (auto buf : idle)
+    TZF_FreeBuffer (buf);
+}
+
+void
+TZF_ReleaseThreadBuffers (void)
+{
+  TZF_SurrenderThreadCache ();
+
+  if (tls_buffers != nullptr)
+  {
+    EnterCriticalSection (&buffer_pool.cs);
+    {
+      buffer_pool.caches.erase (
+        std::remove ( buffer_pool.caches.begin (),
+                        buffer_pool.caches.end (), tls_buffers ),
+          buffer_pool.caches.end () );
+    }
+    LeaveCriticalSection (&buffer_pool.cs);
+  }
+
+  delete tls_buffers;
+         tls_buffers = nullptr;
+}
+
+tzf_buffer_pool_stats_s
+TZF_GetBufferPoolStats (void)
+{
+  tzf_buffer_pool_stats_s stats;
+
+  stats.leases       = InterlockedAdd64 (&buffer_pool.stats.leases,       0);
+  stats.thread_hits  = InterlockedAdd64 (&buffer_pool.stats.thread_hits,  0);
+  stats.shared_hits  = InterlockedAdd64 (&buffer_pool.stats.shared_hits,  0);
+  stats.heap_allocs  = InterlockedAdd64 (&buffer_pool.stats.heap_allocs,  0);
+  stats.over_cap     = InterlockedAdd64 (&buffer_pool.stats.over_cap,     0);
+  stats.leased_bytes = InterlockedAdd64 (&buffer_pool.stats.leased_bytes, 0);
+  stats.leased_peak  = InterlockedAdd64 (&buffer_pool.stats.leased_peak,  0);
+  stats.total_bytes  = InterlockedAdd64 (&buffer_pool.stats.total_bytes,  0);
+  stats.total_peak   = InterlockedAdd64 (&buffer_pool.stats.total_peak,   0);
+
+  return stats;
+}
+
+void
+TZF_LogBufferPoolStats (void)
+{
+  tzf_buffer_pool_stats_s stats =
+    TZF_GetBufferPoolStats ();
+
+  if (stats.leases == 0)
+    return;
+
+  tex_log->Log ( L"[ Buf. Pool] %7llu leases: %5.1f%% thread cache, %5.1f%% shared,"
+                 L" %llu heap allocations, %llu over the cap",
+                   stats.leases,
+                     100.0 * (double)stats.thread_hits / (double)stats.leases,
+                     100.0 * (double)stats.shared_hits / (double)stats.leases,
+                       stats.heap_allocs, stats.over_cap );
+
+  tex_log->Log ( L"[ Buf. Pool] High-water marks: %8.2f MiB leased, %8.2f MiB allocated"
+                 L" (cap: %li MiB)",
+                   (double)stats.leased_peak / (1024.0 * 1024.0),
+                   (double)stats.total_peak  / (1024.0 * 1024.0),
+                     config.textures.max_streaming_buffers_in_mib );
+}
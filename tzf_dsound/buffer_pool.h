@@ -0,0 +1,94 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__BUFFER_POOL_H__
+#define __TZF__BUFFER_POOL_H__
+
+#include <Windows.h>
+#include <cstdint>
+
+//
+// Decode and read buffers for texture streaming.
+//
+//   Leases are rounded up to a power of two between 64 KiB and 256 MiB.
+//     A returned buffer goes to the returning thread's cache (a couple per
+//       size class), or to a shared free list once that is full, so it can
+//         be leased on one thread and returned on another.  Larger leases
+//           are allocated exactly and freed on return.
+//
+//   Everything allocated, leased or idle, counts against
+//     TZFIX.Textures/MaxStreamingBuffersInMiB.  At the cap, idle shared
+//       buffers are freed first, then every thread's cache is drained into
+//         the shared lists and those are freed.  If what is leased is still
+//           over the cap, the lease is allocated exactly and freed on return
+//             rather than failing a valid texture.
+//
+#define TZF_BUFFER_MIN_SHIFT    16
+#define TZF_BUFFER_MAX_SHIFT    28
+#define TZF_BUFFER_CLASSES      (TZF_BUFFER_MAX_SHIFT - TZF_BUFFER_MIN_SHIFT + 1)
+
+struct tzf_buffer_s {
+  uint8_t* data       = nullptr;
+  size_t   capacity   = 0;    // At least what was asked for
+
+  int      size_class = -1;   // -1 if it was too large for any class
+  DWORD    returned   = 0UL;  // GetTickCount () when last returned
+};
+
+// nullptr only if the heap says no; with past_cap false, also rather than
+//   going over the cap (for copies that are only worth keeping if cheap)
+tzf_buffer_s*
+TZF_LeaseBuffer          (size_t len, bool past_cap = true);
+
+// From any thread
+void
+TZF_ReturnBuffer         (tzf_buffer_s* buf);
+
+// Hands the calling thread's cache to the shared lists, then frees shared
+//   buffers that have been idle for at least min_idle_ms.
+void
+TZF_TrimBufferPool       (DWORD min_idle_ms);
+
+// Called when a worker thread exits
+void
+TZF_ReleaseThreadBuffers (void);
+
+struct tzf_buffer_pool_stats_s {
+  uint64_t leases        = 0ULL;
+  uint64_t thread_hits   = 0ULL;   // Served from the leasing thread's cache
+  uint64_t shared_hits   = 0ULL;   // Served from a shared free list
+  uint64_t heap_allocs   = 0ULL;
+  uint64_t over_cap      = 0ULL;   // One-off allocations past the cap
+
+  uint64_t leased_bytes  = 0ULL;
+  uint64_t leased_peak   = 0ULL;
+  uint64_t total_bytes   = 0ULL;   // Leased + idle
+  uint64_t total_peak    = 0ULL;
+};
+
+tzf_buffer_pool_stats_s
+TZF_GetBufferPoolStats   (void);
+
+void
+TZF_LogBufferPoolStats   (void);
+
+#endif /* __TZF__BUFFER_POOL_H__ */
@@ -77,13 +77,45 @@ struct {
 
 struct {
   tzf::ParameterBool*    remaster;
+  tzf::ParameterStringW* mipmap_filter;
+  tzf::ParameterBool*    gamma_correct_mips;
+  tzf::ParameterInt*     remaster_bc_quality;
+  tzf::ParameterBool*    remaster_cache;
+  tzf::ParameterInt*     max_remaster_cache;
   tzf::ParameterBool*    cache;
   tzf::ParameterBool*    dump;
   tzf::ParameterInt*     cache_size;
   tzf::ParameterInt*     worker_threads;
+  tzf::ParameterBool*    map_archives;
+  tzf::ParameterBool*    map_loose_files;
+  tzf::ParameterInt*     max_mapped_size;
+  tzf::ParameterInt*     max_decoder_cache;
+  tzf::ParameterInt*     io_queue_depth;
+  tzf::ParameterBool*    overlapped_io;
+  tzf::ParameterInt*     max_stream_buffers;
+  tzf::ParameterInt*     max_in_flight;
+  tzf::ParameterBool*    speculative_prefetch;
+  tzf::ParameterInt*     max_speculative;
+  tzf::ParameterInt*     max_l2_cache;
+  tzf::ParameterBool*    compress_l2_cache;
+  tzf::ParameterBool*    fast_reset;
+  tzf::ParameterBool*    progressive;
+  tzf::ParameterInt*     progressive_min;
+  tzf::ParameterInt*     progressive_skip;
+  tzf::ParameterBool*    demote;
+  tzf::ParameterInt*     demote_mips;
+  tzf::ParameterInt*     demote_min;
+  tzf::ParameterInt*     promote_binds;
+  tzf::ParameterBool*    share_identical;
+  tzf::ParameterBool*    verify_packs;
+  tzf::ParameterBool*    decode_benchmark;
+  tzf::ParameterBool*    record_trace;
+  tzf::ParameterInt*     trace_scene_gap;
   tzf::ParameterFloat*   lod_bias;
   tzf::ParameterBool*    show_loading_text;
   tzf::ParameterBool*    dump_on_demand;
+  tzf::ParameterInt*     max_dump_queue;
+  tzf::ParameterBool*    dump_store;
 } textures;
 
 
@@ -449,6 +481,26 @@ TZF_LoadConfig (std::wstring name)
       L"TZFIX.Textures",
         L"Dump" );
 
+  textures.max_dump_queue =
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Dumped Textures (MiB) Waiting to be Written; 0 Writes Them Immediately")
+      );
+  textures.max_dump_queue->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxDumpQueueInMiB" );
+
+  textures.dump_store =
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Dump Each Distinct Texture Once, into a Content-Addressed Store")
+      );
+  textures.dump_store->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"DumpToStore" );
+
   textures.dump_on_demand =
     static_cast <tzf::ParameterBool *>
       (g_ParameterFactory.create_parameter <bool> (
@@ -469,6 +521,56 @@ TZF_LoadConfig (std::wstring name)
       L"TZFIX.Textures",
         L"Remaster" );
 
+  textures.mipmap_filter =
+    static_cast <tzf::ParameterStringW *>
+      (g_ParameterFactory.create_parameter <std::wstring> (
+        L"Mipmap Filter for Remastered Textures (Box, Triangle or D3DX)")
+      );
+  textures.mipmap_filter->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RemasterMipFilter" );
+
+  textures.gamma_correct_mips =
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Filter Remastered Mipmaps in Linear Light")
+      );
+  textures.gamma_correct_mips->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RemasterGammaCorrectMips" );
+
+  textures.remaster_bc_quality =
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"DXT Encoder Effort for Remastered Mipmaps (0-2)")
+      );
+  textures.remaster_bc_quality->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RemasterCompressionQuality" );
+
+  textures.remaster_cache =
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Keep Remastered Mipmaps on Disk Between Runs")
+      );
+  textures.remaster_cache->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RemasterDiskCache" );
+
+  textures.max_remaster_cache =
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Size Limit of the Remaster Disk Cache (MiB)")
+      );
+  textures.max_remaster_cache->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxRemasterCacheInMiB" );
+
   textures.show_loading_text =
     static_cast <tzf::ParameterBool *>
       (g_ParameterFactory.create_parameter <bool> (
@@ -509,6 +611,256 @@ TZF_LoadConfig (std::wstring name)
       L"TZFIX.Textures",
         L"WorkerThreads" );
 
+  textures.map_archives = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Memory-Map Texture Archives")
+      );
+  textures.map_archives->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MapArchives" );
+
+  textures.map_loose_files = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Memory-Map Loose Texture Files")
+      );
+  textures.map_loose_files->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MapLooseTextures" );
+
+  textures.max_mapped_size = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Address Space Reserved for Mapped Archives")
+      );
+  textures.max_mapped_size->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxMappedArchivesInMiB" );
+
+  textures.max_decoder_cache = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Decoder Memory Retained per Worker Thread")
+      );
+  textures.max_decoder_cache->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxDecoderCacheInKiB" );
+
+  textures.io_queue_depth = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Streaming Reads Kept in Flight")
+      );
+  textures.io_queue_depth->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"StreamingIOQueueDepth" );
+
+  textures.overlapped_io = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Use Overlapped I/O for Streaming Reads")
+      );
+  textures.overlapped_io->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"OverlappedIO" );
+
+  textures.max_stream_buffers = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Memory Kept for Streaming Decode Buffers")
+      );
+  textures.max_stream_buffers->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxStreamingBuffersInMiB" );
+
+  textures.max_in_flight = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Decode Memory Allowed in Flight While Streaming")
+      );
+  textures.max_in_flight->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxInFlightStreamingInMiB" );
+
+  textures.speculative_prefetch = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Stage Other Textures From Each Decoded Block")
+      );
+  textures.speculative_prefetch->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"SpeculativePrefetch" );
+
+  textures.max_speculative = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Memory Kept for Speculatively Staged Textures")
+      );
+  textures.max_speculative->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxSpeculativeCacheInMiB" );
+
+  textures.max_l2_cache = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"System Memory Kept for Purged Injected Textures")
+      );
+  textures.max_l2_cache->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"MaxL2CacheInMiB" );
+
+  textures.compress_l2_cache = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Compress the L2 Texture Cache")
+      );
+  textures.compress_l2_cache->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"CompressL2Cache" );
+
+  textures.fast_reset = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Restore Injected Textures from RAM after a Device Reset")
+      );
+  textures.fast_reset->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RestoreTexturesAfterReset" );
+
+  textures.progressive = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Stream Large Injected Textures at Low Resolution First (7z Only From the L2 Cache)")
+      );
+  textures.progressive->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"ProgressiveStreaming" );
+
+  textures.progressive_min = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Smallest Texture (KiB) Given a Low Resolution Pass")
+      );
+  textures.progressive_min->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"ProgressiveStreamingMinKiB" );
+
+  textures.progressive_skip = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Mip Levels Left Out of the Low Resolution Pass")
+      );
+  textures.progressive_skip->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"ProgressiveSkipMipLevels" );
+
+  textures.demote = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Drop Mip Levels of Idle Injected Textures before Evicting Any")
+      );
+  textures.demote->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"DemoteBeforeEvicting" );
+
+  textures.demote_mips = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Mip Levels Dropped by a Demotion")
+      );
+  textures.demote_mips->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"DemoteMipLevels" );
+
+  textures.demote_min = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Smallest Injected Texture (KiB) Worth Demoting")
+      );
+  textures.demote_min->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"DemoteMinKiB" );
+
+  textures.promote_binds = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Binds after which a Demoted Texture is Loaded in Full Again")
+      );
+  textures.promote_binds->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"PromoteAfterBinds" );
+
+  textures.share_identical = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Load Byte-Identical Textures Once")
+      );
+  textures.share_identical->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"ShareIdenticalTextures" );
+
+  textures.verify_packs = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Verify Texture Pack Checksums on Load")
+      );
+  textures.verify_packs->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"VerifyPackCRC" );
+
+  textures.decode_benchmark = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Time a Serial Decode After Each Archive in Textures.WarmArchives")
+      );
+  textures.decode_benchmark->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"DecodeBenchmark" );
+
+  textures.record_trace = 
+    static_cast <tzf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Record Texture Access Trace for Repacking")
+      );
+  textures.record_trace->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"RecordAccessTrace" );
+
+  textures.trace_scene_gap = 
+    static_cast <tzf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Idle Time that Starts a New Trace Scene")
+      );
+  textures.trace_scene_gap->register_to_ini (
+    dll_ini,
+      L"TZFIX.Textures",
+        L"AccessTraceSceneGapInMs" );
+
 
   gamepad.texture_set = 
     static_cast <tzf::ParameterStringW *>
@@ -665,11 +1017,43 @@ TZF_LoadConfig (std::wstring name)
   render.rescale_env_shadows->load (config.render.env_shadow_rescale);
 
   textures.remaster->load          (config.textures.remaster);
+  textures.mipmap_filter->load     (config.textures.mipmap_filter);
+  textures.gamma_correct_mips->load (config.textures.gamma_correct_mips);
+  textures.remaster_bc_quality->load (config.textures.remaster_bc_quality);
+  textures.remaster_cache->load    (config.textures.remaster_cache);
+  textures.max_remaster_cache->load (config.textures.max_remaster_cache_in_mib);
   textures.cache->load             (config.textures.cache);
   textures.dump->load              (config.textures.dump);
   textures.dump_on_demand->load    (config.textures.on_demand_dump);
+  textures.max_dump_queue->load    (config.textures.max_dump_queue_in_mib);
+  textures.dump_store->load        (config.textures.dump_store);
   textures.cache_size->load        (config.textures.max_cache_in_mib);
   textures.worker_threads->load    (config.textures.worker_threads);
+  textures.map_archives->load      (config.textures.map_archives);
+  textures.map_loose_files->load   (config.textures.map_loose_files);
+  textures.max_mapped_size->load   (config.textures.max_mapped_in_mib);
+  textures.max_decoder_cache->load (config.textures.max_decoder_cache_in_kib);
+  textures.io_queue_depth->load    (config.textures.io_queue_depth);
+  textures.overlapped_io->load     (config.textures.overlapped_io);
+  textures.max_stream_buffers->load (config.textures.max_streaming_buffers_in_mib);
+  textures.max_in_flight->load     (config.textures.max_in_flight_in_mib);
+  textures.speculative_prefetch->load (config.textures.speculative_prefetch);
+  textures.max_speculative->load   (config.textures.max_speculative_in_mib);
+  textures.max_l2_cache->load      (config.textures.max_l2_cache_in_mib);
+  textures.compress_l2_cache->load (config.textures.compress_l2_cache);
+  textures.fast_reset->load        (config.textures.fast_reset);
+  textures.progressive->load       (config.textures.progressive_streaming);
+  textures.progressive_min->load   (config.textures.progressive_min_in_kib);
+  textures.progressive_skip->load  (config.textures.progressive_skip_mips);
+  textures.demote->load            (config.textures.demote_before_evict);
+  textures.demote_mips->load       (config.textures.demote_mip_levels);
+  textures.demote_min->load        (config.textures.demote_min_in_kib);
+  textures.promote_binds->load     (config.textures.promote_after_binds);
+  textures.share_identical->load   (config.textures.share_identical);
+  textures.verify_packs->load      (config.textures.verify_packs);
+  textures.decode_benchmark->load  (config.textures.decode_benchmark);
+  textures.record_trace->load      (config.textures.record_access_trace);
+  textures.trace_scene_gap->load   (config.textures.trace_scene_gap_in_ms);
   textures.lod_bias->load          (config.textures.lod_bias);
   textures.show_loading_text->load (config.textures.show_loading_text);
 
@@ -736,11 +1120,43 @@ TZF_SaveConfig (std::wstring name, bool close_config)
   render.auto_apply_changes->store  (config.render.auto_apply_changes);
 
   textures.remaster->store          (config.textures.remaster);
+  textures.mipmap_filter->store     (config.textures.mipmap_filter);
+  textures.gamma_correct_mips->store (config.textures.gamma_correct_mips);
+  textures.remaster_bc_quality->store (config.textures.remaster_bc_quality);
+  textures.remaster_cache->store    (config.textures.remaster_cache);
+  textures.max_remaster_cache->store (config.textures.max_remaster_cache_in_mib);
   textures.cache->store             (config.textures.cache);
   textures.dump->store              (config.textures.dump);
   textures.dump_on_demand->store    (config.textures.on_demand_dump);
+  textures.max_dump_queue->store    (config.textures.max_dump_queue_in_mib);
+  textures.dump_store->store        (config.textures.dump_store);
   textures.cache_size->store        (config.textures.max_cache_in_mib);
   textures.worker_threads->store    (config.textures.worker_threads);
+  textures.map_archives->store      (config.textures.map_archives);
+  textures.map_loose_files->store   (config.textures.map_loose_files);
+  textures.max_mapped_size->store   (config.textures.max_mapped_in_mib);
+  textures.max_decoder_cache->store (config.textures.max_decoder_cache_in_kib);
+  textures.io_queue_depth->store    (config.textures.io_queue_depth);
+  textures.overlapped_io->store     (config.textures.overlapped_io);
+  textures.max_stream_buffers->store (config.textures.max_streaming_buffers_in_mib);
+  textures.max_in_flight->store     (config.textures.max_in_flight_in_mib);
+  textures.speculative_prefetch->store (config.textures.speculative_prefetch);
+  textures.max_speculative->store   (config.textures.max_speculative_in_mib);
+  textures.max_l2_cache->store      (config.textures.max_l2_cache_in_mib);
+  textures.compress_l2_cache->store (config.textures.compress_l2_cache);
+  textures.fast_reset->store        (config.textures.fast_reset);
+  textures.progressive->store       (config.textures.progressive_streaming);
+  textures.progressive_min->store   (config.textures.progressive_min_in_kib);
+  textures.progressive_skip->store  (config.textures.progressive_skip_mips);
+  textures.demote->store            (config.textures.demote_before_evict);
+  textures.demote_mips->store       (config.textures.demote_mip_levels);
+  textures.demote_min->store        (config.textures.demote_min_in_kib);
+  textures.promote_binds->store     (config.textures.promote_after_binds);
+  textures.share_identical->store   (config.textures.share_identical);
+  textures.verify_packs->store      (config.textures.verify_packs);
+  textures.decode_benchmark->store  (config.textures.decode_benchmark);
+  textures.record_trace->store      (config.textures.record_access_trace);
+  textures.trace_scene_gap->store   (config.textures.trace_scene_gap_in_ms);
   textures.lod_bias->store          (config.textures.lod_bias);
   textures.show_loading_text->store (config.textures.show_loading_text);
 
@@ -83,10 +83,55 @@ struct tzf_config_t
 
   struct {
     bool     dump                = false;
+    int32_t  max_dump_queue_in_mib
+                                 = 64L;
+    bool     dump_store          = false;
     bool     remaster            = false;
+    std::wstring
+             mipmap_filter       = L"Box";
+    bool     gamma_correct_mips  = false;
+    int32_t  remaster_bc_quality = 1L;
+    bool     remaster_cache      = true;
+    int32_t  max_remaster_cache_in_mib
+                                 = 256L;
     bool     cache               = true;
     int32_t  max_cache_in_mib    = 2048L;
     int32_t  worker_threads      = 6;
+    bool     map_archives        = true;
+    bool     map_loose_files     = true;
+    int32_t  max_mapped_in_mib   = 128L;
+    int32_t  max_decoder_cache_in_kib
+                                 = 2048L;
+    int32_t  io_queue_depth      = 8L;
+    bool     overlapped_io       = true;
+    int32_t  max_streaming_buffers_in_mib
+                                 = 128L;
+    int32_t  max_in_flight_in_mib
+                                 = 64L;
+    bool     speculative_prefetch
+                                 = false;
+    int32_t  max_speculative_in_mib
+                                 = 64L;
+    int32_t  max_l2_cache_in_mib = 64L;
+    bool     compress_l2_cache   = true;
+    bool     fast_reset          = true;
+    bool     progressive_streaming
+                                 = true;
+    int32_t  progressive_min_in_kib
+                                 = 4096L;
+    int32_t  progressive_skip_mips
+                                 = 2L;
+    bool     demote_before_evict = true;
+    int32_t  demote_mip_levels   = 2L;
+    int32_t  demote_min_in_kib   = 1024L;
+    int32_t  promote_after_binds = 120L;
+    bool     share_identical     = true;
+    bool     verify_packs        = false;
+    bool     decode_benchmark    = false;
+    bool     record_access_trace = false;
+    int32_t  trace_scene_gap_in_ms
+                                 = 2000L;
+
     bool     show_loading_text   = true;
     float    lod_bias            = 0.0f;
     std::wstring                 
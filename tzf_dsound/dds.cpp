@@ -0,0 +1,243 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include "dds.h"
+
+#include <cstring>
+
+// Offsets from the start of the file, magic included
+static const size_t   DDS_HEADER_SIZE   = 128;
+
+static const uint32_t DDS_MAGIC         = 0x20534444; // "DDS "
+static const uint32_t DX10_FOURCC       = 0x30315844; // "DX10"
+
+static const uint32_t DDSD_MIPMAPCOUNT  = 0x00020000;
+static const uint32_t DDSCAPS_COMPLEX   = 0x00000008;
+static const uint32_t DDSCAPS_MIPMAP    = 0x00400000;
+static const uint32_t DDSD_DEPTH        = 0x00800000;
+
+static const uint32_t DDPF_ALPHA        = 0x00000002;
+static const uint32_t DDPF_FOURCC       = 0x00000004;
+static const uint32_t DDPF_RGB          = 0x00000040;
+static const uint32_t DDPF_LUMINANCE    = 0x00020000;
+static const uint32_t DDPF_BUMPDUDV     = 0x00080000;
+static const uint32_t DDPF_ALPHAPIXELS  = 0x00000001;
+
+static const uint32_t DDSCAPS2_CUBEMAP  = 0x00000200;
+static const uint32_t DDSCAPS2_ALLFACES = 0x0000FC00;
+static const uint32_t DDSCAPS2_VOLUME   = 0x00200000;
+
+#define TZF_FOURCC(a,b,c,d) ( (uint32_t)(a)         | ((uint32_t)(b) << 8) | \
+                              ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24) )
+
+// D3DFORMAT values; d3d9.h is not available to tzf_packbuild everywhere
+enum {
+  FMT_R8G8B8       = 20,  FMT_A8R8G8B8      = 21,  FMT_X8R8G8B8    = 22,
+  FMT_R5G6B5       = 23,  FMT_X1R5G5B5      = 24,  FMT_A1R5G5B5    = 25,
+  FMT_A4R4G4B4     = 26,  FMT_R3G3B2        = 27,  FMT_A8          = 28,
+  FMT_A8R3G3B2     = 29,  FMT_X4R4G4B4      = 30,  FMT_A2B10G10R10 = 31,
+  FMT_A8B8G8R8     = 32,  FMT_X8B8G8R8      = 33,  FMT_G16R16      = 34,
+  FMT_A2R10G10B10  = 35,  FMT_A16B16G16R16  = 36,
+  FMT_L8           = 50,  FMT_A8L8          = 51,  FMT_A4L4        = 52,
+  FMT_V8U8         = 60,  FMT_Q8W8V8U8      = 63,  FMT_V16U16      = 64,
+  FMT_L16          = 81,
+  FMT_R16F         = 111, FMT_G16R16F       = 112, FMT_A16B16G16R16F = 113,
+  FMT_R32F         = 114, FMT_G32R32F       = 115, FMT_A32B32G32R32F = 116,
+
+  FMT_DXT1         = TZF_FOURCC ('D','X','T','1'),
+  FMT_DXT3         = TZF_FOURCC ('D','X','T','3'),
+  FMT_DXT5         = TZF_FOURCC ('D','X','T','5')
+};
+
+static inline uint32_t
+read32 (const uint8_t* p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof (v));
+  return v;
+}
+
+struct tzf_dds_mask_s {
+  uint32_t bits;
+  uint32_t r, g, b, a;
+  uint32_t format;
+};
+
+// The legacy pixel formats D3DX writes and reads, by flag family
+static const tzf_dds_mask_s rgb_formats [] = {
+  { 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000, FMT_A8R8G8B8    },
+  { 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000, FMT_X8R8G8B8    },
+  { 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, FMT_A8B8G8R8    },
+  { 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0x00000000, FMT_X8B8G8R8    },
+  { 32, 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000, FMT_A2R10G10B10 },
+  { 32, 0x000003FF, 0x000FFC00, 0x3FF00000, 0xC0000000, FMT_A2B10G10R10 },
+  { 32, 0x0000FFFF, 0xFFFF0000, 0x00000000, 0x00000000, FMT_G16R16      },
+  { 24, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000, FMT_R8G8B8      },
+  { 16, 0x0000F800, 0x000007E0, 0x0000001F, 0x00000000, FMT_R5G6B5      },
+  { 16, 0x00007C00, 0x000003E0, 0x0000001F, 0x00008000, FMT_A1R5G5B5    },
+  { 16, 0x00007C00, 0x000003E0, 0x0000001F, 0x00000000, FMT_X1R5G5B5    },
+  { 16, 0x00000F00, 0x000000F0, 0x0000000F, 0x0000F000, FMT_A4R4G4B4    },
+  { 16, 0x00000F00, 0x000000F0, 0x0000000F, 0x00000000, FMT_X4R4G4B4    },
+  { 16, 0x000000E0, 0x0000001C, 0x00000003, 0x0000FF00, FMT_A8R3G3B2    },
+  {  8, 0x000000E0, 0x0000001C, 0x00000003, 0x00000000, FMT_R3G3B2      }
+};
+
+static const tzf_dds_mask_s luminance_formats [] = {
+  {  8, 0x000000FF, 0x00000000, 0x00000000, 0x00000000, FMT_L8          },
+  { 16, 0x0000FFFF, 0x00000000, 0x00000000, 0x00000000, FMT_L16         },
+  { 16, 0x000000FF, 0x00000000, 0x00000000, 0x0000FF00, FMT_A8L8        },
+  {  8, 0x0000000F, 0x00000000, 0x00000000, 0x000000F0, FMT_A4L4        }
+};
+
+static const tzf_dds_mask_s bump_formats [] = {
+  { 16, 0x000000FF, 0x0000FF00, 0x00000000, 0x00000000, FMT_V8U8        },
+  { 32, 0x0000FFFF, 0xFFFF0000, 0x00000000, 0x00000000, FMT_V16U16      },
+  { 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, FMT_Q8W8V8U8    }
+};
+
+template <size_t N>
+static uint32_t
+TZF_MatchMasks (const tzf_dds_mask_s (&table) [N], const uint8_t* pf, bool alpha)
+{
+  uint32_t bits = read32 (pf + 12);
+  uint32_t r    = read32 (pf + 16);
+  uint32_t g    = read32 (pf + 20);
+  uint32_t b    = read32 (pf + 24);
+  uint32_t a    = alpha ? read32 (pf + 28) : 0;
+
+  for (const auto& fmt : table)
+  {
+    if ( fmt.bits == bits && fmt.r == r && fmt.g == g &&
+         fmt.b    == b    && fmt.a == a )
+      return fmt.format;
+  }
+
+  return 0;
+}
+
+bool
+TZF_ParseDDSHeader (const void* data, size_t size, tzf_dds_info_s* info)
+{
+  const uint8_t* p = (const uint8_t *)data;
+
+  if (p == nullptr || size < DDS_HEADER_SIZE || read32 (p) != DDS_MAGIC)
+    return false;
+
+  // Sizes of DDS_HEADER and DDS_PIXELFORMAT; D3DX rejects anything else
+  if (read32 (p + 4) != 124 || read32 (p + 76) != 32)
+    return false;
+
+  const uint8_t* pf = p + 76;
+
+  uint32_t flags    = read32 (p + 8);
+  uint32_t height   = read32 (p + 12);
+  uint32_t width    = read32 (p + 16);
+  uint32_t depth    = read32 (p + 24);
+  uint32_t mips     = read32 (p + 28);
+  uint32_t pf_flags = read32 (pf + 4);
+  uint32_t fourcc   = read32 (pf + 8);
+  uint32_t caps2    = read32 (p + 112);
+
+  tzf_dds_info_s out;
+
+  out.data_offset = (uint32_t)DDS_HEADER_SIZE;
+  out.cubemap     = (caps2 & DDSCAPS2_CUBEMAP) != 0;
+  out.volume      = (caps2 & DDSCAPS2_VOLUME)  != 0 && (flags & DDSD_DEPTH) != 0;
+
+  if (pf_flags & DDPF_FOURCC)
+  {
+    // D3DX9 cannot load a DX10 extended header, whatever its format
+    if (fourcc == DX10_FOURCC)
+      return false;
+
+    // Everything else, D3DFMT_DXTn and the numbered D3DFMT_ values
+    //   alike, is already the D3DFORMAT
+    out.format = fourcc;
+  }
+
+  else
+  {
+    bool alpha = (pf_flags & (DDPF_ALPHAPIXELS | DDPF_ALPHA)) != 0;
+
+    if (pf_flags & DDPF_RGB)
+      out.format = TZF_MatchMasks (rgb_formats,       pf, alpha);
+    else if (pf_flags & DDPF_LUMINANCE)
+      out.format = TZF_MatchMasks (luminance_formats, pf, alpha);
+    else if (pf_flags & DDPF_BUMPDUDV)
+      out.format = TZF_MatchMasks (bump_formats,      pf, alpha);
+    else if ((pf_flags & DDPF_ALPHA) && read32 (pf + 12) == 8)
+      out.format = FMT_A8;
+  }
+
+  if (out.format == 0 || width == 0 || height == 0)
+    return false;
+
+  // Partial cubemaps were a D3D7 thing; D3D9 cannot create one
+  if (out.cubemap && (caps2 & DDSCAPS2_ALLFACES) != DDSCAPS2_ALLFACES)
+    return false;
+
+  if (out.cubemap && (out.volume || width != height))
+    return false;
+
+  out.width  = width;
+  out.height = height;
+  out.depth  = (out.volume && depth != 0) ? depth : 1;
+
+  // Never more levels than it takes to reach 1x1x1
+  uint32_t largest = width > height ? width : height;
+           largest = largest > out.depth ? largest : out.depth;
+  uint32_t full    = 1;
+
+  while (largest > 1)
+  {
+    largest >>= 1;
+    ++full;
+  }
+
+  out.mip_levels = ((flags & DDSD_MIPMAPCOUNT) && mips != 0) ? mips : 1;
+
+  if (out.mip_levels > full)
+    out.mip_levels = full;
+
+  *info = out;
+
+  return true;
+}
+
+void
+TZF_SetDDSMipCount (void* data, uint32_t levels)
+{
+  uint8_t* p = (uint8_t *)data;
+
+  uint32_t flags = read32 (p + 8)   | DDSD_MIPMAPCOUNT;
+  uint32_t caps  = read32 (p + 108);
+
+  if (levels > 1)
+    caps |=   DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+  else
+    caps &= ~DDSCAPS_MIPMAP;
+
+  memcpy (p + 8,   &flags,  4);
+  memcpy (p + 28,  &levels, 4);
+  memcpy (p + 108, &caps,   4);
+}
@@ -0,0 +1,57 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__DDS_H__
+#define __TZF__DDS_H__
+
+#include <cstdint>
+#include <cstddef>
+
+//
+// Reads the DDS header in place; the same answers
+//   D3DXGetImageInfoFromFileInMemory (...) gives for a DDS file, without
+//     going through D3DX.  Shared with tzf_packbuild.
+//
+
+struct tzf_dds_info_s {
+  uint32_t width       = 0;
+  uint32_t height      = 0;
+  uint32_t depth       = 1;  // Volume textures only
+  uint32_t mip_levels  = 1;
+  uint32_t format      = 0;  // D3DFORMAT; FourCC or one of the D3DFMT_ values
+  bool     cubemap     = false;
+  bool     volume      = false;
+  uint32_t data_offset = 0;  // First byte of the top mip level
+};
+
+// False if this is not a DDS file, or one D3D9 has no format for (DX10
+//   extended headers included, which D3DX9 cannot load either); callers
+//     then ask D3DX, which also handles every other image file format.
+bool
+TZF_ParseDDSHeader (const void* data, size_t size, tzf_dds_info_s* info);
+
+// Marks a header TZF_ParseDDSHeader (...) accepted as having levels mip levels
+void
+TZF_SetDDSMipCount (void* data, uint32_t levels);
+
+#endif /* __TZF__DDS_H__ */
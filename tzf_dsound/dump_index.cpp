@@ -0,0 +1,394 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "dump_index.h"
+
+#include <cstring>
+#include <cwchar>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+
+#define TZF_DUMP_INDEX_MAGIC   0x49445A54UL // "TZDI"
+#define TZF_DUMP_INDEX_VERSION 1UL
+
+// A directory this recently written to may change again without its time
+//   moving (FAT keeps times to 2 seconds), so it is not trusted next run
+#define TZF_DUMP_INDEX_SETTLE  (4ULL * 10000000ULL) // FILETIME units
+
+typedef std::chrono::steady_clock tzf_dump_index_clock;
+
+struct tzf_dump_dir_s {
+  uint64_t               mtime = 0ULL;  // 0 never matches
+  uint64_t               bytes = 0ULL;
+  std::vector <uint32_t> checksums;
+};
+
+typedef std::map <std::wstring, tzf_dump_dir_s> tzf_dump_dirs_t;
+
+//
+// Header, then for each directory:
+//
+//   uint32 name_chars, uint32 files, uint64 mtime, uint64 bytes,
+//     wchar_t name [name_chars], uint32 checksums [files]
+//
+struct tzf_dump_index_header_s {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t dirs;
+};
+
+struct tzf_dump_index_dir_s {
+  uint32_t name_chars;
+  uint32_t files;
+  uint64_t mtime;
+  uint64_t bytes;
+};
+
+static double
+TZF_DumpIndexMs (tzf_dump_index_clock::time_point start)
+{
+  return
+    std::chrono::duration <double, std::milli> (tzf_dump_index_clock::now () - start).count ();
+}
+
+static uint64_t
+TZF_FileTimeToU64 (const FILETIME& ft)
+{
+  return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+// Anything short, damaged or from another version is the same as no manifest
+static bool
+TZF_ReadDumpManifest (const wchar_t* wszManifest, tzf_dump_dirs_t& dirs)
+{
+  HANDLE hFile =
+    CreateFileW ( wszManifest,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER         size = { 0 };
+  std::vector <uint8_t> data;
+  DWORD                 read = 0;
+
+  bool ok =
+    GetFileSizeEx (hFile, &size) && size.QuadPart < 0x40000000LL;
+
+  if (ok)
+  {
+    data.resize ((size_t)size.QuadPart);
+
+    ok = data.empty () ||
+         ( ReadFile (hFile, data.data (), (DWORD)data.size (), &read, nullptr) &&
+           read == data.size () );
+  }
+
+  CloseHandle (hFile);
+
+  tzf_dump_index_header_s header;
+
+  if ((! ok) || data.size () < sizeof (header))
+    return false;
+
+  memcpy (&header, data.data (), sizeof (header));
+
+  if ( header.magic   != TZF_DUMP_INDEX_MAGIC ||
+       header.version != TZF_DUMP_INDEX_VERSION )
+    return false;
+
+  size_t pos = sizeof (header);
+
+  for (uint32_t i = 0; i < header.dirs; i++)
+  {
+    tzf_dump_index_dir_s rec;
+
+    if (data.size () - pos < sizeof (rec))
+      break;
+
+    memcpy (&rec, data.data () + pos, sizeof (rec));
+    pos += sizeof (rec);
+
+    const uint64_t payload =
+      (uint64_t)rec.name_chars * sizeof (wchar_t) +
+      (uint64_t)rec.files      * sizeof (uint32_t);
+
+    if (rec.name_chars == 0 || rec.name_chars >= MAX_PATH || payload > data.size () - pos)
+      break;
+
+    std::wstring name (rec.name_chars, L'\0');
+
+    memcpy (&name [0], data.data () + pos, rec.name_chars * sizeof (wchar_t));
+    pos += rec.name_chars * sizeof (wchar_t);
+
+    tzf_dump_dir_s& dir = dirs [name];
+
+    dir.mtime = rec.mtime;
+    dir.bytes = rec.bytes;
+    dir.checksums.resize (rec.files);
+
+    if (rec.files > 0)
+      memcpy (dir.checksums.data (), data.data () + pos, rec.files * sizeof (uint32_t));
+
+    pos += rec.files * sizeof (uint32_t);
+  }
+
+  if (pos != data.size () || dirs.size () != header.dirs)
+  {
+    dirs.clear ();
+    return false;
+  }
+
+  return true;
+}
+
+// Through a temporary file; a torn manifest would only cost a full walk,
+//   but a rename is cheaper than finding that out
+static bool
+TZF_WriteDumpManifest (const wchar_t* wszManifest, const tzf_dump_dirs_t& dirs)
+{
+  std::vector <uint8_t> data;
+
+  auto append = [&](const void* src, size_t len) {
+    data.insert (data.end (), (const uint8_t *)src, (const uint8_t *)src + len);
+  };
+
+  tzf_dump_index_header_s header = { TZF_DUMP_INDEX_MAGIC,
+                                     TZF_DUMP_INDEX_VERSION,
+                                     (uint32_t)dirs.size () };
+
+  append (&header, sizeof (header));
+
+  for (const auto& it : dirs)
+  {
+    tzf_dump_index_dir_s rec = { (uint32_t)it.first.length (),
+                                 (uint32_t)it.second.checksums.size (),
+                                 it.second.mtime,
+                                 it.second.bytes };
+
+    append (&rec,                           sizeof (rec));
+    append (it.first.c_str (),              rec.name_chars * sizeof (wchar_t));
+    append (it.second.checksums.data (),    rec.files      * sizeof (uint32_t));
+  }
+
+  std::wstring temp = std::wstring (wszManifest) + L".tmp";
+
+  HANDLE hFile =
+    CreateFileW ( temp.c_str (),
+                    GENERIC_WRITE,
+                      0x00,
+                        nullptr,
+                          CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD written = 0;
+  bool  ok      =
+    WriteFile (hFile, data.data (), (DWORD)data.size (), &written, nullptr) &&
+    written == data.size ();
+
+  CloseHandle (hFile);
+
+  if (! (ok && MoveFileExW (temp.c_str (), wszManifest, MOVEFILE_REPLACE_EXISTING)))
+  {
+    DeleteFileW (temp.c_str ());
+    return false;
+  }
+
+  return true;
+}
+
+//
+// FindExInfoBasic skips the 8.3 names and a large fetch asks for bigger
+//   batches per call; on a directory of tens of thousands of files that is
+//     most of the cost of listing it.
+//
+static bool
+TZF_ListDumpDirectory ( const std::wstring&        dir,
+                        tzf_dump_dir_s&            out,
+                        const std::atomic <bool>*  cancel )
+{
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileExW ( (dir + L"\\*").c_str (),
+                         FindExInfoBasic,
+                           &fd,
+                             FindExSearchNameMatch,
+                               nullptr,
+                                 FIND_FIRST_EX_LARGE_FETCH );
+
+  if (hFind == INVALID_HANDLE_VALUE)
+    return true;
+
+  do
+  {
+    if (cancel != nullptr && cancel->load ())
+    {
+      FindClose (hFind);
+      return false;
+    }
+
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+
+    size_t   len      = wcslen (fd.cFileName);
+    wchar_t* end      = nullptr;
+    uint32_t checksum =
+      (uint32_t)wcstoul (fd.cFileName, &end, 16);
+
+    // <checksum>.dds, and nothing the writer left half done (.dds.tmp)
+    if ( len < 5 || _wcsicmp (fd.cFileName + len - 4, L".dds") ||
+         end != fd.cFileName + len - 4 )
+      continue;
+
+    out.checksums.push_back (checksum);
+    out.bytes += ((uint64_t)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+  } while (FindNextFileW (hFind, &fd));
+
+  FindClose (hFind);
+
+  return true;
+}
+
+bool
+TZF_ScanDumpTree ( const wchar_t*                  wszRoot,
+                   const wchar_t*                  wszManifest,
+                   std::unordered_set <uint32_t>&  checksums,
+                   tzf_dump_scan_stats_s*          stats,
+                   const std::atomic <bool>*       cancel )
+{
+  tzf_dump_scan_stats_s scan;
+
+  auto start = tzf_dump_index_clock::now ();
+
+  tzf_dump_dirs_t known;
+
+  if (wszManifest != nullptr)
+    TZF_ReadDumpManifest (wszManifest, known);
+
+  scan.load_ms = TZF_DumpIndexMs (start);
+
+  FILETIME now_ft;
+  GetSystemTimeAsFileTime (&now_ft);
+
+  const uint64_t now    = TZF_FileTimeToU64 (now_ft);
+  const size_t   before = known.size ();
+
+  tzf_dump_dirs_t found;
+  bool            complete = true;
+  bool            changed  = false;
+
+  std::wstring     root (wszRoot);
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileW ((root + L"\\*").c_str (), &fd);
+
+  if (hFind != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      if ( (! (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) ||
+           (! wcscmp (fd.cFileName, L".")) || (! wcscmp (fd.cFileName, L"..")) )
+        continue;
+
+      std::wstring path = root + L"\\" + fd.cFileName;
+
+      // The parent's copy of this (what FindFirstFileW returned) can lag
+      //   behind; the directory's own record cannot
+      WIN32_FILE_ATTRIBUTE_DATA attr;
+
+      if (! GetFileAttributesExW (path.c_str (), GetFileExInfoStandard, &attr))
+        continue;
+
+      const uint64_t mtime = TZF_FileTimeToU64 (attr.ftLastWriteTime);
+
+      auto it = known.find (fd.cFileName);
+
+      if (it != known.end () && it->second.mtime == mtime && mtime != 0ULL)
+      {
+        found [fd.cFileName] = std::move (it->second);
+        scan.reused++;
+        continue;
+      }
+
+      // The time is read before listing, so a file added meanwhile moves
+      //   it past what gets recorded
+      tzf_dump_dir_s& dir = found [fd.cFileName];
+
+      dir.mtime = (now - mtime < TZF_DUMP_INDEX_SETTLE) ? 0ULL : mtime;
+      changed   = true;
+
+      if (! TZF_ListDumpDirectory (path, dir, cancel))
+      {
+        complete = false;
+        break;
+      }
+
+      scan.listed += dir.checksums.size ();
+    } while (FindNextFileW (hFind, &fd));
+
+    FindClose (hFind);
+  }
+
+  // A directory that went away
+  if (scan.reused != before)
+    changed = true;
+
+  for (const auto& it : found)
+  {
+    checksums.insert (it.second.checksums.begin (), it.second.checksums.end ());
+
+    scan.directories++;
+    scan.files += it.second.checksums.size ();
+    scan.bytes += it.second.bytes;
+  }
+
+  if (complete && changed && wszManifest != nullptr)
+  {
+    auto save = tzf_dump_index_clock::now ();
+
+    scan.saved   = TZF_WriteDumpManifest (wszManifest, found);
+    scan.save_ms = TZF_DumpIndexMs       (save);
+  }
+
+  scan.scan_ms = TZF_DumpIndexMs (start);
+
+  if (stats != nullptr)
+    *stats = scan;
+
+  return complete;
+}
@@ -0,0 +1,66 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__DUMP_INDEX_H__
+#define __TZF__DUMP_INDEX_H__
+
+#include <cstdint>
+#include <atomic>
+#include <unordered_set>
+
+//
+// Finds what has already been dumped without listing every file.
+//
+//   The manifest keeps one record per format directory (DXT1, A8R8G8B8, ...)
+//     holding that directory's last-write time and the checksums in it.  A
+//       directory whose time still matches is taken from the manifest and
+//         only the others are listed again.
+//
+//   Creating, deleting or renaming a file moves its directory's time, so
+//     this sees anything the dumper or Explorer does.  Editing a file in
+//       place does not, but only names matter here.
+//
+
+struct tzf_dump_scan_stats_s {
+  uint32_t directories = 0UL;
+  uint32_t reused      = 0UL;   // Taken from the manifest as they were
+  uint64_t files       = 0ULL;
+  uint64_t bytes       = 0ULL;
+  uint64_t listed      = 0ULL;  // Files in directories that had to be listed
+  double   load_ms     = 0.0;
+  double   scan_ms     = 0.0;   // Everything, load_ms included
+  double   save_ms     = 0.0;
+  bool     saved       = false; // Something had changed since the manifest
+};
+
+// Every <checksum>.dds one level below wszRoot.  wszManifest is read first
+//   and rewritten if anything changed; it may be nullptr (a full walk).  False
+//     if cancel was set, in which case checksums is incomplete.
+bool
+TZF_ScanDumpTree ( const wchar_t*                  wszRoot,
+                   const wchar_t*                  wszManifest,
+                   std::unordered_set <uint32_t>&  checksums,
+                   tzf_dump_scan_stats_s*          stats,
+                   const std::atomic <bool>*       cancel = nullptr );
+
+#endif /* __TZF__DUMP_INDEX_H__ */
@@ -0,0 +1,433 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#define NOMINMAX
+
+#include <Windows.h>
+#include <process.h>
+
+#include "dump_queue.h"
+#include "config.h"
+#include "log.h"
+
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <unordered_set>
+
+extern iSK_Logger* tex_log;
+
+typedef BOOL(WINAPI *QueryPerformanceCounter_t)(_Out_ LARGE_INTEGER *lpPerformanceCount);
+extern QueryPerformanceCounter_t QueryPerformanceCounter_Original;
+
+struct tzf_dump_s {
+  std::wstring          path;
+  std::vector <uint8_t> data;
+  bool                  keep_existing = false;
+
+  // Set instead of path by TZF_QueueDumpTo (...)
+  tzf_dump_write_pfn    write    = nullptr;
+  uint32_t              checksum = 0UL;
+  uint32_t              format   = 0UL;
+};
+
+static struct {
+  CRITICAL_SECTION                    cs;
+  HANDLE                              wake    = nullptr; // Queued, or stopping
+  HANDLE                              drained = nullptr; // A file was finished
+  HANDLE                              thread  = nullptr;
+  bool                                stop    = false;
+
+  std::deque         <tzf_dump_s>     pending;
+  std::unordered_set <std::wstring>   dirs;              // Known to exist
+
+  tzf_dump_queue_stats_s              stats;
+} dump_queue;
+
+static bool
+TZF_InitDumpQueue (void)
+{
+  InitializeCriticalSectionAndSpinCount (&dump_queue.cs, 1000UL);
+
+  dump_queue.wake    = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+  dump_queue.drained = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+
+  return true;
+}
+
+static bool dump_queue_init = TZF_InitDumpQueue ();
+
+
+static uint64_t
+TZF_GetDumpQueueCap (void)
+{
+  return (uint64_t)std::max (0, config.textures.max_dump_queue_in_mib) * 1024ULL * 1024ULL;
+}
+
+// Parents first; each directory is only ever asked for once
+void
+TZF_CreateDumpDirectory (const std::wstring& dir)
+{
+  bool known = false;
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    known = (dump_queue.dirs.count (dir) != 0);
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+
+  if (known)
+    return;
+
+  size_t sep = dir.find_last_of (L'\\');
+
+  if (sep != std::wstring::npos && sep != 0)
+    TZF_CreateDumpDirectory (dir.substr (0, sep));
+
+  // Fails harmlessly if it is already there
+  CreateDirectoryW (dir.c_str (), nullptr);
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    if (dump_queue.dirs.insert (dir).second)
+      dump_queue.stats.directories++;
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+}
+
+bool
+TZF_WriteDumpFile (const std::wstring& path, const std::vector <uint8_t>& data)
+{
+  std::wstring temp = path + L".tmp";
+
+  HANDLE hFile =
+    CreateFileW ( temp.c_str (),
+                    GENERIC_WRITE,
+                      0x00,
+                        nullptr,
+                          CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD written = 0;
+  bool  ok      =
+    WriteFile (hFile, data.data (), (DWORD)data.size (), &written, nullptr) &&
+    written == data.size ();
+
+  CloseHandle (hFile);
+
+  // A partly written file must never be found under the real name
+  if (! (ok && MoveFileExW (temp.c_str (), path.c_str (), MOVEFILE_REPLACE_EXISTING)))
+  {
+    DeleteFileW (temp.c_str ());
+    return false;
+  }
+
+  return true;
+}
+
+static void
+TZF_WriteDump (const tzf_dump_s& dump)
+{
+  LARGE_INTEGER start, end, freq;
+
+  QueryPerformanceFrequency        (&freq);
+  QueryPerformanceCounter_Original (&start);
+
+  bool ok   = false;
+  bool kept = false;
+
+  if (dump.write != nullptr)
+  {
+    ok = dump.write (dump.checksum, dump.format, dump.data);
+
+    QueryPerformanceCounter_Original (&end);
+
+    if (! ok)
+      tex_log->Log (L"[ Dump Tex ] Could not store texture %08x", dump.checksum);
+  }
+
+  // Queued before anyone knew whether it was already there
+  else if ( dump.keep_existing &&
+            GetFileAttributesW (dump.path.c_str ()) != INVALID_FILE_ATTRIBUTES )
+  {
+    QueryPerformanceCounter_Original (&end);
+
+    ok   = true;
+    kept = true;
+  }
+
+  else
+  {
+    size_t sep = dump.path.find_last_of (L'\\');
+
+    if (sep != std::wstring::npos)
+      TZF_CreateDumpDirectory (dump.path.substr (0, sep));
+
+    ok = TZF_WriteDumpFile (dump.path, dump.data);
+
+    QueryPerformanceCounter_Original (&end);
+
+    if (! ok)
+      tex_log->Log (L"[ Dump Tex ] Could not write %s", dump.path.c_str ());
+  }
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    if (kept)
+      dump_queue.stats.kept++;
+
+    else if (ok)
+    {
+      dump_queue.stats.written++;
+      dump_queue.stats.bytes_written += dump.data.size ();
+    }
+
+    else
+      dump_queue.stats.failed++;
+
+    dump_queue.stats.write_ms      +=
+      1000.0 * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+    dump_queue.stats.backlog       -= 1;
+    dump_queue.stats.backlog_bytes -= dump.data.size ();
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+
+  SetEvent (dump_queue.drained);
+}
+
+//
+// Takes everything queued at once, so a burst of dumps (a new area, a menu)
+//   is written back to back without a round trip through the queue for
+//     every file.
+//
+static unsigned int
+__stdcall
+TZF_DumpWriterThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  bool stop = false;
+
+  while (! stop)
+  {
+    WaitForSingleObject (dump_queue.wake, INFINITE);
+
+    for (;;)
+    {
+      std::deque <tzf_dump_s> batch;
+
+      EnterCriticalSection (&dump_queue.cs);
+      {
+        batch.swap (dump_queue.pending);
+        stop = dump_queue.stop;
+
+        if (! batch.empty ())
+          dump_queue.stats.batches++;
+      }
+      LeaveCriticalSection (&dump_queue.cs);
+
+      if (batch.empty ())
+        break;
+
+      SetThreadPriority ( GetCurrentThread (),
+                            THREAD_MODE_BACKGROUND_BEGIN );
+
+      for ( auto& dump : batch )
+        TZF_WriteDump (dump);
+
+      SetThreadPriority ( GetCurrentThread (),
+                            THREAD_MODE_BACKGROUND_END );
+    }
+  }
+
+  return 0;
+}
+
+static void
+TZF_PostDump (tzf_dump_s& dump)
+{
+  const uint64_t cap = TZF_GetDumpQueueCap ();
+
+  EnterCriticalSection (&dump_queue.cs);
+
+  dump_queue.stats.queued++;
+  dump_queue.stats.backlog++;
+  dump_queue.stats.backlog_bytes += dump.data.size ();
+
+  // Started with the first dump; most sessions never make one
+  if (cap != 0 && dump_queue.thread == nullptr && (! dump_queue.stop))
+  {
+    dump_queue.thread =
+      (HANDLE)_beginthreadex ( nullptr,
+                                 0,
+                                   TZF_DumpWriterThread,
+                                     nullptr,
+                                       0x00,
+                                         nullptr );
+  }
+
+  // Disabled, shut down, or the thread could not be started
+  if (cap == 0 || dump_queue.stop || dump_queue.thread == nullptr)
+  {
+    LeaveCriticalSection (&dump_queue.cs);
+
+    TZF_WriteDump (dump);
+    return;
+  }
+
+  // Full; waits rather than dropping anything.  What was already queued
+  //   still fits, so the writer is guaranteed to get to this one.
+  if (dump_queue.stats.backlog_bytes - dump.data.size () > cap)
+  {
+    dump_queue.stats.stalls++;
+
+    while ( dump_queue.stats.backlog_bytes - dump.data.size () > cap &&
+            dump_queue.thread != nullptr )
+    {
+      LeaveCriticalSection (&dump_queue.cs);
+      WaitForSingleObject  (dump_queue.drained, 100UL);
+      EnterCriticalSection (&dump_queue.cs);
+    }
+  }
+
+  dump_queue.pending.push_back (std::move (dump));
+
+  LeaveCriticalSection (&dump_queue.cs);
+
+  SetEvent (dump_queue.wake);
+}
+
+void
+TZF_QueueDump ( const wchar_t*         wszPath,
+                std::vector <uint8_t>& data,
+                bool                   keep_existing )
+{
+  tzf_dump_s dump;
+
+  dump.path          = wszPath;
+  dump.keep_existing = keep_existing;
+  dump.data.swap (data);
+
+  TZF_PostDump (dump);
+}
+
+void
+TZF_QueueDumpTo ( tzf_dump_write_pfn     write,
+                  uint32_t               checksum,
+                  uint32_t               format,
+                  std::vector <uint8_t>& data )
+{
+  tzf_dump_s dump;
+
+  dump.write    = write;
+  dump.checksum = checksum;
+  dump.format   = format;
+  dump.data.swap (data);
+
+  TZF_PostDump (dump);
+}
+
+void
+TZF_WaitForDumps (void)
+{
+  EnterCriticalSection (&dump_queue.cs);
+
+  while (dump_queue.stats.backlog != 0)
+  {
+    LeaveCriticalSection (&dump_queue.cs);
+    WaitForSingleObject  (dump_queue.drained, 100UL);
+    EnterCriticalSection (&dump_queue.cs);
+  }
+
+  LeaveCriticalSection (&dump_queue.cs);
+}
+
+void
+TZF_ShutdownDumpQueue (void)
+{
+  HANDLE thread = nullptr;
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    dump_queue.stop = true;
+    thread          = dump_queue.thread;
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+
+  if (thread == nullptr)
+    return;
+
+  SetEvent            (dump_queue.wake);
+  WaitForSingleObject (thread, INFINITE);
+  CloseHandle         (thread);
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    dump_queue.thread = nullptr;
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+}
+
+tzf_dump_queue_stats_s
+TZF_GetDumpQueueStats (void)
+{
+  tzf_dump_queue_stats_s stats;
+
+  EnterCriticalSection (&dump_queue.cs);
+  {
+    stats = dump_queue.stats;
+  }
+  LeaveCriticalSection (&dump_queue.cs);
+
+  return stats;
+}
+
+void
+TZF_LogDumpQueueStats (void)
+{
+  tzf_dump_queue_stats_s stats =
+    TZF_GetDumpQueueStats ();
+
+  if (stats.queued == 0)
+    return;
+
+  tex_log->Log ( L"[ Dump Tex ] %7llu textures written (%9.2f MiB) in %llu batches,"
+                 L" %9.2f ms spent writing; %llu failed, %llu already on disk",
+                   stats.written,
+                     (double)stats.bytes_written / (1024.0 * 1024.0),
+                       stats.batches,
+                         stats.write_ms,
+                           stats.failed,
+                             stats.kept );
+
+  tex_log->Log ( L"[ Dump Tex ] %7lu directories created, queue full %llu times,"
+                 L" %zu textures never written",
+                   stats.directories,
+                     stats.stalls,
+                       stats.backlog );
+}
@@ -0,0 +1,99 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__DUMP_QUEUE_H__
+#define __TZF__DUMP_QUEUE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// Texture dumps are written by a background thread.  The render thread only
+//   snapshots a texture into memory and queues the bytes; the writer creates
+//     each directory once per session and writes whatever has piled up in
+//       one batch.
+//
+//   Nothing is ever dropped: once TZFIX.Textures/MaxDumpQueueInMiB is
+//     queued, TZF_QueueDump (...) waits for the writer to catch up.  With
+//       the limit at 0, files are written on the calling thread as before.
+//
+
+// Takes data; wszPath's directory (and its parents) are created if missing.
+//   With keep_existing, a file already at wszPath is left as it is.
+void
+TZF_QueueDump           ( const wchar_t*         wszPath,
+                          std::vector <uint8_t>& data,
+                          bool                   keep_existing = false );
+
+// Called on the writer thread in place of writing a file; false on failure
+typedef bool (*tzf_dump_write_pfn)( uint32_t                     checksum,
+                                    uint32_t                     format,
+                                    const std::vector <uint8_t>& data );
+
+// Same as above, but write decides where (and whether) data goes
+void
+TZF_QueueDumpTo         ( tzf_dump_write_pfn     write,
+                          uint32_t               checksum,
+                          uint32_t               format,
+                          std::vector <uint8_t>& data );
+
+// Parents first; remembered, so asking again costs nothing
+void
+TZF_CreateDumpDirectory (const std::wstring& dir);
+
+// Through a temporary file, so a partly written one is never left behind
+bool
+TZF_WriteDumpFile       (const std::wstring& path, const std::vector <uint8_t>& data);
+
+// Returns once everything queued so far is on disk
+void
+TZF_WaitForDumps        (void);
+
+// Writes everything still queued, then stops the writer
+void
+TZF_ShutdownDumpQueue   (void);
+
+struct tzf_dump_queue_stats_s {
+  uint64_t queued        = 0ULL;
+  uint64_t written       = 0ULL;
+  uint64_t failed        = 0ULL;
+  uint64_t kept          = 0ULL;  // Already on disk (keep_existing)
+  uint64_t bytes_written = 0ULL;
+  double   write_ms      = 0.0;   // Spent by the writer, not the render thread
+  uint64_t batches       = 0ULL;
+  uint64_t stalls        = 0ULL;  // Times the queue was full
+  uint32_t directories   = 0UL;   // Created (or found) by the writer
+
+  size_t   backlog       = 0;     // Queued and not yet on disk
+  uint64_t backlog_bytes = 0ULL;
+};
+
+tzf_dump_queue_stats_s
+TZF_GetDumpQueueStats   (void);
+
+void
+TZF_LogDumpQueueStats   (void);
+
+#endif /* __TZF__DUMP_QUEUE_H__ */
@@ -0,0 +1,450 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "dump_store.h"
+#include "dump_queue.h"
+#include "config.h"
+#include "log.h"
+
+#include "lzma/XzCrc64.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#define TZF_DUMP_STORE_DIR      L"TZFix_Res\\dump\\store"
+#define TZF_DUMP_STORE_MANIFEST TZF_DUMP_STORE_DIR L"\\manifest.tzd"
+
+#define TZF_DUMP_STORE_MAGIC    0x4D445A54UL // "TZDM"
+#define TZF_DUMP_STORE_VERSION  1UL
+
+extern iSK_Logger* tex_log;
+
+typedef BOOL(WINAPI *QueryPerformanceCounter_t)(_Out_ LARGE_INTEGER *lpPerformanceCount);
+extern QueryPerformanceCounter_t QueryPerformanceCounter_Original;
+
+// Exactly what follows the 8-byte header in manifest.tzd, once per record
+static_assert (sizeof (tzf_dump_record_s) == 24, "Manifest record layout changed");
+
+static struct {
+  CRITICAL_SECTION                                    cs;
+  bool                                                opened   = false;
+  HANDLE                                              manifest = INVALID_HANDLE_VALUE;
+
+  std::unordered_map <uint32_t, tzf_dump_record_s>    records;
+  std::unordered_map <uint64_t, uint64_t>             payloads; // Hash -> size
+
+  tzf_dump_store_stats_s                              stats;
+} dump_store;
+
+static bool
+TZF_InitDumpStore (void)
+{
+  InitializeCriticalSectionAndSpinCount (&dump_store.cs, 1000UL);
+  Crc64GenerateTable                    ();
+
+  return true;
+}
+
+static bool dump_store_init = TZF_InitDumpStore ();
+
+
+static void
+TZF_GetStoredDumpPath (uint64_t hash, wchar_t* wszPath)
+{
+  _swprintf ( wszPath, L"%s\\%016llx.dds",
+                TZF_DUMP_STORE_DIR,
+                  hash );
+}
+
+// Caller holds dump_store.cs
+static void
+TZF_ApplyDumpRecord (const tzf_dump_record_s& record)
+{
+  if (record.size == 0)
+    dump_store.records.erase (record.checksum);
+
+  else
+  {
+    dump_store.records  [record.checksum] = record;
+    dump_store.payloads [record.hash]     = record.size;
+  }
+}
+
+// Caller holds dump_store.cs
+static bool
+TZF_AppendDumpRecord (const tzf_dump_record_s& record)
+{
+  if (dump_store.manifest == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD written = 0;
+
+  return WriteFile ( dump_store.manifest, &record, sizeof (record),
+                       &written, nullptr ) && written == sizeof (record);
+}
+
+// Caller holds dump_store.cs
+static bool
+TZF_OpenDumpStoreLocked (void)
+{
+  if (dump_store.opened)
+    return dump_store.manifest != INVALID_HANDLE_VALUE;
+
+  dump_store.opened = true;
+
+  LARGE_INTEGER start, end, freq;
+
+  QueryPerformanceFrequency        (&freq);
+  QueryPerformanceCounter_Original (&start);
+
+  TZF_CreateDumpDirectory (TZF_DUMP_STORE_DIR);
+
+  dump_store.manifest =
+    CreateFileW ( TZF_DUMP_STORE_MANIFEST,
+                    GENERIC_READ | GENERIC_WRITE,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                              nullptr );
+
+  if (dump_store.manifest == INVALID_HANDLE_VALUE)
+  {
+    tex_log->Log (L"[Dump Store] Cannot open %s", TZF_DUMP_STORE_MANIFEST);
+    return false;
+  }
+
+  LARGE_INTEGER size = { 0LL };
+  GetFileSizeEx (dump_store.manifest, &size);
+
+  std::vector <uint8_t> data ((size_t)size.QuadPart);
+
+  DWORD read = 0;
+
+  if ( (! data.empty ()) &&
+       (! ReadFile (dump_store.manifest, data.data (), (DWORD)data.size (), &read, nullptr)) )
+    read = 0;
+
+  uint32_t header [2] = { 0UL, 0UL };
+
+  if (read >= sizeof (header))
+    memcpy (header, data.data (), sizeof (header));
+
+  // Anything else (including an empty file) starts a new manifest
+  if ( header [0] != TZF_DUMP_STORE_MAGIC ||
+       header [1] != TZF_DUMP_STORE_VERSION )
+  {
+    if (read != 0)
+      tex_log->Log (L"[Dump Store] %s is not a manifest this version can read; starting over",
+                      TZF_DUMP_STORE_MANIFEST);
+
+    header [0] = TZF_DUMP_STORE_MAGIC;
+    header [1] = TZF_DUMP_STORE_VERSION;
+
+    read = sizeof (header);
+
+    LARGE_INTEGER zero = { 0LL };
+
+    SetFilePointerEx (dump_store.manifest, zero, nullptr, FILE_BEGIN);
+    SetEndOfFile     (dump_store.manifest);
+
+    DWORD written = 0;
+    WriteFile        (dump_store.manifest, header, sizeof (header), &written, nullptr);
+  }
+
+  // A record cut short by a crash is dropped, so new ones stay aligned
+  size_t records = (read - sizeof (header)) / sizeof (tzf_dump_record_s);
+
+  for (size_t i = 0; i < records; i++)
+  {
+    tzf_dump_record_s record;
+
+    memcpy ( &record,
+               data.data () + sizeof (header) + i * sizeof (tzf_dump_record_s),
+                 sizeof (tzf_dump_record_s) );
+
+    TZF_ApplyDumpRecord (record);
+  }
+
+  LARGE_INTEGER tail;
+  tail.QuadPart = sizeof (header) + records * sizeof (tzf_dump_record_s);
+
+  SetFilePointerEx (dump_store.manifest, tail, nullptr, FILE_BEGIN);
+  SetEndOfFile     (dump_store.manifest);
+
+  // Payloads that are no longer referenced stay on disk; nothing is
+  //   ever deleted from the store
+  for ( auto& it : dump_store.payloads )
+  {
+    dump_store.stats.payloads++;
+    dump_store.stats.bytes += it.second;
+  }
+
+  QueryPerformanceCounter_Original (&end);
+
+  dump_store.stats.open_ms =
+    1000.0 * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+  return true;
+}
+
+bool
+TZF_OpenDumpStore (void)
+{
+  bool ok = false;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    ok = TZF_OpenDumpStoreLocked () && (! dump_store.records.empty ());
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return ok;
+}
+
+void
+TZF_CloseDumpStore (void)
+{
+  EnterCriticalSection (&dump_store.cs);
+  {
+    if (dump_store.manifest != INVALID_HANDLE_VALUE)
+      CloseHandle (dump_store.manifest);
+
+    dump_store.manifest = INVALID_HANDLE_VALUE;
+  }
+  LeaveCriticalSection (&dump_store.cs);
+}
+
+bool
+TZF_IsInDumpStore (uint32_t checksum)
+{
+  bool stored = false;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    TZF_OpenDumpStoreLocked ();
+
+    stored = (dump_store.records.count (checksum) != 0);
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return stored;
+}
+
+// Writer thread; the payload is only written if no stored file has the
+//   same bytes already
+static bool
+TZF_WriteStoredDump ( uint32_t                     checksum,
+                      uint32_t                     format,
+                      const std::vector <uint8_t>& data )
+{
+  tzf_dump_record_s record;
+
+  record.checksum = checksum;
+  record.format   = format;
+  record.size     = data.size ();
+  record.hash     = Crc64Calc (data.data (), data.size ());
+
+  wchar_t wszPath [MAX_PATH];
+  TZF_GetStoredDumpPath (record.hash, wszPath);
+
+  uint64_t known_size = 0ULL;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    auto payload =
+      dump_store.payloads.find (record.hash);
+
+    if (payload != dump_store.payloads.end ())
+      known_size = payload->second;
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  bool deduped =
+    known_size == record.size && GetFileAttributesW (wszPath) != INVALID_FILE_ATTRIBUTES;
+
+  if (known_size != 0 && known_size != record.size)
+  {
+    tex_log->Log ( L"[Dump Store] Texture %08x has the same CRC-64 as a stored file"
+                   L" of another size; not stored",
+                     checksum );
+  }
+
+  bool ok = deduped || ( known_size == 0 &&
+                         TZF_WriteDumpFile (wszPath, data) );
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    if (ok)
+      ok = TZF_AppendDumpRecord (record);
+
+    if (ok)
+    {
+      if (! dump_store.payloads.count (record.hash))
+      {
+        dump_store.stats.payloads++;
+        dump_store.stats.bytes += record.size;
+      }
+
+      TZF_ApplyDumpRecord (record);
+
+      dump_store.stats.stored++;
+
+      if (deduped)
+      {
+        dump_store.stats.deduped++;
+        dump_store.stats.bytes_saved += record.size;
+      }
+    }
+
+    // Dumped again the next time it is created
+    else
+      dump_store.records.erase (checksum);
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return ok;
+}
+
+void
+TZF_StoreDump (uint32_t checksum, uint32_t format, std::vector <uint8_t>& data)
+{
+  EnterCriticalSection (&dump_store.cs);
+  {
+    TZF_OpenDumpStoreLocked ();
+
+    // Counts as stored from now on; the record is filled in once written
+    tzf_dump_record_s pending;
+
+    pending.checksum = checksum;
+    pending.format   = format;
+    pending.size     = data.size ();
+
+    dump_store.records [checksum] = pending;
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  TZF_QueueDumpTo (TZF_WriteStoredDump, checksum, format, data);
+}
+
+bool
+TZF_RemoveFromDumpStore (uint32_t checksum)
+{
+  bool removed = false;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    TZF_OpenDumpStoreLocked ();
+
+    if (dump_store.records.erase (checksum) != 0)
+    {
+      tzf_dump_record_s tombstone;
+
+      tombstone.checksum = checksum;
+
+      TZF_AppendDumpRecord (tombstone);
+
+      removed = true;
+    }
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return removed;
+}
+
+std::vector <tzf_dump_record_s>
+TZF_GetDumpStoreRecords (void)
+{
+  std::vector <tzf_dump_record_s> records;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    TZF_OpenDumpStoreLocked ();
+
+    records.reserve (dump_store.records.size ());
+
+    for ( auto& it : dump_store.records )
+    {
+      if (it.second.hash != 0ULL)
+        records.push_back (it.second);
+    }
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return records;
+}
+
+bool
+TZF_ExportStoredDump (const tzf_dump_record_s& record, const wchar_t* wszPath)
+{
+  if (GetFileAttributesW (wszPath) != INVALID_FILE_ATTRIBUTES)
+    return true;
+
+  wchar_t wszStored [MAX_PATH];
+  TZF_GetStoredDumpPath (record.hash, wszStored);
+
+  return CreateHardLinkW (wszPath, wszStored, nullptr) ||
+         CopyFileW       (wszStored, wszPath, TRUE);
+}
+
+tzf_dump_store_stats_s
+TZF_GetDumpStoreStats (void)
+{
+  tzf_dump_store_stats_s stats;
+
+  EnterCriticalSection (&dump_store.cs);
+  {
+    stats         = dump_store.stats;
+    stats.records = dump_store.records.size ();
+  }
+  LeaveCriticalSection (&dump_store.cs);
+
+  return stats;
+}
+
+void
+TZF_LogDumpStoreStats (void)
+{
+  tzf_dump_store_stats_s stats =
+    TZF_GetDumpStoreStats ();
+
+  if (! dump_store.opened)
+    return;
+
+  tex_log->Log ( L"[Dump Store] %7llu textures in %7llu files (%9.2f MiB);"
+                 L" manifest read in %7.2f ms",
+                   stats.records,
+                     stats.payloads,
+                       (double)stats.bytes / (1024.0 * 1024.0),
+                         stats.open_ms );
+
+  tex_log->Log ( L"[Dump Store] %7llu stored this session, %7llu identical to a"
+                 L" stored file (%9.2f MiB not written)",
+                   stats.stored,
+                     stats.deduped,
+                       (double)stats.bytes_saved / (1024.0 * 1024.0) );
+}
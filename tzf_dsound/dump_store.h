@@ -0,0 +1,95 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__DUMP_STORE_H__
+#define __TZF__DUMP_STORE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Content-addressed dump store (TZFIX.Textures/DumpToStore).
+//
+//   Dumped textures are written once per distinct payload, as
+//     TZFix_Res\dump\store\<crc64>.dds, and manifest.tzd maps each checksum
+//       to its format and payload.  A texture dumped again (another session,
+//         another checksum with the same bytes) only adds a manifest record.
+//
+//   The manifest is append-only and read once at startup; later records
+//     replace earlier ones, and a record with no payload deletes the entry.
+//       Textures.ExportDumps writes the usual dump\textures\<format>\ layout.
+//
+
+struct tzf_dump_record_s {
+  uint32_t checksum = 0UL;
+  uint32_t format   = 0UL;   // D3DFORMAT
+  uint64_t hash     = 0ULL;  // CRC-64 of the payload; 0 until it is stored
+  uint64_t size     = 0ULL;
+};
+
+// Reads the manifest; false if there is none yet
+bool
+TZF_OpenDumpStore       (void);
+
+void
+TZF_CloseDumpStore      (void);
+
+// Includes textures still in the dump queue
+bool
+TZF_IsInDumpStore       (uint32_t checksum);
+
+// Takes data and hands it to the dump queue
+void
+TZF_StoreDump           (uint32_t checksum, uint32_t format, std::vector <uint8_t>& data);
+
+// False if checksum was not in the store; its payload stays if shared
+bool
+TZF_RemoveFromDumpStore (uint32_t checksum);
+
+// Every stored texture (nothing still queued)
+std::vector <tzf_dump_record_s>
+TZF_GetDumpStoreRecords (void);
+
+// Hard link to the payload if possible, otherwise a copy
+bool
+TZF_ExportStoredDump    (const tzf_dump_record_s& record, const wchar_t* wszPath);
+
+struct tzf_dump_store_stats_s {
+  uint64_t records     = 0ULL;   // Checksums in the manifest
+  uint64_t payloads    = 0ULL;   // Distinct files
+  uint64_t bytes       = 0ULL;   // What those files take
+
+  uint64_t stored      = 0ULL;   // This session
+  uint64_t deduped     = 0ULL;   //   of which only needed a manifest record
+  uint64_t bytes_saved = 0ULL;
+  double   open_ms     = 0.0;
+};
+
+tzf_dump_store_stats_s
+TZF_GetDumpStoreStats   (void);
+
+void
+TZF_LogDumpStoreStats   (void);
+
+#endif /* __TZF__DUMP_STORE_H__ */
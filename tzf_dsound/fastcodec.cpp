@@ -0,0 +1,252 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "fastcodec.h"
+
+#include <cstring>
+#include <vector>
+
+//
+// Block format limits; a decoder written against the LZ4 block spec relies
+//   on these, so they have to hold for anything we emit.
+//
+static const size_t MIN_MATCH     = 4;
+static const size_t LAST_LITERALS = 5;  // The final 5 bytes are literals
+static const size_t MF_LIMIT      = 12; // No match may start after this
+static const size_t MAX_OFFSET    = 65535;
+
+static const int    HASH_LOG      = 16;
+
+static inline uint32_t
+read32 (const uint8_t* p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof (uint32_t));
+  return v;
+}
+
+static inline uint32_t
+hash32 (uint32_t v)
+{
+  return (uint32_t)(v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+size_t
+TZF_FastCompressBound (size_t len)
+{
+  return len + (len / 255) + 16;
+}
+
+// Writes the 255-run that encodes a length field overflowing its nibble
+static inline uint8_t*
+write_length (uint8_t* op, size_t len)
+{
+  while (len >= 255)
+  {
+    *op++ = 255;
+    len  -= 255;
+  }
+
+  *op++ = (uint8_t)len;
+
+  return op;
+}
+
+static bool
+emit_sequence ( uint8_t*&       op,
+                const uint8_t*  op_end,
+                const uint8_t*  literals,
+                size_t          lit_len,
+                size_t          offset,
+                size_t          match_len )  // 0 for the final sequence
+{
+  size_t worst = 1 + (lit_len / 255) + 1 + lit_len +
+                 2 + (match_len / 255) + 1;
+
+  if ((size_t)(op_end - op) < worst)
+    return false;
+
+  size_t   ml    = match_len ? match_len - MIN_MATCH : 0;
+  uint8_t* token = op++;
+
+  *token = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) |
+                      (ml      < 15 ? ml      : 15));
+
+  if (lit_len >= 15)
+    op = write_length (op, lit_len - 15);
+
+  memcpy (op, literals, lit_len);
+  op += lit_len;
+
+  if (match_len == 0)
+    return true;
+
+  *op++ = (uint8_t)( offset       & 0xFF);
+  *op++ = (uint8_t)((offset >> 8) & 0xFF);
+
+  if (ml >= 15)
+    op = write_length (op, ml - 15);
+
+  return true;
+}
+
+size_t
+TZF_FastCompress ( const uint8_t* src, size_t src_len,
+                         uint8_t* dst, size_t dst_cap )
+{
+  uint8_t*       op     = dst;
+  const uint8_t* op_end = dst + dst_cap;
+
+  size_t anchor = 0;
+  size_t ip     = 0;
+
+  if (src_len > MF_LIMIT)
+  {
+    std::vector <uint32_t> table (1 << HASH_LOG, 0);
+
+    while (ip + MF_LIMIT < src_len)
+    {
+      uint32_t seq  = read32 (src + ip);
+      uint32_t h    = hash32 (seq);
+      size_t   cand = table [h];
+
+      table [h] = (uint32_t)ip;
+
+      if ( cand < ip && ip - cand <= MAX_OFFSET &&
+           read32 (src + cand) == seq )
+      {
+        size_t max_len   = src_len - LAST_LITERALS - ip;
+        size_t match_len = MIN_MATCH;
+
+        while ( match_len < max_len &&
+                src [cand + match_len] == src [ip + match_len] )
+          ++match_len;
+
+        if (! emit_sequence ( op, op_end,
+                                src + anchor, ip - anchor,
+                                  ip - cand, match_len ))
+          return 0;
+
+        ip    += match_len;
+        anchor = ip;
+      }
+
+      else
+        ++ip;
+    }
+  }
+
+  if (! emit_sequence (op, op_end, src + anchor, src_len - anchor, 0, 0))
+    return 0;
+
+  return (size_t)(op - dst);
+}
+
+bool
+TZF_FastDecompress ( const uint8_t* src, size_t src_len,
+                           uint8_t* dst, size_t dst_len )
+{
+  const uint8_t* ip     = src;
+  const uint8_t* ip_end = src + src_len;
+
+  uint8_t*       op     = dst;
+  uint8_t*       op_end = dst + dst_len;
+
+  while (ip < ip_end)
+  {
+    uint8_t token   = *ip++;
+    size_t  lit_len = token >> 4;
+
+    if (lit_len == 15)
+    {
+      uint8_t s;
+
+      do
+      {
+        if (ip >= ip_end)
+          return false;
+
+        s        = *ip++;
+        lit_len += s;
+      } while (s == 255);
+    }
+
+    if ( (size_t)(ip_end - ip) < lit_len ||
+         (size_t)(op_end - op) < lit_len )
+      return false;
+
+    memcpy (op, ip, lit_len);
+    op += lit_len;
+    ip += lit_len;
+
+    // The last sequence has no match
+    if (ip == ip_end)
+      break;
+
+    if (ip_end - ip < 2)
+      return false;
+
+    size_t offset = (size_t)ip [0] | ((size_t)ip [1] << 8);
+    ip += 2;
+
+    if (offset == 0 || offset > (size_t)(op - dst))
+      return false;
+
+    size_t match_len = token & 0x0F;
+
+    if (match_len == 15)
+    {
+      uint8_t s;
+
+      do
+      {
+        if (ip >= ip_end)
+          return false;
+
+        s          = *ip++;
+        match_len += s;
+      } while (s == 255);
+    }
+
+    match_len += MIN_MATCH;
+
+    if ((size_t)(op_end - op) < match_len)
+      return false;
+
+    const uint8_t* match = op - offset;
+
+    // Overlapping copies replicate the last 'offset' bytes (RLE)
+    if (offset >= match_len)
+    {
+      memcpy (op, match, match_len);
+      op += match_len;
+    }
+
+    else
+    {
+      while (match_len--)
+        *op++ = *match++;
+    }
+  }
+
+  return op == op_end;
+}
@@ -0,0 +1,49 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__FASTCODEC_H__
+#define __TZF__FASTCODEC_H__
+
+#include <cstdint>
+#include <cstddef>
+
+//
+// Byte-oriented LZ77 codec that reads and writes the LZ4 block format
+//   (no frame header, no checksums); decodes several times faster than
+//     LZMA at the cost of ratio.  Shared with tzf_packbuild.
+//
+
+// Worst-case output size for len bytes of input
+size_t
+TZF_FastCompressBound (size_t len);
+
+// Returns the compressed size, or 0 if the output did not fit in dst_cap
+size_t
+TZF_FastCompress      ( const uint8_t* src, size_t src_len,
+                              uint8_t* dst, size_t dst_cap );
+
+// Returns false if src is malformed or does not decode to exactly dst_len
+bool
+TZF_FastDecompress    ( const uint8_t* src, size_t src_len,
+                              uint8_t* dst, size_t dst_len );
+
+#endif /* __TZF__FASTCODEC_H__ */
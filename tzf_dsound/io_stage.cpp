@@ -0,0 +1,421 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifdef _WIN32
+# define NOMINMAX
+# include <Windows.h>
+#endif
+
+#include "io_stage.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+typedef std::chrono::steady_clock tzf_io_clock;
+
+struct tzf_io_op_s;
+
+struct tzf_io_stage_s {
+  tzf_io_backend_t                backend;
+  size_t                          depth;
+
+  std::mutex                      lock;
+  std::condition_variable         cv;       // Thread backend: work or stop
+  std::deque <tzf_io_op_s *>      queue;
+  size_t                          pending   = 0;
+  size_t                          in_flight = 0;
+  bool                            stop      = false;
+
+  std::vector <std::thread>       threads;
+  tzf_io_stats_s                  stats;
+
+#ifdef _WIN32
+  HANDLE                          wake      = nullptr;
+#endif
+};
+
+// A request from the moment it is submitted until done has run
+struct tzf_io_op_s {
+  tzf_io_stage_s*                 stage;
+  tzf_io_request_s*               req;
+  tzf_io_clock::time_point        submitted;
+
+#ifdef _WIN32
+  OVERLAPPED                      ov;
+  HANDLE                          hFile     = INVALID_HANDLE_VALUE;
+#endif
+};
+
+const char*
+TZF_GetIOBackendName (tzf_io_backend_t backend)
+{
+  switch (backend)
+  {
+    case TZF_IO_BACKEND_OVERLAPPED: return "overlapped";
+    case TZF_IO_BACKEND_THREADS:    return "threads";
+  }
+
+  return "unknown";
+}
+
+static void
+TZF_FinishRead (tzf_io_op_s* op, bool ok)
+{
+  tzf_io_stage_s*   stage = op->stage;
+  tzf_io_request_s* req   = op->req;
+
+  req->ok = ok;
+
+  if (! ok)
+    std::vector <uint8_t> ().swap (req->data);
+
+  double ms =
+    std::chrono::duration <double, std::milli> (tzf_io_clock::now () - op->submitted).count ();
+
+  {
+    std::lock_guard <std::mutex> lock (stage->lock);
+
+    stage->in_flight--;
+
+    stage->stats.requests++;
+    stage->stats.failures += ok ? 0 : 1;
+    stage->stats.bytes    += req->data.size ();
+    stage->stats.read_ms  += ms;
+  }
+
+  delete op;
+
+  // req may be gone once this returns
+  if (req->done != nullptr)
+    req->done (req);
+
+  {
+    std::lock_guard <std::mutex> lock (stage->lock);
+    stage->pending--;
+  }
+
+  stage->cv.notify_all ();
+}
+
+// Takes the next queued request if the depth allows another one in flight
+static tzf_io_op_s*
+TZF_TakeRead (tzf_io_stage_s* stage)
+{
+  if (stage->queue.empty () || stage->in_flight >= stage->depth)
+    return nullptr;
+
+  tzf_io_op_s* op = stage->queue.front ();
+                    stage->queue.pop_front ();
+
+  stage->in_flight++;
+  stage->stats.max_in_flight =
+    std::max (stage->stats.max_in_flight, (uint32_t)stage->in_flight);
+
+  return op;
+}
+
+
+//
+// Thread backend: every thread owns one outstanding read
+//
+static bool
+TZF_ReadBlocking (tzf_io_request_s* req)
+{
+#ifdef _WIN32
+  FILE* fIn = _wfopen (req->path.c_str (), L"rb");
+#else
+  std::vector <char> path (req->path.length () * MB_CUR_MAX + 1);
+
+  if (wcstombs (path.data (), req->path.c_str (), path.size ()) == (size_t)-1)
+    return false;
+
+  // Paths are built the Windows way everywhere else
+  std::replace (path.begin (), path.end (), '\\', '/');
+
+  FILE* fIn = fopen (path.data (), "rb");
+#endif
+
+  if (fIn == nullptr)
+    return false;
+
+#ifdef _WIN32
+  bool ok = _fseeki64 (fIn, 0, SEEK_END) == 0;
+  int64_t size = _ftelli64 (fIn);
+#else
+  bool ok = fseeko (fIn, 0, SEEK_END) == 0;
+  int64_t size = (int64_t)ftello (fIn);
+#endif
+
+  ok = ok && size >= 0 && (uint64_t)size >= req->offset;
+
+  if (ok)
+  {
+    size_t len =
+      (size_t)std::min ((uint64_t)req->length, (uint64_t)size - req->offset);
+
+    req->data.resize (len);
+
+#ifdef _WIN32
+    ok = _fseeki64 (fIn, (int64_t)req->offset, SEEK_SET) == 0;
+#else
+    ok = fseeko (fIn, (off_t)req->offset, SEEK_SET) == 0;
+#endif
+
+    ok = ok && len > 0 && fread (req->data.data (), len, 1, fIn) == 1;
+  }
+
+  fclose (fIn);
+
+  return ok;
+}
+
+static void
+TZF_IOThread (tzf_io_stage_s* stage)
+{
+  for (;;)
+  {
+    tzf_io_op_s* op = nullptr;
+
+    {
+      std::unique_lock <std::mutex> lock (stage->lock);
+
+      stage->cv.wait (lock, [&] { return stage->stop || (! stage->queue.empty ()); });
+
+      // Drain the queue before honoring stop
+      if ((op = TZF_TakeRead (stage)) == nullptr)
+        return;
+    }
+
+    TZF_FinishRead (op, TZF_ReadBlocking (op->req));
+  }
+}
+
+
+//
+// Overlapped backend: one thread keeps up to depth ReadFileEx (...) calls
+//   outstanding; their completion routines run while it waits alertably.
+//
+#ifdef _WIN32
+static VOID
+CALLBACK
+TZF_ReadCompletion (DWORD dwError, DWORD dwTransferred, LPOVERLAPPED lpOverlapped)
+{
+  // ReadFileEx (...) leaves hEvent to the caller
+  tzf_io_op_s* op = (tzf_io_op_s *)lpOverlapped->hEvent;
+
+  CloseHandle (op->hFile);
+
+  TZF_FinishRead ( op, dwError       == ERROR_SUCCESS &&
+                       dwTransferred == op->req->data.size () );
+}
+
+// false if the read could not be started; true if it completes later
+static bool
+TZF_IssueOverlappedRead (tzf_io_op_s* op)
+{
+  tzf_io_request_s* req = op->req;
+
+  op->hFile =
+    CreateFileW ( req->path.c_str (),
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL  |
+                            FILE_FLAG_OVERLAPPED   |
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr );
+
+  if (op->hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER liSize = { 0 };
+
+  if ( (! GetFileSizeEx (op->hFile, &liSize)) ||
+       (uint64_t)liSize.QuadPart < req->offset )
+  {
+    CloseHandle (op->hFile);
+    return false;
+  }
+
+  uint64_t len =
+    std::min ((uint64_t)req->length, (uint64_t)liSize.QuadPart - req->offset);
+
+  if (len == 0 || len > MAXDWORD)
+  {
+    CloseHandle (op->hFile);
+    return false;
+  }
+
+  req->data.resize ((size_t)len);
+
+  ZeroMemory (&op->ov, sizeof (OVERLAPPED));
+
+  op->ov.Offset     = (DWORD)(req->offset & 0xFFFFFFFFULL);
+  op->ov.OffsetHigh = (DWORD)(req->offset >> 32);
+  op->ov.hEvent     = (HANDLE)op;
+
+  if (! ReadFileEx (op->hFile, req->data.data (), (DWORD)len, &op->ov, TZF_ReadCompletion))
+  {
+    CloseHandle (op->hFile);
+    return false;
+  }
+
+  return true;
+}
+
+static void
+TZF_OverlappedThread (tzf_io_stage_s* stage)
+{
+  for (;;)
+  {
+    for (;;)
+    {
+      tzf_io_op_s* op = nullptr;
+
+      {
+        std::lock_guard <std::mutex> lock (stage->lock);
+        op = TZF_TakeRead (stage);
+      }
+
+      if (op == nullptr)
+        break;
+
+      if (! TZF_IssueOverlappedRead (op))
+        TZF_FinishRead (op, false);
+    }
+
+    {
+      std::lock_guard <std::mutex> lock (stage->lock);
+
+      if (stage->stop && stage->pending == 0)
+        return;
+    }
+
+    // Returns early (WAIT_IO_COMPLETION) whenever a read finishes
+    WaitForSingleObjectEx (stage->wake, INFINITE, TRUE);
+  }
+}
+#endif
+
+
+tzf_io_stage_s*
+TZF_CreateIOStage (tzf_io_backend_t backend, int queue_depth)
+{
+#ifndef _WIN32
+  if (backend == TZF_IO_BACKEND_OVERLAPPED)
+    return nullptr;
+#endif
+
+  tzf_io_stage_s* stage = new tzf_io_stage_s;
+
+  stage->backend = backend;
+  stage->depth   = (size_t)std::max (1, queue_depth);
+
+#ifdef _WIN32
+  if (backend == TZF_IO_BACKEND_OVERLAPPED)
+  {
+    stage->wake = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+    stage->threads.emplace_back (TZF_OverlappedThread, stage);
+
+    return stage;
+  }
+#endif
+
+  for (size_t i = 0; i < stage->depth; i++)
+    stage->threads.emplace_back (TZF_IOThread, stage);
+
+  return stage;
+}
+
+void
+TZF_DestroyIOStage (tzf_io_stage_s* stage)
+{
+  {
+    std::lock_guard <std::mutex> lock (stage->lock);
+    stage->stop = true;
+  }
+
+  stage->cv.notify_all ();
+
+#ifdef _WIN32
+  if (stage->wake != nullptr)
+    SetEvent (stage->wake);
+#endif
+
+  for (auto& thread : stage->threads)
+    thread.join ();
+
+#ifdef _WIN32
+  if (stage->wake != nullptr)
+    CloseHandle (stage->wake);
+#endif
+
+  delete stage;
+}
+
+void
+TZF_SubmitRead (tzf_io_stage_s* stage, tzf_io_request_s* req)
+{
+  tzf_io_op_s* op = new tzf_io_op_s;
+
+  op->stage     = stage;
+  op->req       = req;
+  op->submitted = tzf_io_clock::now ();
+
+  req->ok = false;
+  req->data.clear ();
+
+  {
+    std::lock_guard <std::mutex> lock (stage->lock);
+
+    stage->queue.push_back (op);
+    stage->pending++;
+  }
+
+  stage->cv.notify_one ();
+
+#ifdef _WIN32
+  if (stage->wake != nullptr)
+    SetEvent (stage->wake);
+#endif
+}
+
+size_t
+TZF_GetIOStagePending (tzf_io_stage_s* stage)
+{
+  std::lock_guard <std::mutex> lock (stage->lock);
+  return stage->pending;
+}
+
+tzf_io_stats_s
+TZF_GetIOStageStats (tzf_io_stage_s* stage)
+{
+  std::lock_guard <std::mutex> lock (stage->lock);
+  return stage->stats;
+}
@@ -0,0 +1,96 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__IO_STAGE_H__
+#define __TZF__IO_STAGE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Read stage for texture streaming.
+//
+//   Requests are read ahead of the decode workers, up to queue_depth at a
+//     time, and handed back through a callback once their bytes are in
+//       memory.  Workers then decode without ever waiting on the disk, and
+//         the reads are not subject to their background I/O priority.
+//
+//   The overlapped backend is Win32 only; the thread backend uses nothing
+//     but the C++ runtime so the stage can be built and measured anywhere.
+//
+enum tzf_io_backend_t {
+  TZF_IO_BACKEND_OVERLAPPED = 0,  // One thread, ReadFileEx (...)
+  TZF_IO_BACKEND_THREADS    = 1   // queue_depth threads, blocking reads
+};
+
+struct tzf_io_request_s;
+
+// Called on an I/O thread; it must not block
+typedef void (*tzf_io_done_pfn)(tzf_io_request_s* req);
+
+struct tzf_io_request_s {
+  std::wstring          path;
+  uint64_t              offset = 0ULL;
+  size_t                length = SIZE_MAX;  // SIZE_MAX reads to the end of the file
+
+  // Valid once done is called; data is empty if ok is false, and reading
+  //   nothing (an empty file, or offset at the end of it) counts as failure
+  std::vector <uint8_t> data;
+  bool                  ok     = false;
+
+  tzf_io_done_pfn       done   = nullptr;
+  void*                 user   = nullptr;
+};
+
+struct tzf_io_stats_s {
+  uint64_t requests      = 0ULL;
+  uint64_t failures      = 0ULL;
+  uint64_t bytes         = 0ULL;
+  double   read_ms       = 0.0;   // Summed over requests, submit to done
+  uint32_t max_in_flight = 0UL;
+};
+
+struct tzf_io_stage_s;
+
+// Returns nullptr if the backend is not available on this platform
+tzf_io_stage_s*
+TZF_CreateIOStage     (tzf_io_backend_t backend, int queue_depth);
+
+// Completes every request already submitted, then stops the I/O threads
+void
+TZF_DestroyIOStage    (tzf_io_stage_s* stage);
+
+void
+TZF_SubmitRead        (tzf_io_stage_s* stage, tzf_io_request_s* req);
+
+// Submitted and not yet done
+size_t
+TZF_GetIOStagePending (tzf_io_stage_s* stage);
+
+tzf_io_stats_s
+TZF_GetIOStageStats   (tzf_io_stage_s* stage);
+
+const char*
+TZF_GetIOBackendName  (tzf_io_backend_t backend);
+
+#endif /* __TZF__IO_STAGE_H__ */
@@ -0,0 +1,323 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include "mipgen.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined (_M_X64) || defined (__SSE2__) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+# define TZF_MIPGEN_SSE2
+# include <emmintrin.h>
+#endif
+
+static inline uint32_t
+clamp_coord (int64_t v, uint32_t limit)
+{
+  return v < 0 ? 0 : (v >= (int64_t)limit ? limit - 1 : (uint32_t)v);
+}
+
+//
+// sRGB <-> linear, 8-bit encoded to 16-bit linear and back.  64 KiB for the
+//   way back is a lot of table, but it is exact and the lookups stay cheap.
+//
+struct tzf_srgb_tables_s {
+  uint16_t to_linear [256];
+  uint8_t  to_srgb   [65536];
+
+  tzf_srgb_tables_s (void)
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      double c = i / 255.0;
+      double l = c <= 0.04045 ? c / 12.92 : pow ((c + 0.055) / 1.055, 2.4);
+
+      to_linear [i] = (uint16_t)(l * 65535.0 + 0.5);
+    }
+
+    for (int i = 0; i < 65536; i++)
+    {
+      double l = i / 65535.0;
+      double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow (l, 1.0 / 2.4) - 0.055;
+
+      to_srgb [i] = (uint8_t)(c * 255.0 + 0.5);
+    }
+  }
+};
+
+static const tzf_srgb_tables_s&
+TZF_GetSRGBTables (void)
+{
+  static const tzf_srgb_tables_s tables;
+  return tables;
+}
+
+uint32_t
+TZF_GetMipLevelCount (uint32_t width, uint32_t height)
+{
+  uint32_t largest = width > height ? width : height;
+  uint32_t levels  = 1;
+
+  while (largest > 1)
+  {
+    largest >>= 1;
+    ++levels;
+  }
+
+  return levels;
+}
+
+size_t
+TZF_GetMipChainSize (uint32_t width, uint32_t height, uint32_t levels)
+{
+  size_t size = 0;
+
+  for (uint32_t i = 0; i < levels; i++)
+  {
+    size  += (size_t)width * height * 4;
+
+    width  = width  > 1 ? width  / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+
+  return size;
+}
+
+// Odd sizes lose their last row / column, same as a 2x2 box over them would
+static void
+TZF_BoxLinear ( const uint8_t* src, uint32_t w, uint32_t h,
+                      uint8_t* dst, uint32_t dw, uint32_t dh )
+{
+  for (uint32_t y = 0; y < dh; y++)
+  {
+    const uint8_t* r0 = src + (size_t)clamp_coord (2 * (int64_t)y,     h) * w * 4;
+    const uint8_t* r1 = src + (size_t)clamp_coord (2 * (int64_t)y + 1, h) * w * 4;
+          uint8_t* out = dst + (size_t)y * dw * 4;
+
+    uint32_t x = 0;
+
+#ifdef TZF_MIPGEN_SSE2
+    // Two output pixels from four input pixels on each of two rows
+    if (w >= 2)
+    {
+      const __m128i zero = _mm_setzero_si128 ();
+      const __m128i two  = _mm_set1_epi16    (2);
+
+      for (; x + 2 <= dw; x += 2)
+      {
+        __m128i a = _mm_loadu_si128 ((const __m128i *)(r0 + x * 8));
+        __m128i b = _mm_loadu_si128 ((const __m128i *)(r1 + x * 8));
+
+        __m128i lo = _mm_add_epi16 (_mm_unpacklo_epi8 (a, zero), _mm_unpacklo_epi8 (b, zero));
+        __m128i hi = _mm_add_epi16 (_mm_unpackhi_epi8 (a, zero), _mm_unpackhi_epi8 (b, zero));
+
+        __m128i sum =
+          _mm_add_epi16 ( _mm_unpacklo_epi64 (lo, hi),
+                          _mm_unpackhi_epi64 (lo, hi) );
+
+        sum = _mm_srli_epi16 (_mm_add_epi16 (sum, two), 2);
+
+        _mm_storel_epi64 ((__m128i *)(out + x * 4), _mm_packus_epi16 (sum, sum));
+      }
+    }
+#endif
+
+    for (; x < dw; x++)
+    {
+      uint32_t x0 = clamp_coord (2 * (int64_t)x,     w) * 4;
+      uint32_t x1 = clamp_coord (2 * (int64_t)x + 1, w) * 4;
+
+      for (int c = 0; c < 4; c++)
+      {
+        out [x * 4 + c] =
+          (uint8_t)((r0 [x0 + c] + r0 [x1 + c] + r1 [x0 + c] + r1 [x1 + c] + 2) >> 2);
+      }
+    }
+  }
+}
+
+// Separable 1-3-3-1; the vertical pass goes through a row of 16-bit sums
+static void
+TZF_TriangleLinear ( const uint8_t* src, uint32_t w, uint32_t h,
+                           uint8_t* dst, uint32_t dw, uint32_t dh )
+{
+  std::vector <uint16_t> row ((size_t)w * 4);
+
+  for (uint32_t y = 0; y < dh; y++)
+  {
+    const uint8_t* r [4];
+
+    for (int i = 0; i < 4; i++)
+      r [i] = src + (size_t)clamp_coord (2 * (int64_t)y - 1 + i, h) * w * 4;
+
+    size_t i = 0;
+    size_t n = (size_t)w * 4;
+
+#ifdef TZF_MIPGEN_SSE2
+    const __m128i zero = _mm_setzero_si128 ();
+
+    for (; i + 16 <= n; i += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *)(r [0] + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *)(r [1] + i));
+      __m128i c = _mm_loadu_si128 ((const __m128i *)(r [2] + i));
+      __m128i d = _mm_loadu_si128 ((const __m128i *)(r [3] + i));
+
+      __m128i outer_lo = _mm_add_epi16 (_mm_unpacklo_epi8 (a, zero), _mm_unpacklo_epi8 (d, zero));
+      __m128i outer_hi = _mm_add_epi16 (_mm_unpackhi_epi8 (a, zero), _mm_unpackhi_epi8 (d, zero));
+      __m128i inner_lo = _mm_add_epi16 (_mm_unpacklo_epi8 (b, zero), _mm_unpacklo_epi8 (c, zero));
+      __m128i inner_hi = _mm_add_epi16 (_mm_unpackhi_epi8 (b, zero), _mm_unpackhi_epi8 (c, zero));
+
+      inner_lo = _mm_add_epi16 (inner_lo, _mm_add_epi16 (inner_lo, inner_lo));
+      inner_hi = _mm_add_epi16 (inner_hi, _mm_add_epi16 (inner_hi, inner_hi));
+
+      _mm_storeu_si128 ((__m128i *)(row.data () + i),     _mm_add_epi16 (outer_lo, inner_lo));
+      _mm_storeu_si128 ((__m128i *)(row.data () + i + 8), _mm_add_epi16 (outer_hi, inner_hi));
+    }
+#endif
+
+    for (; i < n; i++)
+      row [i] = (uint16_t)(r [0][i] + r [3][i] + 3 * (r [1][i] + r [2][i]));
+
+    uint8_t* out = dst + (size_t)y * dw * 4;
+
+    for (uint32_t x = 0; x < dw; x++)
+    {
+      const uint16_t* c [4];
+
+      for (int k = 0; k < 4; k++)
+        c [k] = row.data () + (size_t)clamp_coord (2 * (int64_t)x - 1 + k, w) * 4;
+
+#ifdef TZF_MIPGEN_SSE2
+      __m128i a = _mm_loadl_epi64 ((const __m128i *)c [0]);
+      __m128i b = _mm_loadl_epi64 ((const __m128i *)c [1]);
+      __m128i e = _mm_loadl_epi64 ((const __m128i *)c [2]);
+      __m128i d = _mm_loadl_epi64 ((const __m128i *)c [3]);
+
+      __m128i inner = _mm_add_epi16 (b, e);
+      __m128i sum   = _mm_add_epi16 ( _mm_add_epi16 (a, d),
+                                      _mm_add_epi16 (inner, _mm_add_epi16 (inner, inner)) );
+
+      sum = _mm_srli_epi16 (_mm_add_epi16 (sum, _mm_set1_epi16 (32)), 6);
+
+      uint32_t px = (uint32_t)_mm_cvtsi128_si32 (_mm_packus_epi16 (sum, sum));
+
+      memcpy (out + x * 4, &px, 4);
+#else
+      for (int ch = 0; ch < 4; ch++)
+      {
+        uint32_t sum = c [0][ch] + c [3][ch] + 3 * (c [1][ch] + c [2][ch]);
+
+        out [x * 4 + ch] = (uint8_t)((sum + 32) >> 6);
+      }
+#endif
+    }
+  }
+}
+
+// Color in linear light, alpha as stored; no SIMD, the lookups dominate
+static void
+TZF_FilterSRGB ( const uint8_t* src, uint32_t w, uint32_t h,
+                       uint8_t* dst, uint32_t dw, uint32_t dh,
+                 tzf_mip_filter_t filter )
+{
+  const tzf_srgb_tables_s& tables = TZF_GetSRGBTables ();
+
+  const bool     tent    = filter == TZF_MIP_FILTER_TRIANGLE;
+  const int      taps    = tent ? 4 : 2;
+  const int      first   = tent ? -1 : 0;
+  const uint32_t w1d [4] = { 1, 3, 3, 1 };
+  const uint32_t shift   = tent ? 6 : 2;
+
+  for (uint32_t y = 0; y < dh; y++)
+  {
+    for (uint32_t x = 0; x < dw; x++)
+    {
+      uint32_t sum [4] = { };
+
+      for (int j = 0; j < taps; j++)
+      {
+        const uint8_t* row =
+          src + (size_t)clamp_coord (2 * (int64_t)y + first + j, h) * w * 4;
+
+        for (int i = 0; i < taps; i++)
+        {
+          const uint8_t* px     = row + clamp_coord (2 * (int64_t)x + first + i, w) * 4;
+          uint32_t       weight = tent ? w1d [j] * w1d [i] : 1;
+
+          sum [0] += weight * tables.to_linear [px [0]];
+          sum [1] += weight * tables.to_linear [px [1]];
+          sum [2] += weight * tables.to_linear [px [2]];
+          sum [3] += weight * px [3];
+        }
+      }
+
+      uint8_t* out = dst + ((size_t)y * dw + x) * 4;
+
+      out [0] = tables.to_srgb [(sum [0] + (1 << (shift - 1))) >> shift];
+      out [1] = tables.to_srgb [(sum [1] + (1 << (shift - 1))) >> shift];
+      out [2] = tables.to_srgb [(sum [2] + (1 << (shift - 1))) >> shift];
+      out [3] = (uint8_t)     ((sum [3] + (1 << (shift - 1))) >> shift);
+    }
+  }
+}
+
+void
+TZF_GenerateMipLevel ( const uint8_t*   src,
+                       uint32_t         width,
+                       uint32_t         height,
+                       uint8_t*         dst,
+                       tzf_mip_filter_t filter,
+                       bool             srgb )
+{
+  uint32_t dw = width  > 1 ? width  / 2 : 1;
+  uint32_t dh = height > 1 ? height / 2 : 1;
+
+  if (srgb)
+    TZF_FilterSRGB     (src, width, height, dst, dw, dh, filter);
+  else if (filter == TZF_MIP_FILTER_TRIANGLE)
+    TZF_TriangleLinear (src, width, height, dst, dw, dh);
+  else
+    TZF_BoxLinear      (src, width, height, dst, dw, dh);
+}
+
+void
+TZF_GenerateMipChain ( uint8_t*         chain,
+                       uint32_t         width,
+                       uint32_t         height,
+                       uint32_t         levels,
+                       tzf_mip_filter_t filter,
+                       bool             srgb )
+{
+  for (uint32_t i = 1; i < levels; i++)
+  {
+    uint8_t* next = chain + (size_t)width * height * 4;
+
+    TZF_GenerateMipLevel (chain, width, height, next, filter, srgb);
+
+    chain  = next;
+    width  = width  > 1 ? width  / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+}
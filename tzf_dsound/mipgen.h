@@ -0,0 +1,70 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__MIPGEN_H__
+#define __TZF__MIPGEN_H__
+
+#include <cstdint>
+#include <cstddef>
+
+//
+// Mipmap generation for 32-bit 8:8:8:8 images (A8R8G8B8, X8R8G8B8,
+//   A8B8G8R8, X8B8G8R8); the fourth byte of every pixel is alpha and is
+//     never gamma corrected.  SSE2 where the compiler has it, plain C++
+//       otherwise.  Shared with tzf_packbuild.
+//
+
+enum tzf_mip_filter_t {
+  TZF_MIP_FILTER_BOX      = 0,  // 2x2 average, what D3DX_FILTER_BOX does
+  TZF_MIP_FILTER_TRIANGLE = 1   // 4x4 tent, 1-3-3-1 in each direction
+};
+
+// Levels down to 1x1, the same count D3DX uses for MipLevels = 0
+uint32_t
+TZF_GetMipLevelCount  (uint32_t width, uint32_t height);
+
+// Bytes taken by levels levels of a width x height image, tightly packed
+size_t
+TZF_GetMipChainSize   (uint32_t width, uint32_t height, uint32_t levels);
+
+// One level from the one above it; dst is max (width / 2, 1) pixels wide
+//   and max (height / 2, 1) pixels high.  srgb averages color in linear light.
+void
+TZF_GenerateMipLevel  ( const uint8_t*   src,
+                        uint32_t         width,
+                        uint32_t         height,
+                        uint8_t*         dst,
+                        tzf_mip_filter_t filter,
+                        bool             srgb );
+
+// chain holds the top level; the levels below it are written right after,
+//   which is how DDS stores them.  chain must be TZF_GetMipChainSize (...) long.
+void
+TZF_GenerateMipChain  ( uint8_t*         chain,
+                        uint32_t         width,
+                        uint32_t         height,
+                        uint32_t         levels,
+                        tzf_mip_filter_t filter,
+                        bool             srgb );
+
+#endif /* __TZF__MIPGEN_H__ */
@@ -229,16 +229,15 @@ TZF_DrawFileList (bool& can_scroll)
 
     for ( auto it : sources [sel].checksums )
     {
-      tzf_tex_record_s* injectable =
-        TZF_GetInjectableTexture (it);
+      tzf_tex_record_s injectable;
 
-      if (injectable != nullptr) {
+      if (TZF_GetInjectableTexture (it, &injectable)) {
                     
         ImGui::TextColored ( ImVec4 (0.9f, 0.6f, 0.3f, 1.0f), " %08x    ", it );
         ImGui::SameLine    (                                                  );
 
         bool streaming = 
-          injectable->method == Streaming;
+          injectable.method == Streaming;
 
         ImGui::TextColored ( streaming ?
                                ImVec4 ( 0.2f,  0.90f, 0.3f, 1.0f ) :
@@ -249,7 +248,7 @@ TZF_DrawFileList (bool& can_scroll)
         ImGui::SameLine    (                               );
 
         ImGui::TextColored ( ImVec4 (1.f, 1.f, 1.f, 1.f), "%#5.2f MiB  ",
-                            (double)injectable->size / (1024.0 * 1024.0) );
+                            (double)injectable.size / (1024.0 * 1024.0) );
       }
     }
 
@@ -1125,7 +1124,7 @@ TZFix_TextureModDlg (void)
 
 
           bool injected  =
-            (TZF_GetInjectableTexture (debug_tex_id) != nullptr),
+            TZF_GetInjectableTexture (debug_tex_id, nullptr),
                reloading = false;;
 
           int num_lods = pTex->d3d9_tex->pTexOverride->GetLevelCount ();
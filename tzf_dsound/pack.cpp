@@ -0,0 +1,709 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "pack.h"
+#include "fastcodec.h"
+#include "buffer_pool.h"
+#include "config.h"
+#include "log.h"
+
+#include "lzma/7zCrc.h"
+#include "lzma/LzmaDec.h"
+#include "lzma/Lzma2Dec.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+extern iSK_Logger* tex_log;
+
+struct tzf_pack_s {
+  std::wstring                     name;
+
+  HANDLE                           hFile = INVALID_HANDLE_VALUE;
+  HANDLE                           hMap  = nullptr;
+  uint64_t                         size  = 0ULL;
+
+  tzf_pack_header_s                header;
+  std::vector <tzf_pack_entry_s>   entries;
+  std::vector <tzf_pack_block_s>   blocks;
+  std::vector <uint32_t>           block_entries; // Entries in each block
+
+  // Most recently decoded solid block; textures laid out next to each other
+  //   by the repacker are copied out of this instead of decoding it again.
+  //     The copy is a pool buffer, so it counts against the pool's cap,
+  //       and TZF_TrimPackBlockCaches (...) drops it once it goes idle.
+  CRITICAL_SECTION                 solid_lock;
+  uint32_t                         solid_block = UINT32_MAX;
+  std::shared_ptr <tzf_buffer_s>   solid_data;
+  DWORD                            solid_used  = 0UL;
+
+  volatile LONG                    refs  = 1L;
+};
+
+static struct {
+  std::vector <tzf_pack_s *> table;
+  CRITICAL_SECTION           cs;
+} packs;
+
+static DWORD
+TZF_GetAllocationGranularity (void)
+{
+  static DWORD granularity = 0;
+
+  if (granularity == 0)
+  {
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo (&sysinfo);
+
+    granularity = sysinfo.dwAllocationGranularity;
+  }
+
+  return granularity;
+}
+
+static bool
+TZF_InitPacks (void)
+{
+  InitializeCriticalSectionAndSpinCount (&packs.cs, 1000UL);
+  return true;
+}
+
+static bool packs_init = TZF_InitPacks ();
+
+
+static bool
+TZF_ReadPackBytes (HANDLE hFile, uint64_t offset, void* out, size_t len)
+{
+  LARGE_INTEGER liPos;
+  liPos.QuadPart = offset;
+
+  if (! SetFilePointerEx (hFile, liPos, nullptr, FILE_BEGIN))
+    return false;
+
+  DWORD dwRead = 0;
+
+  return ReadFile (hFile, out, (DWORD)len, &dwRead, nullptr) && dwRead == len;
+}
+
+// Maps [offset, offset + len) wherever the allocation granularity allows it
+static const uint8_t*
+TZF_MapPackRange ( const tzf_pack_s* pack,
+                   uint64_t          offset,
+                   size_t            len,
+                   void**            base )
+{
+  uint64_t aligned =
+    offset & ~(uint64_t)(TZF_GetAllocationGranularity () - 1);
+
+  size_t   delta   = (size_t)(offset - aligned);
+
+  *base =
+    MapViewOfFile ( pack->hMap,
+                      FILE_MAP_READ,
+                        (DWORD)(aligned >> 32), (DWORD)(aligned & 0xFFFFFFFFULL),
+                          delta + len );
+
+  if (*base == nullptr)
+    return nullptr;
+
+  return (const uint8_t *)*base + delta;
+}
+
+//
+// The builder can leave a copy of the header and index next to the pack, so
+//   opening a large pack does not seek into it for the index.  It is only
+//     trusted when its header is byte-for-byte the pack's own.
+//
+static bool
+TZF_ReadPackSidecar (tzf_pack_s* pack)
+{
+  std::wstring sidecar (pack->name);
+  size_t       ext = sidecar.find_last_of (L"./\\");
+
+  if (ext != std::wstring::npos && sidecar [ext] == L'.')
+    sidecar.resize (ext);
+
+  sidecar += TZF_PACK_SIDECAR_EXT;
+
+  HANDLE hSidecar =
+    CreateFileW ( sidecar.c_str (),
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL |
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr );
+
+  if (hSidecar == INVALID_HANDLE_VALUE)
+    return false;
+
+  const tzf_pack_header_s& hdr = pack->header;
+  tzf_pack_header_s        copy;
+
+  bool ok =
+    TZF_ReadPackBytes (hSidecar, 0ULL, &copy, sizeof (copy)) &&
+      (! memcmp (&copy, &hdr, sizeof (hdr)));
+
+  size_t entry_bytes = pack->entries.size () * sizeof (tzf_pack_entry_s);
+  size_t block_bytes = pack->blocks.size  () * sizeof (tzf_pack_block_s);
+
+  ok = ok &&
+    (entry_bytes == 0 || TZF_ReadPackBytes (hSidecar, hdr.entry_offset, pack->entries.data (), entry_bytes)) &&
+    (block_bytes == 0 || TZF_ReadPackBytes (hSidecar, hdr.block_offset, pack->blocks.data  (), block_bytes));
+
+  CloseHandle (hSidecar);
+
+  return ok;
+}
+
+static bool
+TZF_VerifyPackCRC (const tzf_pack_s* pack)
+{
+  const uint64_t WINDOW = 64ULL * 1024ULL * 1024ULL;
+
+  UInt32   crc = CRC_INIT_VAL;
+  uint64_t pos = sizeof (tzf_pack_header_s);
+
+  while (pos < pack->size)
+  {
+    size_t len = (size_t)std::min (WINDOW, pack->size - pos);
+
+    void*          base = nullptr;
+    const uint8_t* data = TZF_MapPackRange (pack, pos, len, &base);
+
+    if (data == nullptr)
+      return false;
+
+    crc = CrcUpdate (crc, data, len);
+
+    UnmapViewOfFile (base);
+
+    pos += len;
+  }
+
+  return CRC_GET_DIGEST (crc) == pack->header.pack_crc32;
+}
+
+tzf_pack_s*
+TZF_OpenPack (const wchar_t* wszPack)
+{
+  tzf_pack_s* pack = new tzf_pack_s;
+
+  InitializeCriticalSectionAndSpinCount (&pack->solid_lock, 100UL);
+
+  pack->name  = wszPack;
+  pack->hFile =
+    CreateFileW ( wszPack,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL |
+                            FILE_FLAG_RANDOM_ACCESS,
+                              nullptr );
+
+  auto Fail = [&](const wchar_t* wszReason) -> tzf_pack_s* {
+    tex_log->Log ( L"[Inject Tex]  ** Cannot use texture pack '%s': %s",
+                     wszPack, wszReason );
+
+    TZF_ReleasePack (pack);
+    return nullptr;
+  };
+
+  if (pack->hFile == INVALID_HANDLE_VALUE)
+    return Fail (L"could not open file");
+
+  LARGE_INTEGER liSize = { 0 };
+  GetFileSizeEx (pack->hFile, &liSize);
+
+  pack->size = liSize.QuadPart;
+
+  tzf_pack_header_s& hdr = pack->header;
+
+  if ( pack->size < sizeof (tzf_pack_header_s) ||
+       (! TZF_ReadPackBytes (pack->hFile, 0ULL, &hdr, sizeof (hdr))) )
+    return Fail (L"truncated header");
+
+  if (hdr.magic != TZF_PACK_MAGIC)
+    return Fail (L"not a texture pack");
+
+  if (hdr.version != TZF_PACK_VERSION)
+    return Fail (L"unsupported version");
+
+  uint32_t header_crc = hdr.header_crc32;
+                        hdr.header_crc32 = 0;
+
+  if (CrcCalc (&hdr, sizeof (hdr)) != header_crc)
+    return Fail (L"header checksum mismatch");
+
+  hdr.header_crc32 = header_crc;
+
+  uint64_t entry_bytes = (uint64_t)hdr.entry_count * sizeof (tzf_pack_entry_s);
+  uint64_t block_bytes = (uint64_t)hdr.block_count * sizeof (tzf_pack_block_s);
+
+  // Written so that a crafted offset cannot wrap around
+  if ( hdr.entry_offset > pack->size || entry_bytes > pack->size - hdr.entry_offset ||
+       hdr.block_offset > pack->size || block_bytes > pack->size - hdr.block_offset )
+    return Fail (L"truncated index");
+
+  pack->entries.resize (hdr.entry_count);
+  pack->blocks.resize  (hdr.block_count);
+
+  if ( (! TZF_ReadPackSidecar (pack)) &&
+       ( (entry_bytes && (! TZF_ReadPackBytes (pack->hFile, hdr.entry_offset, pack->entries.data (), (size_t)entry_bytes))) ||
+         (block_bytes && (! TZF_ReadPackBytes (pack->hFile, hdr.block_offset, pack->blocks.data  (), (size_t)block_bytes))) ) )
+    return Fail (L"could not read index");
+
+  for ( auto& it : pack->blocks )
+  {
+    if (it.offset > pack->size || it.packed_size > pack->size - it.offset)
+      return Fail (L"block extends past end of file");
+  }
+
+  // TZF_FindPackEntry (...) is a binary search
+  for ( size_t i = 1; i < pack->entries.size (); i++ )
+  {
+    if (pack->entries [i - 1].checksum >= pack->entries [i].checksum)
+      return Fail (L"entries not sorted by checksum");
+  }
+
+  pack->block_entries.resize (hdr.block_count, 0);
+
+  for ( auto& it : pack->entries )
+  {
+    if ( it.block >= hdr.block_count ||
+         (uint64_t)it.offset + it.size > pack->blocks [it.block].unpacked_size )
+      return Fail (L"entry does not fit its block");
+
+    ++pack->block_entries [it.block];
+  }
+
+  pack->hMap =
+    CreateFileMappingW (pack->hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+  if (pack->hMap == nullptr)
+    return Fail (L"could not create file mapping");
+
+  if ((hdr.flags & TZF_PACK_FLAG_CRC) && config.textures.verify_packs)
+  {
+    if (! TZF_VerifyPackCRC (pack))
+      return Fail (L"pack checksum mismatch");
+  }
+
+  return pack;
+}
+
+void
+TZF_ReleasePack (tzf_pack_s* pack)
+{
+  if (InterlockedDecrement (&pack->refs) != 0)
+    return;
+
+  if (pack->hMap != nullptr)
+    CloseHandle (pack->hMap);
+
+  if (pack->hFile != INVALID_HANDLE_VALUE)
+    CloseHandle (pack->hFile);
+
+  DeleteCriticalSection (&pack->solid_lock);
+
+  delete pack;
+}
+
+uint32_t
+TZF_GetPackEntryCount (const tzf_pack_s* pack)
+{
+  return (uint32_t)pack->entries.size ();
+}
+
+const tzf_pack_entry_s*
+TZF_GetPackEntry (const tzf_pack_s* pack, uint32_t idx)
+{
+  return &pack->entries [idx];
+}
+
+uint32_t
+TZF_FindPackEntry (const tzf_pack_s* pack, uint32_t checksum)
+{
+  auto it =
+    std::lower_bound ( pack->entries.begin (), pack->entries.end (), checksum,
+                         [](const tzf_pack_entry_s& entry, uint32_t key) {
+                           return entry.checksum < key;
+                         } );
+
+  if (it == pack->entries.end () || it->checksum != checksum)
+    return UINT32_MAX;
+
+  return (uint32_t)(it - pack->entries.begin ());
+}
+
+size_t
+TZF_GetPackEntryBufferSize (const tzf_pack_s* pack, uint32_t idx)
+{
+  const tzf_pack_block_s& block =
+    pack->blocks [pack->entries [idx].block];
+
+  if (block.codec == TZF_PACK_CODEC_STORED)
+    return 0;
+
+  return block.unpacked_size;
+}
+
+void
+TZF_GetPackBlockNeighbors ( const tzf_pack_s*        pack,
+                            uint32_t                 idx,
+                            std::vector <uint32_t>&  neighbors )
+{
+  uint32_t block = pack->entries [idx].block;
+
+  // Only solid blocks hold more than one texture; skip the scan otherwise
+  if (pack->entries [idx].size == pack->blocks [block].unpacked_size)
+    return;
+
+  for (uint32_t i = 0; i < (uint32_t)pack->entries.size (); i++)
+  {
+    if (i != idx && pack->entries [i].block == block)
+      neighbors.push_back (i);
+  }
+}
+
+
+static SRes
+TZF_DecodePackBlock ( const tzf_pack_block_s* block,
+                      const uint8_t*          packed,
+                      uint8_t*                out,
+                      ISzAlloc*               alloc )
+{
+  SizeT       out_len = block->unpacked_size;
+  SizeT       in_len  = block->packed_size;
+  ELzmaStatus status;
+
+  switch (block->codec)
+  {
+    case TZF_PACK_CODEC_FAST:
+      return TZF_FastDecompress (packed, in_len, out, out_len) ?
+               SZ_OK : SZ_ERROR_DATA;
+
+    case TZF_PACK_CODEC_LZMA:
+      RINOK (LzmaDecode ( out, &out_len, packed, &in_len,
+                            block->props, LZMA_PROPS_SIZE,
+                              LZMA_FINISH_ANY, &status, alloc ));
+      break;
+
+    case TZF_PACK_CODEC_LZMA2:
+      RINOK (Lzma2Decode ( out, &out_len, packed, &in_len,
+                             block->props [0],
+                               LZMA_FINISH_ANY, &status, alloc ));
+      break;
+
+    default:
+      return SZ_ERROR_UNSUPPORTED;
+  }
+
+  return (out_len == block->unpacked_size) ? SZ_OK : SZ_ERROR_DATA;
+}
+
+// No C++ objects in here; __try cannot unwind them
+static SRes
+TZF_DecodePackBlockGuarded ( const tzf_pack_block_s* block,
+                             const uint8_t*          packed,
+                             uint8_t*                out,
+                             ISzAlloc*               alloc )
+{
+  SRes res = SZ_ERROR_FAIL;
+
+  __try
+  {
+    if (CrcCalc (packed, block->packed_size) != block->crc32)
+      res = SZ_ERROR_CRC;
+    else
+      res = TZF_DecodePackBlock (block, packed, out, alloc);
+  }
+
+  __except ( GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ?
+               EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    res = SZ_ERROR_READ;
+  }
+
+  return res;
+}
+
+// range is nullptr unless the caller already read the entry's file range
+static SRes
+TZF_ReadPackEntryImpl ( tzf_pack_s*      pack,
+                        uint32_t         idx,
+                        const uint8_t*   range,
+                        uint8_t*         buf,
+                        size_t           buf_len,
+                        tzf_pack_view_s* view,
+                        ISzAlloc*        alloc )
+{
+  const tzf_pack_entry_s& entry = pack->entries [idx];
+  const tzf_pack_block_s& block = pack->blocks  [entry.block];
+
+  view->data        = nullptr;
+  view->size        = 0;
+  view->mapped_base = nullptr;
+  view->block       = nullptr;
+
+  if (block.codec != TZF_PACK_CODEC_STORED && buf_len < block.unpacked_size)
+    return SZ_ERROR_PARAM;
+
+  // Stored: map only the entry itself and hand that out
+  if (block.codec == TZF_PACK_CODEC_STORED)
+  {
+    const uint8_t* data = range;
+
+    if (data == nullptr)
+      data = TZF_MapPackRange (pack, block.offset + entry.offset, entry.size, &view->mapped_base);
+
+    if (data == nullptr)
+      return SZ_ERROR_READ;
+
+    view->data = data;
+    view->size = entry.size;
+
+    return SZ_OK;
+  }
+
+  // A block with one texture in it will not be asked for again soon
+  bool solid = (pack->block_entries [entry.block] > 1);
+
+  if (solid)
+  {
+    std::shared_ptr <tzf_buffer_s> cached;
+
+    EnterCriticalSection (&pack->solid_lock);
+    {
+      if (pack->solid_block == entry.block)
+      {
+        cached           = pack->solid_data;
+        pack->solid_used = GetTickCount ();
+      }
+    }
+    LeaveCriticalSection (&pack->solid_lock);
+
+    if (cached != nullptr)
+    {
+      memcpy (buf, cached->data + entry.offset, entry.size);
+
+      view->data = buf;
+      view->size = entry.size;
+
+      return SZ_OK;
+    }
+  }
+
+  void*          base   = nullptr;
+  const uint8_t* packed = range;
+
+  if (packed == nullptr)
+    packed = TZF_MapPackRange (pack, block.offset, block.packed_size, &base);
+
+  if (packed == nullptr)
+    return SZ_ERROR_READ;
+
+  SRes res =
+    TZF_DecodePackBlockGuarded (&block, packed, buf, alloc);
+
+  if (base != nullptr)
+    UnmapViewOfFile (base);
+
+  if (res == SZ_OK)
+  {
+    view->data  = buf + entry.offset;
+    view->size  = entry.size;
+    view->block = buf;
+
+    // Only cached if the pool has room for it below its cap
+    tzf_buffer_s* copy =
+      solid ? TZF_LeaseBuffer (block.unpacked_size, false) : nullptr;
+
+    if (copy != nullptr)
+    {
+      memcpy (copy->data, buf, block.unpacked_size);
+
+      std::shared_ptr <tzf_buffer_s> decoded (copy, TZF_ReturnBuffer);
+
+      EnterCriticalSection (&pack->solid_lock);
+      {
+        pack->solid_block = entry.block;
+        pack->solid_used  = GetTickCount ();
+        pack->solid_data.swap (decoded);
+      }
+      LeaveCriticalSection (&pack->solid_lock);
+    }
+  }
+
+  return res;
+}
+
+SRes
+TZF_ReadPackEntry ( tzf_pack_s*      pack,
+                    uint32_t         idx,
+                    uint8_t*         buf,
+                    size_t           buf_len,
+                    tzf_pack_view_s* view,
+                    ISzAlloc*        alloc )
+{
+  return TZF_ReadPackEntryImpl (pack, idx, nullptr, buf, buf_len, view, alloc);
+}
+
+SRes
+TZF_ReadPackEntryFrom ( tzf_pack_s*      pack,
+                        uint32_t         idx,
+                        const uint8_t*   range,
+                        uint8_t*         buf,
+                        size_t           buf_len,
+                        tzf_pack_view_s* view,
+                        ISzAlloc*        alloc )
+{
+  return TZF_ReadPackEntryImpl (pack, idx, range, buf, buf_len, view, alloc);
+}
+
+void
+TZF_GetPackEntryRange ( const tzf_pack_s* pack,
+                        uint32_t          idx,
+                        uint64_t*         offset,
+                        size_t*           len )
+{
+  const tzf_pack_entry_s& entry = pack->entries [idx];
+  const tzf_pack_block_s& block = pack->blocks  [entry.block];
+
+  if (block.codec == TZF_PACK_CODEC_STORED)
+  {
+    *offset = block.offset + entry.offset;
+    *len    = entry.size;
+  }
+
+  else
+  {
+    *offset = block.offset;
+    *len    = block.packed_size;
+  }
+}
+
+const wchar_t*
+TZF_GetPackName (const tzf_pack_s* pack)
+{
+  return pack->name.c_str ();
+}
+
+void
+TZF_ReleasePackView (tzf_pack_view_s* view)
+{
+  if (view->mapped_base != nullptr)
+    UnmapViewOfFile (view->mapped_base);
+
+  view->mapped_base = nullptr;
+  view->data        = nullptr;
+  view->size        = 0;
+  view->block       = nullptr;
+}
+
+
+void
+TZF_RegisterPack (unsigned int archive, tzf_pack_s* pack)
+{
+  EnterCriticalSection (&packs.cs);
+  {
+    if (packs.table.size () <= archive)
+      packs.table.resize (archive + 1, nullptr);
+
+    if (packs.table [archive] != nullptr)
+      TZF_ReleasePack (packs.table [archive]);
+
+    packs.table [archive] = pack;
+  }
+  LeaveCriticalSection (&packs.cs);
+}
+
+tzf_pack_s*
+TZF_GetPack (unsigned int archive)
+{
+  tzf_pack_s* pack = nullptr;
+
+  EnterCriticalSection (&packs.cs);
+  {
+    if (archive < packs.table.size ())
+      pack = packs.table [archive];
+
+    if (pack != nullptr)
+      InterlockedIncrement (&pack->refs);
+  }
+  LeaveCriticalSection (&packs.cs);
+
+  return pack;
+}
+
+void
+TZF_ClosePacks (void)
+{
+  EnterCriticalSection (&packs.cs);
+  {
+    for ( auto it : packs.table )
+    {
+      if (it != nullptr)
+        TZF_ReleasePack (it);
+    }
+
+    packs.table.clear ();
+  }
+  LeaveCriticalSection (&packs.cs);
+}
+
+void
+TZF_TrimPackBlockCaches (DWORD min_idle_ms)
+{
+  std::vector <std::shared_ptr <tzf_buffer_s>> idle;
+  DWORD                                        now = GetTickCount ();
+
+  EnterCriticalSection (&packs.cs);
+  {
+    for ( auto it : packs.table )
+    {
+      if (it == nullptr)
+        continue;
+
+      EnterCriticalSection (&it->solid_lock);
+      {
+        if (it->solid_data != nullptr && now - it->solid_used >= min_idle_ms)
+        {
+          idle.push_back (nullptr);
+          idle.back ().swap (it->solid_data);
+
+          it->solid_block = UINT32_MAX;
+        }
+      }
+      LeaveCriticalSection (&it->solid_lock);
+    }
+  }
+  LeaveCriticalSection (&packs.cs);
+}
@@ -0,0 +1,132 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__PACK_H__
+#define __TZF__PACK_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+
+#include "pack_format.h"
+#include "lzma/7zTypes.h"
+
+struct tzf_pack_s;
+
+// Validates the header and reads the index; the block data is left on disk.
+//   The pack is returned holding one reference.
+tzf_pack_s*
+TZF_OpenPack    (const wchar_t* wszPack);
+
+void
+TZF_ReleasePack (tzf_pack_s* pack);
+
+uint32_t
+TZF_GetPackEntryCount      (const tzf_pack_s* pack);
+
+const tzf_pack_entry_s*
+TZF_GetPackEntry           (const tzf_pack_s* pack, uint32_t idx);
+
+// Binary search of the sorted index; returns UINT32_MAX if not present
+uint32_t
+TZF_FindPackEntry          (const tzf_pack_s* pack, uint32_t checksum);
+
+// Decode buffer TZF_ReadPackEntry (...) needs; 0 for stored entries
+size_t
+TZF_GetPackEntryBufferSize (const tzf_pack_s* pack, uint32_t idx);
+
+// Every other entry in idx's block; none unless the block is solid
+void
+TZF_GetPackBlockNeighbors  ( const tzf_pack_s*        pack,
+                             uint32_t                 idx,
+                             std::vector <uint32_t>&  neighbors );
+
+
+struct tzf_pack_view_s {
+  const uint8_t* data        = nullptr;
+  size_t         size        = 0;
+
+  // Non-null while data points into a mapped view of the pack
+  void*          mapped_base = nullptr;
+
+  // The whole unpacked block, if it was decoded into buf for this read
+  const uint8_t* block       = nullptr;
+};
+
+//
+// Stored entries come back as a pointer into a mapped view (zero-copy),
+//   everything else is decoded into buf.  Either way, the view must be
+//     released once the caller is done with view->data.
+//
+SRes
+TZF_ReadPackEntry   ( tzf_pack_s*      pack,
+                      uint32_t         idx,
+                      uint8_t*         buf,
+                      size_t           buf_len,
+                      tzf_pack_view_s* view,
+                      ISzAlloc*        alloc );
+
+// Same as above, but reads from a copy of the entry's file range (see
+//   TZF_GetPackEntryRange) instead of mapping the pack.  A stored entry's
+//     view points into range, which must outlive it.
+SRes
+TZF_ReadPackEntryFrom ( tzf_pack_s*      pack,
+                        uint32_t         idx,
+                        const uint8_t*   range,
+                        uint8_t*         buf,
+                        size_t           buf_len,
+                        tzf_pack_view_s* view,
+                        ISzAlloc*        alloc );
+
+void
+TZF_ReleasePackView (tzf_pack_view_s* view);
+
+// The bytes TZF_ReadPackEntry (...) reads from disk for idx: the entry if
+//   it is stored, otherwise its whole compressed block
+void
+TZF_GetPackEntryRange ( const tzf_pack_s* pack,
+                        uint32_t          idx,
+                        uint64_t*         offset,
+                        size_t*           len );
+
+const wchar_t*
+TZF_GetPackName     (const tzf_pack_s* pack);
+
+
+// Packs are registered under the same archive index as TZF_GetTextureArchives;
+//   registering hands the table the caller's reference.
+void
+TZF_RegisterPack    (unsigned int archive, tzf_pack_s* pack);
+
+// Adds a reference (release it with TZF_ReleasePack); nullptr for 7z archives
+tzf_pack_s*
+TZF_GetPack         (unsigned int archive);
+
+void
+TZF_ClosePacks      (void);
+
+// Drops each pack's cached solid block if it has not been read from for
+//   min_idle_ms; the buffers go back to the pool
+void
+TZF_TrimPackBlockCaches (DWORD min_idle_ms);
+
+#endif /* __TZF__PACK_H__ */
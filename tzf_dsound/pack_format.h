@@ -0,0 +1,107 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__PACK_FORMAT_H__
+#define __TZF__PACK_FORMAT_H__
+
+#include <cstdint>
+
+//
+// TZF Texture Pack (.tzp)
+//
+//   [ header ][ entries (sorted by checksum) ][ blocks ][ pad ][ block data ]
+//
+//   Block data starts on a TZF_PACK_ALIGNMENT boundary and so does every
+//     block.  A block holds one or more textures back-to-back and has a
+//       single codec; packs built for random access use one texture per
+//         block, which is how each entry gets its own codec.
+//
+//   Stored blocks are never copied; the loader hands D3DX a pointer into a
+//     mapped view of the pack.
+//
+//   This header is shared with tzf_packbuild and must not depend on Windows.
+//
+
+#define TZF_PACK_MAGIC      0x50465A54UL  // 'TZFP'
+#define TZF_PACK_VERSION    1
+#define TZF_PACK_ALIGNMENT  4096
+#define TZF_PACK_EXT        L".tzp"
+
+// Optional copy of the header and index next to the pack (same name);
+//   the loader reads the index from it when its header matches the pack's.
+#define TZF_PACK_SIDECAR_EXT L".tzi"
+
+// pack_crc32 is valid and covers everything after the header
+#define TZF_PACK_FLAG_CRC   0x0001
+
+enum tzf_pack_codec_t {
+  TZF_PACK_CODEC_STORED = 0,
+  TZF_PACK_CODEC_FAST   = 1, // LZ4 block format, see fastcodec.h
+  TZF_PACK_CODEC_LZMA   = 2, // Raw LZMA stream, 5 property bytes
+  TZF_PACK_CODEC_LZMA2  = 3  // Raw LZMA2 stream, 1 property byte
+};
+
+#pragma pack (push, 1)
+struct tzf_pack_header_s {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+
+  uint32_t entry_count;
+  uint32_t block_count;
+
+  uint64_t entry_offset;
+  uint64_t block_offset;
+  uint64_t data_offset;
+
+  uint32_t pack_crc32;
+  uint32_t header_crc32;   // Computed with this field set to 0
+
+  uint8_t  reserved [16];
+};
+
+struct tzf_pack_entry_s {
+  uint32_t checksum;       // Same key as injectable_textures
+  uint32_t block;
+  uint32_t offset;         // Within the unpacked block
+  uint32_t size;
+  uint32_t crc32;          // Of the unpacked texture, 0 if not recorded
+  uint8_t  method;         // tzf_load_method_t
+  uint8_t  reserved [3];
+};
+
+struct tzf_pack_block_s {
+  uint64_t offset;         // Absolute, multiple of TZF_PACK_ALIGNMENT
+  uint32_t packed_size;
+  uint32_t unpacked_size;
+  uint32_t crc32;          // Of the packed bytes
+  uint8_t  codec;          // tzf_pack_codec_t
+  uint8_t  props [5];
+  uint8_t  reserved [6];
+};
+#pragma pack (pop)
+
+static_assert (sizeof (tzf_pack_header_s) == 64, "tzf_pack_header_s must be 64 bytes");
+static_assert (sizeof (tzf_pack_entry_s)  == 24, "tzf_pack_entry_s must be 24 bytes");
+static_assert (sizeof (tzf_pack_block_s)  == 32, "tzf_pack_block_s must be 32 bytes");
+
+#endif /* __TZF__PACK_FORMAT_H__ */
@@ -0,0 +1,262 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "payload_cache.h"
+#include "fastcodec.h"
+#include "config.h"
+#include "log.h"
+
+#include <list>
+#include <algorithm>
+#include <unordered_map>
+
+extern iSK_Logger* tex_log;
+
+struct tzf_payload_s {
+  std::vector <uint8_t>            data;
+  size_t                           size       = 0;      // Uncompressed
+  bool                             compressed = false;
+
+  std::list   <uint32_t>::iterator age;
+};
+
+static struct {
+  CRITICAL_SECTION                             cs;
+
+  std::unordered_map <uint32_t, tzf_payload_s> entries;
+  std::list          <uint32_t>                order;  // Least recently used first
+
+  tzf_payload_cache_stats_s                    stats;
+} payload_cache;
+
+static bool
+TZF_InitPayloadCache (void)
+{
+  InitializeCriticalSectionAndSpinCount (&payload_cache.cs, 1000UL);
+  return true;
+}
+
+static bool payload_cache_init = TZF_InitPayloadCache ();
+
+
+static uint64_t
+TZF_GetPayloadCacheCap (void)
+{
+  return (uint64_t)std::max (0, config.textures.max_l2_cache_in_mib) * 1024ULL * 1024ULL;
+}
+
+// Caller holds payload_cache.cs
+static void
+TZF_DropTexturePayload (uint32_t checksum)
+{
+  auto entry =
+    payload_cache.entries.find (checksum);
+
+  payload_cache.stats.evicted   += 1;
+  payload_cache.stats.raw_bytes -= entry->second.size;
+  payload_cache.stats.bytes     -= entry->second.data.size ();
+
+  payload_cache.order.erase   (entry->second.age);
+  payload_cache.entries.erase (entry);
+}
+
+void
+TZF_StoreTexturePayload (uint32_t checksum, const uint8_t* data, size_t size)
+{
+  const uint64_t cap = TZF_GetPayloadCacheCap ();
+
+  if (size == 0 || size > cap || TZF_HasTexturePayload (checksum))
+    return;
+
+  tzf_payload_s payload;
+
+  payload.size = size;
+
+  // Compressed outside the lock; only kept if it actually saves something
+  if (config.textures.compress_l2_cache)
+  {
+    std::vector <uint8_t> packed (TZF_FastCompressBound (size));
+
+    size_t packed_len =
+      TZF_FastCompress (data, size, packed.data (), packed.size ());
+
+    if (packed_len != 0 && packed_len < size)
+    {
+      payload.data.assign (packed.begin (), packed.begin () + packed_len);
+      payload.compressed = true;
+    }
+  }
+
+  if (! payload.compressed)
+    payload.data.assign (data, data + size);
+
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    // Another worker may have loaded the same texture meanwhile
+    if (! payload_cache.entries.count (checksum))
+    {
+      while (payload_cache.stats.bytes + payload.data.size () > cap)
+        TZF_DropTexturePayload (payload_cache.order.front ());
+
+      payload.age =
+        payload_cache.order.insert (payload_cache.order.end (), checksum);
+
+      payload_cache.stats.stored    += 1;
+      payload_cache.stats.raw_bytes += payload.size;
+      payload_cache.stats.bytes     += payload.data.size ();
+      payload_cache.stats.peak_bytes =
+        std::max (payload_cache.stats.peak_bytes, payload_cache.stats.bytes);
+
+      payload_cache.entries.emplace (checksum, std::move (payload));
+    }
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+}
+
+void
+TZF_TouchTexturePayload (uint32_t checksum)
+{
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    auto entry =
+      payload_cache.entries.find (checksum);
+
+    if (entry != payload_cache.entries.end ())
+    {
+      payload_cache.order.splice ( payload_cache.order.end (),
+                                     payload_cache.order, entry->second.age );
+    }
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+}
+
+bool
+TZF_FetchTexturePayload (uint32_t checksum, std::vector <uint8_t>& data)
+{
+  std::vector <uint8_t> packed;
+  bool                  found = false;
+
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    payload_cache.stats.lookups += 1;
+
+    auto entry =
+      payload_cache.entries.find (checksum);
+
+    if (entry != payload_cache.entries.end ())
+    {
+      if (entry->second.compressed)
+      {
+        packed = entry->second.data;
+        data.resize (entry->second.size);
+      }
+
+      else
+        data = entry->second.data;
+
+      found = true;
+    }
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+
+  if (found && (! packed.empty ()))
+    found = TZF_FastDecompress (packed.data (), packed.size (), data.data (), data.size ());
+
+  if (found)
+  {
+    EnterCriticalSection (&payload_cache.cs);
+    {
+      payload_cache.stats.hits        += 1;
+      payload_cache.stats.bytes_saved += data.size ();
+    }
+    LeaveCriticalSection (&payload_cache.cs);
+  }
+
+  return found;
+}
+
+bool
+TZF_HasTexturePayload (uint32_t checksum)
+{
+  bool found = false;
+
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    found = payload_cache.entries.count (checksum) != 0;
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+
+  return found;
+}
+
+void
+TZF_ClearTexturePayloads (void)
+{
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    while (! payload_cache.order.empty ())
+      TZF_DropTexturePayload (payload_cache.order.front ());
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+}
+
+tzf_payload_cache_stats_s
+TZF_GetPayloadCacheStats (void)
+{
+  tzf_payload_cache_stats_s stats;
+
+  EnterCriticalSection (&payload_cache.cs);
+  {
+    stats = payload_cache.stats;
+  }
+  LeaveCriticalSection (&payload_cache.cs);
+
+  return stats;
+}
+
+void
+TZF_LogPayloadCacheStats (void)
+{
+  tzf_payload_cache_stats_s stats =
+    TZF_GetPayloadCacheStats ();
+
+  if (stats.lookups == 0)
+    return;
+
+  tex_log->Log ( L"[ L2 Cache ] %7llu lookups, %5.1f%% hits: %9.2f MiB not read or"
+                 L" decoded again",
+                   stats.lookups,
+                     100.0 * (double)stats.hits / (double)stats.lookups,
+                       (double)stats.bytes_saved / (1024.0 * 1024.0) );
+
+  tex_log->Log ( L"[ L2 Cache ] %7llu payloads stored, %llu evicted; %9.2f MiB held"
+                 L" at most (cap: %li MiB, %hs)",
+                   stats.stored, stats.evicted,
+                     (double)stats.peak_bytes / (1024.0 * 1024.0),
+                       config.textures.max_l2_cache_in_mib,
+                         config.textures.compress_l2_cache ? "compressed" :
+                                                             "uncompressed" );
+}
@@ -0,0 +1,79 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__PAYLOAD_CACHE_H__
+#define __TZF__PAYLOAD_CACHE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//
+// Second-level cache: the DDS files of injected textures, kept in system
+//   memory (fast-compressed if TZFIX.Textures/CompressL2Cache is set) so
+//     that a texture the manager purged can be created again without going
+//       back to disk or LZMA.
+//
+//   A payload is stored when its texture is injected, which is the only
+//     time its bytes are in memory, and moves to the back of the line again
+//       when the texture is purged; the least recently used is dropped once
+//         TZFIX.Textures/MaxL2CacheInMiB is reached.
+//
+
+// Copies (or compresses) data; does nothing if checksum is already stored
+void
+TZF_StoreTexturePayload   (uint32_t checksum, const uint8_t* data, size_t size);
+
+// The texture was purged from the texture cache; keep its payload longest
+void
+TZF_TouchTexturePayload   (uint32_t checksum);
+
+// Decompresses the payload into data; the cache keeps its copy
+bool
+TZF_FetchTexturePayload   (uint32_t checksum, std::vector <uint8_t>& data);
+
+bool
+TZF_HasTexturePayload     (uint32_t checksum);
+
+// Payloads are only valid for the data sources they were read from
+void
+TZF_ClearTexturePayloads  (void);
+
+struct tzf_payload_cache_stats_s {
+  uint64_t lookups      = 0ULL;
+  uint64_t hits         = 0ULL;
+  uint64_t bytes_saved  = 0ULL;   // Payload bytes not read / decoded again
+
+  uint64_t stored       = 0ULL;
+  uint64_t evicted      = 0ULL;
+  uint64_t raw_bytes    = 0ULL;   // Uncompressed size of what is held
+  uint64_t bytes        = 0ULL;   // What it actually takes
+  uint64_t peak_bytes   = 0ULL;
+};
+
+tzf_payload_cache_stats_s
+TZF_GetPayloadCacheStats  (void);
+
+void
+TZF_LogPayloadCacheStats  (void);
+
+#endif /* __TZF__PAYLOAD_CACHE_H__ */
@@ -0,0 +1,528 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "remaster_cache.h"
+#include "config.h"
+#include "log.h"
+
+#include <process.h>
+
+#include <list>
+#include <string>
+#include <cwctype>
+#include <algorithm>
+#include <unordered_map>
+
+#define TZF_REMASTER_CACHE_DIR L"TZFix_Res\\remaster_cache"
+
+// Bump whenever mipgen.cpp or bcn.cpp would produce different bytes
+#define TZF_REMASTER_CACHE_VERSION 1
+
+extern iSK_Logger* tex_log;
+
+typedef BOOL(WINAPI *QueryPerformanceCounter_t)(_Out_ LARGE_INTEGER *lpPerformanceCount);
+extern QueryPerformanceCounter_t QueryPerformanceCounter_Original;
+
+struct tzf_remaster_file_s {
+  uint64_t                         size = 0ULL;
+  std::list   <uint64_t>::iterator age;
+};
+
+// Keyed by settings << 32 | checksum
+static struct {
+  CRITICAL_SECTION                                   cs;
+
+  volatile LONG                                      scan    = 0L;  // 1 = started
+  HANDLE                                             scanned = nullptr;
+  HANDLE                                             thread  = 0;
+  volatile bool                                      cancel  = false;
+
+  std::unordered_map <uint64_t, tzf_remaster_file_s> files;
+  std::list          <uint64_t>                      order;  // Least recently used first
+
+  tzf_remaster_cache_stats_s                         stats;
+} remaster_cache;
+
+static bool
+TZF_InitRemasterCache (void)
+{
+  InitializeCriticalSectionAndSpinCount (&remaster_cache.cs, 1000UL);
+
+  remaster_cache.scanned =
+    CreateEvent (nullptr, TRUE, FALSE, nullptr);
+
+  return true;
+}
+
+static bool remaster_cache_init = TZF_InitRemasterCache ();
+
+
+static uint64_t
+TZF_GetRemasterCacheCap (void)
+{
+  return (uint64_t)std::max (0, config.textures.max_remaster_cache_in_mib) * 1024ULL * 1024ULL;
+}
+
+// FNV-1a over everything that changes what a remaster looks like
+static uint32_t
+TZF_GetRemasterSettings (void)
+{
+  std::wstring filter (config.textures.mipmap_filter);
+
+  std::transform (filter.begin (), filter.end (), filter.begin (), towlower);
+
+  wchar_t wszSettings [128];
+
+  _swprintf ( wszSettings, L"%d|%s|%d|%d",
+                TZF_REMASTER_CACHE_VERSION,
+                  filter.c_str (),
+                    config.textures.gamma_correct_mips ? 1 : 0,
+                      config.textures.remaster_bc_quality );
+
+  uint32_t hash = 2166136261UL;
+
+  for (const wchar_t* pwc = wszSettings; *pwc != L'\0'; pwc++)
+  {
+    hash ^= (uint32_t)*pwc;
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+static uint64_t
+TZF_GetRemasterKey (uint32_t checksum)
+{
+  return ((uint64_t)TZF_GetRemasterSettings () << 32) | checksum;
+}
+
+static void
+TZF_GetRemasterPath (uint64_t key, wchar_t* wszPath)
+{
+  _swprintf ( wszPath, L"%s\\%08x_%08x.dds",
+                TZF_REMASTER_CACHE_DIR,
+                  (uint32_t)key, (uint32_t)(key >> 32) );
+}
+
+//
+// Files are ordered by write time, which TZF_FetchRemaster (...) bumps on
+//   every hit, so the least recently used survive a restart.  The directory
+//     is listed without holding remaster_cache.cs.
+//
+static unsigned int
+__stdcall
+TZF_ScanRemasterCacheThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_BEGIN );
+
+  struct found_s {
+    uint64_t key;
+    uint64_t size;
+    uint64_t time;
+  };
+
+  std::vector <found_s> found;
+
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileW (TZF_REMASTER_CACHE_DIR L"\\*.dds", &fd);
+
+  if (hFind != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      if (remaster_cache.cancel)
+        break;
+
+      uint32_t checksum, settings;
+
+      if (swscanf (fd.cFileName, L"%8x_%8x.dds", &checksum, &settings) != 2)
+        continue;
+
+      found.push_back ( found_s {
+        ((uint64_t)settings << 32) | checksum,
+        ULARGE_INTEGER { fd.nFileSizeLow,             fd.nFileSizeHigh             }.QuadPart,
+        ULARGE_INTEGER { fd.ftLastWriteTime.dwLowDateTime,
+                         fd.ftLastWriteTime.dwHighDateTime }.QuadPart } );
+    } while (FindNextFileW (hFind, &fd));
+
+    FindClose (hFind);
+  }
+
+  // Left behind by a write that never finished
+  hFind =
+    FindFirstFileW (TZF_REMASTER_CACHE_DIR L"\\*.tmp", &fd);
+
+  if (hFind != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      std::wstring path (TZF_REMASTER_CACHE_DIR L"\\");
+
+      DeleteFileW ((path + fd.cFileName).c_str ());
+    } while (FindNextFileW (hFind, &fd));
+
+    FindClose (hFind);
+  }
+
+  std::sort ( found.begin (), found.end (),
+                [](const found_s& a, const found_s& b) {
+                  return a.time < b.time;
+                } );
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_END );
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    for (const found_s& file : found)
+    {
+      if (remaster_cache.files.count (file.key))
+        continue;
+
+      tzf_remaster_file_s entry;
+
+      entry.size = file.size;
+      entry.age  =
+        remaster_cache.order.insert (remaster_cache.order.end (), file.key);
+
+      remaster_cache.files.emplace (file.key, entry);
+
+      remaster_cache.stats.files += 1;
+      remaster_cache.stats.bytes += file.size;
+    }
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  SetEvent (remaster_cache.scanned);
+
+  return 0;
+}
+
+void
+TZF_BeginRemasterCacheScan (void)
+{
+  if (InterlockedCompareExchange (&remaster_cache.scan, 1L, 0L) != 0L)
+    return;
+
+  remaster_cache.thread =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 TZF_ScanRemasterCacheThread,
+                                   nullptr,
+                                     0x00,
+                                       nullptr );
+
+  // No thread; list it here
+  if (remaster_cache.thread == 0)
+    TZF_ScanRemasterCacheThread (nullptr);
+}
+
+void
+TZF_EndRemasterCacheScan (void)
+{
+  if (remaster_cache.thread != 0)
+  {
+    remaster_cache.cancel = true;
+
+    WaitForSingleObject (remaster_cache.thread, INFINITE);
+    CloseHandle         (remaster_cache.thread);
+
+    remaster_cache.thread = 0;
+  }
+}
+
+// Workers only; a lookup before the listing is done would resample (and
+//   write) a chain that is already on disk
+static void
+TZF_WaitForRemasterCacheScan (void)
+{
+  TZF_BeginRemasterCacheScan ();
+
+  WaitForSingleObject (remaster_cache.scanned, INFINITE);
+}
+
+// Caller holds remaster_cache.cs
+static void
+TZF_DropRemaster (uint64_t key, bool evicted)
+{
+  auto file =
+    remaster_cache.files.find (key);
+
+  if (file == remaster_cache.files.end ())
+    return;
+
+  wchar_t wszPath [MAX_PATH];
+  TZF_GetRemasterPath (key, wszPath);
+
+  DeleteFileW (wszPath);
+
+  if (evicted)
+    remaster_cache.stats.evicted += 1;
+
+  remaster_cache.stats.files -= 1;
+  remaster_cache.stats.bytes -= file->second.size;
+
+  remaster_cache.order.erase (file->second.age);
+  remaster_cache.files.erase (file);
+}
+
+bool
+TZF_HasRemaster (uint32_t checksum)
+{
+  const uint64_t key   = TZF_GetRemasterKey (checksum);
+  bool           found = false;
+
+  TZF_WaitForRemasterCacheScan ();
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    found = remaster_cache.files.count (key) != 0;
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  return found;
+}
+
+bool
+TZF_FetchRemaster (uint32_t checksum, std::vector <uint8_t>& data)
+{
+  const uint64_t key = TZF_GetRemasterKey (checksum);
+
+  uint64_t size = 0ULL;
+
+  TZF_WaitForRemasterCacheScan ();
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    remaster_cache.stats.lookups += 1;
+
+    auto file =
+      remaster_cache.files.find (key);
+
+    if (file != remaster_cache.files.end ())
+      size = file->second.size;
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  if (size < 4 || size > UINT32_MAX)
+    return false;
+
+  LARGE_INTEGER freq, start, end;
+
+  QueryPerformanceFrequency        (&freq);
+  QueryPerformanceCounter_Original (&start);
+
+  wchar_t wszPath [MAX_PATH];
+  TZF_GetRemasterPath (key, wszPath);
+
+  // Deleting it from under us (eviction by another thread) is fine
+  HANDLE hFile =
+    CreateFileW ( wszPath,
+                    GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr );
+
+  bool  ok   = false;
+  DWORD read = 0;
+
+  if (hFile != INVALID_HANDLE_VALUE)
+  {
+    data.resize ((size_t)size);
+
+    ok = ReadFile (hFile, data.data (), (DWORD)size, &read, nullptr) &&
+           read == size && (! memcmp (data.data (), "DDS ", 4));
+
+    if (ok)
+    {
+      FILETIME   ftNow;
+      GetSystemTimeAsFileTime (&ftNow);
+
+      SetFileTime (hFile, nullptr, nullptr, &ftNow);
+    }
+
+    CloseHandle (hFile);
+  }
+
+  QueryPerformanceCounter_Original (&end);
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    auto file =
+      remaster_cache.files.find (key);
+
+    if (ok)
+    {
+      remaster_cache.stats.hits       += 1;
+      remaster_cache.stats.bytes_read += size;
+      remaster_cache.stats.read_ms    +=
+        1000.0 * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+      if (file != remaster_cache.files.end ())
+      {
+        remaster_cache.order.splice ( remaster_cache.order.end (),
+                                        remaster_cache.order, file->second.age );
+      }
+    }
+
+    // Damaged or gone; make it again next time
+    else
+      TZF_DropRemaster (key, false);
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  if (! ok)
+    data.clear ();
+
+  return ok;
+}
+
+bool
+TZF_StoreRemaster (uint32_t checksum, const uint8_t* data, size_t size, double resample_ms)
+{
+  const uint64_t key = TZF_GetRemasterKey (checksum);
+  const uint64_t cap = TZF_GetRemasterCacheCap ();
+
+  if (size == 0 || size > cap || size > UINT32_MAX || TZF_HasRemaster (checksum))
+    return false;
+
+  wchar_t wszPath [MAX_PATH],
+          wszTemp [MAX_PATH];
+
+  TZF_GetRemasterPath (key, wszPath);
+
+  // Unique per thread, so two workers storing the same texture cannot mix
+  _swprintf (wszTemp, L"%s.%lu.tmp", wszPath, GetCurrentThreadId ());
+
+  CreateDirectoryW (L"TZFix_Res",          nullptr);
+  CreateDirectoryW (TZF_REMASTER_CACHE_DIR, nullptr);
+
+  HANDLE hFile =
+    CreateFileW ( wszTemp,
+                    GENERIC_WRITE,
+                      0x00,
+                        nullptr,
+                          CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD written = 0;
+  bool  ok      =
+    WriteFile (hFile, data, (DWORD)size, &written, nullptr) && written == size;
+
+  CloseHandle (hFile);
+
+  // A partly written file must never be found under the real name
+  if (! (ok && MoveFileExW (wszTemp, wszPath, MOVEFILE_REPLACE_EXISTING)))
+  {
+    DeleteFileW (wszTemp);
+    return false;
+  }
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    if (! remaster_cache.files.count (key))
+    {
+      // Never evict what was just written
+      while ( remaster_cache.stats.bytes + size > cap &&
+              (! remaster_cache.order.empty ()) )
+        TZF_DropRemaster (remaster_cache.order.front (), true);
+
+      tzf_remaster_file_s entry;
+
+      entry.size = size;
+      entry.age  =
+        remaster_cache.order.insert (remaster_cache.order.end (), key);
+
+      remaster_cache.files.emplace (key, entry);
+
+      remaster_cache.stats.files         += 1;
+      remaster_cache.stats.bytes         += size;
+      remaster_cache.stats.stored        += 1;
+      remaster_cache.stats.bytes_written += size;
+      remaster_cache.stats.resample_ms   += resample_ms;
+    }
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  return true;
+}
+
+tzf_remaster_cache_stats_s
+TZF_GetRemasterCacheStats (void)
+{
+  tzf_remaster_cache_stats_s stats;
+
+  EnterCriticalSection (&remaster_cache.cs);
+  {
+    stats = remaster_cache.stats;
+  }
+  LeaveCriticalSection (&remaster_cache.cs);
+
+  return stats;
+}
+
+void
+TZF_LogRemasterCacheStats (void)
+{
+  tzf_remaster_cache_stats_s stats =
+    TZF_GetRemasterCacheStats ();
+
+  if (stats.lookups == 0 && stats.stored == 0)
+    return;
+
+  if (stats.lookups != 0)
+  {
+    tex_log->Log ( L"[ Remaster ] %7llu lookups, %5.1f%% hits: %9.2f MiB read from"
+                   L" the disk cache in %9.2f ms",
+                     stats.lookups,
+                       100.0 * (double)stats.hits / (double)stats.lookups,
+                         (double)stats.bytes_read / (1024.0 * 1024.0),
+                           stats.read_ms );
+  }
+
+  tex_log->Log ( L"[ Remaster ] %7llu chains resampled and stored (%9.2f MiB, %9.2f ms"
+                 L" of resampling that will not be repeated), %llu evicted",
+                   stats.stored,
+                     (double)stats.bytes_written / (1024.0 * 1024.0),
+                       stats.resample_ms,
+                         stats.evicted );
+
+  tex_log->Log ( L"[ Remaster ] %7llu files on disk, %9.2f MiB (cap: %li MiB)",
+                   stats.files,
+                     (double)stats.bytes / (1024.0 * 1024.0),
+                       config.textures.max_remaster_cache_in_mib );
+}
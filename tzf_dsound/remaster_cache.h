@@ -0,0 +1,88 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__REMASTER_CACHE_H__
+#define __TZF__REMASTER_CACHE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//
+// Remastered mip chains (the DDS files TZF_ResampleWithMipGen builds), kept
+//   in TZFix_Res\remaster_cache so that resampling a texture is paid for
+//     once rather than on every launch and after every purge.
+//
+//   Files are named <checksum>_<settings>.dds, where settings hashes the
+//     mip filter, gamma and DXT encoder options; changing any of those just
+//       stops matching the old files.  Reading a file marks it as used (its
+//         write time), and the least recently used files are deleted once
+//           TZFIX.Textures/MaxRemasterCacheInMiB is reached.
+//
+//   Only chains built by the hand-written filters are stored; what D3DX
+//     makes (other formats, RemasterMipFilter=D3DX) is made every time.
+//
+//   The directory is listed on a background thread from init; lookups and
+//     stores wait for it, so they belong on the resample workers.
+//
+
+void
+TZF_BeginRemasterCacheScan (void);
+
+void
+TZF_EndRemasterCacheScan   (void);
+
+// Reads the chain made with the current settings into data
+bool
+TZF_FetchRemaster         (uint32_t checksum, std::vector <uint8_t>& data);
+
+// Writes data to the cache; resample_ms is what making it cost, for the log.
+//   False if nothing was written (already stored, too large, or I/O failed).
+bool
+TZF_StoreRemaster         (uint32_t checksum, const uint8_t* data, size_t size, double resample_ms);
+
+bool
+TZF_HasRemaster           (uint32_t checksum);
+
+struct tzf_remaster_cache_stats_s {
+  uint64_t lookups       = 0ULL;
+  uint64_t hits          = 0ULL;
+  uint64_t bytes_read    = 0ULL;
+  double   read_ms       = 0.0;    // Time spent reading hits
+
+  uint64_t stored        = 0ULL;
+  uint64_t bytes_written = 0ULL;
+  double   resample_ms   = 0.0;    // What the stored chains took to make
+  uint64_t evicted       = 0ULL;
+
+  uint64_t files         = 0ULL;   // Everything on disk, any settings
+  uint64_t bytes         = 0ULL;
+};
+
+tzf_remaster_cache_stats_s
+TZF_GetRemasterCacheStats (void);
+
+void
+TZF_LogRemasterCacheStats (void);
+
+#endif /* __TZF__REMASTER_CACHE_H__ */
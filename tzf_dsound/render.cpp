@@ -80,6 +80,8 @@ extern bool pending_loads            (void);
 extern void TZFix_LoadQueuedTextures (void);
 extern void TZFix_DrawConfigUI       (void);
 
+extern void TZF_RestoreInjectedTextures (IDirect3DDevice9* pDevice);
+
 enum reset_stage_s {
   Initiate = 0x0, // Fake device loss
   Respond  = 0x1, // Fake device not reset
@@ -1726,6 +1728,9 @@ D3D9Reset_Detour ( IDirect3DDevice9      *This,
   if (SUCCEEDED (hr))
   {
     HWND hWnd = pPresentationParameters->hDeviceWindow;
+
+    // Whatever TextureManager::reset (...) kept in RAM
+    TZF_RestoreInjectedTextures (This);
   }
 
   trigger_reset = reset_stage_s::Clear;
@@ -0,0 +1,460 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__SNAPSHOT_INDEX_H__
+#define __TZF__SNAPSHOT_INDEX_H__
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#if defined (_M_X64) || defined (__SSE2__) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+# define TZF_INDEX_SSE2
+# include <emmintrin.h>
+#endif
+
+//
+// A checksum -> record table that is read from every thread and written
+//   almost never (a data source refresh, a failed stream, the gamepad
+//     texture).
+//
+//   Readers never lock: they look things up in an immutable snapshot, a
+//     sorted key array plus a parallel value array.  Writers build a new
+//       snapshot from a copy of the current one, publish it with a single
+//         pointer swap and free the old one once no reader can still be
+//           looking at it.
+//
+//   Grace periods use two reader counts, picked by the low bit of epoch_.
+//     After a swap the writer flips the epoch and waits for the old count
+//       to drain; readers that show up in the meantime land in the other
+//         count and can only have seen the new snapshot.  A reader holds
+//           its count for one search, so the wait is short.
+//
+//   The counts are striped by thread so workers on different cores do
+//     not all bounce the same cache line.
+//
+//   Nothing handed out points into a snapshot; records are copied out.
+//
+//   Sized for a few hundred thousand entries:
+//
+//     o Values are stored as tzf_index_packing_s <_T>::packed_t; anything
+//         that does not pack goes to a short spill list instead.
+//     o Checksums are uniform, so their top bits index a directory of
+//         where each run of keys starts (~8 keys per run).  The rest is a
+//           branchless narrowing and one 4-wide compare.
+//     o A small direct-mapped cache of recent hits sits in front of that.
+//
+
+// Identity by default; specialize to store _T in fewer bytes
+template <typename _T>
+struct tzf_index_packing_s {
+  typedef _T packed_t;
+
+  static bool pack   (const _T& value, packed_t* packed) { *packed = value; return true; }
+  static _T   unpack (const packed_t& packed)            { return packed;                }
+};
+
+template <typename _T>
+class TZF_SnapshotIndex
+{
+public:
+  typedef std::pair <uint32_t, _T>                    item_t;
+  typedef typename tzf_index_packing_s <_T>::packed_t packed_t;
+
+  TZF_SnapshotIndex (void) : current_ (build (std::vector <item_t> ())) {
+    for (auto& stripe : stripes_)
+    {
+      stripe.readers [0] = 0;
+      stripe.readers [1] = 0;
+    }
+  }
+
+  ~TZF_SnapshotIndex (void) {
+    delete current_.load ();
+  }
+
+  bool find (uint32_t key, _T* out) const
+  {
+    read_s read (this);
+
+    return read.snap->find (key, out);
+  }
+
+  size_t count (uint32_t key) const {
+    return find (key, nullptr) ? 1 : 0;
+  }
+
+  size_t size (void) const
+  {
+    read_s read (this);
+
+    return read.snap->size ();
+  }
+
+  // Ordered by key
+  std::vector <item_t> items (void) const
+  {
+    read_s read (this);
+
+    return read.snap->items ();
+  }
+
+  // Bytes held by the current snapshot
+  size_t memory (void) const
+  {
+    read_s read (this);
+
+    const snapshot_s* snap = read.snap;
+
+    return sizeof (snapshot_s)                                +
+           snap->keys.capacity   () * sizeof (uint32_t)       +
+           snap->values.capacity () * sizeof (packed_t)       +
+           snap->spill.capacity  () * sizeof (item_t)         +
+           snap->runs.capacity   () * sizeof (uint32_t);
+  }
+
+  // Bumped by every publish
+  uint32_t generation (void) const {
+    return generation_.load ();
+  }
+
+  // Replaces everything; the first item wins if a key appears twice
+  template <typename _Items>
+  void assign (const _Items& items)
+  {
+    std::vector <item_t> sorted (items.begin (), items.end ());
+
+    std::stable_sort ( sorted.begin (), sorted.end (),
+                         [](const item_t& a, const item_t& b) {
+                           return a.first < b.first;
+                         } );
+
+    sorted.erase ( std::unique ( sorted.begin (), sorted.end (),
+                                   [](const item_t& a, const item_t& b) {
+                                     return a.first == b.first;
+                                   } ),
+                     sorted.end () );
+
+    snapshot_s* snap = build (sorted);
+
+    std::lock_guard <std::mutex> lock (write_lock_);
+
+    publish (snap);
+  }
+
+  void insert_or_assign (uint32_t key, const _T& value)
+  {
+    std::lock_guard <std::mutex> lock (write_lock_);
+
+    std::vector <item_t> items = current_.load ()->items ();
+
+    auto it =
+      std::lower_bound ( items.begin (), items.end (), key,
+                           [](const item_t& a, uint32_t b) {
+                             return a.first < b;
+                           } );
+
+    if (it != items.end () && it->first == key)
+      it->second = value;
+    else
+      items.insert (it, std::make_pair (key, value));
+
+    publish (build (items));
+  }
+
+  bool erase (uint32_t key)
+  {
+    std::lock_guard <std::mutex> lock (write_lock_);
+
+    if (! current_.load ()->find (key, nullptr))
+      return false;
+
+    std::vector <item_t> items = current_.load ()->items ();
+
+    items.erase (
+      std::lower_bound ( items.begin (), items.end (), key,
+                           [](const item_t& a, uint32_t b) {
+                             return a.first < b;
+                           } ) );
+
+    publish (build (items));
+
+    return true;
+  }
+
+  void clear (void)
+  {
+    std::lock_guard <std::mutex> lock (write_lock_);
+
+    publish (build (std::vector <item_t> ()));
+  }
+
+protected:
+  enum { STRIPES     = 16,
+         HOT_ENTRIES = 1024,
+         KEY_PADDING = 4 };
+
+  struct snapshot_s {
+    std::vector <uint32_t> keys;     // Sorted, then KEY_PADDING x UINT32_MAX
+    std::vector <packed_t> values;
+    std::vector <item_t>   spill;    // Sorted; values that did not pack
+    std::vector <uint32_t> runs;     // First key with each top-bits prefix
+    uint32_t               count;    // Keys, not counting the padding
+    uint32_t               shift;
+
+    // Index of a key seen recently, plus one; checked against keys before
+    //   it is believed, so a stale or torn-looking entry only costs a miss
+    mutable std::atomic <uint32_t> hot [HOT_ENTRIES];
+
+    snapshot_s (void) : count (0), shift (31) {
+      for (auto& entry : hot)
+        entry.store (0, std::memory_order_relaxed);
+    }
+
+    size_t size (void) const {
+      return count + spill.size ();
+    }
+
+    size_t lookup (uint32_t key) const
+    {
+      std::atomic <uint32_t>& entry = hot [(key ^ (key >> 16)) & (HOT_ENTRIES - 1)];
+      uint32_t                seen  = entry.load (std::memory_order_relaxed);
+
+      if (seen != 0 && keys [seen - 1] == key)
+        return seen - 1;
+
+      uint32_t        run  = key >> shift;
+      const uint32_t* base = keys.data () + runs [run];
+      size_t          len  = runs [run + 1] - runs [run];
+
+      // Keeps the key, if there, within base [0 .. len]
+      while (len > KEY_PADDING - 1)
+      {
+        size_t half = len / 2;
+
+        base  = (base [half] < key) ? base + half : base;
+        len  -= half;
+      }
+
+      size_t idx = base - keys.data ();
+
+#ifdef TZF_INDEX_SSE2
+      int match =
+        _mm_movemask_ps (
+          _mm_castsi128_ps (
+            _mm_cmpeq_epi32 ( _mm_loadu_si128 ((const __m128i *)base),
+                              _mm_set1_epi32  ((int)key) ) ) );
+
+      if (match == 0)
+        return SIZE_MAX;
+
+      idx += (match & 1) ? 0 : (match & 2) ? 1 : (match & 4) ? 2 : 3;
+#else
+      size_t end = idx + KEY_PADDING;
+
+      while (idx < end && keys [idx] != key)
+        ++idx;
+
+      if (idx == end)
+        return SIZE_MAX;
+#endif
+
+      // Matched the padding; UINT32_MAX is not a key here
+      if (idx >= count)
+        return SIZE_MAX;
+
+      entry.store ((uint32_t)idx + 1, std::memory_order_relaxed);
+
+      return idx;
+    }
+
+    bool find (uint32_t key, _T* out) const
+    {
+      size_t idx = lookup (key);
+
+      if (idx != SIZE_MAX)
+      {
+        if (out != nullptr)
+          *out = tzf_index_packing_s <_T>::unpack (values [idx]);
+
+        return true;
+      }
+
+      if (spill.empty ())
+        return false;
+
+      auto it =
+        std::lower_bound ( spill.begin (), spill.end (), key,
+                             [](const item_t& a, uint32_t b) {
+                               return a.first < b;
+                             } );
+
+      if (it == spill.end () || it->first != key)
+        return false;
+
+      if (out != nullptr)
+        *out = it->second;
+
+      return true;
+    }
+
+    std::vector <item_t> items (void) const
+    {
+      std::vector <item_t> out;
+
+      out.reserve (size ());
+
+      auto spilled = spill.begin ();
+
+      for (uint32_t i = 0; i < count; i++)
+      {
+        while (spilled != spill.end () && spilled->first < keys [i])
+          out.push_back (*spilled++);
+
+        out.push_back (
+          std::make_pair (keys [i], tzf_index_packing_s <_T>::unpack (values [i]))
+        );
+      }
+
+      out.insert (out.end (), spilled, spill.end ());
+
+      return out;
+    }
+  };
+
+  // items must be sorted and unique
+  static snapshot_s* build (const std::vector <item_t>& items)
+  {
+    snapshot_s* snap = new snapshot_s ();
+
+    snap->keys.reserve   (items.size () + KEY_PADDING);
+    snap->values.reserve (items.size ());
+
+    for (auto& it : items)
+    {
+      packed_t packed;
+
+      if (tzf_index_packing_s <_T>::pack (it.second, &packed))
+      {
+        snap->keys.push_back   (it.first);
+        snap->values.push_back (packed);
+      }
+
+      else
+        snap->spill.push_back (it);
+    }
+
+    snap->count = (uint32_t)snap->keys.size ();
+
+    // About 8 keys per run, 64K runs at most
+    uint32_t bits = 1;
+
+    while (bits < 16 && (snap->count >> (bits + 3)) != 0)
+      ++bits;
+
+    snap->shift = 32 - bits;
+    snap->runs.resize ((1 << bits) + 1);
+
+    for (uint32_t run = 0, i = 0; run <= (1U << bits); run++)
+    {
+      while (i < snap->count && (snap->keys [i] >> snap->shift) < run)
+        ++i;
+
+      snap->runs [run] = i;
+    }
+
+    snap->keys.insert (snap->keys.end (), KEY_PADDING, UINT32_MAX);
+
+    return snap;
+  }
+
+  // One cache line each
+  struct stripe_s {
+    std::atomic <uint32_t> readers [2];
+    uint8_t                pad     [64 - 2 * sizeof (std::atomic <uint32_t>)];
+  };
+
+  // Pins whatever snapshot is current for as long as it lives
+  struct read_s {
+    read_s (const TZF_SnapshotIndex* index)
+    {
+      stripe_s& stripe =
+        index->stripes_ [ std::hash <std::thread::id> () (std::this_thread::get_id ()) %
+                            STRIPES ];
+
+      // Re-check the epoch so a reader that raced a flip is never counted
+      //   against the half the writer has already stopped waiting on
+      for (;;)
+      {
+        uint32_t epoch = index->epoch_.load ();
+
+        slot = &stripe.readers [epoch & 1];
+        slot->fetch_add (1);
+
+        if (index->epoch_.load () == epoch)
+          break;
+
+        slot->fetch_sub (1);
+      }
+
+      snap = index->current_.load ();
+    }
+
+    ~read_s (void) {
+      slot->fetch_sub (1);
+    }
+
+    const snapshot_s*        snap;
+    std::atomic <uint32_t>*  slot;
+  };
+
+  // Write lock held
+  void publish (snapshot_s* snap)
+  {
+    snapshot_s* old   = current_.exchange (snap);
+    uint32_t    epoch = epoch_.fetch_add (1);
+
+    ++generation_;
+
+    for (auto& stripe : stripes_)
+    {
+      while (stripe.readers [epoch & 1].load () != 0)
+        std::this_thread::yield ();
+    }
+
+    delete old;
+  }
+
+private:
+  std::atomic <snapshot_s *>      current_;
+  mutable stripe_s                stripes_ [STRIPES];
+  std::atomic <uint32_t>          epoch_      = { 0 };
+  std::atomic <uint32_t>          generation_ = { 0 };
+  std::mutex                      write_lock_;
+};
+
+#endif /* __TZF__SNAPSHOT_INDEX_H__ */
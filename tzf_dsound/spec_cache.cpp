@@ -0,0 +1,205 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "spec_cache.h"
+#include "config.h"
+#include "log.h"
+
+#include <list>
+#include <algorithm>
+#include <unordered_map>
+
+extern iSK_Logger* tex_log;
+
+struct tzf_spec_entry_s {
+  std::vector <uint8_t>           data;
+  std::list   <uint32_t>::iterator age;
+};
+
+static struct {
+  CRITICAL_SECTION                                cs;
+
+  std::unordered_map <uint32_t, tzf_spec_entry_s> entries;
+  std::list          <uint32_t>                   order;  // Oldest first
+
+  tzf_spec_cache_stats_s                          stats;
+} spec_cache;
+
+static bool
+TZF_InitSpeculativeCache (void)
+{
+  InitializeCriticalSectionAndSpinCount (&spec_cache.cs, 1000UL);
+  return true;
+}
+
+static bool spec_cache_init = TZF_InitSpeculativeCache ();
+
+
+// Caller holds spec_cache.cs
+static void
+TZF_EvictSpeculativeTexture (uint32_t checksum)
+{
+  auto entry =
+    spec_cache.entries.find (checksum);
+
+  size_t size = entry->second.data.size ();
+
+  spec_cache.stats.wasted       += 1;
+  spec_cache.stats.wasted_bytes += size;
+  spec_cache.stats.bytes        -= size;
+
+  spec_cache.order.erase   (entry->second.age);
+  spec_cache.entries.erase (entry);
+}
+
+bool
+TZF_StageSpeculativeTexture (uint32_t checksum, const uint8_t* data, size_t size)
+{
+  const uint64_t cap =
+    (uint64_t)std::max (0, config.textures.max_speculative_in_mib) * 1024ULL * 1024ULL;
+
+  if (size == 0 || size > cap)
+    return false;
+
+  bool staged = false;
+
+  EnterCriticalSection (&spec_cache.cs);
+  {
+    if (! spec_cache.entries.count (checksum))
+    {
+      while (spec_cache.stats.bytes + size > cap)
+        TZF_EvictSpeculativeTexture (spec_cache.order.front ());
+
+      tzf_spec_entry_s& entry =
+        spec_cache.entries [checksum];
+
+      entry.data.assign (data, data + size);
+      entry.age = spec_cache.order.insert (spec_cache.order.end (), checksum);
+
+      spec_cache.stats.staged       += 1;
+      spec_cache.stats.staged_bytes += size;
+      spec_cache.stats.bytes        += size;
+      spec_cache.stats.peak_bytes    =
+        std::max (spec_cache.stats.peak_bytes, spec_cache.stats.bytes);
+
+      staged = true;
+    }
+  }
+  LeaveCriticalSection (&spec_cache.cs);
+
+  return staged;
+}
+
+bool
+TZF_TakeSpeculativeTexture (uint32_t checksum, std::vector <uint8_t>& data)
+{
+  bool hit = false;
+
+  EnterCriticalSection (&spec_cache.cs);
+  {
+    auto entry =
+      spec_cache.entries.find (checksum);
+
+    if (entry != spec_cache.entries.end ())
+    {
+      data.swap (entry->second.data);
+
+      spec_cache.stats.hits      += 1;
+      spec_cache.stats.hit_bytes += data.size ();
+      spec_cache.stats.bytes     -= data.size ();
+
+      spec_cache.order.erase   (entry->second.age);
+      spec_cache.entries.erase (entry);
+
+      hit = true;
+    }
+  }
+  LeaveCriticalSection (&spec_cache.cs);
+
+  return hit;
+}
+
+bool
+TZF_IsSpeculativeTextureStaged (uint32_t checksum)
+{
+  bool staged = false;
+
+  EnterCriticalSection (&spec_cache.cs);
+  {
+    staged = spec_cache.entries.count (checksum) != 0;
+  }
+  LeaveCriticalSection (&spec_cache.cs);
+
+  return staged;
+}
+
+void
+TZF_ClearSpeculativeCache (void)
+{
+  EnterCriticalSection (&spec_cache.cs);
+  {
+    while (! spec_cache.order.empty ())
+      TZF_EvictSpeculativeTexture (spec_cache.order.front ());
+  }
+  LeaveCriticalSection (&spec_cache.cs);
+}
+
+tzf_spec_cache_stats_s
+TZF_GetSpeculativeCacheStats (void)
+{
+  tzf_spec_cache_stats_s stats;
+
+  EnterCriticalSection (&spec_cache.cs);
+  {
+    stats = spec_cache.stats;
+  }
+  LeaveCriticalSection (&spec_cache.cs);
+
+  return stats;
+}
+
+void
+TZF_LogSpeculativeCacheStats (void)
+{
+  tzf_spec_cache_stats_s stats =
+    TZF_GetSpeculativeCacheStats ();
+
+  if (stats.staged == 0)
+    return;
+
+  tex_log->Log ( L"[Spec.Cache] %7llu textures staged (%9.2f MiB): %5.1f%% used"
+                 L" (%9.2f MiB), %llu evicted unused (%9.2f MiB)",
+                   stats.staged,
+                     (double)stats.staged_bytes / (1024.0 * 1024.0),
+                       100.0 * (double)stats.hits / (double)stats.staged,
+                         (double)stats.hit_bytes    / (1024.0 * 1024.0),
+                           stats.wasted,
+                             (double)stats.wasted_bytes / (1024.0 * 1024.0) );
+
+  tex_log->Log ( L"[Spec.Cache] Held %9.2f MiB at most (cap: %li MiB)",
+                   (double)stats.peak_bytes / (1024.0 * 1024.0),
+                     config.textures.max_speculative_in_mib );
+}
@@ -0,0 +1,71 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__SPEC_CACHE_H__
+#define __TZF__SPEC_CACHE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//
+// Textures decoded along with another one from the same solid block, kept
+//   in system memory on the bet that the game asks for them soon.  A hit
+//     hands the bytes over (and forgets them); a miss costs nothing but the
+//       memory, which is capped by TZFIX.Textures/MaxSpeculativeCacheInMiB.
+//         The oldest textures are evicted first.
+//
+
+// Copies data; false if it is already staged or would not fit at all
+bool
+TZF_StageSpeculativeTexture    (uint32_t checksum, const uint8_t* data, size_t size);
+
+// Moves the staged bytes into data and removes them from the cache
+bool
+TZF_TakeSpeculativeTexture     (uint32_t checksum, std::vector <uint8_t>& data);
+
+bool
+TZF_IsSpeculativeTextureStaged (uint32_t checksum);
+
+// Staged bytes are only valid for the data sources they were read from
+void
+TZF_ClearSpeculativeCache      (void);
+
+struct tzf_spec_cache_stats_s {
+  uint64_t staged        = 0ULL;
+  uint64_t staged_bytes  = 0ULL;
+  uint64_t hits          = 0ULL;   // Taken before being evicted or cleared
+  uint64_t hit_bytes     = 0ULL;
+  uint64_t wasted        = 0ULL;   // Evicted or cleared without a hit
+  uint64_t wasted_bytes  = 0ULL;
+
+  uint64_t bytes         = 0ULL;
+  uint64_t peak_bytes    = 0ULL;
+};
+
+tzf_spec_cache_stats_s
+TZF_GetSpeculativeCacheStats   (void);
+
+void
+TZF_LogSpeculativeCacheStats   (void);
+
+#endif /* __TZF__SPEC_CACHE_H__ */
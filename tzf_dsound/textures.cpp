@@ -31,9 +31,12 @@
 #include "hook.h"
 #include "log.h"
 #include <process.h>
+#include <psapi.h>
+#pragma comment (lib, "psapi.lib")
 
 #include <cstdint>
 #include <algorithm>
+#include <atomic>
 
 #include "command.h"
 
@@ -43,6 +46,23 @@
 #include "lzma/7zCrc.h"
 #include "lzma/7zFile.h"
 #include "lzma/7zVersion.h"
+#include "lzma/XzCrc64.h"
+
+#include "archive.h"
+#include "pack.h"
+#include "trace.h"
+#include "io_stage.h"
+#include "buffer_pool.h"
+#include "spec_cache.h"
+#include "payload_cache.h"
+#include "dds.h"
+#include "mipgen.h"
+#include "bcn.h"
+#include "remaster_cache.h"
+#include "dump_queue.h"
+#include "dump_store.h"
+#include "dump_index.h"
+#include "snapshot_index.h"
 
 #define TZFIX_TEXTURE_DIR L"TZFix_Res"
 #define TZFIX_TEXTURE_EXT L".dds"
@@ -84,6 +104,9 @@ static SetDepthStencilSurface_pfn              D3D9SetDepthStencilSurface_Origin
 extern uint32_t
 TZF_MakeShadowBitShift (uint32_t dim);
 
+static int64_t
+TZF_GetSharedTextureSavings (void);
+
 typedef BOOL(WINAPI *QueryPerformanceCounter_t)(_Out_ LARGE_INTEGER *lpPerformanceCount);
 extern QueryPerformanceCounter_t QueryPerformanceCounter_Original;
 
@@ -116,6 +139,7 @@ void TZFix_LoadQueuedTextures (void);
 #include <map>
 #include <set>
 #include <queue>
+#include <memory>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -190,36 +214,118 @@ TBF_HashSet <IDirect3DSurface9 *> outstanding_screenshots; // Not excellent scre
                                                            //   that aren't finished yet and we can't reset
                                                            //     the D3D9 device because of.
 
-std::unordered_map <uint32_t, tzf_tex_record_s> injectable_textures;
-std::vector        <std::wstring>               archives;
+// How injectable_textures stores a record: 12 bytes, where a map node held
+//   the key, the 20 (32-bit) or 32 byte record and two links.  Records that
+//     do not fit (255+ archives, 4M+ files in one, 4 GiB+) are kept whole.
+struct tzf_tex_packed_s {
+  uint32_t size;
+  uint32_t buffer;
+  uint32_t fileno  : 22;
+  uint32_t archive :  8; // 0xFF: loose file
+  uint32_t method  :  2;
+};
+
+template <>
+struct tzf_index_packing_s <tzf_tex_record_s> {
+  typedef tzf_tex_packed_s packed_t;
+
+  static bool pack (const tzf_tex_record_s& record, packed_t* packed)
+  {
+    const unsigned int loose = std::numeric_limits <unsigned int>::max ();
+
+    if ( (uint64_t)record.size   > UINT32_MAX ||
+         (uint64_t)record.buffer > UINT32_MAX ||
+         record.fileno < 0                    ||
+         record.fileno >= (1 << 22)           ||
+         (record.archive >= 0xFF && record.archive != loose) )
+      return false;
+
+    packed->size    = (uint32_t)record.size;
+    packed->buffer  = (uint32_t)record.buffer;
+    packed->fileno  = (uint32_t)record.fileno;
+    packed->archive = record.archive == loose ? 0xFF : record.archive;
+    packed->method  = (uint32_t)record.method;
+
+    return true;
+  }
+
+  static tzf_tex_record_s unpack (const packed_t& packed)
+  {
+    tzf_tex_record_s record;
+
+    record.size    = packed.size;
+    record.buffer  = packed.buffer;
+    record.fileno  = (int)packed.fileno;
+    record.archive = packed.archive == 0xFF ?
+                       std::numeric_limits <unsigned int>::max () : packed.archive;
+    record.method  = (tzf_load_method_t)packed.method;
+
+    return record;
+  }
+};
+
+typedef std::vector <std::wstring> tzf_archive_names_t;
+
+// Read from the render thread and every worker; see snapshot_index.h
+TZF_SnapshotIndex  <tzf_tex_record_s>           injectable_textures;
 std::unordered_set <uint32_t>                   dumped_textures;
 
+// What a record's archive indexes; never changed in place, a refresh
+//   publishes a new table with std::atomic_store (...)
+static std::shared_ptr <const tzf_archive_names_t>
+  archives = std::make_shared <const tzf_archive_names_t> ();
+
 std::vector <std::wstring>
 TZF_GetTextureArchives (void)
 {
-  return archives;
+  return *std::atomic_load (&archives);
 }
 
-std::vector < std::pair < uint32_t, tzf_tex_record_s > >
-TZF_GetInjectableTextures (void)
+//
+// A record and the archive table it indexes, as a consistent pair.
+//
+//   TZF_RefreshDataSources (...) publishes an empty table before it clears
+//     the records, and the new table before it assigns the new ones; a table
+//       that was current both before and after the lookup matches the record
+//         (or is empty, and matches nothing).
+//
+static bool
+TZF_FindInjectableTexture ( uint32_t                                     checksum,
+                            tzf_tex_record_s*                            record,
+                            std::shared_ptr <const tzf_archive_names_t>* names )
 {
-  std::vector < std::pair < uint32_t, tzf_tex_record_s > > textures;
-
-  for ( auto it : injectable_textures ) 
+  for (;;)
   {
-    textures.push_back (std::make_pair (it.first, it.second));
+    std::shared_ptr <const tzf_archive_names_t> before =
+      std::atomic_load (&archives);
+
+    bool found =
+      injectable_textures.find (checksum, record);
+
+    if (std::atomic_load (&archives) == before)
+    {
+      names->swap (before);
+      return found;
+    }
   }
+}
 
-  return textures;
+static const wchar_t*
+TZF_GetArchiveName (const tzf_archive_names_t& names, unsigned int archive)
+{
+  return archive < names.size () ? names [archive].c_str () : L"INVALID";
 }
 
-tzf_tex_record_s*
-TZF_GetInjectableTexture (uint32_t checksum)
+std::vector < std::pair < uint32_t, tzf_tex_record_s > >
+TZF_GetInjectableTextures (void)
 {
-  if (injectable_textures.count (checksum))
-    return &injectable_textures [checksum];
+  return injectable_textures.items ();
+}
 
-  return nullptr;
+bool
+TZF_GetInjectableTexture (uint32_t checksum, tzf_tex_record_s* record)
+{
+  return injectable_textures.find (checksum, record);
 }
 
 // The set of textures used during the last frame
@@ -637,10 +743,11 @@ tzf::RenderFix::TextureManager::numInjectedTextures (void)
   return injected_count;
 }
 
+// Each checksum sharing an override counts it; the copies were never made
 int64_t
 tzf::RenderFix::TextureManager::cacheSizeInjected (void)
 {
-  return injected_size;
+  return injected_size - TZF_GetSharedTextureSavings ();
 }
 
 int64_t
@@ -807,6 +914,9 @@ D3D9SetTexture_Detour (
 
     QueryPerformanceCounter_Original (&pSKTex->last_used);
 
+    if (pSKTex->demoted_mips != 0)
+      ++pSKTex->binds;
+
     tex_crc32 = pSKTex->tex_crc32;
 
     //
@@ -1080,6 +1190,28 @@ typedef HRESULT (WINAPI *D3DXGetImageInfoFromFileInMemory_pfn)
 D3DXGetImageInfoFromFileInMemory_pfn
   D3DXGetImageInfoFromFileInMemory = nullptr;
 
+// DDS headers are read in place; D3DX only gets the other file formats
+static HRESULT
+TZF_GetImageInfo (LPCVOID pSrcData, UINT SrcDataSize, D3DXIMAGE_INFO* info)
+{
+  tzf_dds_info_s dds;
+
+  if (! TZF_ParseDDSHeader (pSrcData, SrcDataSize, &dds))
+    return D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, info);
+
+  info->Width           = dds.width;
+  info->Height          = dds.height;
+  info->Depth           = dds.depth;
+  info->MipLevels       = dds.mip_levels;
+  info->Format          = (D3DFORMAT)dds.format;
+  info->ImageFileFormat = D3DXIFF_DDS;
+  info->ResourceType    = dds.cubemap ? D3DRTYPE_CUBETEXTURE   :
+                          dds.volume  ? D3DRTYPE_VOLUMETEXTURE :
+                                        D3DRTYPE_TEXTURE;
+
+  return S_OK;
+}
+
 typedef HRESULT (WINAPI *D3DXGetImageInfoFromFile_pfn)
 (
   _In_ LPCWSTR         pSrcFile,
@@ -1181,7 +1313,10 @@ struct tzf_tex_load_s {
   enum {
     Stream,    // This load will be streamed
     Immediate, // This load must finish immediately   (pSrc is unused)
-    Resample   // Change image properties             (pData is supplied)
+    Resample,  // Change image properties             (pData is supplied)
+    Decode,    // Bulk archive decode; no texture      (decode is supplied)
+    Restore,   // Recreate after a device reset        (staged at reset)
+    Residency  // Demote or promote an injected texture (skip_mips says which)
   } type;
 
   LPDIRECT3DDEVICE9   pDevice;
@@ -1199,6 +1334,27 @@ struct tzf_tex_load_s {
   LPDIRECT3DTEXTURE9  pDest = nullptr;
   LPDIRECT3DTEXTURE9  pSrc  = nullptr;
 
+  // Decode only
+  tzf_decode_job_s*   decode = nullptr;
+
+  // Stream: the file (or pack block) as read by the I/O stage, if it ran
+  tzf_io_request_s*   io     = nullptr;
+
+  // Stream / Immediate: bytes charged against the in-flight budget
+  size_t              in_flight = 0;
+
+  // Stream: top mip levels this pass leaves out (0 = the full chain).  A
+  //   preview is swapped in when it finishes and the same job is posted
+  //     again for the full chain; requested times both for the log.
+  // Residency: levels the new override leaves out (0 = promote it again)
+  UINT                skip_mips = 0;
+  bool                previewed = false;
+  LARGE_INTEGER       requested = { 0LL };
+
+  // Header of the image, once something has read it (Width != 0); Resample
+  //   gets it from the detour, loads from InjectTexture (...)
+  D3DXIMAGE_INFO      info  = { };
+
   LARGE_INTEGER       start = { 0LL };
   LARGE_INTEGER       end   = { 0LL };
   LARGE_INTEGER       freq  = { 0LL };
@@ -1399,6 +1555,12 @@ public:
   {
     EnterCriticalSection (&cs_jobs);
     {
+      if (stopped_)
+      {
+        LeaveCriticalSection (&cs_jobs);
+        return;
+      }
+
       // Defer the creation of this until the first job is posted
       if (! spool_thread_) {
         spool_thread_ =
@@ -1411,7 +1573,8 @@ public:
       }
 
       // Don't let the game free this while we are working on it...
-      job->pDest->AddRef ();
+      if (job->pDest != nullptr)
+        job->pDest->AddRef ();
 
       jobs_.push (job);
       SetEvent   (events_.jobs_added);
@@ -1462,6 +1625,35 @@ public:
     SetEvent (events_.shutdown);
   }
 
+  // At shutdown: takes no more jobs, lets the workers finish what is queued
+  //   and then has each one leave through its exit path (which releases its
+  //     buffers and decoder context).
+  void stopWorkers (void) {
+    EnterCriticalSection (&cs_jobs);
+    {
+      stopped_ = true;
+    }
+    LeaveCriticalSection (&cs_jobs);
+
+    if (spool_thread_ != nullptr) {
+      shutdown ();
+
+      // Wake the spooler from either of its waits
+      SetEvent (events_.jobs_added);
+      SetEvent (events_.results_waiting);
+
+      WaitForSingleObject (spool_thread_, INFINITE);
+      CloseHandle         (spool_thread_);
+
+      spool_thread_ = nullptr;
+    }
+
+    for ( auto it : workers_ )
+      delete it;
+
+    workers_.clear ();
+  }
+
   std::vector <tzf_tex_thread_stats_s> getWorkerStats (void)
   {
     std::vector <tzf_tex_thread_stats_s> stats;
@@ -1535,9 +1727,166 @@ private:
   CRITICAL_SECTION cs_jobs;
   CRITICAL_SECTION cs_results;
 
-  HANDLE spool_thread_;
+  HANDLE        spool_thread_;
+  volatile bool stopped_ = false;
 } *resample_pool = nullptr;
 
+extern tzf_io_stage_s* io_stage;
+
+static bool
+TZF_QueueTextureRead (tzf_tex_load_s* load);
+
+//
+// Every stream job is charged what a worker will need to decode it when it
+//   is admitted, and the charge is returned once its texture is created.
+//     Past TZFIX.Textures/MaxInFlightStreamingInMiB, streamed jobs are held
+//       back (in order) until enough is returned; jobs the game is blocking
+//         on are always admitted.  One job is always let through, however
+//           large, so an oversized solid block cannot stall streaming.
+//
+static struct {
+  CRITICAL_SECTION        cs;
+
+  std::queue < std::pair < tzf_tex_load_s*, size_t > >
+                          held;
+
+  LONG64                  reserved  = 0LL;
+
+  struct {
+    volatile LONG64 reserved_peak = 0LL;
+    volatile LONG   held_jobs     = 0L;
+    volatile LONG   held_peak     = 0L;
+  } stats;
+} stream_budget;
+
+static bool
+TZF_InitStreamBudget (void)
+{
+  InitializeCriticalSectionAndSpinCount (&stream_budget.cs, 1000UL);
+  return true;
+}
+
+static bool stream_budget_init = TZF_InitStreamBudget ();
+
+// The packed (solid) block a 7z texture decodes from, for the I/O stage to
+//   read ahead; a block larger than the whole in-flight budget is left to
+//     the mapping (or buffered reads) the decoder uses otherwise.
+static bool
+TZF_GetArchiveReadAhead ( const tzf_tex_record_s& record,
+                          uint64_t*               offset,
+                          uint64_t*               length )
+{
+  if ( io_stage       == nullptr ||
+       record.archive == std::numeric_limits <unsigned int>::max () )
+    return false;
+
+  // Packs have no blocks here; they read their entries ahead themselves
+  if (! TZF_GetArchiveBlockRange (record.archive, (uint32_t)record.fileno, offset, length))
+    return false;
+
+  const uint64_t budget =
+    (uint64_t)std::max (0, config.textures.max_in_flight_in_mib) * 1024ULL * 1024ULL;
+
+  return *length <= (uint64_t)(SIZE_MAX >> 1) &&
+         ( budget == 0ULL || *length <= budget );
+}
+
+// What a worker will hold to decode this: the solid block or decode buffer
+//   for archives and packs (and a 7z block's packed bytes, if read ahead),
+//     the file itself for loose textures.
+static size_t
+TZF_GetStreamFootprint (tzf_tex_load_s* load)
+{
+  tzf_tex_record_s inject;
+
+  if (! injectable_textures.find (load->checksum, &inject))
+    return std::max ((size_t)1, (size_t)load->SrcDataSize);
+
+  // Staged and L2-cached textures skip the decode
+  if ( TZF_IsSpeculativeTextureStaged (load->checksum) ||
+       TZF_HasTexturePayload          (load->checksum) )
+    return std::max ((size_t)1, inject.size);
+
+  uint64_t offset = 0ULL,
+           length = 0ULL;
+
+  if ( load->type != tzf_tex_load_s::Stream ||
+       (! TZF_GetArchiveReadAhead (inject, &offset, &length)) )
+    length = 0ULL;
+
+  return std::max ( { (size_t)1, inject.size, inject.buffer } ) + (size_t)length;
+}
+
+static void
+TZF_ChargeStreamJob (tzf_tex_load_s* load, size_t footprint)
+{
+  load->in_flight          = footprint;
+  stream_budget.reserved  += footprint;
+
+  if (stream_budget.reserved > stream_budget.stats.reserved_peak)
+    stream_budget.stats.reserved_peak = stream_budget.reserved;
+}
+
+// false if the job was held back; it is posted again when admitted
+static bool
+TZF_AdmitStreamJob (tzf_tex_load_s* load)
+{
+  // Already charged (back from the I/O stage), or not a load at all
+  if ( load->in_flight != 0 ||
+       ( load->type != tzf_tex_load_s::Stream &&
+         load->type != tzf_tex_load_s::Immediate ) )
+    return true;
+
+  const LONG64 budget =
+    (LONG64)config.textures.max_in_flight_in_mib * 1024LL * 1024LL;
+
+  size_t footprint = TZF_GetStreamFootprint (load);
+  bool   admit     = false;
+
+  EnterCriticalSection (&stream_budget.cs);
+  {
+    admit = budget                  <= 0LL                                   ||
+            load->type              == tzf_tex_load_s::Immediate             ||
+            stream_budget.reserved  == 0LL                                   ||
+          ( stream_budget.held.empty () &&
+            stream_budget.reserved + (LONG64)footprint <= budget );
+
+    if (admit)
+      TZF_ChargeStreamJob (load, footprint);
+
+    else
+    {
+      // Keeps the texture alive until the job is admitted
+      if (load->pDest != nullptr)
+        load->pDest->AddRef ();
+
+      stream_budget.held.push (std::make_pair (load, footprint));
+
+      InterlockedIncrement (&stream_budget.stats.held_jobs);
+
+      if ((LONG)stream_budget.held.size () > stream_budget.stats.held_peak)
+        stream_budget.stats.held_peak = (LONG)stream_budget.held.size ();
+    }
+  }
+  LeaveCriticalSection (&stream_budget.cs);
+
+  return admit;
+}
+
+static size_t
+TZF_GetHeldStreamJobs (void)
+{
+  size_t held = 0;
+
+  EnterCriticalSection (&stream_budget.cs);
+  {
+    held = stream_budget.held.size ();
+  }
+  LeaveCriticalSection (&stream_budget.cs);
+
+  return held;
+}
+
 //
 // Split stream jobs into small and large in order to prevent
 //   starvation from wreaking havoc on load times.
@@ -1559,10 +1908,11 @@ struct SK_StreamSplitter
 
   size_t queueLength (void)
   {
-    size_t len = 0;
+    size_t len = TZF_GetHeldStreamJobs ();
 
-    if (lrg_tex) len += lrg_tex->queueLength ();
-    if (sm_tex)  len += sm_tex->queueLength  ();
+    if (lrg_tex)  len += lrg_tex->queueLength     ();
+    if (sm_tex)   len += sm_tex->queueLength      ();
+    if (io_stage) len += TZF_GetIOStagePending (io_stage);
 
     return len;
   }
@@ -1585,6 +1935,14 @@ struct SK_StreamSplitter
 
   void postJob (tzf_tex_load_s* job)
   {
+    // Over the in-flight budget; comes back once other jobs retire
+    if (! TZF_AdmitStreamJob (job))
+      return;
+
+    // The job comes back here once the I/O stage has its bytes in memory
+    if (TZF_QueueTextureRead (job))
+      return;
+
     // A "Large" load is one >= 128 KiB
     if (job->SrcDataSize > (128 * 1024))
       lrg_tex->postJob (job);
@@ -1596,6 +1954,9 @@ struct SK_StreamSplitter
   SK_TextureThreadPool* sm_tex  = nullptr;
 } stream_pool;
 
+// nullptr when StreamingIOQueueDepth is 0; workers then do their own reads
+tzf_io_stage_s* io_stage = nullptr;
+
 std::queue <TexLoadRef> textures_to_stream;
 
 std::unordered_map   <uint32_t, tzf_tex_load_s *>
@@ -1697,209 +2058,1203 @@ finished_streaming (uint32_t checksum)
 
 HANDLE decomp_semaphore;
 
-// Keep a pool of memory around so that we are not allocating and freeing
-//  memory constantly...
-namespace streaming_memory {
-  std::unordered_map <DWORD, void*>    data;
-  std::unordered_map <DWORD, size_t>   data_len;
-  std::unordered_map <DWORD, uint32_t> data_age;
+//
+// Loose files at least this large are handed to D3DX straight from a
+//   read-only view of the file instead of being read into a pooled buffer,
+//     which would otherwise tie up a size class as large as the file for as
+//       long as the pool keeps it around.  Smaller files are not worth a mapping.
+//
+#define TZF_LOOSE_MAP_MIN (256UL * 1024UL)
+
+static struct {
+  volatile LONG   files   [3] = { };   // [0] = Read into a pooled buffer
+  volatile LONG64 bytes   [3] = { };   // [1] = Mapped
+  volatile LONG64 ticks   [3] = { };   // [2] = Read ahead by the I/O stage
+  volatile LONG64 largest [3] = { };
+} loose_io;
+
+static void
+TZF_CountLooseLoad (int path, size_t size, LONGLONG ticks)
+{
+  InterlockedIncrement (&loose_io.files [path]);
+  InterlockedAdd64     (&loose_io.bytes [path], (LONG64)size);
+  InterlockedAdd64     (&loose_io.ticks [path], ticks);
+
+  LONG64 largest = loose_io.largest [path];
+
+  while ( (LONG64)size > largest &&
+          InterlockedCompareExchange64 (&loose_io.largest [path], (LONG64)size, largest) != largest )
+    largest = loose_io.largest [path];
+}
+
+static void
+TZF_LogLooseFileStats (void)
+{
+  LARGE_INTEGER freq;
+  QueryPerformanceFrequency (&freq);
+
+  const wchar_t* names [] = { L"    Read", L"  Mapped", L"  Staged" };
 
-  bool alloc (size_t len, DWORD dwThreadId = GetCurrentThreadId ())
+  for (int i = 0; i < 3; i++)
   {
-    if (data_len [dwThreadId] < len) {
-      if (data [dwThreadId] != nullptr)
-        free (data [dwThreadId]);
+    LONG files = InterlockedExchangeAdd (&loose_io.files [i], 0);
 
-      if (len < 8192 * 1024)
-        data_len [dwThreadId] = 8192 * 1024;
-      else
-        data_len [dwThreadId] = len;
+    if (files == 0)
+      continue;
 
-      data     [dwThreadId] = malloc      (data_len [dwThreadId]);
-      data_age [dwThreadId] = timeGetTime ();
+    double mib =
+      (double)InterlockedAdd64 (&loose_io.bytes [i], 0) / (1024.0 * 1024.0);
+    double ms  =
+      1000.0 * (double)InterlockedAdd64 (&loose_io.ticks [i], 0) /
+               (double)freq.QuadPart;
 
-      if (data [dwThreadId] != nullptr) {
-        return true;
-      } else {
-        data_len [dwThreadId] = 0;
-        return false;
-      }
-    } else {
-      return true;
-    }
+    tex_log->Log ( L"[Loose I/O ] %s: %6li files,  %9.2f MiB loaded in %10.2f ms"
+                   L"  (%7.2f ms/file)",
+                     names [i], files, mib, ms, ms / (double)files );
   }
 
-  void trim (size_t max_size, uint32_t min_age, DWORD dwThreadId = GetCurrentThreadId ()) {
-    if (data_age [dwThreadId] < min_age) {
-      if (data_len [dwThreadId] > max_size) {
-        free (data [dwThreadId]);
-        data  [dwThreadId] = nullptr;
-
-        if (max_size > 0)
-          data [dwThreadId] = malloc (max_size);
+  if (InterlockedExchangeAdd (&loose_io.files [1], 0) > 0)
+  {
+    LONG64 read_peak = InterlockedAdd64 (&loose_io.largest [0], 0);
+    LONG64 all_peak  = std::max (read_peak, InterlockedAdd64 (&loose_io.largest [1], 0));
 
-        if (data  [dwThreadId] != nullptr) {
-          data_len [dwThreadId] = max_size;
-          data_age [dwThreadId] = timeGetTime ();
-        } else {
-          data_len [dwThreadId] = 0;
-          data_age [dwThreadId] = 0;
-        }
-      }
-    }
+    tex_log->Log ( L"[Loose I/O ] Largest buffer leased for a loose file: %lli KiB"
+                   L" (%lli KiB if every file were read)",
+                     read_peak / 1024LL, all_peak / 1024LL );
   }
 }
 
-HRESULT
-InjectTexture (tzf_tex_load_s* load)
+//
+// Progressive streaming: the first pass over a large injected texture that
+//   D3DX reads straight from a mapping leaves out its top mip levels.  D3DX
+//     then only touches the tail of the file, so only that much is paged in.
+//       0 if the image has too few levels (or is a cubemap) for a preview.
+//
+static UINT
+TZF_GetPreviewSkip (UINT wanted, const D3DXIMAGE_INFO& img_info)
 {
-  D3DXIMAGE_INFO img_info = {    };
-  bool           streamed =  false;
-  size_t         size     =      0;
-  HRESULT        hr       = E_FAIL;
+  if ( wanted                == 0                 ||
+       img_info.ResourceType != D3DRTYPE_TEXTURE  ||
+       img_info.MipLevels    <= wanted )
+    return 0;
 
-  auto inject =
-    injectable_textures.find (load->checksum);
+  return wanted;
+}
 
-  if (inject == injectable_textures.end ())
-  {
-    tex_log->Log ( L"[Inject Tex]  >> Load Request for Checksum: %X "
-                   L"has no Injection Record !!",
-                     load->checksum );
+static DWORD
+TZF_GetPreviewMipFilter (UINT skip)
+{
+  return skip ? D3DX_SKIP_DDS_MIP_LEVELS (skip, D3DX_DEFAULT) : D3DX_DEFAULT;
+}
 
-    return E_NOT_VALID_STATE;
-  }
+// Loose files (when mapped), stored pack entries and anything the L2 cache
+//   holds.  A 7z texture (or a compressed pack entry) has to be decoded whole
+//     before D3DX sees a byte of it, so only its second and later loads (from
+//       the L2 cache) get a preview
+static bool
+TZF_CanPreviewTexture (uint32_t checksum, const tzf_tex_record_s& record)
+{
+  if ( config.textures.max_l2_cache_in_mib > 0 &&
+       TZF_HasTexturePayload (checksum) )
+    return true;
 
-  const tzf_tex_record_s* inj_tex =
-    &(*inject).second;
+  if (record.archive == std::numeric_limits <unsigned int>::max ())
+    return config.textures.map_loose_files;
 
-  streamed =
-    (inj_tex->method == Streaming);
+  tzf_pack_s* pack =
+    TZF_GetPack (record.archive);
 
-  //
-  // Load:  From Regular Filesystem
-  //
-  if ( inj_tex->archive == std::numeric_limits <unsigned int>::max () )
-  {
-    HANDLE hTexFile =
-      CreateFile ( load->wszFilename,
-                     GENERIC_READ,
-                       FILE_SHARE_READ,
-                         nullptr,
-                           OPEN_EXISTING,
-                             FILE_ATTRIBUTE_NORMAL |
-                             FILE_FLAG_SEQUENTIAL_SCAN,
-                               nullptr );
+  if (pack == nullptr)
+    return false;
 
-    DWORD read = 0UL;
+  bool stored =
+    TZF_GetPackEntryBufferSize (pack, (uint32_t)record.fileno) == 0;
 
-    if (hTexFile != INVALID_HANDLE_VALUE)
-    {
-      size = GetFileSize (hTexFile, nullptr);
+  TZF_ReleasePack (pack);
 
-      if (streaming_memory::alloc (size))
-      {
-        load->pSrcData = streaming_memory::data [GetCurrentThreadId ()];
+  return stored;
+}
 
-        ReadFile (hTexFile, load->pSrcData, (DWORD)size, &read, nullptr);
+//
+// Packs often ship one image under several checksums.  A full chain made
+//   from bytes already loaded for another checksum would be the same
+//     texture, so the one already made is handed out again (AddRef) instead.
+//
+//   The table keeps a reference of its own, which TZF_PruneSharedTextures
+//     (...) drops once nothing else holds one.  Previews and reduced chains
+//       are never shared, and only payloads whose size more than one
+//         injectable texture has are hashed at all.
+//
+#define TZF_SHARED_PRUNE_MS 1000UL
 
-        load->SrcDataSize = read;
+struct tzf_shared_tex_s {
+  IDirect3DTexture9* pTex = nullptr;
+  size_t             size = 0;
+};
 
-        if (streamed && size > (32 * 1024))
-        {
-          SetThreadPriority ( GetCurrentThread (),
-                                THREAD_PRIORITY_BELOW_NORMAL |
-                                THREAD_MODE_BACKGROUND_BEGIN );
-        }
+static struct {
+  CRITICAL_SECTION                                 cs;
+  std::unordered_map <uint64_t, tzf_shared_tex_s>  textures;         // CRC-64 of the payload
+  std::unordered_set <size_t>                      sizes;            // Had by 2+ textures
 
-        D3DXGetImageInfoFromFileInMemory (
-          load->pSrcData,
-            load->SrcDataSize,
-              &img_info );
+  LONG                                             hashed       = 0L;
+  LONG64                                           hashed_bytes = 0LL;
+  LONG                                             reused       = 0L;  // Loads that created nothing
+  LONG64                                           reused_bytes = 0LL;
 
-        hr = D3DXCreateTextureFromFileInMemoryEx_Original (
-          load->pDevice,
-            load->pSrcData, load->SrcDataSize,
-              D3DX_DEFAULT, D3DX_DEFAULT, img_info.MipLevels,
-                0, D3DFMT_FROM_FILE,
-                  D3DPOOL_DEFAULT,
-                    D3DX_DEFAULT, D3DX_DEFAULT,
-                      0,
-                        &img_info, nullptr,
-                          &load->pSrc );
+  // As of the last prune
+  LONG                                             copies       = 0L;  // Overrides past the first
+  LONG64                                           saved        = 0LL;
+  LONG64                                           peak_saved   = 0LL;
+} shared_tex;
 
-        load->pSrcData = nullptr;
-      }
+static bool
+TZF_InitSharedTextures (void)
+{
+  InitializeCriticalSectionAndSpinCount (&shared_tex.cs, 1000UL);
+  Crc64GenerateTable                    ();
 
-      else {
-        // OUT OF MEMORY ?!
-      }
+  return true;
+}
 
-      CloseHandle (hTexFile);
-    }
+static bool shared_tex_init = TZF_InitSharedTextures ();
+
+// After the injectable set changes; identical payloads have identical sizes
+static void
+TZF_FindSharedTextureSizes (void)
+{
+  std::unordered_set <size_t> seen;
+  std::unordered_set <size_t> twice;
+
+  for ( auto& it : injectable_textures.items () )
+  {
+    if (! seen.insert (it.second.size).second)
+      twice.insert (it.second.size);
   }
 
-  //
-  // Load:  From (Compressed) Archive (.7z or .zip)
-  //
-  else
+  EnterCriticalSection (&shared_tex.cs);
   {
-    wchar_t       arc_name [MAX_PATH] = { };
-    CFileInStream arc_stream;
-    CLookToRead   look_stream;
-    ISzAlloc      thread_alloc;
-    ISzAlloc      thread_tmp_alloc;
+    shared_tex.sizes.swap (twice);
+  }
+  LeaveCriticalSection (&shared_tex.cs);
+}
 
-    FileInStream_CreateVTable (&arc_stream);
-    LookToRead_CreateVTable   (&look_stream, False);
+// Worker side, before creating a full chain from load->pSrcData.  On a miss,
+//   hash is what to pass to TZF_OfferSharedTexture (...); 0 if not hashed.
+static bool
+TZF_TakeSharedTexture (tzf_tex_load_s* load, uint64_t* hash)
+{
+  *hash = 0ULL;
 
-    look_stream.realStream = &arc_stream.s;
-    LookToRead_Init         (&look_stream);
+  if ((! config.textures.share_identical) || load->SrcDataSize == 0)
+    return false;
 
-    thread_alloc.Alloc     = SzAlloc;
-    thread_alloc.Free      = SzFree;
+  bool candidate = false;
 
-    thread_tmp_alloc.Alloc = SzAllocTemp;
-    thread_tmp_alloc.Free  = SzFreeTemp;
+  EnterCriticalSection (&shared_tex.cs);
+  {
+    candidate = (shared_tex.sizes.count (load->SrcDataSize) != 0);
+  }
+  LeaveCriticalSection (&shared_tex.cs);
 
-    CSzArEx      arc;
-                 size   = inj_tex->size;
-    int          fileno = inj_tex->fileno;
+  if (! candidate)
+    return false;
 
-    if (inj_tex->archive <= archives.size ())
-      wcscpy (arc_name, archives [inj_tex->archive].c_str ());
-    else
-      wcscpy (arc_name, L"INVALID");
+  *hash = Crc64Calc (load->pSrcData, load->SrcDataSize);
 
-    if (streamed && size > (32 * 1024))
-    {
-      SetThreadPriority ( GetCurrentThread (),
-                            THREAD_PRIORITY_LOWEST |
-                            THREAD_MODE_BACKGROUND_BEGIN );
-    }
+  bool found = false;
 
-    if (InFile_OpenW (&arc_stream.file, arc_name))
-    {
-      tex_log->Log ( L"[Inject Tex]  ** Cannot open archive file: %s",
-                       arc_name );
-      return E_FAIL;
-    }
+  EnterCriticalSection (&shared_tex.cs);
+  {
+    shared_tex.hashed++;
+    shared_tex.hashed_bytes += load->SrcDataSize;
 
-    SzArEx_Init (&arc);
+    auto shared =
+      shared_tex.textures.find (*hash);
 
-    if (SzArEx_Open (&arc, &look_stream.s, &thread_alloc, &thread_tmp_alloc) != SZ_OK)
+    if ( shared              != shared_tex.textures.end () &&
+         shared->second.size == load->SrcDataSize )
     {
-      tex_log->Log ( L"[Inject Tex]  ** Cannot open archive file: %s",
-                       arc_name );
-      return E_FAIL;
+      shared->second.pTex->AddRef ();
+
+      load->pSrc = shared->second.pTex;
+      found      = true;
+
+      shared_tex.reused++;
+      shared_tex.reused_bytes += load->SrcDataSize;
     }
+  }
+  LeaveCriticalSection (&shared_tex.cs);
 
-    if (streaming_memory::alloc (size))
-    {
-      load->pSrcData = streaming_memory::data [GetCurrentThreadId ()];
-      bool wait      = true;
+  return found;
+}
 
-      while (wait)
+// Worker side, once a full chain was created; if another worker got there
+//   first, load->pSrc is swapped for that one
+static void
+TZF_OfferSharedTexture (tzf_tex_load_s* load, uint64_t hash)
+{
+  if (hash == 0ULL || load->pSrc == nullptr)
+    return;
+
+  EnterCriticalSection (&shared_tex.cs);
+  {
+    auto shared =
+      shared_tex.textures.find (hash);
+
+    if (shared == shared_tex.textures.end ())
+    {
+      tzf_shared_tex_s& add =
+        shared_tex.textures [hash];
+
+      add.pTex = load->pSrc;
+      add.size = load->SrcDataSize;
+
+      add.pTex->AddRef ();
+    }
+
+    else if (shared->second.size == load->SrcDataSize)
+    {
+      load->pSrc->Release ();
+      load->pSrc = shared->second.pTex;
+      load->pSrc->AddRef  ();
+
+      shared_tex.reused++;
+      shared_tex.reused_bytes += load->SrcDataSize;
+    }
+  }
+  LeaveCriticalSection (&shared_tex.cs);
+}
+
+//
+// Render thread.  Drops the table's reference to anything it alone holds
+//   (or to everything, before the device is reset) and works out how much
+//     sharing saves right now.  Only the table hands out new references, so
+//       a texture found unused here cannot be picked up again meanwhile.
+//
+static void
+TZF_PruneSharedTextures (bool drop_all)
+{
+  static DWORD last_prune = 0UL;
+
+  DWORD dwTime = timeGetTime ();
+
+  if ((! drop_all) && dwTime - last_prune < TZF_SHARED_PRUNE_MS)
+    return;
+
+  last_prune = dwTime;
+
+  LONG   copies  = 0L;
+  LONG64 saved   = 0LL;
+  bool   changed = false;
+
+  EnterCriticalSection (&shared_tex.cs);
+  {
+    for ( auto it  = shared_tex.textures.begin ();
+               it != shared_tex.textures.end   (); )
+    {
+      IDirect3DTexture9* pTex = it->second.pTex;
+
+      // Not counting the table's and this one
+      ULONG others = pTex->AddRef () - 2;
+                     pTex->Release ();
+
+      if (drop_all || others == 0)
+      {
+        pTex->Release ();
+
+        it = shared_tex.textures.erase (it);
+        continue;
+      }
+
+      copies += (LONG)  (others - 1);
+      saved  += (LONG64)(others - 1) * (LONG64)it->second.size;
+
+      ++it;
+    }
+
+    changed = ( shared_tex.copies != copies ||
+                shared_tex.saved  != saved );
+
+    shared_tex.copies     = copies;
+    shared_tex.saved      = saved;
+    shared_tex.peak_saved = std::max (shared_tex.peak_saved, saved);
+  }
+  LeaveCriticalSection (&shared_tex.cs);
+
+  if (changed && (! drop_all))
+    tzf::RenderFix::tex_mgr.updateOSD ();
+}
+
+static int64_t
+TZF_GetSharedTextureSavings (void)
+{
+  return shared_tex.saved;
+}
+
+static void
+TZF_LogSharedTextureStats (void)
+{
+  if (shared_tex.hashed == 0)
+    return;
+
+  tex_log->Log ( L"[Shared Tex] %6li payloads hashed (%8.2f MiB), %6li loads"
+                 L" reused an identical texture (%8.2f MiB not created)",
+                   shared_tex.hashed,
+                     (double)shared_tex.hashed_bytes / (1024.0 * 1024.0),
+                   shared_tex.reused,
+                     (double)shared_tex.reused_bytes / (1024.0 * 1024.0) );
+
+  tex_log->Log ( L"[Shared Tex] At most %8.2f MiB of VRAM saved at once",
+                   (double)shared_tex.peak_saved / (1024.0 * 1024.0) );
+}
+
+// An I/O error on a mapped page surfaces as an exception while D3DX reads it;
+//   loose files and pack entries both come through here, mapped or not
+static HRESULT
+TZF_CreateLooseTexture (tzf_tex_load_s* load, D3DXIMAGE_INFO* img_info, UINT preview = 0)
+{
+  HRESULT  hr   = E_FAIL;
+  uint64_t hash = 0ULL;
+
+  __try
+  {
+    TZF_GetImageInfo (
+      load->pSrcData,
+        load->SrcDataSize,
+          img_info );
+
+    UINT skip =
+      (load->skip_mips = TZF_GetPreviewSkip (preview, *img_info));
+
+    // Hashing reads all of a mapping, so it belongs in here too
+    if (skip == 0 && TZF_TakeSharedTexture (load, &hash))
+      hr = S_OK;
+
+    else
+    {
+      hr = D3DXCreateTextureFromFileInMemoryEx_Original (
+        load->pDevice,
+          load->pSrcData, load->SrcDataSize,
+            skip ? std::max (1U, img_info->Width  >> skip) : D3DX_DEFAULT,
+            skip ? std::max (1U, img_info->Height >> skip) : D3DX_DEFAULT,
+              img_info->MipLevels - skip,
+                0, D3DFMT_FROM_FILE,
+                  D3DPOOL_DEFAULT,
+                    D3DX_DEFAULT, TZF_GetPreviewMipFilter (skip),
+                      0,
+                        skip ? nullptr : img_info, nullptr,
+                          &load->pSrc );
+
+      if (SUCCEEDED (hr))
+        TZF_OfferSharedTexture (load, hash);
+    }
+  }
+
+  __except ( GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ?
+               EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    hr = E_FAIL;
+  }
+
+  return hr;
+}
+
+//
+// The rest of a solid block is still in memory right after one texture was
+//   decoded from it.  With SpeculativePrefetch on, the neighbors the game may
+//     ask for next are copied into the speculative cache, as long as the copy
+//       of the texture we would load is this one and it is not already loading.
+//
+static void
+TZF_StageNeighbor ( uint32_t       checksum,
+                    unsigned int   archive,
+                    uint32_t       fileno,
+                    const uint8_t* data,
+                    size_t         size )
+{
+  tzf_tex_record_s inject;
+
+  if ( (! injectable_textures.find (checksum, &inject)) ||
+       inject.archive != archive                        ||
+       inject.fileno  != (int)fileno )
+    return;
+
+  if (is_streaming (checksum))
+    return;
+
+  TZF_StageSpeculativeTexture (checksum, data, size);
+}
+
+// The checksum an archive file is named after
+static bool
+TZF_GetArchiveFileChecksum (const CSzArEx* arc, uint32_t fileno, uint32_t* checksum)
+{
+  wchar_t wszEntry [MAX_PATH];
+
+  // Length includes the terminator
+  if (SzArEx_GetFileNameUtf16 (arc, fileno, nullptr) > MAX_PATH)
+    return false;
+
+  SzArEx_GetFileNameUtf16 (arc, fileno, (UInt16 *)wszEntry);
+
+  const wchar_t* wszName =
+    wcsrchr (wszEntry, L'/');
+
+  return swscanf (wszName != nullptr ? wszName + 1 : wszEntry, L"%x", checksum) == 1;
+}
+
+static void
+TZF_StageArchiveNeighbors ( unsigned int   archive,
+                            const CSzArEx* arc,
+                            uint32_t       fileno,
+                            const uint8_t* block )
+{
+  std::vector <tzf_block_file_s> files;
+
+  TZF_GetArchiveBlockNeighbors (arc, fileno, files);
+
+  for ( auto& file : files )
+  {
+    uint32_t checksum;
+
+    if (TZF_GetArchiveFileChecksum (arc, file.fileno, &checksum))
+      TZF_StageNeighbor (checksum, archive, file.fileno, block + file.offset, file.size);
+  }
+}
+
+//
+// Textures.WarmArchives:  What the warm-up decodes goes to the L2 cache
+//   (or, with that off, the speculative cache), so that the first load of
+//     a warmed texture decodes nothing.  Each of those first loads is
+//       checked: served from memory, or decoded again because the cache
+//         dropped the texture before the game asked for it.
+//
+static struct {
+  CRITICAL_SECTION              cs;
+  std::unordered_set <uint32_t> pending;      // Warmed, not loaded since
+
+  volatile LONG                 warmed      = 0L;
+  LONG                          served      = 0L;
+  LONG                          redecoded   = 0L;
+} warm_cache;
+
+static bool
+TZF_InitWarmCache (void)
+{
+  InitializeCriticalSectionAndSpinCount (&warm_cache.cs, 1000UL);
+  return true;
+}
+
+static bool warm_cache_init = TZF_InitWarmCache ();
+
+// Worker thread; tzf_decoded_file_pfn for the warm-up's decode jobs
+static void
+TZF_KeepWarmedTexture ( const tzf_decode_job_s* job,
+                        const CSzArEx*          arc,
+                        uint32_t                fileno,
+                        const Byte*             data,
+                        size_t                  size )
+{
+  uint32_t checksum;
+
+  if (! TZF_GetArchiveFileChecksum (arc, fileno, &checksum))
+    return;
+
+  tzf_tex_record_s                            inject;
+  std::shared_ptr <const tzf_archive_names_t> names;
+
+  // Only the copy that would be loaded, and not if the archive list was
+  //   rebuilt since the job was planned
+  if ( (! TZF_FindInjectableTexture (checksum, &inject, &names))        ||
+       inject.archive != job->archive                                   ||
+       inject.fileno  != (int)fileno                                    ||
+       job->archive_name != TZF_GetArchiveName (*names, job->archive) )
+    return;
+
+  if (config.textures.max_l2_cache_in_mib > 0)
+  {
+    TZF_StoreTexturePayload (checksum, data, size);
+
+    if (! TZF_HasTexturePayload (checksum))
+      return;
+  }
+
+  else if (! ( config.textures.speculative_prefetch &&
+               TZF_StageSpeculativeTexture (checksum, data, size) ))
+    return;
+
+  EnterCriticalSection (&warm_cache.cs);
+  {
+    if (warm_cache.pending.insert (checksum).second)
+      InterlockedIncrement (&warm_cache.warmed);
+  }
+  LeaveCriticalSection (&warm_cache.cs);
+}
+
+// The first load of a warmed texture; decoded is whether it had to be
+static void
+TZF_CheckWarmedTexture (uint32_t checksum, bool decoded)
+{
+  if (InterlockedExchangeAdd (&warm_cache.warmed, 0) == 0)
+    return;
+
+  bool warmed = false;
+
+  EnterCriticalSection (&warm_cache.cs);
+  {
+    if (warm_cache.pending.erase (checksum) != 0)
+    {
+      warmed = true;
+
+      if (decoded)
+        ++warm_cache.redecoded;
+      else
+        ++warm_cache.served;
+    }
+  }
+  LeaveCriticalSection (&warm_cache.cs);
+
+  if (warmed && decoded)
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Texture %08x was warmed, but is decoded again"
+                   L" (dropped from the cache before it was loaded)",
+                     checksum );
+  }
+}
+
+// Warmed bytes are only valid for the data sources they were read from
+static void
+TZF_ClearWarmedTextures (void)
+{
+  EnterCriticalSection (&warm_cache.cs);
+  {
+    warm_cache.pending.clear ();
+  }
+  LeaveCriticalSection (&warm_cache.cs);
+}
+
+static void
+TZF_LogWarmCacheStats (void)
+{
+  if (InterlockedExchangeAdd (&warm_cache.warmed, 0) == 0)
+    return;
+
+  EnterCriticalSection (&warm_cache.cs);
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Warm-up: %6li textures cached, first loads:"
+                   L" %li from memory, %li decoded again, %lu yet to come",
+                     warm_cache.warmed, warm_cache.served, warm_cache.redecoded,
+                       (ULONG)warm_cache.pending.size () );
+  }
+  LeaveCriticalSection (&warm_cache.cs);
+}
+
+static void
+TZF_StagePackNeighbors ( unsigned int   archive,
+                         tzf_pack_s*    pack,
+                         uint32_t       idx,
+                         const uint8_t* block )
+{
+  std::vector <uint32_t> neighbors;
+
+  TZF_GetPackBlockNeighbors (pack, idx, neighbors);
+
+  for ( auto neighbor : neighbors )
+  {
+    const tzf_pack_entry_s* entry =
+      TZF_GetPackEntry (pack, neighbor);
+
+    TZF_StageNeighbor (entry->checksum, archive, neighbor, block + entry->offset, entry->size);
+  }
+}
+
+//
+// Device reset:  The injected textures that were resident are recreated on
+//   the worker pool from payloads kept in RAM (the L2 cache) as soon as the
+//     device is back, and handed straight to the game's textures as it
+//       creates them again instead of streaming from disk.
+//
+//   Only the checksums are staged; each Restore job decompresses its own
+//     payload, so a reset costs no more memory than the workers decoding
+//       at once.  A payload the L2 cache drops in between streams normally.
+//
+static struct {
+  CRITICAL_SECTION                                          cs;
+
+  std::unordered_set <uint32_t>                             staged;
+  std::unordered_map <uint32_t, IDirect3DTexture9*>         ready;
+
+  LARGE_INTEGER                                             start = { 0LL };
+  LONG                                                      outstanding = 0L;
+  LONG                                                      total       = 0L;
+  LONG64                                                    bytes       = 0LL;
+} reset_restore;
+
+static bool
+TZF_InitResetRestore (void)
+{
+  InitializeCriticalSectionAndSpinCount (&reset_restore.cs, 1000UL);
+  return true;
+}
+
+static bool reset_restore_init = TZF_InitResetRestore ();
+
+// Caller holds reset_restore.cs; one of the textures staged at reset is done
+static void
+TZF_FinishRestore (void)
+{
+  if (reset_restore.outstanding == 0 || --reset_restore.outstanding > 0)
+    return;
+
+  LARGE_INTEGER now, freq;
+  QueryPerformanceCounter_Original (&now);
+  QueryPerformanceFrequency        (&freq);
+
+  tex_log->Log ( L"[ Tex. Mgr ] Device reset: %li injected textures (%6.2f MiB)"
+                 L" back at full quality after %8.2f ms",
+                   reset_restore.total,
+                     (double)reset_restore.bytes / (1024.0 * 1024.0),
+                       1000.0 * (double)(now.QuadPart - reset_restore.start.QuadPart) /
+                                (double)freq.QuadPart );
+}
+
+// Before the device is reset: keep what is resident, forget the last reset
+static void
+TZF_StageResetPayloads (const std::vector <uint32_t>& resident)
+{
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    if (! reset_restore.ready.empty ())
+    {
+      tex_log->Log ( L"[ Tex. Mgr ] %lu textures restored after the last reset were"
+                     L" never requested again",
+                       (unsigned long)reset_restore.ready.size () );
+    }
+
+    // D3DPOOL_DEFAULT; these must not survive the reset
+    for ( auto it : reset_restore.ready )
+      it.second->Release ();
+
+    reset_restore.ready.clear  ();
+    reset_restore.staged.clear ();
+
+    QueryPerformanceCounter_Original (&reset_restore.start);
+
+    reset_restore.outstanding = 0L;
+    reset_restore.bytes       = 0LL;
+
+    for ( auto checksum : resident )
+    {
+      if (TZF_HasTexturePayload (checksum))
+        reset_restore.staged.insert (checksum);
+    }
+
+    reset_restore.total = (LONG)reset_restore.staged.size ();
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+
+  if (resident.empty ())
+    return;
+
+  tex_log->Log ( L"[ Tex. Mgr ]   %lu of %lu resident injected textures"
+                 L" will be restored from the L2 cache",
+                   (unsigned long)reset_restore.total,
+                     (unsigned long)resident.size () );
+}
+
+// After a successful reset: recreate everything staged on the worker pool
+void
+TZF_RestoreInjectedTextures (IDirect3DDevice9* pDevice)
+{
+  std::vector <tzf_tex_load_s *> jobs;
+
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    reset_restore.outstanding = (LONG)reset_restore.staged.size ();
+
+    for ( auto checksum : reset_restore.staged )
+    {
+      tzf_tex_load_s*  load = new tzf_tex_load_s;
+      tzf_tex_record_s record;
+
+      injectable_textures.find (checksum, &record);
+
+      load->pDevice     = pDevice;
+      load->checksum    = checksum;
+      load->type        = tzf_tex_load_s::Restore;
+      load->SrcDataSize = (UINT)record.size;
+
+      jobs.push_back (load);
+    }
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+
+  for ( auto load : jobs )
+    stream_pool.postJob (load);
+}
+
+// Worker side; the payload is decompressed here, one job at a time
+static void
+TZF_RunRestoreJob (tzf_tex_load_s* load)
+{
+  bool staged;
+
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    staged = (reset_restore.staged.erase (load->checksum) != 0);
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+
+  if (! staged)
+    return;
+
+  std::vector <uint8_t> payload;
+
+  // Evicted since the reset; the game's request will stream it instead
+  if (! TZF_FetchTexturePayload (load->checksum, payload))
+  {
+    EnterCriticalSection (&reset_restore.cs);
+    {
+      TZF_FinishRestore ();
+    }
+    LeaveCriticalSection (&reset_restore.cs);
+
+    return;
+  }
+
+  D3DXIMAGE_INFO img_info = { };
+
+  load->pSrcData    = payload.data ();
+  load->SrcDataSize = (UINT)payload.size ();
+
+  HRESULT hr =
+    TZF_CreateLooseTexture (load, &img_info);
+
+  load->pSrcData    = nullptr;
+
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    reset_restore.bytes += payload.size ();
+
+    if (SUCCEEDED (hr))
+      reset_restore.ready [load->checksum] = load->pSrc;
+    else
+      TZF_FinishRestore ();
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+}
+
+// Render thread; nullptr unless the texture was recreated from RAM already
+static IDirect3DTexture9*
+TZF_ClaimRestoredTexture (uint32_t checksum)
+{
+  IDirect3DTexture9* pTex = nullptr;
+
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    auto ready =
+      reset_restore.ready.find (checksum);
+
+    if (ready != reset_restore.ready.end ())
+    {
+      pTex = ready->second;
+      reset_restore.ready.erase (ready);
+
+      TZF_FinishRestore ();
+    }
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+
+  return pTex;
+}
+
+// A stream job got to the texture before its restore job did; claim the
+//   restore and decompress the payload here instead
+static bool
+TZF_TakeResetPayload (uint32_t checksum, std::vector <uint8_t>& data)
+{
+  bool claimed = false;
+
+  EnterCriticalSection (&reset_restore.cs);
+  {
+    if (reset_restore.staged.erase (checksum) != 0)
+    {
+      TZF_FinishRestore ();
+
+      claimed = true;
+    }
+  }
+  LeaveCriticalSection (&reset_restore.cs);
+
+  return claimed && TZF_FetchTexturePayload (checksum, data);
+}
+
+// Called while load->pSrcData still holds the DDS file just created from
+static void
+TZF_KeepTexturePayload (tzf_tex_load_s* load, HRESULT hr)
+{
+  if (SUCCEEDED (hr) && config.textures.max_l2_cache_in_mib > 0)
+  {
+    TZF_StoreTexturePayload ( load->checksum,
+                                (const uint8_t *)load->pSrcData,
+                                  load->SrcDataSize );
+  }
+}
+
+HRESULT
+InjectTexture (tzf_tex_load_s* load)
+{
+  D3DXIMAGE_INFO img_info = {    };
+  bool           streamed =  false;
+  size_t         size     =      0;
+  HRESULT        hr       = E_FAIL;
+  tzf_pack_s*    pack     = nullptr;
+
+  // Read ahead by the I/O stage; if that failed, read it here as usual
+  std::unique_ptr <tzf_io_request_s> io (load->io);
+                                         load->io = nullptr;
+
+  if (io != nullptr && (! io->ok))
+    io.reset ();
+
+  // Only the L2 cache and the branches D3DX reads from a mapping make a
+  //   preview; everything else loads in full.  The full chain that follows
+  //     a preview from the L2 cache decompresses its payload a second time
+  const UINT preview = load->skip_mips;
+             load->skip_mips = 0;
+
+  // A demotion drops the same levels from whatever it is built from
+  const UINT reduced =
+    load->type == tzf_tex_load_s::Residency ? preview : 0;
+
+  tzf_tex_record_s                            inject;
+  std::shared_ptr <const tzf_archive_names_t> names;
+
+  if (! TZF_FindInjectableTexture (load->checksum, &inject, &names))
+  {
+    tex_log->Log ( L"[Inject Tex]  >> Load Request for Checksum: %X "
+                   L"has no Injection Record !!",
+                     load->checksum );
+
+    return E_NOT_VALID_STATE;
+  }
+
+  const tzf_tex_record_s* inj_tex =
+    &inject;
+
+  streamed =
+    (inj_tex->method == Streaming);
+
+  std::vector <uint8_t> staged;
+
+  //
+  // Load:  Kept in RAM across a device reset
+  //
+  if (TZF_TakeResetPayload (load->checksum, staged))
+  {
+    size              = staged.size ();
+    load->pSrcData    = staged.data ();
+    load->SrcDataSize = (UINT)size;
+
+    hr = TZF_CreateLooseTexture (load, &img_info, reduced);
+
+    load->pSrcData    = nullptr;
+  }
+
+  //
+  // Load:  Staged by an earlier decode of the same block
+  //
+  else if (TZF_TakeSpeculativeTexture (load->checksum, staged))
+  {
+    TZF_CheckWarmedTexture (load->checksum, false);
+
+    size              = staged.size ();
+    load->pSrcData    = staged.data ();
+    load->SrcDataSize = (UINT)size;
+
+    hr = TZF_CreateLooseTexture (load, &img_info, reduced);
+
+    TZF_KeepTexturePayload (load, hr);
+
+    load->pSrcData    = nullptr;
+  }
+
+  //
+  // Load:  From the L2 cache, purged earlier
+  //
+  else if ( config.textures.max_l2_cache_in_mib > 0 &&
+            TZF_FetchTexturePayload (load->checksum, staged) )
+  {
+    TZF_CheckWarmedTexture (load->checksum, false);
+
+    size              = staged.size ();
+    load->pSrcData    = staged.data ();
+    load->SrcDataSize = (UINT)size;
+
+    hr = TZF_CreateLooseTexture (load, &img_info, preview);
+
+    load->pSrcData    = nullptr;
+  }
+
+  //
+  // Load:  From Regular Filesystem, already in memory
+  //
+  else if ( inj_tex->archive == std::numeric_limits <unsigned int>::max () &&
+            io != nullptr )
+  {
+    LARGE_INTEGER start;
+    QueryPerformanceCounter_Original (&start);
+
+    size              = io->data.size ();
+    load->pSrcData    = io->data.data ();
+    load->SrcDataSize = (UINT)size;
+
+    hr = TZF_CreateLooseTexture (load, &img_info, reduced);
+
+    TZF_KeepTexturePayload (load, hr);
+
+    load->pSrcData    = nullptr;
+
+    LARGE_INTEGER end;
+    QueryPerformanceCounter_Original (&end);
+
+    TZF_CountLooseLoad (2, size, end.QuadPart - start.QuadPart);
+  }
+
+  //
+  // Load:  From Regular Filesystem
+  //
+  else if ( inj_tex->archive == std::numeric_limits <unsigned int>::max () )
+  {
+    HANDLE hTexFile =
+      CreateFile ( load->wszFilename,
+                     GENERIC_READ,
+                       FILE_SHARE_READ,
+                         nullptr,
+                           OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL |
+                             FILE_FLAG_SEQUENTIAL_SCAN,
+                               nullptr );
+
+    DWORD read = 0UL;
+
+    if (hTexFile != INVALID_HANDLE_VALUE)
+    {
+      LARGE_INTEGER start;
+      QueryPerformanceCounter_Original (&start);
+
+      size = GetFileSize (hTexFile, nullptr);
+
+      HANDLE        hMap   = nullptr;
+      void*         view   = nullptr;
+      tzf_buffer_s* pooled = nullptr;
+
+      // pSrcData is not initialized for Stream / Immediate loads
+      load->pSrcData = nullptr;
+
+      if (config.textures.map_loose_files && size >= TZF_LOOSE_MAP_MIN)
+      {
+        hMap =
+          CreateFileMappingW (hTexFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (hMap != nullptr)
+          view = MapViewOfFile (hMap, FILE_MAP_READ, 0, 0, 0);
+      }
+
+      if (view != nullptr)
+      {
+        load->pSrcData    = view;
+        load->SrcDataSize = (UINT)size;
+      }
+
+      else if ((pooled = TZF_LeaseBuffer (size)) != nullptr)
+      {
+        load->pSrcData = pooled->data;
+
+        ReadFile (hTexFile, load->pSrcData, (DWORD)size, &read, nullptr);
+
+        load->SrcDataSize = read;
+      }
+
+      else {
+        // OUT OF MEMORY ?!
+      }
+
+      if (load->pSrcData != nullptr)
+      {
+        if (streamed && size > (32 * 1024))
+        {
+          SetThreadPriority ( GetCurrentThread (),
+                                THREAD_PRIORITY_BELOW_NORMAL |
+                                THREAD_MODE_BACKGROUND_BEGIN );
+        }
+
+        hr = TZF_CreateLooseTexture (load, &img_info, view != nullptr ? preview : reduced);
+
+        if (FAILED (hr) && view != nullptr)
+        {
+          tex_log->Log ( L"[Inject Tex]  ** Could not read mapped texture file: %s",
+                           load->wszFilename );
+        }
+
+        // Copying out of the mapping could fault the same way D3DX can; the
+        //   file cache serves these well enough anyway
+        if (view == nullptr)
+          TZF_KeepTexturePayload (load, hr);
+
+        load->pSrcData = nullptr;
+
+        LARGE_INTEGER end;
+        QueryPerformanceCounter_Original (&end);
+
+        TZF_CountLooseLoad (view != nullptr ? 1 : 0, size, end.QuadPart - start.QuadPart);
+      }
+
+      if (view != nullptr)
+        UnmapViewOfFile (view);
+
+      TZF_ReturnBuffer (pooled);
+
+      if (hMap != nullptr)
+        CloseHandle (hMap);
+
+      CloseHandle (hTexFile);
+    }
+  }
+
+  //
+  // Load:  From TZF Texture Pack (.tzp)
+  //
+  else if ( (pack = TZF_GetPack (inj_tex->archive)) != nullptr )
+  {
+    tzf_decoder_ctx_s* decoder  = TZF_GetDecoderContext ();
+    uint32_t           idx      = (uint32_t)inj_tex->fileno;
+
+    // 0 means the entry is stored and will be read straight from the mapping
+    size_t             buf_size = TZF_GetPackEntryBufferSize (pack, idx);
+    bool               throttle = false;
+
+                       size     = inj_tex->size;
+
+    if (streamed && size > (32 * 1024))
+    {
+      SetThreadPriority ( GetCurrentThread (),
+                            THREAD_PRIORITY_LOWEST |
+                            THREAD_MODE_BACKGROUND_BEGIN );
+
+      throttle = (buf_size != 0);
+    }
+
+    tzf_buffer_s* pooled = nullptr;
+
+    if (buf_size == 0 || (pooled = TZF_LeaseBuffer (buf_size)) != nullptr)
+    {
+      uint8_t*        buf  = nullptr;
+      tzf_pack_view_s view;
+
+      if (buf_size != 0)
+        buf = pooled->data;
+
+      if (throttle)
+        WaitForSingleObject (decomp_semaphore, INFINITE);
+
+      SRes res = (io != nullptr) ?
+        TZF_ReadPackEntryFrom (pack, idx, io->data.data (), buf, buf_size, &view, &decoder->alloc.vt) :
+        TZF_ReadPackEntry     (pack, idx,                   buf, buf_size, &view, &decoder->alloc.vt);
+
+      if (throttle)
+        ReleaseSemaphore (decomp_semaphore, 1, nullptr);
+
+      if (res == SZ_OK)
+      {
+        load->pSrcData    = (LPVOID)view.data;
+        load->SrcDataSize = (UINT)  view.size;
+
+        // Stored entries are read straight from the pack's mapping, and a
+        //   truncated pack or a lost drive faults in the middle of that
+        hr =
+          TZF_CreateLooseTexture (load, &img_info, buf_size == 0 ? preview : reduced);
+
+        if (FAILED (hr) && buf_size == 0)
+        {
+          tex_log->Log ( L"[Inject Tex]  ** Could not read stored entry for "
+                         L"crc32=%x in pack: %s",
+                           load->checksum,
+                             TZF_GetArchiveName (*names, inj_tex->archive) );
+        }
+
+        // Same as mapped loose files: the copy could fault, and the file
+        //   cache keeps stored entries close at hand anyway
+        if (buf_size != 0)
+          TZF_KeepTexturePayload (load, hr);
+
+        load->pSrcData = nullptr;
+
+        if (config.textures.speculative_prefetch && view.block != nullptr)
+          TZF_StagePackNeighbors (inj_tex->archive, pack, idx, view.block);
+      }
+
+      else
+      {
+        tex_log->Log ( L"[Inject Tex]  ** Pack read failed (SRes=%i) "
+                       L"for crc32=%x in pack: %s",
+                         res, load->checksum,
+                           TZF_GetArchiveName (*names, inj_tex->archive) );
+      }
+
+      TZF_ReleasePackView (&view);
+      TZF_ReturnBuffer    (pooled);
+    }
+
+    TZF_ReleasePack (pack);
+  }
+
+  //
+  // Load:  From (Compressed) Archive (.7z or .zip)
+  //
+  else
+  {
+    wchar_t            arc_name [MAX_PATH] = { };
+    tzf_decoder_ctx_s* decoder = TZF_GetDecoderContext ();
+
+    TZF_CheckWarmedTexture (load->checksum, true);
+
+                 size   = inj_tex->size;
+    int          fileno = inj_tex->fileno;
+
+    wcscpy (arc_name, TZF_GetArchiveName (*names, inj_tex->archive));
+
+    if (streamed && size > (32 * 1024))
+    {
+      SetThreadPriority ( GetCurrentThread (),
+                            THREAD_PRIORITY_LOWEST |
+                            THREAD_MODE_BACKGROUND_BEGIN );
+    }
+
+    const CSzArEx* arc =
+      TZF_OpenCachedArchive (decoder, inj_tex->archive, arc_name);
+
+    if (arc == nullptr)
+    {
+      tex_log->Log ( L"[Inject Tex]  ** Cannot open archive file: %s",
+                       arc_name );
+      return E_FAIL;
+    }
+
+    // SzArEx_Extract (...) decodes the entire solid block the file lives in,
+    //   not just the file itself; the buffer has to hold all of it.
+    size_t block_size =
+      std::max (size, TZF_GetArchiveBlockSize (arc, fileno));
+
+    tzf_buffer_s* pooled = TZF_LeaseBuffer (block_size);
+
+    if (pooled != nullptr)
+    {
+      load->pSrcData = pooled->data;
+      bool wait      = true;
+
+      while (wait)
       {
         DWORD dwResult = WAIT_OBJECT_0;
 
@@ -1913,40 +3268,92 @@ InjectTexture (tzf_tex_load_s* load)
         {
         case WAIT_OBJECT_0:
         {
-          uint32_t block_idx     = 0xFFFFFFFF;
-          Byte*    out           = (Byte *)streaming_memory::data     [GetCurrentThreadId ()];
-          size_t   out_len       =         streaming_memory::data_len [GetCurrentThreadId ()];
+          Byte*    out           = (Byte *)pooled->data;
+          size_t   out_len       =         pooled->capacity;
           size_t   offset        = 0;
           size_t   decomp_size   = 0;
 
-          SzArEx_Extract ( &arc,          &look_stream.s, fileno,
-                           &block_idx,    &out,           &out_len,
-                           &offset,       &decomp_size,
-                           &thread_alloc, &thread_tmp_alloc );
+          SRes res = SZ_ERROR_FAIL;
+
+          // Read ahead by the I/O stage; a block that turns out not to be
+          //   this one (the archive list was rebuilt since) fails to decode,
+          //     and the archive is read as usual
+          if (io != nullptr)
+          {
+            tzf_archive_stream_s ahead;
+
+            TZF_OpenReadAheadStream ( io->data.data (), io->offset,
+                                        io->data.size (), &ahead );
+
+            res =
+              TZF_ExtractArchiveFile ( &ahead,             arc,  fileno,
+                                       out,                out_len,
+                                       &offset,            &decomp_size,
+                                       &decoder->alloc.vt, &decoder->alloc.vt );
+
+            io.reset ();
+          }
+
+          if (res != SZ_OK)
+          {
+            res =
+              TZF_ExtractArchiveFile ( &decoder->stream,   arc,  fileno,
+                                       out,                out_len,
+                                       &offset,            &decomp_size,
+                                       &decoder->alloc.vt, &decoder->alloc.vt );
+          }
 
           if (streamed && size > (32 * 1024))
             ReleaseSemaphore (decomp_semaphore, 1, nullptr);
 
           wait = false;
 
-          load->pSrcData    = (Byte *)streaming_memory::data [GetCurrentThreadId ()] + offset;
+          if (res != SZ_OK)
+          {
+            tex_log->Log ( L"[Inject Tex]  ** Decompression failed (SRes=%i) "
+                           L"for crc32=%x in archive: %s",
+                             res, load->checksum, arc_name );
+            break;
+          }
+
+          load->pSrcData    = (Byte *)pooled->data + offset;
           load->SrcDataSize = (UINT)decomp_size;
 
-          D3DXGetImageInfoFromFileInMemory (
+          TZF_GetImageInfo (
             load->pSrcData,
               load->SrcDataSize,
                 &img_info );
 
-          hr = D3DXCreateTextureFromFileInMemoryEx_Original (
-            load->pDevice,
-              load->pSrcData, load->SrcDataSize,
-                img_info.Width, img_info.Height, img_info.MipLevels,
-                  0, img_info.Format,
-                    D3DPOOL_DEFAULT,
-                      D3DX_DEFAULT, D3DX_DEFAULT,
-                        0,
-                          &img_info, nullptr,
-                            &load->pSrc );
+          UINT skip =
+            (load->skip_mips = TZF_GetPreviewSkip (reduced, img_info));
+
+          uint64_t hash = 0ULL;
+
+          if (skip == 0 && TZF_TakeSharedTexture (load, &hash))
+            hr = S_OK;
+
+          else
+          {
+            hr = D3DXCreateTextureFromFileInMemoryEx_Original (
+              load->pDevice,
+                load->pSrcData, load->SrcDataSize,
+                  std::max (1U, img_info.Width  >> skip),
+                  std::max (1U, img_info.Height >> skip), img_info.MipLevels - skip,
+                    0, img_info.Format,
+                      D3DPOOL_DEFAULT,
+                        D3DX_DEFAULT, TZF_GetPreviewMipFilter (skip),
+                          0,
+                            skip ? nullptr : &img_info, nullptr,
+                              &load->pSrc );
+
+            if (SUCCEEDED (hr))
+              TZF_OfferSharedTexture (load, hash);
+          }
+
+          TZF_KeepTexturePayload (load, hr);
+
+          if (config.textures.speculative_prefetch)
+            TZF_StageArchiveNeighbors (inj_tex->archive, arc, fileno, pooled->data);
         } break;
 
         default:
@@ -1959,10 +3366,9 @@ InjectTexture (tzf_tex_load_s* load)
       }
 
       load->pSrcData = nullptr;
-    }
 
-    File_Close  (&arc_stream.file);
-    SzArEx_Free (&arc, &thread_alloc);
+      TZF_ReturnBuffer (pooled);
+    }
   }
 
   if (streamed && size > (32 * 1024))
@@ -1971,9 +3377,213 @@ InjectTexture (tzf_tex_load_s* load)
                           THREAD_MODE_BACKGROUND_END );
   }
 
+  if (SUCCEEDED (hr))
+    load->info = img_info;
+
   return hr;
 }
 
+extern bool shutting_down;
+
+static void
+TZF_TextureReadDone (tzf_io_request_s* req)
+{
+  tzf_tex_load_s*    load  = (tzf_tex_load_s *)req->user;
+  IDirect3DTexture9* pDest = load->pDest;
+
+  if (shutting_down)
+  {
+    delete req;
+    delete load;
+  }
+
+  // A failed read still goes to a worker; it reads the file itself
+  else
+    stream_pool.postJob (load);
+
+  // postJob (...) took its own reference
+  if (pDest != nullptr)
+    pDest->Release ();
+}
+
+// Called once load's last pass no longer holds any of its buffers; a no-op
+//   for a job that was never charged or has already been retired
+static void
+TZF_RetireStreamJob (tzf_tex_load_s* load)
+{
+  if (load->in_flight == 0)
+    return;
+
+  const LONG64 budget =
+    (LONG64)config.textures.max_in_flight_in_mib * 1024LL * 1024LL;
+
+  std::vector <tzf_tex_load_s *> admitted;
+
+  EnterCriticalSection (&stream_budget.cs);
+  {
+    stream_budget.reserved -= load->in_flight;
+    load->in_flight         = 0;
+
+    while ((! shutting_down) && (! stream_budget.held.empty ()))
+    {
+      tzf_tex_load_s* next      = stream_budget.held.front ().first;
+      size_t          footprint = stream_budget.held.front ().second;
+
+      if ( budget                 > 0LL &&
+           stream_budget.reserved > 0LL &&
+           stream_budget.reserved + (LONG64)footprint > budget )
+        break;
+
+      stream_budget.held.pop ();
+
+      TZF_ChargeStreamJob (next, footprint);
+      admitted.push_back  (next);
+    }
+  }
+  LeaveCriticalSection (&stream_budget.cs);
+
+  for (auto next : admitted)
+  {
+    IDirect3DTexture9* pDest = next->pDest;
+
+    stream_pool.postJob (next);
+
+    // postJob (...) took its own reference
+    if (pDest != nullptr)
+      pDest->Release ();
+  }
+}
+
+// Jobs still held back at shutdown never reach a worker
+static void
+TZF_DropHeldStreamJobs (void)
+{
+  EnterCriticalSection (&stream_budget.cs);
+  {
+    while (! stream_budget.held.empty ())
+    {
+      tzf_tex_load_s* load = stream_budget.held.front ().first;
+                             stream_budget.held.pop   ();
+
+      if (load->pDest != nullptr)
+        load->pDest->Release ();
+
+      delete load;
+    }
+  }
+  LeaveCriticalSection (&stream_budget.cs);
+}
+
+static void
+TZF_LogStreamBudgetStats (void)
+{
+  PROCESS_MEMORY_COUNTERS pmc = { };
+  pmc.cb = sizeof (pmc);
+
+  if (GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof (pmc)))
+  {
+    tex_log->Log ( L"[ Mem. Mgr ] Peak private bytes: %8.2f MiB",
+                     (double)pmc.PeakPagefileUsage / (1024.0 * 1024.0) );
+  }
+
+  tex_log->Log ( L"[ Mem. Mgr ] In-flight decode memory peaked at %8.2f MiB"
+                 L" (budget: %li MiB); %li jobs held back, %li at once at most",
+                   (double)stream_budget.stats.reserved_peak / (1024.0 * 1024.0),
+                     config.textures.max_in_flight_in_mib,
+                       InterlockedExchangeAdd (&stream_budget.stats.held_jobs, 0),
+                         stream_budget.stats.held_peak );
+}
+
+static bool
+TZF_QueueTextureRead (tzf_tex_load_s* load)
+{
+  if ( io_stage   == nullptr                 ||
+       load->type != tzf_tex_load_s::Stream  ||
+       load->io   != nullptr )
+    return false;
+
+  // A preview reads only the tail of the file, through a mapping
+  if (load->skip_mips != 0)
+    return false;
+
+  // Already in memory; there is nothing to read
+  if ( TZF_IsSpeculativeTextureStaged (load->checksum) ||
+       TZF_HasTexturePayload          (load->checksum) )
+    return false;
+
+  tzf_tex_record_s                            record;
+  std::shared_ptr <const tzf_archive_names_t> names;
+
+  if (! TZF_FindInjectableTexture (load->checksum, &record, &names))
+    return false;
+
+  tzf_pack_s*       pack   = nullptr;
+  tzf_io_request_s* req    = new tzf_io_request_s;
+  uint64_t          length = 0ULL;
+
+  if (record.archive == std::numeric_limits <unsigned int>::max ())
+    req->path = load->wszFilename;
+
+  else if ((pack = TZF_GetPack (record.archive)) != nullptr)
+  {
+    req->path = TZF_GetPackName (pack);
+
+    TZF_GetPackEntryRange (pack, (uint32_t)record.fileno, &req->offset, &req->length);
+    TZF_ReleasePack       (pack);
+  }
+
+  // 7z: the whole packed block; the worker decodes it out of memory
+  else if ( record.archive < names->size () &&
+            TZF_GetArchiveReadAhead (record, &req->offset, &length) )
+  {
+    req->path   = (*names) [record.archive];
+    req->length = (size_t)length;
+  }
+
+  else
+  {
+    delete req;
+    return false;
+  }
+
+  req->done = TZF_TextureReadDone;
+  req->user = load;
+  load->io  = req;
+
+  // Keeps the texture alive until the job reaches a worker pool
+  if (load->pDest != nullptr)
+    load->pDest->AddRef ();
+
+  TZF_SubmitRead (io_stage, req);
+
+  return true;
+}
+
+static void
+TZF_LogIOStageStats (void)
+{
+  if (io_stage == nullptr)
+    return;
+
+  tzf_io_stats_s stats =
+    TZF_GetIOStageStats (io_stage);
+
+  if (stats.requests == 0)
+    return;
+
+  tex_log->Log ( L"[ Tex. I/O ] %hs, depth %li: %7llu reads, %9.2f MiB,"
+                 L" %7.2f ms average latency, %lu in flight at most, %llu failed",
+                   TZF_GetIOBackendName (config.textures.overlapped_io ?
+                                           TZF_IO_BACKEND_OVERLAPPED   :
+                                           TZF_IO_BACKEND_THREADS),
+                     config.textures.io_queue_depth,
+                       stats.requests,
+                         (double)stats.bytes / (1024.0 * 1024.0),
+                           stats.read_ms / (double)stats.requests,
+                             stats.max_in_flight,
+                               stats.failures );
+}
+
 CRITICAL_SECTION osd_cs           = { };
 DWORD           last_queue_update =   0;
 
@@ -1996,6 +3606,7 @@ TZFix_UpdateQueueOSD (void)
 
       static std::string resampling_text; static DWORD dwLastResample = 0;
       static std::string streaming_text;  static DWORD dwLastStream   = 0;
+      static std::string dumping_text;    static DWORD dwLastDump     = 0;
       
       if (is_resampling)
       {
@@ -2038,24 +3649,412 @@ TZFix_UpdateQueueOSD (void)
           streaming_text += szFormatted;
         }
 
-        if (count)
-          dwLastStream = dwTime;
-      }
+        if (count)
+          dwLastStream = dwTime;
+      }
+
+      tzf_dump_queue_stats_s dumps =
+        TZF_GetDumpQueueStats ();
+
+      if (dumps.backlog != 0)
+      {
+            char szFormatted [64];
+        sprintf (szFormatted, "  Dumping:    %zu texture", dumps.backlog);
+
+        dumping_text  = szFormatted;
+        dumping_text += (dumps.backlog != 1) ? 's' : ' ';
+
+        sprintf (szFormatted, " [%7.2f MiB]", (double)dumps.backlog_bytes / (1024.0f * 1024.0f));
+        dumping_text += szFormatted;
+
+        dwLastDump = dwTime;
+      }
+
+      if (dwLastResample < dwTime - 150)
+        resampling_text = "";
+
+      if (dwLastStream < dwTime - 150)
+        streaming_text = "";
+
+      if (dwLastDump < dwTime - 150)
+        dumping_text = "";
+
+      // The streaming line has no newline of its own
+      if (streaming_text != "" && dumping_text != "")
+        mod_text = resampling_text + streaming_text + "\n" + dumping_text;
+      else
+        mod_text = resampling_text + streaming_text + dumping_text;
+
+      if (mod_text != "")
+        last_queue_update = dwTime;
+      
+      //LeaveCriticalSection (&osd_cs);
+    }
+  }
+}
+
+//
+// Progressive streaming, as the player sees it: time from the game asking
+//   for a texture to the first upgrade (the preview) and to full quality.
+//     Only the render thread touches these.
+//
+static struct {
+  LONG   previewed    = 0L;
+  double preview_ms   = 0.0;
+  double full_ms      = 0.0;
+
+  LONG   direct       = 0L;  // Streamed in one pass
+  double direct_ms    = 0.0;
+
+  LONG   compressed   = 0L;  // Large enough for a preview, but compressed
+} progressive;
+
+static double
+TZF_GetMsSinceRequest (const tzf_tex_load_s* load)
+{
+  LARGE_INTEGER now, freq;
+
+  QueryPerformanceCounter_Original (&now);
+  QueryPerformanceFrequency        (&freq);
+
+  return 1000.0 * (double)(now.QuadPart - load->requested.QuadPart) /
+                  (double)freq.QuadPart;
+}
+
+// Swaps a finished preview in and posts the same job for the full chain
+static void
+TZF_SwapInPreview (tzf_tex_load_s* load)
+{
+  ISKTextureD3D9* pSKTex =
+    (ISKTextureD3D9 *)load->pDest;
+
+  QueryPerformanceCounter_Original (&pSKTex->last_used);
+
+  if (pSKTex->pTexOverride != nullptr)
+  {
+    pSKTex->pTexOverride->Release ();
+    tzf::RenderFix::tex_mgr.removeInjected (pSKTex->override_size);
+  }
+
+  pSKTex->pTexOverride  = load->pSrc;
+  pSKTex->override_size = load->SrcDataSize;
+
+  tzf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
+  tzf::RenderFix::tex_mgr.updateOSD   ();
+
+  progressive.preview_ms += TZF_GetMsSinceRequest (load);
+
+  load->previewed = true;
+  load->skip_mips = 0;
+  load->pSrc      = nullptr;
+
+  // Behind every preview already queued; it takes its own reference again.
+  //   Still charged from the preview pass, so it is neither counted twice
+  //     nor let past TZFIX.Textures/MaxInFlightStreamingInMiB for free
+  stream_pool.postJob (load);
+}
+
+// Called once the full chain of a streamed texture is on screen
+static void
+TZF_CountStreamedTexture (const tzf_tex_load_s* load)
+{
+  if (load->type != tzf_tex_load_s::Stream || load->requested.QuadPart == 0LL)
+    return;
+
+  double ms =
+    TZF_GetMsSinceRequest (load);
+
+  if (load->previewed)
+  {
+    progressive.previewed += 1;
+    progressive.full_ms   += ms;
+
+    tex_log->Log ( L"[Inject Tex] Texture %08x at full quality after %7.2f ms"
+                   L" (low resolution pass on screen before that)",
+                     load->checksum, ms );
+  }
+
+  else
+  {
+    progressive.direct    += 1;
+    progressive.direct_ms += ms;
+  }
+}
+
+static void
+TZF_LogProgressiveStats (void)
+{
+  if (progressive.previewed > 0)
+  {
+    tex_log->Log ( L"[Progressive] %6li textures streamed in two passes: first upgrade"
+                   L" after %8.2f ms, full quality after %8.2f ms (average)",
+                     progressive.previewed,
+                       progressive.preview_ms / (double)progressive.previewed,
+                         progressive.full_ms    / (double)progressive.previewed );
+  }
+
+  if (progressive.direct > 0)
+  {
+    tex_log->Log ( L"[Progressive] %6li textures streamed in one pass: full quality"
+                   L" after %8.2f ms (average)",
+                     progressive.direct,
+                       progressive.direct_ms / (double)progressive.direct );
+  }
+
+  if (progressive.compressed > 0)
+  {
+    tex_log->Log ( L"[Progressive] %6li large textures had no low resolution pass:"
+                   L" 7z archives and compressed .tzp entries are previewed only"
+                   L" from the L2 cache, after a first full decode",
+                     progressive.compressed );
+  }
+}
+
+//
+// Residency: before purge (...) evicts an injected texture outright, idle
+//   ones are demoted to the same chain without their top mip levels.  A
+//     demoted texture that is bound often enough gets its full chain back.
+//
+// D3DPOOL_DEFAULT textures cannot be read back, so both directions are
+//   loads like any other, from the L2 cache or a mapping of the source.
+//
+#define TZF_DEMOTE_IDLE_MS     2000
+#define TZF_PROMOTE_PERIOD_MS   500
+
+static struct {
+  LONG     demoted        = 0L;
+  int64_t  demoted_bytes  = 0LL; // Reclaimed
+  LONG     promoted       = 0L;
+  int64_t  promoted_bytes = 0LL; // Given back
+  LONG     evicted        = 0L;
+  int64_t  evicted_bytes  = 0LL; // Injected textures purged outright
+  LONG     failed         = 0L;
+} residency;
+
+// Demoting these left nothing out (too few levels, or a cubemap)
+static std::unordered_set <uint32_t> undemotable;
+
+// Only the render thread reads or changes residency
+static void
+TZF_PostResidencyJob (ISKTextureD3D9* pSKTex, UINT skip_mips)
+{
+  tzf_tex_record_s record;
+
+  injectable_textures.find (pSKTex->tex_crc32, &record);
+
+  if (record.method == DontCare)
+    record.method = Streaming;
+
+  tzf_tex_load_s* load = new tzf_tex_load_s;
+
+  load->pDevice     = tzf::RenderFix::pDevice;
+  load->checksum    = pSKTex->tex_crc32;
+  load->type        = tzf_tex_load_s::Residency;
+  load->skip_mips   = skip_mips;
+  load->SrcDataSize = (UINT)record.size;
+  load->pDest       = pSKTex;
+
+  // If -1, load from disk...
+  if (record.archive == std::numeric_limits <unsigned int>::max ())
+  {
+    if (record.method == Streaming)
+      _swprintf ( load->wszFilename, L"%s\\inject\\textures\\streaming\\%08x%s",
+                    TZFIX_TEXTURE_DIR,
+                      load->checksum,
+                        TZFIX_TEXTURE_EXT );
+    else if (record.method == Blocking)
+      _swprintf ( load->wszFilename, L"%s\\inject\\textures\\blocking\\%08x%s",
+                    TZFIX_TEXTURE_DIR,
+                      load->checksum,
+                        TZFIX_TEXTURE_EXT );
+  }
+
+  pSKTex->resizing = true;
+
+  // The temporary reference; TZF_FinishResidencyChange (...) removes it
+  pSKTex->AddRef ();
+
+  stream_pool.postJob (load);
+}
+
+// Roughly what the chain costs without its top skip levels: the file size
+//   scaled by the share of texels left
+static size_t
+TZF_GetReducedSize (size_t full, const D3DXIMAGE_INFO& info, UINT skip)
+{
+  if (skip == 0 || info.MipLevels <= skip)
+    return full;
+
+  double all  = 0.0,
+         kept = 0.0;
+
+  for (UINT i = 0; i < info.MipLevels; i++)
+  {
+    double texels = (double)std::max (1U, info.Width  >> i) *
+                    (double)std::max (1U, info.Height >> i);
+
+    all += texels;
+
+    if (i >= skip)
+      kept += texels;
+  }
+
+  return (size_t)((double)full * (kept / all));
+}
+
+static void
+TZF_FinishResidencyChange (tzf_tex_load_s* load)
+{
+  ISKTextureD3D9* pSKTex =
+    (ISKTextureD3D9 *)load->pDest;
+
+  // Promotions are only ever posted for demoted textures
+  const bool demote = (pSKTex->demoted_mips == 0);
+
+  pSKTex->resizing = false;
+
+  // Asked to drop levels, but the image had none to spare
+  if (demote && load->pSrc != nullptr && load->skip_mips == 0)
+  {
+    undemotable.insert (load->checksum);
+
+    load->pSrc->Release ();
+    load->pSrc = nullptr;
+  }
+
+  if (load->pSrc == nullptr)
+    ++residency.failed;
+
+  // Only our reference is left, the override went away (reloaded, or the
+  //   texture was released) or a new load for it is in flight
+  else if ( pSKTex->refs         <= 1       ||
+            pSKTex->pTexOverride == nullptr ||
+            is_streaming (load->checksum) )
+  {
+    ++residency.failed;
+
+    load->pSrc->Release ();
+  }
+
+  else
+  {
+    const int64_t before = pSKTex->override_size;
+    const int64_t after  =
+      TZF_GetReducedSize (load->SrcDataSize, load->info, load->skip_mips);
+
+    pSKTex->pTexOverride->Release ();
+    tzf::RenderFix::tex_mgr.removeInjected (pSKTex->override_size);
+
+    pSKTex->pTexOverride  = load->pSrc;
+    pSKTex->override_size = (size_t)after;
+    pSKTex->demoted_mips  = load->skip_mips;
+    pSKTex->binds         = 0;
+
+    tzf::RenderFix::tex_mgr.addInjected (pSKTex->override_size);
+
+    if (load->skip_mips != 0)
+    {
+      ++residency.demoted;
+      residency.demoted_bytes  += before - after;
+    }
+
+    else
+    {
+      ++residency.promoted;
+      residency.promoted_bytes += after - before;
+    }
+
+    tzf::RenderFix::tex_mgr.updateOSD ();
+  }
+
+  // Remove the temporary reference
+  load->pDest->Release ();
+}
+
+static void
+TZF_LogResidencyStats (void)
+{
+  if (residency.demoted == 0 && residency.evicted == 0)
+    return;
+
+  tex_log->Log ( L"[Residency ] %6li demotions reclaimed %8.2f MiB, %6li"
+                 L" evictions reclaimed %8.2f MiB",
+                   residency.demoted,
+                     (double)residency.demoted_bytes / (1024.0 * 1024.0),
+                   residency.evicted,
+                     (double)residency.evicted_bytes / (1024.0 * 1024.0) );
+
+  tex_log->Log ( L"[Residency ] %6li promotions took back %8.2f MiB; %li"
+                 L" changes failed or were dropped",
+                   residency.promoted,
+                     (double)residency.promoted_bytes / (1024.0 * 1024.0),
+                       residency.failed );
+}
+
+// LRU first, until the expected savings cover wanted; returns those savings
+static int64_t
+TZF_DemoteIdleTextures ( std::vector <tzf::RenderFix::Texture *>& injected,
+                         int64_t                                   wanted )
+{
+  const UINT    skip     =
+    (UINT)std::min (std::max (config.textures.demote_mip_levels, 0), 15);
+  const int64_t min_size =
+    (int64_t)std::max (0, config.textures.demote_min_in_kib) * 1024LL;
+
+  if (skip == 0)
+    return 0;
 
-      if (dwLastResample < dwTime - 150)
-        resampling_text = "";
+  LARGE_INTEGER now, freq;
 
-      if (dwLastStream < dwTime - 150)
-        streaming_text = "";
+  QueryPerformanceCounter_Original (&now);
+  QueryPerformanceFrequency        (&freq);
 
-      mod_text = resampling_text + streaming_text;
+  const LONGLONG idle =
+    freq.QuadPart * TZF_DEMOTE_IDLE_MS / 1000LL;
 
-      if (mod_text != "")
-        last_queue_update = dwTime;
-      
-      //LeaveCriticalSection (&osd_cs);
+  std::sort ( injected.begin (),
+                injected.end (),
+      []( tzf::RenderFix::Texture *a,
+          tzf::RenderFix::Texture *b )
+    {
+      return a->d3d9_tex->last_used.QuadPart <
+             b->d3d9_tex->last_used.QuadPart;
     }
+  );
+
+  int64_t demoting = 0;
+
+  for ( auto tex : injected )
+  {
+    if (demoting >= wanted)
+      break;
+
+    ISKTextureD3D9* pSKTex = tex->d3d9_tex;
+
+    if ( pSKTex->demoted_mips  != 0                           ||
+         pSKTex->resizing                                     ||
+         pSKTex->must_block                                   ||
+         (int64_t)pSKTex->override_size < min_size            ||
+         now.QuadPart - pSKTex->last_used.QuadPart < idle     ||
+         undemotable.count (tex->crc32)                       ||
+         is_streaming      (tex->crc32) )
+      continue;
+
+    tzf_tex_record_s record;
+
+    // Rebuilding it from a compressed archive would cost a full decode
+    if ( (! TZF_GetInjectableTexture (tex->crc32, &record)) ||
+         (! TZF_CanPreviewTexture (tex->crc32, record)) )
+      continue;
+
+    // Every level is a quarter of the one above it
+    demoting += (int64_t)pSKTex->override_size -
+                ((int64_t)pSKTex->override_size >> (2 * skip));
+
+    TZF_PostResidencyJob (pSKTex, skip);
   }
+
+  return demoting;
 }
 
 void
@@ -2143,6 +4142,16 @@ TZFix_LoadQueuedTextures (void)
     tzf_tex_load_s* load =
       *it;
 
+    if (load->type == tzf_tex_load_s::Residency)
+    {
+      TZF_FinishResidencyChange (load);
+
+      ++it;
+
+      delete load;
+      continue;
+    }
+
     QueryPerformanceCounter_Original (&load->end);
 
     if (false)
@@ -2172,6 +4181,21 @@ TZFix_LoadQueuedTextures (void)
     ISKTextureD3D9* pSKTex =
       (ISKTextureD3D9 *)load->pDest;
 
+    // Still in flight; the full chain is loaded behind the preview
+    if ( load->skip_mips != 0 && pSKTex != nullptr &&
+         pSKTex->refs    != 0 && (! shutting_down) )
+    {
+      TZF_SwapInPreview (load);
+
+      ++loads;
+      ++it;
+
+      continue;
+    }
+
+    // A preview that gets no full chain still holds its charge
+    TZF_RetireStreamJob (load);
+
     if (pSKTex != nullptr)
     {
       if (pSKTex->refs == 0 && load->pSrc != nullptr)
@@ -2184,10 +4208,20 @@ TZFix_LoadQueuedTextures (void)
       {
         QueryPerformanceCounter_Original (&pSKTex->last_used);
 
+        // Replaces the preview
+        if (load->previewed && pSKTex->pTexOverride != nullptr)
+        {
+          pSKTex->pTexOverride->Release ();
+          tzf::RenderFix::tex_mgr.removeInjected (pSKTex->override_size);
+        }
+
         pSKTex->pTexOverride  = load->pSrc;
         pSKTex->override_size = load->SrcDataSize;
+        pSKTex->demoted_mips  = 0;
 
         tzf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
+
+        TZF_CountStreamedTexture (load);
       }
 
       finished_streaming (load->checksum);
@@ -2230,7 +4264,10 @@ TZFix_LoadQueuedTextures (void)
     }
   }
 
-  tzf::RenderFix::tex_mgr.osdStats ();
+  tzf::RenderFix::tex_mgr.updateResidency ();
+  tzf::RenderFix::tex_mgr.osdStats        ();
+
+  TZF_PruneSharedTextures (false);
 }
 
 #include <set>
@@ -2364,7 +4401,7 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
 
   // Necessary to make D3DX texture write functions work
   if ( Pool == D3DPOOL_DEFAULT && ( config.textures.dump &&
-        (! dumped_textures.count     (checksum))         &&
+        (! TZF_IsTextureDumped       (checksum))         &&
         (! injectable_textures.count (checksum)) ) || (
                                     config.textures.on_demand_dump ) )
     Usage = D3DUSAGE_DYNAMIC;
@@ -2372,7 +4409,7 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
 
 
   D3DXIMAGE_INFO info = { 0 };
-  D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, &info);
+  TZF_GetImageInfo (pSrcData, SrcDataSize, &info);
 
   D3DFORMAT fmt_real = info.Format;
 
@@ -2414,17 +4451,36 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
 
   bool remap_stream = is_streaming (checksum);
 
+  // A copy; the table may be republished while this runs
+  tzf_tex_record_s inject_rec;
+  bool             injectable =
+    injectable_textures.find (checksum, &inject_rec);
+
+  IDirect3DTexture9* pRestored =
+    inject_thread ? nullptr : TZF_ClaimRestoredTexture (checksum);
+
+  //
+  // Injectable textures recreated from RAM after a device reset
+  //
+  if (pRestored != nullptr)
+  {
+    tex_log->Log ( L"[Inject Tex] Injectable texture for checksum (%08x)... restored",
+                     checksum );
+
+    TZF_TraceTextureAccess (checksum);
+  }
+
   //
   // Generic injectable textures
   //
-  if ( (! inject_thread) &&
-            injectable_textures.find (checksum) !=
-                     injectable_textures.end () )
+  else if ( (! inject_thread) && injectable )
   {
     tex_log->LogEx ( true, L"[Inject Tex] Injectable texture for checksum (%08x)... ",
                        checksum );
 
-    tzf_tex_record_s record = injectable_textures [checksum];
+    tzf_tex_record_s record = inject_rec;
+
+    TZF_TraceTextureAccess (checksum);
 
     if (record.method == DontCare)
       record.method = Streaming;
@@ -2455,6 +4511,25 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
 
     wcscpy (load_op->wszFilename, wszInjectFileName);
 
+    QueryPerformanceCounter_Original (&load_op->requested);
+
+    // Large textures get a low resolution pass first
+    if ( load_op->type == tzf_tex_load_s::Stream && (! remap_stream)      &&
+         config.textures.progressive_streaming                            &&
+         config.textures.progressive_skip_mips > 0                        &&
+         record.size >= (size_t)std::max (0, config.textures.progressive_min_in_kib) * 1024 )
+    {
+      if (TZF_CanPreviewTexture (checksum, record))
+      {
+        load_op->skip_mips =
+          (UINT)std::min (config.textures.progressive_skip_mips, 15);
+      }
+
+      // Compressed and not in the L2 cache (yet); this load is in one pass
+      else
+        ++progressive.compressed;
+    }
+
     if (load_op->type == tzf_tex_load_s::Stream)
     {
       if ((! remap_stream))
@@ -2469,9 +4544,9 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
     }
   }
 
-  bool will_replace = (load_op != nullptr || resample);
-
   //tex_log->Log (L"D3DXCreateTextureFromFileInMemoryEx (... MipLevels=%lu ...)", MipLevels);
+  bool will_replace = (load_op != nullptr || pRestored != nullptr || resample);
+
   hr =
     D3DXCreateTextureFromFileInMemoryEx_Original ( pDevice,
                                                      pSrcData,         SrcDataSize,
@@ -2519,11 +4594,7 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
         rec.archive = -1;
         rec.method  =  Blocking;
 
-        if (! injectable_textures.count (checksum))
-          injectable_textures.insert (std::make_pair (checksum, rec));
-        else {
-          injectable_textures [checksum] = rec;
-        }
+        injectable_textures.insert_or_assign (checksum, rec);
 
         tex_log->LogEx (true, L"[Inject Tex] Injecting custom gamepad buttons... ");
 
@@ -2546,12 +4617,29 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
       }
     }
 
-    if ( load_op != nullptr && ( load_op->type == tzf_tex_load_s::Stream ||
-                                 load_op->type == tzf_tex_load_s::Immediate ) )
+    if (pRestored != nullptr)
+    {
+      ISKTextureD3D9* pSKTex =
+        (ISKTextureD3D9 *)*ppTexture;
+
+      QueryPerformanceCounter_Original (&pSKTex->last_used);
+
+      pSKTex->pTexOverride  = pRestored;
+      pSKTex->override_size = inject_rec.size;
+
+      tzf::RenderFix::tex_mgr.addInjected (pSKTex->override_size);
+      tzf::RenderFix::tex_mgr.updateOSD   ();
+    }
+
+    else if ( load_op != nullptr && ( load_op->type == tzf_tex_load_s::Stream ||
+                                      load_op->type == tzf_tex_load_s::Immediate ) )
     {
+      // The gamepad path above may just have added the record
+      tzf_tex_record_s rec;
+
       load_op->SrcDataSize =
-        injectable_textures.count (checksum) == 0 ?
-          0 : injectable_textures [checksum].size;
+        injectable_textures.find (checksum, &rec) ?
+          (UINT)rec.size : 0;
 
       load_op->pDest = *ppTexture;
       EnterCriticalSection        (&cs_tex_stream);
@@ -2647,6 +4735,7 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
 
       load_op->pSrcData    = new uint8_t [SrcDataSize];
       load_op->SrcDataSize = SrcDataSize;
+      load_op->info        = info;
 
       swprintf (load_op->wszFilename, L"Resample_%x.dds", checksum);
 
@@ -2664,6 +4753,10 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
     load_op = nullptr;
   }
 
+  else if (pRestored != nullptr) {
+    pRestored->Release ();
+  }
+
   QueryPerformanceCounter_Original (&end);
 
   if (SUCCEEDED (hr))
@@ -2700,21 +4793,162 @@ D3DXCreateTextureFromFileInMemoryEx_Detour (
   }
 
   if ( config.textures.dump && (! inject_thread) && (! injectable_textures.count (checksum)) &&
-                          (! dumped_textures.count (checksum)) ) {
-    D3DXIMAGE_INFO info = { 0 };
-    D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, &info);
-
-    D3DFORMAT fmt_real = info.Format;
-
+                          (! TZF_IsTextureDumped (checksum)) ) {
     TZF_DumpTexture (fmt_real, checksum, *ppTexture);
   }
 
   return hr;
 }
 
+//
+// What earlier sessions dumped, found in the background while the game
+//   starts.  Until ready is set nothing is known and a texture counts as not
+//     dumped; TZF_DumpTexture (...) then leaves any file it finds in place.
+//       dumped_textures holds what this session dumped.
+//
+static struct {
+  CRITICAL_SECTION               cs;
+  std::unordered_set <uint32_t>  checksums;
+  std::unordered_set <uint32_t>  deleted;          // Before the scan finished
+  volatile LONG                  ready  = 0L;
+  HANDLE                         thread = nullptr;
+  std::atomic <bool>             cancel { false };
+} dump_index;
+
+static bool
+TZF_InitDumpIndex (void)
+{
+  InitializeCriticalSectionAndSpinCount (&dump_index.cs, 1000UL);
+
+  return true;
+}
+
+static bool dump_index_init = TZF_InitDumpIndex ();
+
+static unsigned int
+__stdcall
+TZF_ScanDumpedTexturesThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_BEGIN );
+
+  std::unordered_set <uint32_t> found;
+  tzf_dump_scan_stats_s         stats;
+
+  bool complete =
+    TZF_ScanDumpTree ( TZFIX_TEXTURE_DIR L"\\dump\\textures",
+                         TZFIX_TEXTURE_DIR L"\\dump\\textures.idx",
+                           found,
+                             &stats,
+                               &dump_index.cancel );
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_END );
+
+  // Shutting down
+  if (! complete)
+    return 0;
+
+  EnterCriticalSection (&dump_index.cs);
+  {
+    for ( auto checksum : dump_index.deleted )
+      found.erase (checksum);
+
+    dump_index.checksums.swap (found);
+    dump_index.deleted.clear  ();
+
+    InterlockedExchange (&dump_index.ready, 1L);
+  }
+  LeaveCriticalSection (&dump_index.cs);
+
+  tex_log->Log ( L"[ Dump Tex ] %llu dumped textures (%3.1f MiB) in %lu directories,"
+                 L" %lu unchanged since the last run; %7.2f ms in the background",
+                   stats.files,
+                     (double)stats.bytes / (1024.0 * 1024.0),
+                       stats.directories,
+                         stats.reused,
+                           stats.scan_ms );
+
+  if (stats.saved)
+    tex_log->Log ( L"[ Dump Tex ] %llu files listed, manifest rewritten (%5.2f ms)",
+                     stats.listed, stats.save_ms );
+
+  return 0;
+}
+
+static void
+TZF_BeginDumpIndexScan (void)
+{
+  dump_index.thread =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 TZF_ScanDumpedTexturesThread,
+                                   nullptr,
+                                     0x00,
+                                       nullptr );
+
+  // No thread; list it here, the way it always was
+  if (dump_index.thread == 0)
+    TZF_ScanDumpedTexturesThread (nullptr);
+}
+
+static void
+TZF_EndDumpIndexScan (void)
+{
+  if (dump_index.thread != 0)
+  {
+    dump_index.cancel = true;
+
+    WaitForSingleObject (dump_index.thread, INFINITE);
+    CloseHandle         (dump_index.thread);
+
+    dump_index.thread = 0;
+  }
+}
+
+static bool
+TZF_IsInDumpIndex (uint32_t checksum)
+{
+  if (dump_index.ready == 0L)
+    return false;
+
+  bool found = false;
+
+  EnterCriticalSection (&dump_index.cs);
+  {
+    found = (dump_index.checksums.count (checksum) != 0);
+  }
+  LeaveCriticalSection (&dump_index.cs);
+
+  return found;
+}
+
+// Also keeps a scan still in progress from bringing it back
+static void
+TZF_ForgetDumpedTexture (uint32_t checksum)
+{
+  EnterCriticalSection (&dump_index.cs);
+  {
+    dump_index.checksums.erase (checksum);
+
+    if (dump_index.ready == 0L)
+      dump_index.deleted.insert (checksum);
+  }
+  LeaveCriticalSection (&dump_index.cs);
+}
+
 bool
 TZF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum)
 {
+  // It may not have been written yet
+  TZF_WaitForDumps ();
+
+  // Only its manifest record; the payload may belong to other checksums
+  if (config.textures.dump_store)
+    return TZF_RemoveFromDumpStore (checksum);
+
   wchar_t wszPath [MAX_PATH];
   _swprintf ( wszPath, L"%s\\dump",
                 TZFIX_TEXTURE_DIR );
@@ -2746,7 +4980,8 @@ TZF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum)
   {
     if (DeleteFileW (wszFileName))
     {
-      dumped_textures.erase (checksum);
+      dumped_textures.erase   (checksum);
+      TZF_ForgetDumpedTexture (checksum);
       return true;
     }
   }
@@ -2757,39 +4992,21 @@ TZF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum)
 bool
 TZF_IsTextureDumped (uint32_t checksum)
 {
-  return dumped_textures.count (checksum);
+  if (config.textures.dump_store)
+    return TZF_IsInDumpStore (checksum);
+
+  return dumped_textures.count (checksum) ||
+         TZF_IsInDumpIndex     (checksum);
 }
 
 HRESULT
 TZF_DumpTexture (D3DFORMAT fmt, uint32_t checksum, IDirect3DTexture9* pTex)
 {
   if ( (! injectable_textures.count (checksum)) &&
-       (! dumped_textures.count     (checksum)) )
+       (! TZF_IsTextureDumped       (checksum)) )
   {
     D3DFORMAT fmt_real = fmt;
 
-    bool compressed = (fmt_real >= D3DFMT_DXT1 && fmt_real <= D3DFMT_DXT5);
-
-    wchar_t wszPath [MAX_PATH];
-    _swprintf ( wszPath, L"%s\\dump",
-                  TZFIX_TEXTURE_DIR );
-
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
-
-    _swprintf ( wszPath, L"%s\\dump\\textures",
-                  TZFIX_TEXTURE_DIR );
-
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
-
-    _swprintf ( wszPath, L"%s\\%s",
-                  wszPath,
-                   SK_D3D9_FormatToStr (fmt_real, false).c_str () );
-
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
-
     wchar_t wszFileName [MAX_PATH] = { L'\0' };
     _swprintf ( wszFileName, L"%s\\dump\\textures\\%s\\%08x%s",
                   TZFIX_TEXTURE_DIR,
@@ -2797,10 +5014,33 @@ TZF_DumpTexture (D3DFORMAT fmt, uint32_t checksum, IDirect3DTexture9* pTex)
                       checksum,
                         TZFIX_TEXTURE_EXT );
 
-    HRESULT hr = D3DXSaveTextureToFile (wszFileName, D3DXIFF_DDS, pTex, NULL);
+    // The texture can only be read here; writing the file (and creating
+    //   its directory) is left to the dump queue
+    ID3DXBuffer* pSnapshot = nullptr;
+
+    HRESULT hr =
+      D3DXSaveTextureToFileInMemory (&pSnapshot, D3DXIFF_DDS, pTex, NULL);
 
     if (SUCCEEDED (hr))
-      dumped_textures.insert (checksum);
+    {
+      std::vector <uint8_t> data (
+        (uint8_t *)pSnapshot->GetBufferPointer (),
+        (uint8_t *)pSnapshot->GetBufferPointer () + pSnapshot->GetBufferSize ()
+      );
+
+      pSnapshot->Release ();
+
+      if (config.textures.dump_store)
+        TZF_StoreDump (checksum, fmt_real, data);
+
+      else
+      {
+        // Before the scan has finished, this may already be on disk
+        TZF_QueueDump (wszFileName, data, dump_index.ready == 0L);
+
+        dumped_textures.insert (checksum);
+      }
+    }
 
     return hr;
   }
@@ -2955,8 +5195,268 @@ D3D9SetRenderTarget_Detour (
 #endif
   //}
 
-  return D3D9SetRenderTarget_Original (This, RenderTargetIndex, pRenderTarget);
-}
+  return D3D9SetRenderTarget_Original (This, RenderTargetIndex, pRenderTarget);
+}
+
+
+volatile LONG warming_archives = 0L;
+
+//
+// Decodes every archive fanned out across the large-texture worker pool
+//   (folders + LZMA2 dictionary-reset segments) and keeps the textures in
+//     the L2 cache; see warm_cache.  With DecodeBenchmark=true each archive
+//       is then decoded again folder-by-folder on this thread, output thrown
+//         away, and the speedup logged.
+//
+//   The parallel pass runs first, so the serial pass is the one that gets
+//     a warm file cache; the reported speedup is, if anything, pessimistic.
+//
+unsigned int
+__stdcall
+TZF_WarmArchivesThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  tzf_archive_names_t names =
+    *std::atomic_load (&archives);
+
+  LARGE_INTEGER freq;
+  QueryPerformanceFrequency (&freq);
+
+  double total_parallel = 0.0,
+         total_serial   = 0.0;
+
+  for (unsigned int i = 0; i < names.size (); i++)
+  {
+    LARGE_INTEGER start, mid, end;
+
+    tzf_decode_batch_s              parallel;
+    std::vector <tzf_decode_job_s*> jobs;
+
+    parallel.done =
+      CreateEvent (nullptr, TRUE, FALSE, nullptr);
+
+    LONG warmed =
+      InterlockedExchangeAdd (&warm_cache.warmed, 0);
+
+    TZF_PlanArchiveDecode ( i, names [i].c_str (), true,
+                              TZF_KeepWarmedTexture, &parallel, jobs );
+
+    size_t parallel_jobs = jobs.size ();
+    parallel.remaining   = (LONG)parallel_jobs;
+
+    QueryPerformanceCounter_Original (&start);
+
+    if (jobs.empty ())
+      SetEvent (parallel.done);
+
+    for ( auto it : jobs )
+    {
+      tzf_tex_load_s* load = new tzf_tex_load_s;
+
+      load->type           = tzf_tex_load_s::Decode;
+      load->pDevice        = nullptr;
+      load->pSrcData       = nullptr;
+      load->SrcDataSize    = (UINT)it->unpack_size;
+      load->checksum       = 0x00;
+      load->size           = 0;
+      load->wszFilename[0] = L'\0';
+      load->decode         = it;
+
+      stream_pool.postJob (load);
+    }
+
+    WaitForSingleObject (parallel.done, INFINITE);
+    QueryPerformanceCounter_Original (&mid);
+
+    warmed =
+      InterlockedExchangeAdd (&warm_cache.warmed, 0) - warmed;
+
+    double parallel_ms = 1000.0 * (double)(mid.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+    total_parallel += parallel_ms;
+
+    if (! config.textures.decode_benchmark)
+    {
+      tex_log->Log ( L"[ Arc. I/O ] Warm-up '%s': %6.2f MiB in %lu parallel job(s)"
+                     L" %9.2f ms, %li textures cached%s",
+                       names [i].c_str (),
+                         (double)parallel.bytes / (1024.0 * 1024.0),
+                           (ULONG)parallel_jobs,
+                             parallel_ms, warmed,
+                               parallel.failures ? L"  ** errors **" : L"" );
+
+      CloseHandle (parallel.done);
+      continue;
+    }
+
+    tzf_decode_batch_s serial;
+
+    serial.done =
+      CreateEvent (nullptr, TRUE, FALSE, nullptr);
+
+    jobs.clear ();
+
+    TZF_PlanArchiveDecode (i, names [i].c_str (), false, nullptr, &serial, jobs);
+
+    serial.remaining = (LONG)jobs.size ();
+
+    for ( auto it : jobs )
+      TZF_RunDecodeJob (it);
+
+    QueryPerformanceCounter_Original (&end);
+
+    double serial_ms = 1000.0 * (double)(end.QuadPart - mid.QuadPart) / (double)freq.QuadPart;
+
+    total_serial += serial_ms;
+
+    tex_log->Log ( L"[ Arc. I/O ] Warm-up '%s': %6.2f MiB in %lu parallel job(s)"
+                   L" %9.2f ms, serial %9.2f ms  (%4.2fx), %li textures cached%s",
+                     names [i].c_str (),
+                       (double)parallel.bytes / (1024.0 * 1024.0),
+                         (ULONG)parallel_jobs,
+                           parallel_ms, serial_ms,
+                             parallel_ms > 0.0 ? serial_ms / parallel_ms : 0.0,
+                               warmed,
+                                 (parallel.failures + serial.failures) ? L"  ** errors **" : L"" );
+
+    CloseHandle (serial.done);
+    CloseHandle (parallel.done);
+  }
+
+  if (config.textures.decode_benchmark)
+  {
+    tex_log->Log ( L"[ Arc. I/O ] Warm-up finished: %9.2f ms parallel, %9.2f ms serial  (%4.2fx)",
+                     total_parallel, total_serial,
+                       total_parallel > 0.0 ? total_serial / total_parallel : 0.0 );
+  }
+
+  else
+    tex_log->Log ( L"[ Arc. I/O ] Warm-up finished: %9.2f ms", total_parallel );
+
+  TZF_LogWarmCacheStats     ();
+  TZF_ReleaseDecoderContext ();
+
+  InterlockedExchange (&warming_archives, 0L);
+
+  return 0;
+}
+
+class TZF_WarmArchivesCmd : public SK_ICommand {
+public:
+  virtual SK_ICommandResult execute (const char* szArgs) {
+    // Without the benchmark, all it does is fill one of these
+    if ( config.textures.max_l2_cache_in_mib <= 0   &&
+         (! config.textures.speculative_prefetch)   &&
+         (! config.textures.decode_benchmark) )
+      return SK_ICommandResult ("Textures.WarmArchives", szArgs, "No cache to warm (MaxL2CacheInMiB=0)", 0);
+
+    if (InterlockedCompareExchange (&warming_archives, 1L, 0L) != 0L)
+      return SK_ICommandResult ("Textures.WarmArchives", szArgs, "Already running", 0);
+
+    HANDLE hThread =
+      (HANDLE)_beginthreadex ( nullptr,
+                                 0,
+                                   TZF_WarmArchivesThread,
+                                     nullptr,
+                                       0x00,
+                                         nullptr );
+
+    if (hThread == 0)
+    {
+      InterlockedExchange (&warming_archives, 0L);
+      return SK_ICommandResult ("Textures.WarmArchives", szArgs, "Could not start thread", 0);
+    }
+
+    CloseHandle (hThread);
+
+    return SK_ICommandResult ("Textures.WarmArchives", szArgs, "Results go to logs/textures.log", 1);
+  }
+};
+
+class TZF_MarkSceneCmd : public SK_ICommand {
+public:
+  virtual SK_ICommandResult execute (const char* szArgs) {
+    if (! config.textures.record_access_trace)
+      return SK_ICommandResult ("Textures.MarkScene", szArgs, "RecordAccessTrace is off", 0);
+
+    TZF_MarkTraceScene (szArgs);
+
+    return SK_ICommandResult ("Textures.MarkScene", szArgs, "New scene", 1);
+  }
+};
+
+volatile LONG exporting_dumps = 0L;
+
+// Gives the dump store the usual dump\textures\<format>\<checksum>.dds layout
+unsigned int
+__stdcall
+TZF_ExportDumpsThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  std::vector <tzf_dump_record_s> records =
+    TZF_GetDumpStoreRecords ();
+
+  size_t exported = 0,
+         failed   = 0;
+
+  for ( auto& record : records )
+  {
+    std::wstring dir =
+      std::wstring (TZFIX_TEXTURE_DIR L"\\dump\\textures\\") +
+        SK_D3D9_FormatToStr ((D3DFORMAT)record.format, false);
+
+    TZF_CreateDumpDirectory (dir);
+
+    wchar_t wszFileName [MAX_PATH] = { L'\0' };
+    _swprintf ( wszFileName, L"%s\\%08x%s",
+                  dir.c_str (),
+                    record.checksum,
+                      TZFIX_TEXTURE_EXT );
+
+    if (TZF_ExportStoredDump (record, wszFileName))
+      ++exported;
+    else
+      ++failed;
+  }
+
+  tex_log->Log ( L"[Dump Store] Exported %zu textures to %s\\dump\\textures (%zu failed)",
+                   exported, TZFIX_TEXTURE_DIR, failed );
+
+  InterlockedExchange (&exporting_dumps, 0L);
+
+  return 0;
+}
+
+class TZF_ExportDumpsCmd : public SK_ICommand {
+public:
+  virtual SK_ICommandResult execute (const char* szArgs) {
+    if (! config.textures.dump_store)
+      return SK_ICommandResult ("Textures.ExportDumps", szArgs, "DumpToStore is off", 0);
+
+    if (InterlockedCompareExchange (&exporting_dumps, 1L, 0L) != 0L)
+      return SK_ICommandResult ("Textures.ExportDumps", szArgs, "Already running", 0);
+
+    HANDLE hThread =
+      (HANDLE)_beginthreadex ( nullptr,
+                                 0,
+                                   TZF_ExportDumpsThread,
+                                     nullptr,
+                                       0x00,
+                                         nullptr );
+
+    if (hThread == 0)
+    {
+      InterlockedExchange (&exporting_dumps, 0L);
+      return SK_ICommandResult ("Textures.ExportDumps", szArgs, "Could not start thread", 0);
+    }
+
+    CloseHandle (hThread);
+
+    return SK_ICommandResult ("Textures.ExportDumps", szArgs, "Results go to logs/textures.log", 1);
+  }
+};
 
 void
 tzf::RenderFix::TextureManager::Init (void)
@@ -2988,58 +5488,34 @@ tzf::RenderFix::TextureManager::Init (void)
 
   TZF_RefreshDataSources ();
 
-  if ( GetFileAttributesW (TZFIX_TEXTURE_DIR L"\\dump\\textures") !=
-         INVALID_FILE_ATTRIBUTES ) {
-    WIN32_FIND_DATA fd;
-    WIN32_FIND_DATA fd_sub;
-    HANDLE          hSubFind = INVALID_HANDLE_VALUE;
-    HANDLE          hFind    = INVALID_HANDLE_VALUE;
-    int             files    = 0;
-    LARGE_INTEGER   liSize   = { 0 };
-
-    tex_log->LogEx ( true, L"[ Dump Tex ] Enumerating dumped textures..." );
-
-    hFind = FindFirstFileW (TZFIX_TEXTURE_DIR L"\\dump\\textures\\*", &fd);
-
-    if (hFind != INVALID_HANDLE_VALUE) {
-      do {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
-          wchar_t wszSubDir [MAX_PATH];
-          _swprintf (wszSubDir, L"%s\\dump\\textures\\%s\\*", TZFIX_TEXTURE_DIR, fd.cFileName);
-
-          hSubFind = FindFirstFileW (wszSubDir, &fd_sub);
-
-          if (hSubFind != INVALID_HANDLE_VALUE) {
-            do {
-              if (wcsstr (_wcslwr (fd_sub.cFileName), L".dds")) {
-                uint32_t checksum;
-                swscanf (fd_sub.cFileName, L"%08x.dds", &checksum);
-
-                ++files;
-
-                LARGE_INTEGER fsize;
-
-                fsize.HighPart = fd_sub.nFileSizeHigh;
-                fsize.LowPart  = fd_sub.nFileSizeLow;
-
-                liSize.QuadPart += fsize.QuadPart;
-
-                dumped_textures.insert (checksum);
-              }
-            } while (FindNextFileW (hSubFind, &fd_sub) != 0);
-
-            FindClose (hSubFind);
-          }
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+  // The manifest already lists everything dumped; nothing to enumerate
+  if (config.textures.dump_store)
+  {
+    if (TZF_OpenDumpStore ())
+    {
+      tzf_dump_store_stats_s store =
+        TZF_GetDumpStoreStats ();
 
-      FindClose (hFind);
+      tex_log->Log ( L"[Dump Store] %llu dumped textures in the manifest (%7.2f ms)",
+                       store.records, store.open_ms );
     }
+  }
 
-    tex_log->LogEx ( false, L" %lu files (%3.1f MiB)\n",
-                       files, (double)liSize.QuadPart / (1024.0 * 1024.0) );
+  // Listing every file here held up the game for seconds with a large dump;
+  //   it is done in the background now, and mostly from a manifest
+  else if ( GetFileAttributesW (TZFIX_TEXTURE_DIR L"\\dump\\textures") !=
+              INVALID_FILE_ATTRIBUTES ) {
+    TZF_BeginDumpIndexScan ();
   }
 
+  // Nothing has been dumped yet
+  else
+    InterlockedExchange (&dump_index.ready, 1L);
+
+  // Listed in the background, before the first resample job needs it
+  if (config.textures.remaster && config.textures.remaster_cache)
+    TZF_BeginRemasterCacheScan ();
+
   InterlockedExchange64 (&bytes_saved, 0LL);
 
   time_saved  = 0.0f;
@@ -3059,6 +5535,14 @@ tzf::RenderFix::TextureManager::Init (void)
   stream_pool.lrg_tex = new SK_TextureThreadPool ();
   stream_pool.sm_tex  = new SK_TextureThreadPool ();
 
+  if (config.textures.io_queue_depth > 0)
+  {
+    io_stage =
+      TZF_CreateIOStage ( config.textures.overlapped_io ? TZF_IO_BACKEND_OVERLAPPED :
+                                                          TZF_IO_BACKEND_THREADS,
+                            config.textures.io_queue_depth );
+  }
+
   SK_ICommandProcessor& command =
     *SK_GetCommandProcessor ();
 
@@ -3081,6 +5565,16 @@ tzf::RenderFix::TextureManager::Init (void)
   command.AddVariable (
     "Textures.MaxCacheSize",
       TZF_CreateVar (SK_IVariable::Int,     &config.textures.max_cache_in_mib) );
+
+  command.AddCommand ("Textures.WarmArchives", new TZF_WarmArchivesCmd ());
+  command.AddCommand ("Textures.MarkScene",    new TZF_MarkSceneCmd    ());
+  command.AddCommand ("Textures.ExportDumps",  new TZF_ExportDumpsCmd  ());
+
+  if (config.textures.record_access_trace)
+  {
+    CreateDirectoryW     (TZFIX_TEXTURE_DIR, nullptr);
+    TZF_BeginAccessTrace (TZFIX_TEXTURE_DIR L"\\access_trace.txt");
+  }
 }
 
 void
@@ -3172,6 +5666,9 @@ tzf::RenderFix::TextureManager::Hook (void)
 // Skip the purge step on shutdown
 bool shutting_down = false;
 
+// Nothing may be demoted while the device is about to be reset
+static bool resetting = false;
+
 void
 tzf::RenderFix::TextureManager::Shutdown (void)
 {
@@ -3189,6 +5686,33 @@ tzf::RenderFix::TextureManager::Shutdown (void)
 
   shutting_down = true;
 
+  TZF_DropHeldStreamJobs   ();
+  TZF_LogStreamBudgetStats ();
+
+  TZF_EndDumpIndexScan     ();
+  TZF_EndRemasterCacheScan ();
+
+  // Everything dumped this session is written before the log closes
+  TZF_ShutdownDumpQueue    ();
+  TZF_CloseDumpStore       ();
+
+  // Reads still in flight finish first; with shutting_down set,
+  //   TZF_TextureReadDone (...) deletes their jobs instead of posting them
+  if (io_stage != nullptr)
+  {
+    TZF_LogIOStageStats ();
+    TZF_DestroyIOStage  (io_stage);
+
+    io_stage = nullptr;
+  }
+
+  // Each worker releases its own decoder context (and the archive it holds
+  //   open) on the way out; TZF_ReleaseDecoderContext (...) below only
+  //     reaches this thread's
+  if (stream_pool.lrg_tex != nullptr) stream_pool.lrg_tex->stopWorkers ();
+  if (stream_pool.sm_tex  != nullptr) stream_pool.sm_tex->stopWorkers  ();
+  if (resample_pool       != nullptr) resample_pool->stopWorkers       ();
+
   tex_mgr.reset ();
 
   DeleteCriticalSection (&cs_tex_stream);
@@ -3200,6 +5724,26 @@ tzf::RenderFix::TextureManager::Shutdown (void)
 
   CloseHandle (decomp_semaphore);
 
+  TZF_ReleaseDecoderContext    ();
+  TZF_UnmapArchives            ();
+  TZF_ClosePacks               ();
+  TZF_LogArchiveStats          ();
+  TZF_LogLooseFileStats        ();
+  TZF_LogBufferPoolStats       ();
+  TZF_LogSpeculativeCacheStats ();
+  TZF_LogPayloadCacheStats     ();
+  TZF_LogWarmCacheStats        ();
+  TZF_LogRemasterCacheStats    ();
+  TZF_LogProgressiveStats      ();
+  TZF_LogResidencyStats        ();
+  TZF_LogSharedTextureStats    ();
+  TZF_LogDumpQueueStats        ();
+  TZF_LogDumpStoreStats        ();
+  TZF_ClearSpeculativeCache    ();
+  TZF_ClearTexturePayloads     ();
+  TZF_ClearWarmedTextures      ();
+  TZF_EndAccessTrace           ();
+
   tex_log->Log ( L"[Perf Stats] At shutdown: %7.2f seconds (%7.2f frames)"
                  L" saved by cache",
                    time_saved / 1000.0f,
@@ -3271,7 +5815,25 @@ tzf::RenderFix::TextureManager::purge (void)
   int64_t start_size =
     cacheSizeTotal ();
 
-  while ( start_size - reclaimed > target_size &&
+  // What demotions posted now will give back once they finish
+  int64_t demoting = 0;
+
+  if ( config.textures.demote_before_evict && (! resetting) &&
+       start_size > target_size )
+  {
+    std::vector <tzf::RenderFix::Texture *> injected;
+
+    for ( auto& tex : textures )
+    {
+      if (tex.second->d3d9_tex->pTexOverride != nullptr)
+        injected.push_back (tex.second);
+    }
+
+    demoting =
+      TZF_DemoteIdleTextures (injected, start_size - target_size);
+  }
+
+  while ( start_size - demoting - reclaimed > target_size &&
             free_it != unreferenced_textures.end () ) {
     int             tex_refs = -1;
     ISKTextureD3D9* pSKTex   = (*free_it)->d3d9_tex;
@@ -3279,7 +5841,7 @@ tzf::RenderFix::TextureManager::purge (void)
     //
     // Skip loads that are in-flight so that we do not hitch
     //
-    if (is_streaming ((*free_it)->crc32)) {
+    if (is_streaming ((*free_it)->crc32) || pSKTex->resizing) {
       ++free_it;
       continue;
     }
@@ -3294,8 +5856,9 @@ tzf::RenderFix::TextureManager::purge (void)
       continue;
     }
 
-    int64_t ovr_size  = 0;
-    int64_t base_size = 0;
+    int64_t  ovr_size  = 0;
+    int64_t  base_size = 0;
+    uint32_t crc32     = (*free_it)->crc32;
 
     ++free_it;
 
@@ -3305,10 +5868,16 @@ tzf::RenderFix::TextureManager::purge (void)
 
     if (tex_refs == 0) {
       if (ovr_size != 0) {
+        // Likely to be wanted again before anything still resident
+        TZF_TouchTexturePayload (crc32);
+
         reclaimed += ovr_size;
 
         released_injected++;
         reclaimed_injected += ovr_size;
+
+        ++residency.evicted;
+        residency.evicted_bytes += ovr_size;
       }
     } else {
       tex_log->Log (L"[ Tex. Mgr ] Invalid reference count (%lu)!", tex_refs);
@@ -3327,11 +5896,64 @@ tzf::RenderFix::TextureManager::purge (void)
                    (double)reclaimed_injected / (1024.0 * 1024.0),
                            released_injected );
 
+  if (demoting != 0)
+  {
+    tex_log->Log ( L"[ Tex. Mgr ]   >> Demoting idle injected textures for another"
+                   L" %6.2f MiB (estimated)",
+                     (double)demoting / (1024.0 * 1024.0) );
+  }
+
   updateOSD ();
 
   tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
 }
 
+void
+tzf::RenderFix::TextureManager::updateResidency (void)
+{
+  static DWORD last_update = 0UL;
+
+  DWORD dwTime = timeGetTime ();
+
+  if ( shutting_down || resetting || config.textures.promote_after_binds <= 0 ||
+       dwTime - last_update < TZF_PROMOTE_PERIOD_MS )
+    return;
+
+  last_update = dwTime;
+
+  // Stays clear of the point where purge (...) would demote them again
+  int64_t headroom =
+    std::max (128, config.textures.max_cache_in_mib - 64) * 1024LL * 1024LL -
+      (int64_t)cacheSizeTotal ();
+
+  for ( auto& tex : textures )
+  {
+    ISKTextureD3D9* pSKTex = tex.second->d3d9_tex;
+
+    if ( pSKTex->demoted_mips == 0                                ||
+         pSKTex->resizing                                         ||
+         pSKTex->pTexOverride == nullptr                          ||
+         pSKTex->binds < (ULONG)config.textures.promote_after_binds ||
+         is_streaming (tex.first) )
+      continue;
+
+    tzf_tex_record_s record;
+
+    if (! TZF_GetInjectableTexture (tex.first, &record))
+      continue;
+
+    int64_t growth =
+      (int64_t)record.size - (int64_t)pSKTex->override_size;
+
+    if (growth > headroom)
+      continue;
+
+    headroom -= growth;
+
+    TZF_PostResidencyJob (pSKTex, 0);
+  }
+}
+
 void
 tzf::RenderFix::TextureManager::reset (void)
 {
@@ -3371,8 +5993,11 @@ tzf::RenderFix::TextureManager::reset (void)
   std::unordered_map <uint32_t, tzf::RenderFix::Texture *>::iterator it =
     textures.begin ();
 
+  std::vector <uint32_t> resident;
+
   while (it != textures.end ()) {
-    ISKTextureD3D9* pSKTex =
+    uint32_t        checksum = (*it).first;
+    ISKTextureD3D9* pSKTex   =
       (*it).second->d3d9_tex;
 
     ++it;
@@ -3385,6 +6010,9 @@ tzf::RenderFix::TextureManager::reset (void)
       can_free = true;
       base_size = pSKTex->tex_size;
       ovr_size  = pSKTex->override_size;
+
+      if (pSKTex->pTexOverride != nullptr)
+        resident.push_back (checksum);
     }
 
     else {
@@ -3418,6 +6046,9 @@ tzf::RenderFix::TextureManager::reset (void)
     }
   }
 
+  // D3DPOOL_DEFAULT as well; the table's references cannot outlive the reset
+  TZF_PruneSharedTextures (true);
+
   tex_log->Log ( L"[ Tex. Mgr ]   %4d textures (%4d references)",
                    release_count + unreleased_count,
                      ref_count + ext_refs );
@@ -3435,12 +6066,22 @@ tzf::RenderFix::TextureManager::reset (void)
                    (double)(cacheSizeTotal () - reclaimed)
                                             / (1048576.0) );
 
+  // Recreated from RAM once the device is back (TZF_RestoreInjectedTextures);
+  //   this also drops whatever the last reset restored that was never used.
+  if (shutting_down || (! config.textures.fast_reset))
+    resident.clear ();
+
+  TZF_StageResetPayloads (resident);
+
   updateOSD ();
 
   // Commit this immediately, such that D3D9 Reset will not fail in
   //   fullscreen mode...
   TZFix_LoadQueuedTextures ();
+
+  resetting = true;
   purge                    ();
+  resetting = false;
 
   tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
 }
@@ -3490,6 +6131,28 @@ tzf::RenderFix::TextureManager::updateOSD (void)
 
   osd_stats += szFormatted;
 
+  if (config.textures.max_l2_cache_in_mib > 0)
+  {
+    tzf_payload_cache_stats_s l2 =
+      TZF_GetPayloadCacheStats ();
+
+    sprintf ( szFormatted, "\n%6llu L2 Hits        : %8.2f MiB Saved     (%5.1f%%)",
+                l2.hits,
+                  (double)l2.bytes_saved / 1048576.0,
+                    l2.lookups ? 100.0 * (double)l2.hits / (double)l2.lookups : 0.0 );
+
+    osd_stats += szFormatted;
+  }
+
+  if (shared_tex.copies > 0)
+  {
+    sprintf ( szFormatted, "\n%6li Shared Textures: %8.2f MiB VRAM Saved",
+                shared_tex.copies,
+                  (double)shared_tex.saved / 1048576.0 );
+
+    osd_stats += szFormatted;
+  }
+
   if (debug_tex_id != 0x00) {
     osd_stats += "\n\n";
 
@@ -3555,6 +6218,201 @@ TZFix_LogUsedTextures (void)
 CRITICAL_SECTION        SK_TextureWorkerThread::cs_worker_init;
 ULONG                   SK_TextureWorkerThread::num_threads_init = 0UL;
 
+//
+// A chain remastered on an earlier run (or before a purge) is read on the
+//   worker, while the game draws the single level placeholder, and there
+//     is nothing left to resample.  E_NOTIMPL if there is none.
+//
+static HRESULT
+TZF_CreateFromRemaster (tzf_tex_load_s* load, const D3DXIMAGE_INFO& img_info)
+{
+  std::vector <uint8_t> remastered;
+  tzf_dds_info_s        dds;
+
+  if (! ( TZF_FetchRemaster  (load->checksum, remastered) &&
+          TZF_ParseDDSHeader (remastered.data (), remastered.size (), &dds) ))
+    return E_NOTIMPL;
+
+  HRESULT hr =
+    D3DXCreateTextureFromFileInMemoryEx_Original (
+      load->pDevice,
+        remastered.data (), (UINT)remastered.size (),
+          dds.width, dds.height, dds.mip_levels,
+            0, img_info.Format,
+              D3DPOOL_DEFAULT,
+                D3DX_FILTER_NONE, D3DX_FILTER_NONE,
+                  0,
+                    nullptr, nullptr,
+                      &load->pSrc );
+
+  // Resample it again the usual way
+  return SUCCEEDED (hr) ? hr : E_NOTIMPL;
+}
+
+//
+// Remastered textures get their mip chain built here, on the worker, and
+//   D3DX only uploads it.  32-bit formats are filtered in place; DXT1 and
+//     DXT5 are decoded, filtered and compressed again (bcn.cpp).  Returns
+//       E_NOTIMPL for anything else (DXT3, cubemaps) or when
+//         RemasterMipFilter=D3DX, so the caller can fall back to D3DX; only
+//           the chains built here go to the disk cache.
+//
+static HRESULT
+TZF_ResampleWithMipGen (tzf_tex_load_s* load, const D3DXIMAGE_INFO& img_info)
+{
+  tzf_mip_filter_t filter = TZF_MIP_FILTER_BOX;
+
+  if (! _wcsicmp (config.textures.mipmap_filter.c_str (), L"Triangle"))
+    filter = TZF_MIP_FILTER_TRIANGLE;
+  else if (_wcsicmp (config.textures.mipmap_filter.c_str (), L"Box"))
+    return E_NOTIMPL;
+
+  bool            compressed = false;
+  tzf_bc_format_t bc         = TZF_BC_FORMAT_BC1;
+
+  switch (img_info.Format)
+  {
+    case D3DFMT_A8R8G8B8:
+    case D3DFMT_X8R8G8B8:
+    case D3DFMT_A8B8G8R8:
+    case D3DFMT_X8B8G8R8:
+      break;
+
+    case D3DFMT_DXT1:
+      compressed = true;
+      break;
+
+    case D3DFMT_DXT5:
+      compressed = true;
+      bc         = TZF_BC_FORMAT_BC3;
+      break;
+
+    default:
+      return E_NOTIMPL;
+  }
+
+  tzf_dds_info_s dds;
+
+  if ( img_info.ResourceType != D3DRTYPE_TEXTURE ||
+       (! TZF_ParseDDSHeader (load->pSrcData, load->SrcDataSize, &dds)) )
+    return E_NOTIMPL;
+
+  const uint32_t w      = dds.width;
+  const uint32_t h      = dds.height;
+  const uint32_t levels = TZF_GetMipLevelCount (w, h);
+
+  const size_t top  = compressed ? TZF_GetBCLevelSize (bc, w, h) :
+                                   (size_t)w * h * 4;
+  size_t       len  = dds.data_offset;
+
+  if (dds.data_offset + top > load->SrcDataSize)
+    return E_NOTIMPL;
+
+  if (! compressed)
+    len += TZF_GetMipChainSize (w, h, levels);
+
+  else
+  {
+    for (uint32_t i = 0; i < levels; i++)
+      len += TZF_GetBCLevelSize (bc, std::max (w >> i, 1U), std::max (h >> i, 1U));
+  }
+
+  tzf_buffer_s* pooled =
+    TZF_LeaseBuffer (len);
+
+  if (pooled == nullptr)
+    return E_NOTIMPL;
+
+  if (! compressed)
+  {
+    memcpy (pooled->data, load->pSrcData, dds.data_offset + top);
+
+    TZF_SetDDSMipCount   (pooled->data, levels);
+    TZF_GenerateMipChain ( pooled->data + dds.data_offset,
+                             w, h, levels,
+                               filter, config.textures.gamma_correct_mips );
+  }
+
+  else
+  {
+    tzf_buffer_s* pixels =
+      TZF_LeaseBuffer (TZF_GetMipChainSize (w, h, levels));
+
+    if (pixels == nullptr)
+    {
+      TZF_ReturnBuffer (pooled);
+      return E_NOTIMPL;
+    }
+
+    memcpy (pooled->data, load->pSrcData, dds.data_offset);
+
+    TZF_SetDDSMipCount   (pooled->data, levels);
+    TZF_DecodeBCImage    ( bc, (const uint8_t *)load->pSrcData + dds.data_offset,
+                             w, h, pixels->data );
+    TZF_GenerateMipChain ( pixels->data,
+                             w, h, levels,
+                               filter, config.textures.gamma_correct_mips );
+
+    const uint8_t* src = pixels->data;
+          uint8_t* dst = pooled->data + dds.data_offset;
+
+    // The top level is the original, bit for bit; re-encoding it could only
+    //   lose quality
+    memcpy (dst, (const uint8_t *)load->pSrcData + dds.data_offset, top);
+
+    for (uint32_t i = 0; i < levels; i++)
+    {
+      uint32_t lw = std::max (w >> i, 1U);
+      uint32_t lh = std::max (h >> i, 1U);
+
+      if (i != 0)
+      {
+        TZF_EncodeBCImage ( bc, src, lw, lh, dst,
+                              config.textures.remaster_bc_quality );
+      }
+
+      src += (size_t)lw * lh * 4;
+      dst += TZF_GetBCLevelSize (bc, lw, lh);
+    }
+
+    TZF_ReturnBuffer (pixels);
+  }
+
+  LARGE_INTEGER built;
+  QueryPerformanceCounter (&built);
+
+  HRESULT hr =
+    D3DXCreateTextureFromFileInMemoryEx_Original (
+      load->pDevice,
+        pooled->data, (UINT)len,
+          w, h, levels,
+            0, img_info.Format,
+              D3DPOOL_DEFAULT,
+                D3DX_FILTER_NONE, D3DX_FILTER_NONE,
+                  0,
+                    nullptr, nullptr,
+                      &load->pSrc );
+
+  // Paid once; TZF_CreateFromRemaster (...) finds the chain on disk from
+  //   now on
+  if (SUCCEEDED (hr) && config.textures.remaster_cache)
+  {
+    double ms =
+      1000.0 * (double)(built.QuadPart - load->start.QuadPart) / (double)load->freq.QuadPart;
+
+    if (TZF_StoreRemaster (load->checksum, pooled->data, len, ms))
+    {
+      tex_log->Log ( L"[ Remaster ] Resampled %08x in %7.2f ms; stored in the disk cache"
+                     L" (%5.2f MiB)",
+                       load->checksum, ms, (double)len / (1024.0 * 1024.0) );
+    }
+  }
+
+  TZF_ReturnBuffer (pooled);
+
+  return hr;
+}
+
 HRESULT
 WINAPI
 ResampleTexture (tzf_tex_load_s* load)
@@ -3562,29 +6420,41 @@ ResampleTexture (tzf_tex_load_s* load)
   QueryPerformanceFrequency (&load->freq);
   QueryPerformanceCounter   (&load->start);
 
-  D3DXIMAGE_INFO img_info = { };
+  D3DXIMAGE_INFO img_info = load->info;
 
-  D3DXGetImageInfoFromFileInMemory (
-    load->pSrcData,
-      load->SrcDataSize,
-        &img_info );
+  if (img_info.Width == 0)
+  {
+    TZF_GetImageInfo (
+      load->pSrcData,
+        load->SrcDataSize,
+          &img_info );
+  }
 
   HRESULT hr = E_FAIL;
 
   if (img_info.Depth == 1)
   {
-    hr =
-    D3DXCreateTextureFromFileInMemoryEx_Original (
-      load->pDevice,
-          load->pSrcData, load->SrcDataSize,
-            img_info.Width, img_info.Height, 0,
-              0, false/*config.textures.uncompressed*/ ? D3DFMT_A8R8G8B8 : img_info.Format,
-                D3DPOOL_DEFAULT,
-                  D3DX_FILTER_TRIANGLE | D3DX_FILTER_DITHER,
-                  D3DX_FILTER_BOX      | D3DX_FILTER_DITHER,
-                    0,
-                      nullptr, nullptr,
-                        &load->pSrc );
+    hr = config.textures.remaster_cache ? TZF_CreateFromRemaster (load, img_info) :
+                                          E_NOTIMPL;
+
+    if (hr == E_NOTIMPL)
+      hr = TZF_ResampleWithMipGen (load, img_info);
+
+    if (hr == E_NOTIMPL)
+    {
+      hr =
+      D3DXCreateTextureFromFileInMemoryEx_Original (
+        load->pDevice,
+            load->pSrcData, load->SrcDataSize,
+              img_info.Width, img_info.Height, 0,
+                0, false/*config.textures.uncompressed*/ ? D3DFMT_A8R8G8B8 : img_info.Format,
+                  D3DPOOL_DEFAULT,
+                    D3DX_FILTER_TRIANGLE | D3DX_FILTER_DITHER,
+                    D3DX_FILTER_BOX      | D3DX_FILTER_DITHER,
+                      0,
+                        nullptr, nullptr,
+                          &load->pSrc );
+    }
   }
 
   else
@@ -3601,19 +6471,6 @@ unsigned int
 __stdcall
 SK_TextureWorkerThread::ThreadProc (LPVOID user)
 {
-  EnterCriticalSection (&cs_worker_init);
-  {
-    DWORD dwThreadId = GetCurrentThreadId ();
-
-    if (! streaming_memory::data_len.count (dwThreadId))
-    {
-      streaming_memory::data_len [dwThreadId] = 0;
-      streaming_memory::data     [dwThreadId] = nullptr;
-      streaming_memory::data_age [dwThreadId] = 0;
-    }
-  }
-  LeaveCriticalSection (&cs_worker_init);
-
   SYSTEM_INFO sysinfo;
   GetSystemInfo (&sysinfo);
 
@@ -3665,7 +6522,41 @@ SK_TextureWorkerThread::ThreadProc (LPVOID user)
 
       start_load ();
       {
-        if (pStream->type == tzf_tex_load_s::Resample)
+        // Decode jobs never produce a texture, so there is nothing to post
+        if (pStream->type == tzf_tex_load_s::Decode)
+        {
+          TZF_RunDecodeJob   (pStream->decode);
+          pThread->finishJob ();
+
+          delete pStream;
+        }
+
+        // Nor do restore jobs; the render thread claims what they create
+        else if (pStream->type == tzf_tex_load_s::Restore)
+        {
+          TZF_RunRestoreJob  (pStream);
+          pThread->finishJob ();
+
+          delete pStream;
+        }
+
+        // The render thread swaps the override (or learns it failed: pSrc
+        //   stays nullptr); the injectable list is left alone either way
+        else if (pStream->type == tzf_tex_load_s::Residency)
+        {
+          QueryPerformanceFrequency   (&pStream->freq);
+          QueryPerformanceCounter     (&pStream->start);
+
+          if (FAILED (InjectTexture (pStream)))
+            pStream->pSrc = nullptr;
+
+          QueryPerformanceCounter     (&pStream->end);
+
+          pThread->pool_->postFinished (pStream);
+          pThread->finishJob ();
+        }
+
+        else if (pStream->type == tzf_tex_load_s::Resample)
         {
           InterlockedIncrement      (&resampling);
 
@@ -3710,6 +6601,11 @@ SK_TextureWorkerThread::ThreadProc (LPVOID user)
           HRESULT hr =
             InjectTexture (pStream);
 
+          // A preview keeps its charge for the full chain posted behind it;
+          //   that pass retires it (or the render thread, if it never runs)
+          if (FAILED (hr) || pStream->skip_mips == 0)
+            TZF_RetireStreamJob       (pStream);
+
           QueryPerformanceCounter     (&pStream->end);
 
           InterlockedExchangeSubtract (&streaming_bytes, pStream->SrcDataSize);
@@ -3723,8 +6619,7 @@ SK_TextureWorkerThread::ThreadProc (LPVOID user)
             HRESULT hr = S_OK;
             tex_log->Log ( L"[ Tex. Mgr ] Texture Injection Failure (hr=%x) for texture %x, removing from injectable list...",
               hr, pStream->checksum);
-            if (injectable_textures.count (pStream->checksum))
-              injectable_textures.erase (pStream->checksum);
+            injectable_textures.erase (pStream->checksum);
 
             pStream->pDest->Release ();
             pStream->pSrc = pStream->pDest;
@@ -3744,20 +6639,21 @@ SK_TextureWorkerThread::ThreadProc (LPVOID user)
 
     else if (dwWaitStatus == (wait.mem_trim))
     {
-      // Yay for magic numbers :P   ==> (8 MiB Min Size, 5 Seconds Between Trims)
+      // Buffers idle for 5 seconds go back to the heap
       //
-      const size_t   MIN_SIZE = 8192 * 1024;
-      const uint32_t MIN_AGE  = 5000UL;
+      const DWORD MIN_AGE = 5000UL;
 
-      size_t before = streaming_memory::data_len [GetCurrentThreadId ()];
+      uint64_t before = TZF_GetBufferPoolStats ().total_bytes;
 
-      streaming_memory::trim (MIN_SIZE, timeGetTime () - MIN_AGE);
+      TZF_TrimPackBlockCaches (MIN_AGE);
+      TZF_TrimBufferPool      (MIN_AGE);
+      TZF_TrimDecoderContext  ();
 
-      size_t now    =  streaming_memory::data_len [GetCurrentThreadId ()];
+      uint64_t now    = TZF_GetBufferPoolStats ().total_bytes;
 
-      if (before != now)
+      if (before > now)
       {
-        tex_log->Log ( L"[ Mem. Mgr ]  Trimmed %9lzu bytes of temporary memory for tid=%x",
+        tex_log->Log ( L"[ Mem. Mgr ]  Trimmed %9llu bytes of temporary memory (tid=%x)",
                          before - now,
                            GetCurrentThreadId () );
       }
@@ -3770,7 +6666,8 @@ SK_TextureWorkerThread::ThreadProc (LPVOID user)
     }
   } while (dwWaitStatus != (wait.thread_end));
 
-  streaming_memory::trim (0, timeGetTime ());
+  TZF_ReleaseThreadBuffers  ();
+  TZF_ReleaseDecoderContext ();
 
   //CloseHandle (GetCurrentThread ());
   return 0;
@@ -3807,9 +6704,11 @@ SK_TextureThreadPool::Spooler (LPVOID user)
         ++it;
       }
 
-      // All worker threads are busy, so wait...
+      // All worker threads are busy, so wait...  Decode and restore jobs
+      //   post no result, so poll while stopWorkers (...) is draining
       if (! started) {
-        WaitForSingleObject (pPool->events_.results_waiting, INFINITE);
+        WaitForSingleObject (pPool->events_.results_waiting,
+                               pPool->stopped_ ? 1UL : INFINITE);
       } else {
         pJob =
           pPool->getNextJob ();
@@ -3863,8 +6762,20 @@ TZF_RefreshDataSources (void)
   look_stream.realStream = &arc_stream.s;
   LookToRead_Init         (&look_stream);
 
+  TZF_UnmapArchives         ();
+  TZF_ClosePacks            ();
+  TZF_ClearSpeculativeCache ();
+  TZF_ClearTexturePayloads  ();
+  TZF_ClearWarmedTextures   ();
+
+  // Nothing may resolve to an archive closed above; see
+  //   TZF_FindInjectableTexture (...) for the order
+  std::atomic_store (&archives, std::make_shared <const tzf_archive_names_t> ());
   injectable_textures.clear ();
-  archives.clear            ();
+
+  // Built up here and published all at once
+  std::unordered_map <uint32_t, tzf_tex_record_s> found;
+  tzf_archive_names_t                             found_archives;
 
   //
   // Walk injectable textures so we don't have to query the filesystem on every
@@ -3889,7 +6800,7 @@ TZF_RefreshDataSources (void)
             swscanf (fd.cFileName, L"%x" TZFIX_TEXTURE_EXT, &checksum);
 
             // Already got this texture...
-            if (injectable_textures.count (checksum))
+            if (found.count (checksum))
                 continue;
 
             ++files;
@@ -3906,7 +6817,7 @@ TZF_RefreshDataSources (void)
             rec.archive = std::numeric_limits <unsigned int>::max ();
             rec.method  = Blocking;
 
-            injectable_textures.insert (std::make_pair (checksum, rec));
+            found.insert (std::make_pair (checksum, rec));
           }
         }
       } while (FindNextFileW (hFind, &fd) != 0);
@@ -3924,7 +6835,7 @@ TZF_RefreshDataSources (void)
             swscanf (fd.cFileName, L"%x" TZFIX_TEXTURE_EXT, &checksum);
 
             // Already got this texture...
-            if (injectable_textures.count (checksum))
+            if (found.count (checksum))
                 continue;
 
             ++files;
@@ -3941,7 +6852,7 @@ TZF_RefreshDataSources (void)
             rec.archive = std::numeric_limits <unsigned int>::max ();
             rec.method  = Streaming;
 
-            injectable_textures.insert (std::make_pair (checksum, rec));
+            found.insert (std::make_pair (checksum, rec));
           }
         }
       } while (FindNextFileW (hFind, &fd) != 0);
@@ -3959,7 +6870,7 @@ TZF_RefreshDataSources (void)
             swscanf (fd.cFileName, L"%x" TZFIX_TEXTURE_EXT, &checksum);
 
             // Already got this texture...
-            if (injectable_textures.count (checksum))
+            if (found.count (checksum))
                 continue;
 
             ++files;
@@ -3976,8 +6887,8 @@ TZF_RefreshDataSources (void)
             rec.archive = std::numeric_limits <unsigned int>::max ();
             rec.method  = DontCare;
 
-            if (! injectable_textures.count (checksum))
-              injectable_textures.insert (std::make_pair (checksum, rec));
+            if (! found.count (checksum))
+              found.insert (std::make_pair (checksum, rec));
           }
         }
       } while (FindNextFileW (hFind, &fd) != 0);
@@ -4068,8 +6979,8 @@ TZF_RefreshDataSources (void)
                   swscanf (wszUnqualifiedEntry, L"%x" TZFIX_TEXTURE_EXT, &checksum);
 
                   // Already got this texture...
-                  if ( injectable_textures.count (checksum) ||
-                       inject_blacklist.count    (checksum) ) {
+                  if ( found.count            (checksum) ||
+                       inject_blacklist.count (checksum) ) {
                     free (wszFullName);
                     continue;
                   }
@@ -4081,11 +6992,12 @@ TZF_RefreshDataSources (void)
 
                   tzf_tex_record_s rec;
                   rec.size    = (uint32_t)fileSize;
+                  rec.buffer  = TZF_GetArchiveBlockSize (&arc, i);
                   rec.archive = archive;
                   rec.fileno  = i;
                   rec.method  = method;
 
-                  injectable_textures.insert (std::make_pair (checksum, rec));
+                  found.insert (std::make_pair (checksum, rec));
 
                   ++tex_count;
                   ++files;
@@ -4097,8 +7009,10 @@ TZF_RefreshDataSources (void)
               }
 
               if (tex_count > 0) {
+                TZF_SetArchiveBlockRanges (archive, &arc);
+
                 ++archive;
-                archives.push_back (wszQualifiedArchiveName);
+                found_archives.push_back (wszQualifiedArchiveName);
               }
             }
 
@@ -4106,6 +7020,61 @@ TZF_RefreshDataSources (void)
             File_Close  (&arc_stream.file);
           }
 
+          else if ( wcsstr (wszArchiveNameLwr, TZF_PACK_EXT) )
+          {
+            int tex_count = 0;
+
+            wchar_t wszQualifiedArchiveName [MAX_PATH];
+            _swprintf ( wszQualifiedArchiveName,
+                          L"%s\\inject\\%s",
+                            TZFIX_TEXTURE_DIR,
+                              fd.cFileName );
+
+            tzf_pack_s* pack =
+              TZF_OpenPack (wszQualifiedArchiveName);
+
+            if (pack != nullptr)
+            {
+              uint32_t count = TZF_GetPackEntryCount (pack);
+
+              for (uint32_t i = 0; i < count; i++)
+              {
+                const tzf_pack_entry_s* entry =
+                  TZF_GetPackEntry (pack, i);
+
+                // Already got this texture...
+                if ( found.count            (entry->checksum) ||
+                     inject_blacklist.count (entry->checksum) )
+                  continue;
+
+                tzf_tex_record_s rec;
+                rec.size    = entry->size;
+                rec.buffer  = TZF_GetPackEntryBufferSize (pack, i);
+                rec.archive = archive;
+                rec.fileno  = i;
+                rec.method  = entry->method <= DontCare ?
+                                (tzf_load_method_t)entry->method : DontCare;
+
+                found.insert (std::make_pair (entry->checksum, rec));
+
+                ++tex_count;
+                ++files;
+
+                liSize.QuadPart += rec.size;
+              }
+
+              if (tex_count > 0) {
+                TZF_RegisterPack (archive, pack);
+
+                ++archive;
+                found_archives.push_back (wszQualifiedArchiveName);
+              }
+
+              else
+                TZF_ReleasePack (pack);
+            }
+          }
+
           free (wszArchiveNameLwr);
         }
       } while (FindNextFileW (hFind, &fd) != 0);
@@ -4118,14 +7087,21 @@ TZF_RefreshDataSources (void)
   }
 
   File_Close  (&arc_stream.file);
+
+  std::atomic_store ( &archives,
+                        std::make_shared <const tzf_archive_names_t> (std::move (found_archives)) );
+  injectable_textures.assign (found);
+
+  TZF_FindSharedTextureSizes ();
 }
 
 
 bool
 tzf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
 {
-  if ( injectable_textures.find (checksum) ==
-         injectable_textures.end () )
+  tzf_tex_record_s record;
+
+  if (! injectable_textures.find (checksum, &record))
     return false;
 
   EnterCriticalSection        (&cs_tex_stream);
@@ -4151,8 +7127,6 @@ tzf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
     return false;
   }
 
-  tzf_tex_record_s record = injectable_textures [checksum];
-
   if (record.method == DontCare)
     record.method = Streaming;
 
@@ -4194,8 +7168,7 @@ tzf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
   }
 
   load_op->SrcDataSize =
-    injectable_textures.count (checksum) == 0 ?
-      0 : (UINT)injectable_textures [checksum].size;
+    (UINT)record.size;
 
   load_op->pDest = pTex;
 
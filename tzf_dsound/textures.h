@@ -174,6 +174,9 @@ namespace RenderFix {
     void                     reset (void);
     void                     purge (void); // WIP
 
+    // Promotes demoted textures that are being bound again
+    void                     updateResidency (void);
+
     size_t                   numTextures (void) {
       return textures.size ();
     }
@@ -190,6 +193,11 @@ namespace RenderFix {
       InterlockedAdd64     (&injected_size, size);
     }
 
+    void                     removeInjected (size_t size) {
+      InterlockedDecrement (&injected_count);
+      InterlockedAdd64     (&injected_size, -(LONG64)size);
+    }
+
     std::string              osdStats  (void) { return osd_stats; }
     void                     updateOSD (void);
 
@@ -283,6 +291,9 @@ public:
          tex_crc32     = crc32;
          must_block    = false;
          refs          =  1;
+         demoted_mips  =  0;
+         resizing      = false;
+         binds         =  0;
      };
 
     /*** IUnknown methods ***/
@@ -457,6 +468,10 @@ public:
     LARGE_INTEGER      last_used;     // The last time this texture was used (for rendering)
                                       //   different from the last time referenced, this is
                                       //     set when SetTexture (...) is called.
+
+    UINT               demoted_mips;  // Top mip levels the override leaves out
+    bool               resizing;      //   A demotion or promotion is in flight
+    ULONG              binds;         //   SetTexture (...) calls since the demotion
 };
 
 typedef HRESULT (STDMETHODCALLTYPE *D3DXCreateTextureFromFileInMemoryEx_pfn)
@@ -571,6 +586,7 @@ struct tzf_tex_record_s {
            int               fileno  = 0UL;
   enum     tzf_load_method_t method  = DontCare;
            size_t            size    = 0UL;
+           size_t            buffer  = 0UL; // Decode buffer, if larger (solid blocks)
 };
 
 std::vector <std::wstring>
@@ -579,8 +595,9 @@ TZF_GetTextureArchives (void);
 std::vector < std::pair < uint32_t, tzf_tex_record_s > >
 TZF_GetInjectableTextures (void);
 
-tzf_tex_record_s*
-TZF_GetInjectableTexture (uint32_t checksum);
+// Copies the record out; record may be nullptr to only test for one
+bool
+TZF_GetInjectableTexture (uint32_t checksum, tzf_tex_record_s* record);
 
 void
 TZF_RefreshDataSources (void);
@@ -0,0 +1,131 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include <Windows.h>
+
+#include "trace.h"
+#include "config.h"
+
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+
+static struct {
+  FILE*                          fTrace      = nullptr;
+  CRITICAL_SECTION               cs;
+
+  ULONGLONG                      last_access = 0ULL;
+  uint32_t                       scene       = 0UL;
+  bool                           new_scene   = true;
+  std::string                    scene_name;
+
+  // Textures already listed for the current scene
+  std::unordered_set <uint32_t>  seen;
+} trace;
+
+void
+TZF_BeginAccessTrace (const wchar_t* wszFile)
+{
+  if (trace.fTrace != nullptr)
+    return;
+
+  InitializeCriticalSectionAndSpinCount (&trace.cs, 100UL);
+
+  // Append; the repacker treats every session as more scenes
+  trace.fTrace = _wfopen (wszFile, L"a");
+
+  if (trace.fTrace == nullptr)
+  {
+    DeleteCriticalSection (&trace.cs);
+    return;
+  }
+
+  fprintf (trace.fTrace, "# TZF texture access trace\n");
+
+  trace.new_scene = true;
+}
+
+void
+TZF_EndAccessTrace (void)
+{
+  if (trace.fTrace == nullptr)
+    return;
+
+  EnterCriticalSection (&trace.cs);
+  {
+    fclose (trace.fTrace);
+    trace.fTrace = nullptr;
+  }
+  LeaveCriticalSection (&trace.cs);
+
+  DeleteCriticalSection (&trace.cs);
+}
+
+void
+TZF_TraceTextureAccess (uint32_t checksum)
+{
+  if (trace.fTrace == nullptr)
+    return;
+
+  EnterCriticalSection (&trace.cs);
+  {
+    ULONGLONG now = GetTickCount64 ();
+
+    if ( trace.last_access != 0ULL &&
+         now - trace.last_access > (ULONGLONG)config.textures.trace_scene_gap_in_ms )
+      trace.new_scene = true;
+
+    trace.last_access = now;
+
+    if (trace.new_scene)
+    {
+      fprintf ( trace.fTrace, "scene %lu %s\n",
+                  ++trace.scene,
+                    trace.scene_name.c_str () );
+
+      trace.new_scene = false;
+      trace.scene_name.clear ();
+      trace.seen.clear       ();
+    }
+
+    if (trace.seen.insert (checksum).second)
+      fprintf (trace.fTrace, "%08x\n", checksum);
+  }
+  LeaveCriticalSection (&trace.cs);
+}
+
+void
+TZF_MarkTraceScene (const char* szName)
+{
+  if (trace.fTrace == nullptr)
+    return;
+
+  EnterCriticalSection (&trace.cs);
+  {
+    trace.new_scene  = true;
+    trace.scene_name = szName != nullptr ? szName : "";
+
+    fflush (trace.fTrace);
+  }
+  LeaveCriticalSection (&trace.cs);
+}
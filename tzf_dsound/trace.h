@@ -0,0 +1,49 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__TRACE_H__
+#define __TZF__TRACE_H__
+
+#include <cstdint>
+
+//
+// Texture access trace, consumed by "tzf_packbuild repack".
+//
+//   One checksum per line, each listed once per scene.  A scene ends when
+//     injection goes idle for AccessTraceSceneGapInMs or when one is
+//       started by hand with Textures.MarkScene.
+//
+void
+TZF_BeginAccessTrace   (const wchar_t* wszFile);
+
+void
+TZF_EndAccessTrace     (void);
+
+void
+TZF_TraceTextureAccess (uint32_t checksum);
+
+// szName may be nullptr or empty
+void
+TZF_MarkTraceScene     (const char* szName);
+
+#endif /* __TZF__TRACE_H__ */
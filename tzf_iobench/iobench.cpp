@@ -0,0 +1,348 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// The texture streaming read stage, without the game (or D3D9): nothing
+//   here but the stage itself, the CRC the decode workers stand in with and
+//     a directory walk, so it builds wherever io_stage.cpp does
+//
+
+#ifdef _WIN32
+# define NOMINMAX
+# include <Windows.h>
+#else
+# include <dirent.h>
+# include <sys/stat.h>
+#endif
+
+#include "iobench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#include "lzma/7zCrc.h"
+
+#ifndef _WIN32
+// Paths are built the Windows way everywhere else
+static std::string
+TZF_GetNativePath (const std::wstring& path)
+{
+  std::vector <char> native (path.length () * MB_CUR_MAX + 1);
+
+  if (wcstombs (native.data (), path.c_str (), native.size ()) == (size_t)-1)
+    return std::string ();
+
+  std::replace (native.begin (), native.end (), '\\', '/');
+
+  return native.data ();
+}
+#endif
+
+void
+TZF_FindBenchFiles (const std::wstring& dir, std::vector <std::wstring>& files)
+{
+#ifdef _WIN32
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileW ((dir + L"\\*").c_str (), &fd);
+
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+
+  do
+  {
+    if (! wcscmp (fd.cFileName, L".") || ! wcscmp (fd.cFileName, L".."))
+      continue;
+
+    std::wstring path = dir + L"\\" + fd.cFileName;
+
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      TZF_FindBenchFiles (path, files);
+    else
+      files.push_back (path);
+  } while (FindNextFileW (hFind, &fd));
+
+  FindClose (hFind);
+#else
+  std::string native =
+    TZF_GetNativePath (dir);
+
+  DIR* pDir = opendir (native.c_str ());
+
+  if (pDir == nullptr)
+    return;
+
+  while (dirent* ent = readdir (pDir))
+  {
+    if (! strcmp (ent->d_name, ".") || ! strcmp (ent->d_name, ".."))
+      continue;
+
+    std::vector <wchar_t> name (strlen (ent->d_name) + 1);
+
+    if (mbstowcs (name.data (), ent->d_name, name.size ()) == (size_t)-1)
+      continue;
+
+    std::wstring path = dir + L"\\" + name.data ();
+
+    struct stat st;
+
+    if (stat ((native + "/" + ent->d_name).c_str (), &st) != 0)
+      continue;
+
+    if (S_ISDIR (st.st_mode))
+      TZF_FindBenchFiles (path, files);
+    else if (S_ISREG (st.st_mode))
+      files.push_back (path);
+  }
+
+  closedir (pDir);
+#endif
+}
+
+// Completed reads waiting for a "decode" worker
+struct tzf_bench_results_s {
+  std::mutex                      lock;
+  std::condition_variable         cv;
+  std::deque <tzf_io_request_s *> done;
+  size_t                          remaining = 0;
+  uint32_t                        crc       = 0;
+};
+
+static void
+TZF_BenchReadDone (tzf_io_request_s* req)
+{
+  tzf_bench_results_s* results = (tzf_bench_results_s *)req->user;
+
+  {
+    std::lock_guard <std::mutex> lock (results->lock);
+    results->done.push_back (req);
+  }
+
+  results->cv.notify_one ();
+}
+
+static void
+TZF_BenchDecode (tzf_bench_results_s* results)
+{
+  for (;;)
+  {
+    tzf_io_request_s* req = nullptr;
+
+    {
+      std::unique_lock <std::mutex> lock (results->lock);
+
+      results->cv.wait (lock, [&] {
+        return results->remaining == 0 || (! results->done.empty ());
+      });
+
+      if (results->done.empty ())
+        return;
+
+      req = results->done.front ();
+            results->done.pop_front ();
+    }
+
+    uint32_t crc = CrcCalc (req->data.data (), req->data.size ());
+
+    delete req;
+
+    {
+      std::lock_guard <std::mutex> lock (results->lock);
+
+      results->crc ^= crc;
+
+      if (--results->remaining == 0)
+        results->cv.notify_all ();
+    }
+  }
+}
+
+// What a worker without the I/O stage does: read the whole file, then decode
+static bool
+TZF_BenchReadFile (const std::wstring& path, std::vector <uint8_t>& data)
+{
+#ifdef _WIN32
+  FILE* fIn = _wfopen (path.c_str (), L"rb");
+#else
+  FILE* fIn = fopen (TZF_GetNativePath (path).c_str (), "rb");
+#endif
+
+  if (fIn == nullptr)
+    return false;
+
+#ifdef _WIN32
+  _fseeki64 (fIn, 0, SEEK_END);
+  data.resize ((size_t)_ftelli64 (fIn));
+  _fseeki64 (fIn, 0, SEEK_SET);
+#else
+  fseeko (fIn, 0, SEEK_END);
+  data.resize ((size_t)ftello (fIn));
+  fseeko (fIn, 0, SEEK_SET);
+#endif
+
+  bool ok =
+    data.empty () || fread (data.data (), data.size (), 1, fIn) == 1;
+
+  fclose (fIn);
+
+  return ok;
+}
+
+bool
+TZF_RunIOBenchmark ( const wchar_t*   wszDir,
+                     tzf_io_backend_t backend,
+                     int              max_depth,
+                     int              workers )
+{
+  std::vector <std::wstring> files;
+
+  TZF_FindBenchFiles (wszDir, files);
+
+  if (files.empty ())
+  {
+    fprintf (stderr, "No files under %ls\n", wszDir);
+    return false;
+  }
+
+  tzf_io_stage_s* probe =
+    TZF_CreateIOStage (backend, 1);
+
+  if (probe == nullptr)
+  {
+    fprintf ( stderr, "The %s backend is not available here\n",
+                TZF_GetIOBackendName (backend) );
+    return false;
+  }
+
+  TZF_DestroyIOStage (probe);
+
+  // Narrow output only; the same format strings work with every C runtime
+  printf ( "%zu files, %s backend, %d decode workers\n\n"
+           "    Depth    Seconds      MiB/s   Latency ms   In flight   Failed\n",
+             files.size (), TZF_GetIOBackendName (backend), workers );
+
+  // Depth 0 is the baseline without an I/O stage
+  std::vector <int> runs (1, 0);
+
+  for (int depth = 1; depth < max_depth; depth *= 2)
+    runs.push_back (depth);
+
+  runs.push_back (max_depth);
+
+  for (int depth : runs)
+  {
+    auto start = std::chrono::steady_clock::now ();
+
+    std::vector <std::thread> pool;
+    tzf_io_stats_s            stats;
+
+    if (depth == 0)
+    {
+      std::atomic <size_t>   next   (0);
+      std::atomic <uint64_t> bytes  (0);
+      std::atomic <uint64_t> failed (0);
+
+      for (int i = 0; i < workers; i++)
+      {
+        pool.emplace_back ([&] {
+          std::vector <uint8_t> data;
+
+          for (size_t f = next++; f < files.size (); f = next++)
+          {
+            if (! TZF_BenchReadFile (files [f], data))
+              failed++;
+
+            bytes += data.size ();
+
+            CrcCalc (data.data (), data.size ());
+          }
+        });
+      }
+
+      for (auto& thread : pool)
+        thread.join ();
+
+      stats.requests      = files.size ();
+      stats.bytes         = bytes;
+      stats.failures      = failed;
+      stats.max_in_flight = (uint32_t)workers;
+    }
+
+    else
+    {
+      tzf_io_stage_s* stage =
+        TZF_CreateIOStage (backend, depth);
+
+      if (stage == nullptr)
+        return false;
+
+      tzf_bench_results_s results;
+      results.remaining = files.size ();
+
+      for (int i = 0; i < workers; i++)
+        pool.emplace_back (TZF_BenchDecode, &results);
+
+      // The stage holds everything past depth in its own queue
+      for (const auto& file : files)
+      {
+        tzf_io_request_s* req = new tzf_io_request_s;
+
+        req->path = file;
+        req->done = TZF_BenchReadDone;
+        req->user = &results;
+
+        TZF_SubmitRead (stage, req);
+      }
+
+      for (auto& thread : pool)
+        thread.join ();
+
+      stats = TZF_GetIOStageStats (stage);
+
+      TZF_DestroyIOStage (stage);
+    }
+
+    double secs =
+      std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count ();
+
+    printf ( "  %7d  %9.3f  %9.2f  %11.3f  %10lu  %7llu\n",
+               depth, secs,
+                 (double)stats.bytes / (1024.0 * 1024.0) / secs,
+                   depth == 0 ? 0.0 : stats.read_ms / (double)stats.requests,
+                     (unsigned long)stats.max_in_flight,
+                       (unsigned long long)stats.failures );
+  }
+
+  return true;
+}
+
@@ -0,0 +1,52 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__IOBENCH_H__
+#define __TZF__IOBENCH_H__
+
+#include "io_stage.h"
+
+#include <string>
+#include <vector>
+
+//
+// Every file under dir, recursively; paths are built the Windows way (the
+//   I/O stage turns them around elsewhere)
+//
+void
+TZF_FindBenchFiles    ( const std::wstring&         dir,
+                        std::vector <std::wstring>& files );
+
+//
+// Feeds every file under wszDir through the streaming I/O stage at queue
+//   depths 1, 2, 4, ... max_depth, with workers threads checksumming the
+//     results in place of decoding them.  The first row is the old way:
+//       each worker reads its own file.  Run it on a cold file cache for
+//         numbers that mean anything.
+//
+bool
+TZF_RunIOBenchmark    ( const wchar_t*   wszDir,
+                        tzf_io_backend_t backend,
+                        int              max_depth,
+                        int              workers );
+
+#endif /* __TZF__IOBENCH_H__ */
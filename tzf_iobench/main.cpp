@@ -0,0 +1,147 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// tzf_iobench: the texture streaming read stage, measured on its own
+//
+//   Only io_stage.cpp and the CRC from the LZMA SDK go into it, so it builds
+//     without D3D9 (or Windows, using the thread backend).
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <cstring>
+#include <clocale>
+#include <string>
+#include <vector>
+
+#include "iobench.h"
+
+#include "lzma/7zCrc.h"
+
+#ifndef _WIN32
+# define _wcsicmp wcscasecmp
+#endif
+
+static void
+TZF_PrintUsage (void)
+{
+  fprintf ( stderr,
+    "Usage: tzf_iobench <dir> [--depth N] [--workers N] [--backend overlapped|threads]\n" );
+}
+
+static int
+TZF_IOBench (int argc, wchar_t** argv)
+{
+  if (argc < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  const wchar_t*   wszDir  = argv [0];
+  int              depth   = 16;
+  int              workers = 6;  // WorkerThreads default in tzfix.ini
+  tzf_io_backend_t backend = TZF_IO_BACKEND_OVERLAPPED;
+
+#ifndef _WIN32
+  backend = TZF_IO_BACKEND_THREADS;
+#endif
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--depth") && i + 1 < argc)
+      depth = (int)wcstol (argv [++i], nullptr, 10);
+
+    else if (! wcscmp (argv [i], L"--workers") && i + 1 < argc)
+      workers = (int)wcstol (argv [++i], nullptr, 10);
+
+    else if (! wcscmp (argv [i], L"--backend") && i + 1 < argc)
+    {
+      ++i;
+
+      if (! _wcsicmp (argv [i], L"overlapped"))
+        backend = TZF_IO_BACKEND_OVERLAPPED;
+      else if (! _wcsicmp (argv [i], L"threads"))
+        backend = TZF_IO_BACKEND_THREADS;
+      else
+      {
+        TZF_PrintUsage ();
+        return 1;
+      }
+    }
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (depth < 1 || workers < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunIOBenchmark (wszDir, backend, depth, workers) ? 0 : 3;
+}
+
+#ifdef _WIN32
+int
+wmain (int argc, wchar_t** argv)
+{
+  CrcGenerateTable ();
+
+  return TZF_IOBench (argc - 1, argv + 1);
+}
+#else
+int
+main (int argc, char** argv)
+{
+  setlocale (LC_CTYPE, "");
+
+  CrcGenerateTable ();
+
+  std::vector <std::wstring> args;
+  std::vector <wchar_t *>    wargv;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::vector <wchar_t> arg (strlen (argv [i]) + 1);
+
+    if (mbstowcs (arg.data (), argv [i], arg.size ()) == (size_t)-1)
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+
+    args.emplace_back (arg.data ());
+  }
+
+  for (auto& arg : args)
+    wargv.push_back (&arg [0]);
+
+  return TZF_IOBench ((int)wargv.size (), wargv.data ());
+}
+#endif
@@ -0,0 +1,1326 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include "bench.h"
+#include "pack_writer.h"
+#include "sources.h"
+#include "dds.h"
+#include "mipgen.h"
+#include "bcn.h"
+#include "dump_index.h"
+#include "snapshot_index.h"
+
+#include <d3d9.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+#include <unordered_map>
+#include <random>
+
+#include "lzma/7zCrc.h"
+
+// Mip chain of a w x h block-compressed texture, 4x4 blocks of block_bytes
+static size_t
+TZF_GetMipChainSize (uint32_t w, uint32_t h, uint32_t levels, size_t block_bytes)
+{
+  size_t size = 0;
+
+  for (uint32_t i = 0; i < levels; i++)
+  {
+    size += (size_t)((std::max (w >> i, 1U) + 3) / 4) *
+                    ((std::max (h >> i, 1U) + 3) / 4) * block_bytes;
+  }
+
+  return size;
+}
+
+//
+// Not real images, but shaped like the ones the game dumps: each texture
+//   draws from a small set of endpoints and index patterns, so it compresses
+//     about as well as DXT data usually does instead of not at all.
+//
+static void
+TZF_MakeSyntheticDDS (uint32_t seed, bool dxt5, std::vector <uint8_t>& out)
+{
+  auto rand = [&](void) -> uint32_t {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  };
+
+  static const uint32_t dims [] = { 32, 64, 64, 128, 128, 128, 256, 256, 512 };
+
+  uint32_t w      = dims [rand () % (sizeof (dims) / sizeof (dims [0]))];
+  uint32_t h      = (rand () & 1) ? w : w / 2;
+  uint32_t levels = 1;
+
+  while ((std::max (w, h) >> levels) > 0)
+    levels++;
+
+  size_t block_bytes = dxt5 ? 16 : 8;
+  size_t data_size   = TZF_GetMipChainSize (w, h, levels, block_bytes);
+
+  out.assign (128 + data_size, 0);
+
+  uint32_t header [32] = { };
+
+  header [0]  = 0x20534444;                    // "DDS "
+  header [1]  = 124;                           // dwSize
+  header [2]  = 0x000A1007;                    // CAPS | HEIGHT | WIDTH | PIXELFORMAT |
+                                               //   MIPMAPCOUNT | LINEARSIZE
+  header [3]  = h;
+  header [4]  = w;
+  header [5]  = (uint32_t)TZF_GetMipChainSize (w, h, 1, block_bytes);
+  header [7]  = levels;
+  header [19] = 32;                            // ddspf.dwSize
+  header [20] = 0x4;                           // DDPF_FOURCC
+  header [21] = dxt5 ? 0x35545844 : 0x31545844;
+  header [27] = 0x00401008;                    // COMPLEX | TEXTURE | MIPMAP
+
+  memcpy (out.data (), header, sizeof (header));
+
+  uint32_t endpoints [8], patterns [16];
+
+  for (auto& it : endpoints) it = rand ();
+  for (auto& it : patterns)  it = rand ();
+
+  for (size_t pos = 128; pos < out.size (); pos += block_bytes)
+  {
+    uint8_t* block = &out [pos];
+
+    if (dxt5)
+    {
+      uint32_t alpha = endpoints [rand () % 8];
+      uint32_t bits  = patterns  [rand () % 16];
+
+      memcpy (block,     &alpha, 2);
+      memcpy (block + 2, &bits,  4);
+      memcpy (block + 6, &bits,  2);
+
+      block += 8;
+    }
+
+    memcpy (block,     &endpoints [(pos >> 6) % 8],  4);
+    memcpy (block + 4, &patterns  [rand () % 16],    4);
+  }
+}
+
+static bool
+TZF_WriteSyntheticTree (const std::wstring& dir, int textures)
+{
+  CreateDirectoryW (dir.c_str (),                nullptr);
+  CreateDirectoryW ((dir + L"\\DXT1").c_str (),  nullptr);
+  CreateDirectoryW ((dir + L"\\DXT5").c_str (),  nullptr);
+
+  std::vector <uint8_t> data;
+  bool                  dxt5 = false;
+
+  for (int i = 0; i < textures; i++)
+  {
+    // Every 16th texture repeats the previous payload under a new checksum,
+    //   as the game does for some of its placeholder textures
+    if (i % 16 != 15)
+    {
+      dxt5 = (i % 3) == 0;
+
+      TZF_MakeSyntheticDDS (0x9E3779B9U * (uint32_t)(i + 1), dxt5, data);
+    }
+
+    wchar_t wszFile [MAX_PATH];
+
+    _swprintf ( wszFile, L"%s\\%s\\%08x.dds",
+                  dir.c_str (),
+                    dxt5 ? L"DXT5" : L"DXT1",
+                      0x9E3779B1U * (uint32_t)i );
+
+    FILE* fOut = _wfopen (wszFile, L"wb");
+
+    if (fOut == nullptr || fwrite (data.data (), data.size (), 1, fOut) != 1)
+    {
+      fwprintf (stderr, L"Cannot write %s\n", wszFile);
+
+      if (fOut != nullptr)
+        fclose (fOut);
+
+      return false;
+    }
+
+    fclose (fOut);
+  }
+
+  return true;
+}
+
+bool
+TZF_RunBuildBenchmark ( const wchar_t*   wszDir,
+                        int              textures,
+                        int              max_threads,
+                        int              level )
+{
+  std::wstring dir  (wszDir);
+  std::wstring tree (dir + L"\\textures");
+  std::wstring pack (dir + L"\\bench.tzp");
+
+  wprintf (L"Writing %d synthetic textures to %s...\n", textures, tree.c_str ());
+
+  CreateDirectoryW (dir.c_str (), nullptr);
+
+  if (! TZF_WriteSyntheticTree (tree, textures))
+    return false;
+
+  // 1, 2, 4, ... and max_threads itself when it is not a power of two
+  std::vector <int> runs;
+
+  for (int threads = 1; threads < max_threads; threads *= 2)
+    runs.push_back (threads);
+
+  runs.push_back (max_threads);
+
+  double base_secs = 0.0;
+
+  wprintf (L"\n  Threads    Seconds      MiB/s    Speedup     Ratio\n");
+
+  for (int threads : runs)
+  {
+    auto start = std::chrono::steady_clock::now ();
+
+    std::vector <tzf_pack_input_s> inputs;
+
+    if (! TZF_ReadTreeInputs (tree.c_str (), threads, inputs))
+      return false;
+
+    TZF_DedupInputs           (inputs);
+    TZF_LinkIdenticalPayloads (inputs);
+
+    tzf_pack_options_s opts;
+    tzf_pack_stats_s   stats;
+
+    opts.level   = level;
+    opts.threads = threads;
+    opts.sidecar = true;
+
+    if (! TZF_WritePack (pack.c_str (), inputs, TZF_PlanBySimilarity (inputs, 4 << 20), opts, &stats))
+      return false;
+
+    double secs =
+      std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count ();
+
+    if (threads == 1)
+      base_secs = secs;
+
+    wprintf ( L"  %7d  %9.2f  %9.2f  %8.2fx  %7.1f%%\n",
+                threads, secs,
+                  (double)stats.unpacked / (1024.0 * 1024.0) / secs,
+                    base_secs / secs,
+                      100.0 * (double)stats.packed / (double)stats.unpacked );
+  }
+
+  return true;
+}
+
+// What any header the parser accepts has to satisfy
+static bool
+TZF_IsSaneDDSInfo (const tzf_dds_info_s& info, size_t size)
+{
+  return info.width       != 0    && info.height     != 0  &&
+         info.depth       != 0    && info.mip_levels != 0  &&
+         info.mip_levels  <= 32   && info.format     != 0  &&
+         info.data_offset <= size && (! (info.cubemap && info.volume));
+}
+
+bool
+TZF_RunDDSBenchmark ( const wchar_t*   wszDir,
+                      int              passes,
+                      int              mutations )
+{
+  std::vector <std::vector <uint8_t>> headers;
+
+  if (wszDir != nullptr)
+  {
+    std::vector <std::wstring> files;
+
+    TZF_FindTreeFiles (wszDir, files);
+
+    std::vector <uint8_t> data;
+
+    for (const auto& file : files)
+    {
+      if (TZF_BenchReadFile (file, data))
+        headers.push_back (data);
+    }
+  }
+
+  else
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      headers.emplace_back ();
+      TZF_MakeSyntheticDDS (i + 1, (i & 1) != 0, headers.back ());
+    }
+  }
+
+  if (headers.empty ())
+  {
+    fwprintf (stderr, L"No files under %s\n", wszDir);
+    return false;
+  }
+
+  // Only the headers matter, and this keeps the set in cache
+  for (auto& header : headers)
+  {
+    if (header.size () > 148)
+      header.resize (148);
+  }
+
+  size_t parsed = 0;
+  size_t insane = 0;
+
+  auto start = std::chrono::steady_clock::now ();
+
+  for (int pass = 0; pass < passes; pass++)
+  {
+    for (const auto& header : headers)
+    {
+      tzf_dds_info_s info;
+
+      if (TZF_ParseDDSHeader (header.data (), header.size (), &info))
+        parsed++;
+    }
+  }
+
+  double secs =
+    std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count ();
+
+  wprintf ( L"%zu files, %zu DDS headers read natively per pass\n"
+            L"  %9.2f ns per header\n",
+              headers.size (), parsed / (size_t)passes,
+                1e9 * secs / ((double)headers.size () * (double)passes) );
+
+  uint32_t seed     = 0x2545F491;
+  size_t   accepted = 0;
+
+  auto rand = [&](void) -> uint32_t {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  };
+
+  std::vector <uint8_t> mutant;
+
+  for (const auto& header : headers)
+  {
+    for (int i = 0; i < mutations; i++)
+    {
+      mutant.assign (header.begin (), header.begin () + rand () % (header.size () + 1));
+
+      for (uint32_t flips = rand () % 8; flips > 0 && (! mutant.empty ()); flips--)
+        mutant [rand () % mutant.size ()] = (uint8_t)rand ();
+
+      // An exact-size copy, so anything read past the end is a real overrun
+      std::vector <uint8_t> exact (mutant);
+      tzf_dds_info_s        info;
+
+      if (TZF_ParseDDSHeader (exact.data (), exact.size (), &info))
+      {
+        accepted++;
+
+        if (! TZF_IsSaneDDSInfo (info, exact.size ()))
+          insane++;
+      }
+    }
+  }
+
+  wprintf ( L"  %zu mutated headers, %zu accepted, %zu described wrongly\n",
+              headers.size () * (size_t)mutations, accepted, insane );
+
+  return insane == 0;
+}
+
+// Smooth gradients with some noise, closer to real art than pure noise;
+//   A8R8G8B8, w * h * 4 bytes
+static void
+TZF_MakeBenchImage (uint32_t w, uint32_t h, uint32_t& seed, uint8_t* out)
+{
+  for (uint32_t y = 0; y < h; y++)
+  {
+    for (uint32_t x = 0; x < w; x++)
+    {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+
+      uint8_t* px = out + ((size_t)y * w + x) * 4;
+
+      px [0] = (uint8_t)(x * 255 / w + (seed & 0x0F));
+      px [1] = (uint8_t)(y * 255 / h + ((seed >> 8) & 0x0F));
+      px [2] = (uint8_t)((x ^ y) + ((seed >> 16) & 0x0F));
+      px [3] = (uint8_t)(255 - (x + y) * 127 / (w + h));
+    }
+  }
+}
+
+#define TZF_D3DX_FILTER_NONE     0x00000001
+#define TZF_D3DX_FILTER_TRIANGLE 0x00000004
+#define TZF_D3DX_FILTER_BOX      0x00000005
+#define TZF_D3DX_FILTER_SRGB     0x00600000
+
+typedef IDirect3D9* (WINAPI *Direct3DCreate9_pfn)   (UINT SDKVersion);
+typedef HRESULT     (WINAPI *D3DXFilterTexture_pfn) ( LPDIRECT3DBASETEXTURE9 pBaseTexture,
+                                                      const PALETTEENTRY*    pPalette,
+                                                      UINT                   SrcLevel,
+                                                      DWORD                  Filter );
+typedef HRESULT     (WINAPI *D3DXLoadSurfaceFromMemory_pfn)
+                                                    ( LPDIRECT3DSURFACE9     pDestSurface,
+                                                      const PALETTEENTRY*    pDestPalette,
+                                                      const RECT*            pDestRect,
+                                                      LPCVOID                pSrcMemory,
+                                                      D3DFORMAT              SrcFormat,
+                                                      UINT                   SrcPitch,
+                                                      const PALETTEENTRY*    pSrcPalette,
+                                                      const RECT*            pSrcRect,
+                                                      DWORD                  Filter,
+                                                      D3DCOLOR               ColorKey );
+
+struct tzf_d3dx_bench_s {
+  HMODULE               d3d9   = nullptr;
+  HMODULE               d3dx   = nullptr;
+  IDirect3D9*           d3d    = nullptr;
+  IDirect3DDevice9*     device = nullptr;
+  D3DXFilterTexture_pfn filter = nullptr;
+
+  D3DXLoadSurfaceFromMemory_pfn
+                        load_surface = nullptr;
+};
+
+// Everything D3DX needs to filter a scratch texture; false if any is missing
+static bool
+TZF_OpenD3DXBench (tzf_d3dx_bench_s& bench)
+{
+  bench.d3d9 = LoadLibraryW (L"d3d9.dll");
+  bench.d3dx = LoadLibraryW (L"d3dx9_43.dll");
+
+  if (bench.d3d9 == nullptr || bench.d3dx == nullptr)
+    return false;
+
+  Direct3DCreate9_pfn create =
+    (Direct3DCreate9_pfn)GetProcAddress (bench.d3d9, "Direct3DCreate9");
+
+  bench.filter =
+    (D3DXFilterTexture_pfn)GetProcAddress (bench.d3dx, "D3DXFilterTexture");
+  bench.load_surface =
+    (D3DXLoadSurfaceFromMemory_pfn)GetProcAddress (bench.d3dx, "D3DXLoadSurfaceFromMemory");
+
+  if (create == nullptr || bench.filter == nullptr || bench.load_surface == nullptr)
+    return false;
+
+  bench.d3d = create (D3D_SDK_VERSION);
+
+  if (bench.d3d == nullptr)
+    return false;
+
+  D3DPRESENT_PARAMETERS pp = { };
+
+  pp.Windowed         = TRUE;
+  pp.SwapEffect       = D3DSWAPEFFECT_DISCARD;
+  pp.BackBufferWidth  = 1;
+  pp.BackBufferHeight = 1;
+  pp.hDeviceWindow    = GetDesktopWindow ();
+
+  return SUCCEEDED ( bench.d3d->CreateDevice ( D3DADAPTER_DEFAULT, D3DDEVTYPE_NULLREF,
+                                                 pp.hDeviceWindow,
+                                                   D3DCREATE_SOFTWARE_VERTEXPROCESSING,
+                                                     &pp, &bench.device ) );
+}
+
+static void
+TZF_CloseD3DXBench (tzf_d3dx_bench_s& bench)
+{
+  if (bench.device != nullptr) bench.device->Release ();
+  if (bench.d3d    != nullptr) bench.d3d->Release    ();
+  if (bench.d3dx   != nullptr) FreeLibrary (bench.d3dx);
+  if (bench.d3d9   != nullptr) FreeLibrary (bench.d3d9);
+}
+
+// Milliseconds per chain, or a negative number if D3DX could not do it
+static double
+TZF_TimeD3DXMips ( tzf_d3dx_bench_s& bench,
+                   const uint8_t*    top,
+                   uint32_t          w,
+                   uint32_t          h,
+                   DWORD             filter,
+                   int               passes )
+{
+  IDirect3DTexture9* pTex = nullptr;
+
+  if ( FAILED ( bench.device->CreateTexture ( w, h, 0, 0, D3DFMT_A8R8G8B8,
+                                                D3DPOOL_SCRATCH, &pTex, nullptr ) ) )
+    return -1.0;
+
+  D3DLOCKED_RECT rect;
+
+  if (FAILED (pTex->LockRect (0, &rect, nullptr, 0)))
+  {
+    pTex->Release ();
+    return -1.0;
+  }
+
+  for (uint32_t y = 0; y < h; y++)
+    memcpy ((uint8_t *)rect.pBits + (size_t)y * rect.Pitch, top + (size_t)y * w * 4, w * 4);
+
+  pTex->UnlockRect (0);
+
+  HRESULT hr    = S_OK;
+  auto    start = std::chrono::steady_clock::now ();
+
+  for (int pass = 0; pass < passes && SUCCEEDED (hr); pass++)
+    hr = bench.filter (pTex, nullptr, 0, filter);
+
+  double ms =
+    std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  pTex->Release ();
+
+  return SUCCEEDED (hr) ? ms / passes : -1.0;
+}
+
+bool
+TZF_RunMipBenchmark (int passes)
+{
+  static const uint32_t sizes [][2] = {
+    {  256,  256 }, {  512,  512 }, { 1024, 1024 }, { 2048, 1024 }, { 2048, 2048 }
+  };
+
+  static const struct {
+    const wchar_t*   name;
+    tzf_mip_filter_t filter;
+    bool             srgb;
+    DWORD            d3dx;
+  } filters [] = {
+    { L"Box",           TZF_MIP_FILTER_BOX,      false, TZF_D3DX_FILTER_BOX                            },
+    { L"Triangle",      TZF_MIP_FILTER_TRIANGLE, false, TZF_D3DX_FILTER_TRIANGLE                       },
+    { L"Box, sRGB",     TZF_MIP_FILTER_BOX,      true,  TZF_D3DX_FILTER_BOX      | TZF_D3DX_FILTER_SRGB },
+    { L"Triangle, sRGB",TZF_MIP_FILTER_TRIANGLE, true,  TZF_D3DX_FILTER_TRIANGLE | TZF_D3DX_FILTER_SRGB }
+  };
+
+  tzf_d3dx_bench_s d3dx;
+
+  bool have_d3dx =
+    TZF_OpenD3DXBench (d3dx);
+
+  if (! have_d3dx)
+    fwprintf (stderr, L"D3DX or a NULLREF device is not available; mipgen only\n");
+
+  wprintf ( L"     Size  Filter             mipgen ms     D3DX ms   Speedup\n" );
+
+  uint32_t seed = 0x9E3779B9;
+
+  for (const auto& size : sizes)
+  {
+    const uint32_t w      = size [0];
+    const uint32_t h      = size [1];
+    const uint32_t levels = TZF_GetMipLevelCount (w, h);
+
+    std::vector <uint8_t> chain (TZF_GetMipChainSize (w, h, levels));
+
+    TZF_MakeBenchImage (w, h, seed, chain.data ());
+
+    for (const auto& filter : filters)
+    {
+      auto start = std::chrono::steady_clock::now ();
+
+      for (int pass = 0; pass < passes; pass++)
+        TZF_GenerateMipChain (chain.data (), w, h, levels, filter.filter, filter.srgb);
+
+      double ours =
+        std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count () / passes;
+
+      double theirs = have_d3dx ?
+        TZF_TimeD3DXMips (d3dx, chain.data (), w, h, filter.d3dx, passes) : -1.0;
+
+      if (theirs > 0.0)
+        wprintf ( L"  %4lux%-4lu %-16s %11.3f %11.3f %8.2fx\n",
+                    w, h, filter.name, ours, theirs, theirs / ours );
+      else
+        wprintf ( L"  %4lux%-4lu %-16s %11.3f         n/a       n/a\n",
+                    w, h, filter.name, ours );
+    }
+  }
+
+  TZF_CloseD3DXBench (d3dx);
+
+  return true;
+}
+
+// Over RGB, plus alpha if alpha is set; 99 dB for identical images
+static double
+TZF_GetPSNR (const uint8_t* a, const uint8_t* b, size_t pixels, bool alpha)
+{
+  double sum   = 0.0;
+  size_t count = 0;
+
+  for (size_t i = 0; i < pixels * 4; i++)
+  {
+    if ((i & 3) == 3 && (! alpha))
+      continue;
+
+    double d = (double)a [i] - (double)b [i];
+
+    sum += d * d;
+    count++;
+  }
+
+  return sum == 0.0 ? 99.0 : 10.0 * log10 (255.0 * 255.0 / (sum / count));
+}
+
+// Milliseconds per image and the blocks D3DX wrote, or a negative number
+static double
+TZF_TimeD3DXCompress ( tzf_d3dx_bench_s&      bench,
+                       const uint8_t*         pixels,
+                       uint32_t               w,
+                       uint32_t               h,
+                       tzf_bc_format_t        fmt,
+                       int                    passes,
+                       std::vector <uint8_t>& blocks )
+{
+  IDirect3DTexture9* pTex  = nullptr;
+  IDirect3DSurface9* pSurf = nullptr;
+
+  D3DFORMAT d3d_fmt = fmt == TZF_BC_FORMAT_BC1 ? D3DFMT_DXT1 : D3DFMT_DXT5;
+
+  if ( FAILED ( bench.device->CreateTexture ( w, h, 1, 0, d3d_fmt,
+                                                D3DPOOL_SCRATCH, &pTex, nullptr ) ) )
+    return -1.0;
+
+  if (FAILED (pTex->GetSurfaceLevel (0, &pSurf)))
+  {
+    pTex->Release ();
+    return -1.0;
+  }
+
+  RECT    src   = { 0, 0, (LONG)w, (LONG)h };
+  HRESULT hr    = S_OK;
+  auto    start = std::chrono::steady_clock::now ();
+
+  for (int pass = 0; pass < passes && SUCCEEDED (hr); pass++)
+  {
+    hr = bench.load_surface ( pSurf, nullptr, nullptr,
+                                pixels, D3DFMT_A8R8G8B8, w * 4, nullptr, &src,
+                                  TZF_D3DX_FILTER_NONE, 0 );
+  }
+
+  double ms =
+    std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  pSurf->Release ();
+
+  D3DLOCKED_RECT rect;
+
+  if (SUCCEEDED (hr) && SUCCEEDED (hr = pTex->LockRect (0, &rect, nullptr, D3DLOCK_READONLY)))
+  {
+    const size_t row_bytes = TZF_GetBCLevelSize (fmt, w, 4);
+    const size_t rows      = (h + 3) / 4;
+
+    blocks.resize (row_bytes * rows);
+
+    for (size_t y = 0; y < rows; y++)
+      memcpy (blocks.data () + y * row_bytes, (uint8_t *)rect.pBits + y * rect.Pitch, row_bytes);
+
+    pTex->UnlockRect (0);
+  }
+
+  pTex->Release ();
+
+  return SUCCEEDED (hr) ? ms / passes : -1.0;
+}
+
+bool
+TZF_RunBCBenchmark (int passes)
+{
+  static const uint32_t sizes [] = { 256, 512, 1024, 2048 };
+
+  tzf_d3dx_bench_s d3dx;
+
+  bool have_d3dx =
+    TZF_OpenD3DXBench (d3dx);
+
+  if (! have_d3dx)
+    fwprintf (stderr, L"D3DX or a NULLREF device is not available; no D3DX rows\n");
+
+  wprintf ( L"     Size  Format  Encoder   Encode MPix/s  Decode MPix/s   PSNR dB  vs D3DX dB\n" );
+
+  uint32_t seed = 0x9E3779B9;
+
+  for (uint32_t size : sizes)
+  {
+    const size_t pixels = (size_t)size * size;
+    const double mpix   = (double)pixels / 1e6;
+
+    std::vector <uint8_t> image   (pixels * 4);
+    std::vector <uint8_t> decoded (pixels * 4);
+    std::vector <uint8_t> theirs  (pixels * 4);
+
+    TZF_MakeBenchImage (size, size, seed, image.data ());
+
+    for (tzf_bc_format_t fmt : { TZF_BC_FORMAT_BC1, TZF_BC_FORMAT_BC3 })
+    {
+      const bool     alpha = fmt == TZF_BC_FORMAT_BC3;
+      const wchar_t* name  = alpha ? L"BC3" : L"BC1";
+
+      std::vector <uint8_t> blocks (TZF_GetBCLevelSize (fmt, size, size));
+      std::vector <uint8_t> d3dx_blocks;
+
+      double d3dx_ms = have_d3dx ?
+        TZF_TimeD3DXCompress (d3dx, image.data (), size, size, fmt, passes, d3dx_blocks) : -1.0;
+
+      if (d3dx_ms > 0.0)
+      {
+        TZF_DecodeBCImage (fmt, d3dx_blocks.data (), size, size, theirs.data ());
+
+        wprintf ( L"  %4lux%-4lu %-6s  D3DX      %13.2f  %13s  %8.2f\n",
+                    size, size, name, mpix / (d3dx_ms / 1000.0), L"",
+                      TZF_GetPSNR (image.data (), theirs.data (), pixels, alpha) );
+      }
+
+      for (int quality = TZF_BC_QUALITY_FAST; quality <= TZF_BC_QUALITY_HIGH; quality++)
+      {
+        auto start = std::chrono::steady_clock::now ();
+
+        for (int pass = 0; pass < passes; pass++)
+          TZF_EncodeBCImage (fmt, image.data (), size, size, blocks.data (), quality);
+
+        double encode_secs =
+          std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count () / passes;
+
+        start = std::chrono::steady_clock::now ();
+
+        for (int pass = 0; pass < passes; pass++)
+          TZF_DecodeBCImage (fmt, blocks.data (), size, size, decoded.data ());
+
+        double decode_secs =
+          std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count () / passes;
+
+        double psnr = TZF_GetPSNR (image.data (), decoded.data (), pixels, alpha);
+
+        if (d3dx_ms > 0.0)
+          wprintf ( L"  %4lux%-4lu %-6s  Quality %d %13.2f  %13.2f  %8.2f  %10.2f\n",
+                      size, size, name, quality,
+                        mpix / encode_secs, mpix / decode_secs, psnr,
+                          TZF_GetPSNR (theirs.data (), decoded.data (), pixels, alpha) );
+        else
+          wprintf ( L"  %4lux%-4lu %-6s  Quality %d %13.2f  %13.2f  %8.2f         n/a\n",
+                      size, size, name, quality,
+                        mpix / encode_secs, mpix / decode_secs, psnr );
+      }
+    }
+  }
+
+  TZF_CloseD3DXBench (d3dx);
+
+  return true;
+}
+
+// The walk TextureManager::Init made on the render thread
+static void
+TZF_WalkDumpTree (const std::wstring& root, std::unordered_set <uint32_t>& checksums)
+{
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileW ((root + L"\\*").c_str (), &fd);
+
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+
+  do
+  {
+    WIN32_FIND_DATAW fd_sub;
+    HANDLE           hSubFind =
+      FindFirstFileW ((root + L"\\" + fd.cFileName + L"\\*").c_str (), &fd_sub);
+
+    if (hSubFind == INVALID_HANDLE_VALUE)
+      continue;
+
+    do
+    {
+      if (wcsstr (_wcslwr (fd_sub.cFileName), L".dds"))
+      {
+        uint32_t checksum;
+        swscanf (fd_sub.cFileName, L"%08x.dds", &checksum);
+
+        checksums.insert (checksum);
+      }
+    } while (FindNextFileW (hSubFind, &fd_sub));
+
+    FindClose (hSubFind);
+  } while (FindNextFileW (hFind, &fd));
+
+  FindClose (hFind);
+}
+
+static bool
+TZF_TouchFile (const std::wstring& path)
+{
+  HANDLE hFile =
+    CreateFileW ( path.c_str (),
+                    GENERIC_WRITE,
+                      0x00,
+                        nullptr,
+                          OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+  {
+    fwprintf (stderr, L"Cannot create %s\n", path.c_str ());
+    return false;
+  }
+
+  CloseHandle (hFile);
+
+  return true;
+}
+
+bool
+TZF_RunDumpIndexBenchmark ( const wchar_t* wszDir,
+                            int            files )
+{
+  // What SK_D3D9_FormatToStr (...) names the directories the game dumps to;
+  //   twice for DXT1 and DXT5, which hold most of a real dump
+  static const wchar_t* formats [] = {
+    L"DXT1", L"DXT5", L"DXT1", L"DXT5", L"DXT3", L"A8R8G8B8", L"X8R8G8B8", L"A8"
+  };
+
+  std::wstring dir      (wszDir);
+  std::wstring tree     (dir + L"\\textures");
+  std::wstring manifest (dir + L"\\textures.idx");
+
+  wprintf (L"Creating %d empty dump files under %s...\n", files, tree.c_str ());
+
+  CreateDirectoryW (dir.c_str  (), nullptr);
+  CreateDirectoryW (tree.c_str (), nullptr);
+
+  for (const wchar_t* format : formats)
+    CreateDirectoryW ((tree + L"\\" + format).c_str (), nullptr);
+
+  for (int i = 0; i < files; i++)
+  {
+    wchar_t wszFile [MAX_PATH];
+
+    _swprintf ( wszFile, L"%s\\%s\\%08x.dds",
+                  tree.c_str (),
+                    formats [i % 8],
+                      0x9E3779B1U * (uint32_t)i );
+
+    if (! TZF_TouchFile (wszFile))
+      return false;
+  }
+
+  DeleteFileW (manifest.c_str ());
+
+  // Directories written to in the last few seconds are never trusted
+  wprintf (L"Waiting for directory times to settle...\n");
+  Sleep   (5000UL);
+
+  std::unordered_set <uint32_t> walked;
+
+  auto start = std::chrono::steady_clock::now ();
+
+  TZF_WalkDumpTree (tree, walked);
+
+  double walk_ms =
+    std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  wprintf ( L"\n  %-36s %10s %10s %10s\n"
+            L"  %-36s %10.2f %10zu %10zu\n",
+              L"", L"ms", L"Listed", L"Textures",
+                L"Listing everything (blocked Init)", walk_ms, walked.size (), walked.size () );
+
+  bool ok = true;
+
+  auto run = [&](const wchar_t* wszWhat, size_t expected) {
+    std::unordered_set <uint32_t> found;
+    tzf_dump_scan_stats_s         stats;
+
+    TZF_ScanDumpTree (tree.c_str (), manifest.c_str (), found, &stats);
+
+    wprintf ( L"  %-36s %10.2f %10llu %10zu\n",
+                wszWhat, stats.scan_ms, stats.listed, found.size () );
+
+    if (found.size () != expected)
+    {
+      fwprintf (stderr, L"  Scan found %zu textures, expected %zu\n", found.size (), expected);
+      ok = false;
+    }
+  };
+
+  run (L"Scan, no manifest",            walked.size ());
+  run (L"Scan, manifest up to date",    walked.size ());
+
+  wchar_t wszExtra [MAX_PATH];
+
+  _swprintf ( wszExtra, L"%s\\DXT5\\%08x.dds",
+                tree.c_str (), 0x2545F491U );
+
+  if ((! walked.count (0x2545F491U)) && TZF_TouchFile (wszExtra))
+    run (L"Scan, one texture dumped since", walked.size () + 1);
+
+  DeleteFileW (wszExtra);
+
+  wprintf (L"\n  Only the first row held up the game; the scans run in the background.\n");
+
+  return ok;
+}
+
+// Stands in for tzf_tex_record_s; fileno and size are derived from the key
+//   so a lookup that returned a torn or freed record shows up
+struct tzf_bench_record_s {
+  unsigned int archive = 0;
+           int fileno  = 0;
+           int method  = 0;
+        size_t size    = 0;
+        size_t buffer  = 0;
+};
+
+// Same layout textures.cpp packs tzf_tex_record_s into
+struct tzf_bench_packed_s {
+  uint32_t size;
+  uint32_t buffer;
+  uint32_t fileno  : 22;
+  uint32_t archive :  8;
+  uint32_t method  :  2;
+};
+
+template <>
+struct tzf_index_packing_s <tzf_bench_record_s> {
+  typedef tzf_bench_packed_s packed_t;
+
+  static bool pack (const tzf_bench_record_s& record, packed_t* packed)
+  {
+    if ( (uint64_t)record.size   > UINT32_MAX ||
+         (uint64_t)record.buffer > UINT32_MAX ||
+         record.fileno < 0                    ||
+         record.fileno >= (1 << 22)           ||
+         record.archive >= 0xFF )
+      return false;
+
+    packed->size    = (uint32_t)record.size;
+    packed->buffer  = (uint32_t)record.buffer;
+    packed->fileno  = (uint32_t)record.fileno;
+    packed->archive = record.archive;
+    packed->method  = (uint32_t)record.method;
+
+    return true;
+  }
+
+  static tzf_bench_record_s unpack (const packed_t& packed)
+  {
+    tzf_bench_record_s record;
+
+    record.size    = packed.size;
+    record.buffer  = packed.buffer;
+    record.fileno  = (int)packed.fileno;
+    record.archive = packed.archive;
+    record.method  = (int)packed.method;
+
+    return record;
+  }
+};
+
+static bool
+TZF_IsBenchRecordFor (uint32_t key, const tzf_bench_record_s& record)
+{
+  return (uint32_t)record.fileno == (key & 0x3FFFFF) &&
+                   record.size   == 4096 + (key >> 10);
+}
+
+// Counts what the map asks the heap for; each block also costs the heap a
+//   header, which is not in here
+static size_t bench_map_bytes  = 0;
+static size_t bench_map_blocks = 0;
+
+template <typename _T>
+struct tzf_counting_alloc_s {
+  typedef _T value_type;
+
+  tzf_counting_alloc_s (void) { }
+
+  template <typename _U>
+  tzf_counting_alloc_s (const tzf_counting_alloc_s <_U>&) { }
+
+  _T* allocate (size_t n)
+  {
+    bench_map_bytes  += n * sizeof (_T);
+    bench_map_blocks += 1;
+
+    return (_T *)::operator new (n * sizeof (_T));
+  }
+
+  void deallocate (_T* p, size_t n)
+  {
+    bench_map_bytes  -= n * sizeof (_T);
+    bench_map_blocks -= 1;
+
+    ::operator delete (p);
+  }
+
+  template <typename _U>
+  bool operator== (const tzf_counting_alloc_s <_U>&) const { return true;  }
+
+  template <typename _U>
+  bool operator!= (const tzf_counting_alloc_s <_U>&) const { return false; }
+};
+
+typedef std::unordered_map < uint32_t, tzf_bench_record_s,
+                             std::hash     <uint32_t>,
+                             std::equal_to <uint32_t>,
+                             tzf_counting_alloc_s < std::pair < const uint32_t,
+                                                                tzf_bench_record_s > > >
+        tzf_bench_map_t;
+
+// What injectable_textures was, with the lock it never had
+class TZF_LockedIndex
+{
+public:
+  template <typename _Items>
+  void assign (const _Items& items)
+  {
+    std::lock_guard <std::mutex> lock (lock_);
+
+    map_.clear ();
+    map_.insert (items.begin (), items.end ());
+  }
+
+  void insert_or_assign (uint32_t key, const tzf_bench_record_s& value)
+  {
+    std::lock_guard <std::mutex> lock (lock_);
+
+    map_ [key] = value;
+  }
+
+  bool erase (uint32_t key)
+  {
+    std::lock_guard <std::mutex> lock (lock_);
+
+    return map_.erase (key) != 0;
+  }
+
+  bool find (uint32_t key, tzf_bench_record_s* out) const
+  {
+    std::lock_guard <std::mutex> lock (lock_);
+
+    auto it = map_.find (key);
+
+    if (it == map_.end ())
+      return false;
+
+    *out = it->second;
+
+    return true;
+  }
+
+private:
+  tzf_bench_map_t    map_;
+  mutable std::mutex lock_;
+};
+
+struct tzf_index_bench_result_s {
+  uint64_t lookups      = 0ULL;
+  uint64_t hits         = 0ULL;
+  uint64_t bad          = 0ULL;
+  uint32_t republished  = 0UL;
+  double   seconds      = 0.0;
+};
+
+// One thread over queries made up front, so only the lookup is timed
+template <typename _Find>
+static double
+TZF_TimeLookups ( const std::vector <uint32_t>& queries,
+                  _Find                         find,
+                  tzf_index_bench_result_s*     result )
+{
+  const int passes = 4;
+
+  auto start = std::chrono::steady_clock::now ();
+
+  for (int pass = 0; pass < passes; pass++)
+  {
+    for (uint32_t key : queries)
+    {
+      tzf_bench_record_s rec;
+
+      if (find (key, &rec))
+      {
+        ++result->hits;
+
+        if (! TZF_IsBenchRecordFor (key, rec))
+          ++result->bad;
+      }
+    }
+  }
+
+  result->lookups += (uint64_t)passes * queries.size ();
+
+  return
+    std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now () - start).count () /
+      ((double)passes * queries.size ());
+}
+
+// readers threads look up random keys, half of them present, while one
+//   writer (if refresh) republishes the table the way a data source
+//     refresh, a failed stream and the gamepad texture would
+template <typename _Index>
+static tzf_index_bench_result_s
+TZF_TimeIndex ( _Index&                                                          index,
+                const std::vector <std::pair <uint32_t, tzf_bench_record_s> >&   items,
+                int                                                              readers,
+                int                                                              seconds,
+                bool                                                             refresh )
+{
+  tzf_index_bench_result_s result;
+
+  index.assign (items);
+
+  std::atomic <bool>     stop    (false);
+  std::atomic <uint64_t> lookups (0ULL);
+  std::atomic <uint64_t> hits    (0ULL);
+  std::atomic <uint64_t> bad     (0ULL);
+
+  auto reader = [&](int id) {
+    std::mt19937 rng ((uint32_t)id * 2654435761U);
+
+    uint64_t looked = 0ULL,
+             found  = 0ULL,
+             wrong  = 0ULL;
+
+    while (! stop.load (std::memory_order_relaxed))
+    {
+      // Lookups come in bursts of 256 between checks of stop
+      for (int i = 0; i < 256; i++)
+      {
+        uint32_t           key = items [rng () % items.size ()].first ^ (rng () & 1);
+        tzf_bench_record_s rec;
+
+        if (index.find (key, &rec))
+        {
+          ++found;
+
+          if (! TZF_IsBenchRecordFor (key, rec))
+            ++wrong;
+        }
+      }
+
+      looked += 256;
+    }
+
+    lookups += looked;
+    hits    += found;
+    bad     += wrong;
+  };
+
+  auto start = std::chrono::steady_clock::now ();
+  auto end   = start + std::chrono::seconds (seconds);
+
+  std::vector <std::thread> pool;
+
+  for (int i = 0; i < readers; i++)
+    pool.emplace_back (reader, i);
+
+  while (std::chrono::steady_clock::now () < end)
+  {
+    if (! refresh)
+    {
+      std::this_thread::sleep_for (std::chrono::milliseconds (10));
+      continue;
+    }
+
+    const auto& item = items [result.republished % items.size ()];
+
+    index.assign           (items);
+    index.erase            (item.first);
+    index.insert_or_assign (item.first, item.second);
+
+    result.republished += 3;
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  }
+
+  stop = true;
+
+  for (auto& thread : pool)
+    thread.join ();
+
+  result.seconds =
+    std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count ();
+  result.lookups = lookups;
+  result.hits    = hits;
+  result.bad     = bad;
+
+  return result;
+}
+
+bool
+TZF_RunIndexBenchmark ( int textures,
+                        int readers,
+                        int seconds )
+{
+  std::vector <std::pair <uint32_t, tzf_bench_record_s> > items;
+
+  // Even keys, so key ^ 1 is always a miss
+  for (int i = 0; i < textures; i++)
+  {
+    tzf_bench_record_s rec;
+    uint32_t           key = (0x9E3779B1U * (uint32_t)i) & ~1U;
+
+    rec.archive = (unsigned int)i % 24;
+    rec.fileno  = (int)(key & 0x3FFFFF);
+    rec.size    = 4096 + (key >> 10);
+
+    items.push_back (std::make_pair (key, rec));
+  }
+
+  bool ok = true;
+
+  //
+  // Latency and memory, one thread and no writer
+  //
+  std::mt19937 rng (0x7A46U);
+
+  std::vector <uint32_t> uniform (1 << 20);
+  std::vector <uint32_t> hot     (1 << 20);
+
+  // Half misses; or nine in ten going to 256 textures, as when a scene
+  //   keeps binding the same set
+  for (size_t i = 0; i < uniform.size (); i++)
+  {
+    uniform [i] = items [rng () % items.size ()].first ^ (rng () & 1);
+    hot     [i] = (rng () % 10) ? items [rng () % std::min (items.size (), (size_t)256)].first :
+                                  items [rng () %           items.size ()            ].first ^ 1;
+  }
+
+  wprintf ( L"%d textures\n\n"
+            L"  %-36s %12s %12s %12s %12s\n",
+              textures,
+                L"", L"ns uniform", L"ns hot", L"KiB", L"Bytes each" );
+
+  tzf_index_bench_result_s single;
+
+  {
+    tzf_bench_map_t map;
+
+    map.insert (items.begin (), items.end ());
+
+    auto find = [&](uint32_t key, tzf_bench_record_s* rec) {
+      auto it = map.find (key);
+
+      if (it == map.end ())
+        return false;
+
+      *rec = it->second;
+
+      return true;
+    };
+
+    double ns_uniform = TZF_TimeLookups (uniform, find, &single);
+    double ns_hot     = TZF_TimeLookups (hot,     find, &single);
+
+    wprintf ( L"  %-36s %12.1f %12.1f %12.0f %12.1f  (%zu heap blocks)\n",
+                L"unordered_map", ns_uniform, ns_hot,
+                  (double)bench_map_bytes / 1024.0,
+                  (double)bench_map_bytes / textures, bench_map_blocks );
+  }
+
+  {
+    TZF_SnapshotIndex <tzf_bench_record_s> snapshot;
+
+    snapshot.assign (items);
+
+    auto find = [&](uint32_t key, tzf_bench_record_s* rec) {
+      return snapshot.find (key, rec);
+    };
+
+    double ns_uniform = TZF_TimeLookups (uniform, find, &single);
+    double ns_hot     = TZF_TimeLookups (hot,     find, &single);
+
+    wprintf ( L"  %-36s %12.1f %12.1f %12.0f %12.1f\n",
+                L"Snapshot index", ns_uniform, ns_hot,
+                  (double)snapshot.memory () / 1024.0,
+                  (double)snapshot.memory () / textures );
+  }
+
+  if (single.bad != 0)
+    ok = false;
+
+  //
+  // Throughput with readers threads, with and without a writer
+  //
+  wprintf ( L"\n%d reader threads, %d s per row\n\n"
+            L"  %-36s %12s %12s %10s %8s\n",
+              readers, seconds,
+                L"", L"Lookups/s", L"ns/lookup", L"Publishes", L"Bad" );
+
+  auto report = [&](const wchar_t* wszWhat, const tzf_index_bench_result_s& result) {
+    double rate = (double)result.lookups / std::max (result.seconds, 1e-9);
+
+    wprintf ( L"  %-36s %12.0f %12.1f %10lu %8llu\n",
+                wszWhat, rate, 1e9 * readers / std::max (rate, 1.0),
+                  result.republished, result.bad );
+
+    // About half the keys asked for exist
+    if (result.bad != 0 || result.hits == 0 || result.hits == result.lookups)
+      ok = false;
+  };
+
+  {
+    TZF_LockedIndex locked;
+
+    report (L"Locked map, no writer",    TZF_TimeIndex (locked, items, readers, seconds, false));
+    report (L"Locked map, republishing", TZF_TimeIndex (locked, items, readers, seconds, true));
+  }
+
+  {
+    TZF_SnapshotIndex <tzf_bench_record_s> snapshot;
+
+    report (L"Snapshot, no writer",      TZF_TimeIndex (snapshot, items, readers, seconds, false));
+    report (L"Snapshot, republishing",   TZF_TimeIndex (snapshot, items, readers, seconds, true));
+  }
+
+  if (! ok)
+    fwprintf (stderr, L"\n  A lookup returned the wrong record\n");
+
+  return ok;
+}
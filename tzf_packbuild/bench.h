@@ -0,0 +1,89 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__BENCH_H__
+#define __TZF__BENCH_H__
+
+//
+// Writes a synthetic dump tree of DXT1 / DXT5 textures under wszDir, then
+//   runs the build pipeline over it with 1, 2, 4, ... max_threads threads
+//     and prints throughput for each.
+//
+bool
+TZF_RunBuildBenchmark ( const wchar_t*   wszDir,
+                        int              textures,
+                        int              max_threads,
+                        int              level );
+
+//
+// Times the native DDS header parser over every file under wszDir (or a
+//   set of synthetic textures if wszDir is nullptr), then feeds it
+//     mutations truncated and corrupted copies of each header.  Fails if
+//       any of those is accepted with a description that cannot be right.
+//
+bool
+TZF_RunDDSBenchmark   ( const wchar_t*   wszDir,
+                        int              passes,
+                        int              mutations );
+
+//
+// Builds full mip chains for A8R8G8B8 images of the sizes the remaster
+//   resample sees, with each filter mipgen.cpp has, and with D3DX doing
+//     the same on a NULLREF device (no window, no GPU) when d3dx9_43.dll
+//       can be loaded.
+//
+bool
+TZF_RunMipBenchmark   ( int              passes );
+
+//
+// BC1 / BC3 encode and decode throughput at every encoder quality, and
+//   PSNR against the source image and against what D3DX compresses the
+//     same image to (NULLREF device, when d3dx9_43.dll can be loaded).
+//
+bool
+TZF_RunBCBenchmark    ( int              passes );
+
+//
+// Creates files empty <checksum>.dds files across the format directories a
+//   dump has, then times what TextureManager::Init used to do before the
+//     game could go on (list every one of them) against the background
+//       scan: with no manifest, with an up to date one, and with one
+//         directory changed since it was written.
+//
+bool
+TZF_RunDumpIndexBenchmark ( const wchar_t* wszDir,
+                            int            files );
+
+//
+// The injectable texture table, textures entries of it: single-threaded
+//   lookup latency (uniform and hot-set) and heap held by the compact
+//     snapshot index against the unordered_map it replaced, then lookups
+//       per second from readers threads at once, with and without a writer
+//         republishing it every millisecond.  Fails if any lookup returns
+//           a record that does not belong to its key.
+//
+bool
+TZF_RunIndexBenchmark ( int            textures,
+                        int            readers,
+                        int            seconds );
+
+#endif /* __TZF__BENCH_H__ */
@@ -0,0 +1,544 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// tzf_packbuild: offline tool that turns texture mods into .tzp packs
+//
+//   Drop the output into TZFix\Textures\inject\ next to (or instead of)
+//     the .7z it was made from.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "pack_writer.h"
+#include "sources.h"
+#include "repack.h"
+#include "bench.h"
+
+#include "lzma/7zCrc.h"
+
+static void
+TZF_PrintUsage (void)
+{
+  fwprintf ( stderr,
+    L"Usage: tzf_packbuild convert <in.7z> <out.tzp> [options]\n"
+    L"       tzf_packbuild repack  <trace.txt> <out.tzp> <in.7z|in.tzp>... [options]\n"
+    L"       tzf_packbuild build   <dump or inject dir> <out.tzp> [options]\n"
+    L"       tzf_packbuild bench   [--textures N] [--dir <dir>] [options]\n"
+    L"       tzf_packbuild ddsbench [<dir>] [--passes N] [--mutations N]\n"
+    L"       tzf_packbuild mipbench [--passes N]\n"
+    L"       tzf_packbuild bcbench  [--passes N]\n"
+    L"       tzf_packbuild dumpbench [--files N] [--dir <dir>]\n"
+    L"       tzf_packbuild indexbench [--textures N] [--readers N] [--seconds N]\n"
+    L"\n"
+    L"  --codec <stored|fast|lzma|auto>  Per-texture codec (default: auto)\n"
+    L"  --level <0-9>                    LZMA level (default: 7)\n"
+    L"  --crc                            Store a whole-pack CRC32\n"
+    L"\n"
+    L"repack, build:\n"
+    L"  --block-mib <N>                  Largest solid block (default: 4)\n"
+    L"  --threads <N>                    Encoder threads (default: 1 for repack,\n"
+    L"                                   one per core for build and bench)\n" );
+}
+
+static int
+TZF_ParseCodec (const wchar_t* wszCodec)
+{
+  if (! _wcsicmp (wszCodec, L"stored")) return TZF_PACK_CODEC_STORED;
+  if (! _wcsicmp (wszCodec, L"fast"))   return TZF_PACK_CODEC_FAST;
+  if (! _wcsicmp (wszCodec, L"lzma"))   return TZF_PACK_CODEC_LZMA;
+  if (! _wcsicmp (wszCodec, L"auto"))   return TZF_PACK_CODEC_AUTO;
+
+  return -1;
+}
+
+static void
+TZF_PrintStats (const wchar_t* wszPack, size_t textures, const tzf_pack_stats_s& stats)
+{
+  wprintf ( L"%s: %zu textures, %.2f MiB -> %.2f MiB (%.1f%%)\n",
+              wszPack, textures,
+                (double)stats.unpacked / (1024.0 * 1024.0),
+                (double)stats.packed   / (1024.0 * 1024.0),
+                  stats.unpacked ? 100.0 * (double)stats.packed /
+                                           (double)stats.unpacked : 0.0 );
+
+  for (int codec = 0; codec < 4; codec++)
+  {
+    if (stats.blocks_by_codec [codec] > 0)
+      wprintf ( L"  %-6hs %lu blocks\n",
+                  TZF_GetCodecName (codec),
+                    stats.blocks_by_codec [codec] );
+  }
+}
+
+static int
+TZF_Convert (int argc, wchar_t** argv)
+{
+  if (argc < 2)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  const wchar_t* wszIn  = argv [0];
+  const wchar_t* wszOut = argv [1];
+
+  tzf_pack_options_s opts;
+  int                codec = TZF_PACK_CODEC_AUTO;
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--crc"))
+      opts.crc = true;
+
+    else if (! wcscmp (argv [i], L"--codec") && i + 1 < argc)
+      codec = TZF_ParseCodec (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--level") && i + 1 < argc)
+      opts.level = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (codec < 0 || opts.level < 0 || opts.level > 9)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  std::vector <tzf_pack_input_s> inputs;
+
+  if (! TZF_ReadArchiveInputs (wszIn, inputs))
+    return 2;
+
+  TZF_DedupInputs (inputs);
+
+  tzf_pack_stats_s stats;
+
+  if (! TZF_WritePack (wszOut, inputs, TZF_PlanRandomAccess (inputs, codec), opts, &stats))
+    return 3;
+
+  TZF_PrintStats (wszOut, inputs.size (), stats);
+
+  return 0;
+}
+
+//
+// Lays textures out by the order a recorded session loaded them in (see
+//   RecordAccessTrace in tzfix.ini).  Earlier inputs win on duplicates.
+//
+static int
+TZF_Repack (int argc, wchar_t** argv)
+{
+  if (argc < 3)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  const wchar_t* wszTrace = argv [0];
+  const wchar_t* wszOut   = argv [1];
+
+  std::vector <const wchar_t *> sources;
+
+  tzf_pack_options_s opts;
+  int                block_mib = 4;
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--crc"))
+      opts.crc = true;
+
+    else if (! wcscmp (argv [i], L"--level") && i + 1 < argc)
+      opts.level = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--threads") && i + 1 < argc)
+      opts.threads = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--block-mib") && i + 1 < argc)
+      block_mib = _wtoi (argv [++i]);
+
+    else if (argv [i][0] == L'-')
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+
+    else
+      sources.push_back (argv [i]);
+  }
+
+  if ( sources.empty () || block_mib < 1 || opts.threads < 1 ||
+       opts.level < 0   || opts.level > 9 )
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  std::vector <tzf_trace_scene_s> scenes;
+
+  if (! TZF_LoadAccessTrace (wszTrace, scenes))
+    return 2;
+
+  std::vector <tzf_pack_input_s> inputs;
+
+  for (uint32_t i = 0; i < (uint32_t)sources.size (); i++)
+  {
+    if (! TZF_ReadInputs (sources [i], i, inputs))
+      return 2;
+  }
+
+  TZF_DedupInputs (inputs);
+
+  auto plan =
+    TZF_PlanByAccess (inputs, scenes, (size_t)block_mib << 20);
+
+  tzf_pack_stats_s stats;
+
+  if (! TZF_WritePack (wszOut, inputs, plan, opts, &stats))
+    return 3;
+
+  TZF_PrintStats (wszOut, inputs.size (), stats);
+
+  return TZF_ReportSceneCosts (wszOut, inputs, scenes, plan) ? 0 : 3;
+}
+
+static int
+TZF_DefaultThreads (void)
+{
+  return std::max (1, (int)std::thread::hardware_concurrency ());
+}
+
+//
+// Packs a whole dump or inject tree: identical payloads are stored once, and
+//   textures of the same format and similar size share solid blocks.  Writes
+//     the index sidecar (.tzi) next to the pack.
+//
+static int
+TZF_Build (int argc, wchar_t** argv)
+{
+  if (argc < 2)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  const wchar_t* wszDir = argv [0];
+  const wchar_t* wszOut = argv [1];
+
+  tzf_pack_options_s opts;
+  int                block_mib = 4;
+
+  opts.threads = TZF_DefaultThreads ();
+  opts.sidecar = true;
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--crc"))
+      opts.crc = true;
+
+    else if (! wcscmp (argv [i], L"--level") && i + 1 < argc)
+      opts.level = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--threads") && i + 1 < argc)
+      opts.threads = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--block-mib") && i + 1 < argc)
+      block_mib = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if ( block_mib < 1 || opts.threads < 1 ||
+       opts.level < 0 || opts.level > 9 )
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  std::vector <tzf_pack_input_s> inputs;
+
+  if (! TZF_ReadTreeInputs (wszDir, opts.threads, inputs))
+    return 2;
+
+  TZF_DedupInputs           (inputs);
+  TZF_LinkIdenticalPayloads (inputs);
+
+  tzf_pack_stats_s stats;
+
+  if (! TZF_WritePack (wszOut, inputs, TZF_PlanBySimilarity (inputs, (size_t)block_mib << 20), opts, &stats))
+    return 3;
+
+  TZF_PrintStats (wszOut, inputs.size (), stats);
+
+  return 0;
+}
+
+static int
+TZF_Bench (int argc, wchar_t** argv)
+{
+  const wchar_t* wszDir   = L"tzf_bench";
+  int            textures = 10000;
+  int            threads  = TZF_DefaultThreads ();
+  int            level    = 7;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--textures") && i + 1 < argc)
+      textures = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--dir") && i + 1 < argc)
+      wszDir = argv [++i];
+
+    else if (! wcscmp (argv [i], L"--threads") && i + 1 < argc)
+      threads = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--level") && i + 1 < argc)
+      level = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (textures < 1 || threads < 1 || level < 0 || level > 9)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunBuildBenchmark (wszDir, textures, threads, level) ? 0 : 3;
+}
+
+// The DDS header parser the DLL uses in place of D3DX
+static int
+TZF_DDSBench (int argc, wchar_t** argv)
+{
+  const wchar_t* wszDir    = nullptr;
+  int            passes    = 1000;
+  int            mutations = 10000;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--passes") && i + 1 < argc)
+      passes = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--mutations") && i + 1 < argc)
+      mutations = _wtoi (argv [++i]);
+
+    else if (i == 0 && argv [i][0] != L'-')
+      wszDir = argv [i];
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (passes < 1 || mutations < 0)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunDDSBenchmark (wszDir, passes, mutations) ? 0 : 3;
+}
+
+// The remaster mip generator against D3DX
+static int
+TZF_MipBench (int argc, wchar_t** argv)
+{
+  int passes = 10;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--passes") && i + 1 < argc)
+      passes = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (passes < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunMipBenchmark (passes) ? 0 : 3;
+}
+
+// The remaster DXT1 / DXT5 codec against D3DX
+static int
+TZF_BCBench (int argc, wchar_t** argv)
+{
+  int passes = 5;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--passes") && i + 1 < argc)
+      passes = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (passes < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunBCBenchmark (passes) ? 0 : 3;
+}
+
+// Startup cost of knowing what has been dumped, with and without a manifest
+static int
+TZF_DumpBench (int argc, wchar_t** argv)
+{
+  const wchar_t* wszDir = L"tzf_dumpbench";
+  int            files  = 50000;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--files") && i + 1 < argc)
+      files = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--dir") && i + 1 < argc)
+      wszDir = argv [++i];
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (files < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunDumpIndexBenchmark (wszDir, files) ? 0 : 3;
+}
+
+// Latency, memory and lock-free lookups of the injectable texture table
+static int
+TZF_IndexBench (int argc, wchar_t** argv)
+{
+  int textures = 200000;
+  int readers  = std::max (1, (int)std::thread::hardware_concurrency () - 1);
+  int seconds  = 2;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (! wcscmp (argv [i], L"--textures") && i + 1 < argc)
+      textures = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--readers") && i + 1 < argc)
+      readers = _wtoi (argv [++i]);
+
+    else if (! wcscmp (argv [i], L"--seconds") && i + 1 < argc)
+      seconds = _wtoi (argv [++i]);
+
+    else
+    {
+      TZF_PrintUsage ();
+      return 1;
+    }
+  }
+
+  if (textures < 1 || readers < 1 || seconds < 1)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  return TZF_RunIndexBenchmark (textures, readers, seconds) ? 0 : 3;
+}
+
+int
+wmain (int argc, wchar_t** argv)
+{
+  CrcGenerateTable ();
+
+  if (argc < 2)
+  {
+    TZF_PrintUsage ();
+    return 1;
+  }
+
+  if (! wcscmp (argv [1], L"convert"))
+    return TZF_Convert (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"repack"))
+    return TZF_Repack  (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"build"))
+    return TZF_Build   (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"bench"))
+    return TZF_Bench   (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"ddsbench"))
+    return TZF_DDSBench (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"mipbench"))
+    return TZF_MipBench (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"bcbench"))
+    return TZF_BCBench  (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"dumpbench"))
+    return TZF_DumpBench (argc - 2, argv + 2);
+
+  if (! wcscmp (argv [1], L"indexbench"))
+    return TZF_IndexBench (argc - 2, argv + 2);
+
+  TZF_PrintUsage ();
+
+  return 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include "pack_reader.h"
+#include "fastcodec.h"
+
+#include "lzma/7zCrc.h"
+#include "lzma/Alloc.h"
+#include "lzma/LzmaDec.h"
+#include "lzma/Lzma2Dec.h"
+
+static bool
+TZF_ReadAt (FILE* fPack, uint64_t pos, void* out, size_t len)
+{
+  if (_fseeki64 (fPack, (int64_t)pos, SEEK_SET) != 0)
+    return false;
+
+  return len == 0 || fread (out, len, 1, fPack) == 1;
+}
+
+bool
+TZF_LoadPackFile (const wchar_t* wszPack, tzf_pack_file_s& pack)
+{
+  pack.fPack = _wfopen (wszPack, L"rb");
+
+  if (pack.fPack == nullptr)
+  {
+    fwprintf (stderr, L"Cannot open %s\n", wszPack);
+    return false;
+  }
+
+  tzf_pack_header_s& hdr = pack.header;
+
+  bool ok = TZF_ReadAt (pack.fPack, 0, &hdr, sizeof (hdr));
+
+  if (ok)
+  {
+    uint32_t header_crc = hdr.header_crc32;
+                          hdr.header_crc32 = 0;
+
+    ok = hdr.magic   == TZF_PACK_MAGIC   &&
+         hdr.version == TZF_PACK_VERSION &&
+         CrcCalc (&hdr, sizeof (hdr)) == header_crc;
+
+    hdr.header_crc32 = header_crc;
+  }
+
+  if (ok)
+  {
+    pack.entries.resize (hdr.entry_count);
+    pack.blocks.resize  (hdr.block_count);
+
+    ok = TZF_ReadAt (pack.fPack, hdr.entry_offset, pack.entries.data (), pack.entries.size () * sizeof (tzf_pack_entry_s)) &&
+         TZF_ReadAt (pack.fPack, hdr.block_offset, pack.blocks.data  (), pack.blocks.size  () * sizeof (tzf_pack_block_s));
+  }
+
+  for (size_t i = 0; ok && i < pack.entries.size (); i++)
+  {
+    const tzf_pack_entry_s& entry = pack.entries [i];
+
+    ok = entry.block < hdr.block_count &&
+           (uint64_t)entry.offset + entry.size <= pack.blocks [entry.block].unpacked_size;
+  }
+
+  if (! ok)
+  {
+    fwprintf (stderr, L"%s is not a valid texture pack\n", wszPack);
+    TZF_ClosePackFile (pack);
+  }
+
+  return ok;
+}
+
+void
+TZF_ClosePackFile (tzf_pack_file_s& pack)
+{
+  if (pack.fPack != nullptr)
+    fclose (pack.fPack);
+
+  pack.fPack = nullptr;
+
+  pack.entries.clear ();
+  pack.blocks.clear  ();
+}
+
+bool
+TZF_DecodePackFileBlock ( tzf_pack_file_s&        pack,
+                          uint32_t                block,
+                          std::vector <uint8_t>&  out )
+{
+  const tzf_pack_block_s& blk = pack.blocks [block];
+
+  std::vector <uint8_t> packed (blk.packed_size);
+
+  if (! TZF_ReadAt (pack.fPack, blk.offset, packed.data (), packed.size ()))
+    return false;
+
+  if (CrcCalc (packed.data (), packed.size ()) != blk.crc32)
+    return false;
+
+  out.resize (blk.unpacked_size);
+
+  SizeT       out_len = blk.unpacked_size;
+  SizeT       in_len  = blk.packed_size;
+  ELzmaStatus status;
+  SRes        res     = SZ_OK;
+
+  switch (blk.codec)
+  {
+    case TZF_PACK_CODEC_STORED:
+      out.swap (packed);
+      return out.size () == blk.unpacked_size;
+
+    case TZF_PACK_CODEC_FAST:
+      return TZF_FastDecompress (packed.data (), in_len, out.data (), out_len);
+
+    case TZF_PACK_CODEC_LZMA:
+      res = LzmaDecode ( out.data (), &out_len, packed.data (), &in_len,
+                           blk.props, LZMA_PROPS_SIZE,
+                             LZMA_FINISH_ANY, &status, &g_Alloc );
+      break;
+
+    case TZF_PACK_CODEC_LZMA2:
+      res = Lzma2Decode ( out.data (), &out_len, packed.data (), &in_len,
+                            blk.props [0],
+                              LZMA_FINISH_ANY, &status, &g_Alloc );
+      break;
+
+    default:
+      return false;
+  }
+
+  return res == SZ_OK && out_len == blk.unpacked_size;
+}
@@ -0,0 +1,57 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__PACK_READER_H__
+#define __TZF__PACK_READER_H__
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "pack_format.h"
+
+//
+// Plain stdio reader for packs the tool has written or is repacking; the
+//   DLL's loader (tzf_dsound/pack.cpp) maps the file instead.
+//
+struct tzf_pack_file_s {
+  FILE*                          fPack = nullptr;
+
+  tzf_pack_header_s              header;
+  std::vector <tzf_pack_entry_s> entries;
+  std::vector <tzf_pack_block_s> blocks;
+};
+
+bool
+TZF_LoadPackFile        (const wchar_t* wszPack, tzf_pack_file_s& pack);
+
+void
+TZF_ClosePackFile       (tzf_pack_file_s& pack);
+
+// Reads, checks and decodes one block in full
+bool
+TZF_DecodePackFileBlock ( tzf_pack_file_s&        pack,
+                          uint32_t                block,
+                          std::vector <uint8_t>&  out );
+
+#endif /* __TZF__PACK_READER_H__ */
@@ -0,0 +1,742 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "pack_writer.h"
+#include "fastcodec.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+
+#include "lzma/7zCrc.h"
+#include "lzma/Alloc.h"
+#include "lzma/LzmaEnc.h"
+#include "lzma/Lzma2Enc.h"
+
+const char*
+TZF_GetCodecName (int codec)
+{
+  switch (codec)
+  {
+    case TZF_PACK_CODEC_STORED: return "stored";
+    case TZF_PACK_CODEC_FAST:   return "fast";
+    case TZF_PACK_CODEC_LZMA:   return "lzma";
+    case TZF_PACK_CODEC_LZMA2:  return "lzma2";
+    case TZF_PACK_CODEC_AUTO:   return "auto";
+  }
+
+  return "unknown";
+}
+
+void
+TZF_DedupInputs (std::vector <tzf_pack_input_s>& inputs)
+{
+  std::unordered_set <uint32_t> seen;
+
+  auto dup =
+    std::remove_if ( inputs.begin (), inputs.end (),
+                       [&](const tzf_pack_input_s& in) {
+                         return ! seen.insert (in.checksum).second;
+                       } );
+
+  inputs.erase (dup, inputs.end ());
+}
+
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanRandomAccess (const std::vector <tzf_pack_input_s>& inputs, int codec)
+{
+  std::vector <tzf_pack_block_plan_s> plan;
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+  {
+    if (inputs [i].alias != UINT32_MAX)
+      continue;
+
+    plan.push_back (tzf_pack_block_plan_s ());
+
+    plan.back ().inputs.push_back (i);
+    plan.back ().codec = codec;
+  }
+
+  return plan;
+}
+
+void
+TZF_LinkIdenticalPayloads (std::vector <tzf_pack_input_s>& inputs)
+{
+  std::unordered_map <uint64_t, std::vector <uint32_t>> by_crc;
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+  {
+    tzf_pack_input_s& in = inputs [i];
+
+    if (in.data.empty ())
+      continue;
+
+    uint64_t key =
+      ((uint64_t)in.data.size () << 32) | CrcCalc (in.data.data (), in.data.size ());
+
+    std::vector <uint32_t>& same = by_crc [key];
+
+    for (uint32_t first : same)
+    {
+      if (! memcmp (inputs [first].data.data (), in.data.data (), in.data.size ()))
+      {
+        in.alias = first;
+        break;
+      }
+    }
+
+    if (in.alias == UINT32_MAX)
+      same.push_back (i);
+  }
+}
+
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanBySimilarity (const std::vector <tzf_pack_input_s>& inputs, size_t block_cap)
+{
+  std::vector <uint32_t> order;
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+  {
+    if (inputs [i].alias == UINT32_MAX)
+      order.push_back (i);
+  }
+
+  std::sort ( order.begin (), order.end (),
+                [&](uint32_t a, uint32_t b) {
+                  const tzf_pack_input_s& in_a = inputs [a];
+                  const tzf_pack_input_s& in_b = inputs [b];
+
+                  if (in_a.format != in_b.format)
+                    return in_a.format < in_b.format;
+
+                  if (in_a.data.size () != in_b.data.size ())
+                    return in_a.data.size () < in_b.data.size ();
+
+                  return in_a.checksum < in_b.checksum;
+                } );
+
+  std::vector <tzf_pack_block_plan_s> plan;
+
+  tzf_pack_block_plan_s solid;
+  size_t                solid_size = 0;
+
+  auto flush = [&](void) {
+    if (solid.inputs.empty ())
+      return;
+
+    // A lone texture is better off with a codec that suits it
+    solid.codec = solid.inputs.size () > 1 ? TZF_PACK_CODEC_LZMA2 :
+                                             TZF_PACK_CODEC_AUTO;
+
+    plan.push_back (std::move (solid));
+
+    solid      = tzf_pack_block_plan_s ();
+    solid_size = 0;
+  };
+
+  for (uint32_t idx : order)
+  {
+    const tzf_pack_input_s& in = inputs [idx];
+
+    if (in.data.size () >= block_cap)
+    {
+      tzf_pack_block_plan_s single;
+
+      single.inputs.push_back (idx);
+      plan.push_back (std::move (single));
+
+      continue;
+    }
+
+    if ( solid_size + in.data.size () > block_cap ||
+         ((! solid.inputs.empty ()) && inputs [solid.inputs [0]].format != in.format) )
+      flush ();
+
+    solid.inputs.push_back (idx);
+    solid_size += in.data.size ();
+  }
+
+  flush ();
+
+  return plan;
+}
+
+struct tzf_encoded_block_s {
+  std::vector <uint8_t> packed;
+  uint8_t               codec      = TZF_PACK_CODEC_STORED;
+  uint8_t               props [5]  = { };
+};
+
+static bool
+TZF_EncodeFast ( const uint8_t*             src,
+                 size_t                     len,
+                 std::vector <uint8_t>&     out )
+{
+  out.resize (TZF_FastCompressBound (len));
+
+  size_t size =
+    TZF_FastCompress (src, len, out.data (), out.size ());
+
+  out.resize (size);
+
+  return size != 0;
+}
+
+static bool
+TZF_EncodeLZMA ( const uint8_t*             src,
+                 size_t                     len,
+                 int                        level,
+                 std::vector <uint8_t>&     out,
+                 uint8_t*                   props )
+{
+  CLzmaEncProps enc_props;
+  LzmaEncProps_Init (&enc_props);
+
+  enc_props.level      = level;
+  enc_props.reduceSize = len;   // Shrinks the dictionary to fit the texture
+  enc_props.numThreads = 1;
+
+  // Incompressible data grows a little; anything past this is not worth it
+  SizeT out_len    = len + len / 3 + 128;
+  SizeT props_size = LZMA_PROPS_SIZE;
+
+  out.resize (out_len);
+
+  SRes res =
+    LzmaEncode ( out.data (), &out_len, src, len,
+                   &enc_props, props, &props_size, 0,
+                     nullptr, &g_Alloc, &g_BigAlloc );
+
+  out.resize (res == SZ_OK ? out_len : 0);
+
+  return res == SZ_OK;
+}
+
+struct tzf_mem_in_stream_s {
+  ISeqInStream   s;
+  const uint8_t* data;
+  size_t         len;
+  size_t         pos;
+};
+
+struct tzf_mem_out_stream_s {
+  ISeqOutStream           s;
+  std::vector <uint8_t>*  out;
+};
+
+static SRes
+TZF_MemRead (void* p, void* buf, size_t* size)
+{
+  tzf_mem_in_stream_s* in = (tzf_mem_in_stream_s *)p;
+
+  size_t len = std::min (*size, in->len - in->pos);
+
+  memcpy (buf, in->data + in->pos, len);
+
+  in->pos += len;
+  *size    = len;
+
+  return SZ_OK;
+}
+
+static size_t
+TZF_MemWrite (void* p, const void* buf, size_t size)
+{
+  tzf_mem_out_stream_s* out = (tzf_mem_out_stream_s *)p;
+
+  out->out->insert ( out->out->end (),
+                       (const uint8_t *)buf,
+                         (const uint8_t *)buf + size );
+
+  return size;
+}
+
+//
+// Solid blocks.  With more than one thread the block is cut into LZMA2
+//   chunks that start with a dictionary reset so MtCoder can encode them
+//     side by side; that costs a little ratio.
+//
+static bool
+TZF_EncodeLZMA2 ( const uint8_t*             src,
+                  size_t                     len,
+                  int                        level,
+                  int                        threads,
+                  std::vector <uint8_t>&     out,
+                  uint8_t*                   props )
+{
+  CLzma2EncHandle enc =
+    Lzma2Enc_Create (&g_Alloc, &g_BigAlloc);
+
+  if (enc == nullptr)
+    return false;
+
+  CLzma2EncProps enc_props;
+  Lzma2EncProps_Init (&enc_props);
+
+  enc_props.lzmaProps.level      = level;
+  enc_props.lzmaProps.reduceSize = len;
+  enc_props.numTotalThreads      = std::max (1, threads);
+
+  if (threads > 1)
+    enc_props.blockSize = std::max ( (size_t)1 << 20,
+                                       (len + threads - 1) / threads );
+
+  tzf_mem_in_stream_s  in  = { { TZF_MemRead  }, src, len, 0 };
+  tzf_mem_out_stream_s dst = { { TZF_MemWrite }, &out };
+
+  out.clear   ();
+  out.reserve (len / 2);
+
+  SRes res = Lzma2Enc_SetProps (enc, &enc_props);
+
+  if (res == SZ_OK)
+  {
+    props [0] = Lzma2Enc_WriteProperties (enc);
+    res       = Lzma2Enc_Encode          (enc, &dst.s, &in.s, nullptr);
+  }
+
+  Lzma2Enc_Destroy (enc);
+
+  return res == SZ_OK;
+}
+
+//
+// Auto: store textures that barely compress (BC data often doesn't), take
+//   the fast codec when LZMA would only buy a few percent, otherwise LZMA.
+//
+static void
+TZF_EncodeBlock ( const uint8_t*            src,
+                  size_t                    len,
+                  int                       codec,
+                  const tzf_pack_options_s& opts,
+                  tzf_encoded_block_s&      out )
+{
+  std::vector <uint8_t> fast, lzma;
+  uint8_t               props [5] = { };
+  int                   level     = opts.level;
+
+  if (codec == TZF_PACK_CODEC_LZMA2)
+  {
+    if ( len > 0 &&
+         TZF_EncodeLZMA2 (src, len, level, opts.threads, lzma, props) &&
+         lzma.size () < len )
+    {
+      out.codec = TZF_PACK_CODEC_LZMA2;
+      out.props [0] = props [0];
+      out.packed.swap (lzma);
+    }
+
+    else
+    {
+      out.codec = TZF_PACK_CODEC_STORED;
+      out.packed.assign (src, src + len);
+    }
+
+    return;
+  }
+
+  bool have_fast = false,
+       have_lzma = false;
+
+  if (len > 0 && (codec == TZF_PACK_CODEC_FAST || codec == TZF_PACK_CODEC_AUTO))
+    have_fast = TZF_EncodeFast (src, len, fast);
+
+  if (len > 0 && (codec == TZF_PACK_CODEC_LZMA || codec == TZF_PACK_CODEC_AUTO))
+    have_lzma = TZF_EncodeLZMA (src, len, level, lzma, props);
+
+  if (codec == TZF_PACK_CODEC_AUTO)
+  {
+    size_t best = len;
+
+    if (have_fast) best = std::min (best, fast.size ());
+    if (have_lzma) best = std::min (best, lzma.size ());
+
+    if ((double)best > 0.95 * (double)len)
+      have_fast = have_lzma = false;
+
+    else if (have_fast && have_lzma && (double)fast.size () <= 1.10 * (double)lzma.size ())
+      have_lzma = false;
+
+    else if (have_lzma)
+      have_fast = false;
+  }
+
+  // Never write a compressed block that is larger than the input
+  if (have_lzma && lzma.size () < len)
+  {
+    out.codec = TZF_PACK_CODEC_LZMA;
+    memcpy (out.props, props, sizeof (props));
+    out.packed.swap (lzma);
+  }
+
+  else if (have_fast && fast.size () < len)
+  {
+    out.codec = TZF_PACK_CODEC_FAST;
+    out.packed.swap (fast);
+  }
+
+  else
+  {
+    out.codec = TZF_PACK_CODEC_STORED;
+    out.packed.assign (src, src + len);
+  }
+}
+
+
+static bool
+TZF_WriteAt (FILE* fOut, uint64_t pos, const void* data, size_t len)
+{
+  if (_fseeki64 (fOut, (int64_t)pos, SEEK_SET) != 0)
+    return false;
+
+  return len == 0 || fwrite (data, len, 1, fOut) == 1;
+}
+
+static uint32_t
+TZF_ChecksumFile (FILE* fOut, uint64_t start)
+{
+  std::vector <uint8_t> chunk (4 * 1024 * 1024);
+
+  UInt32 crc = CRC_INIT_VAL;
+
+  fflush    (fOut);
+  _fseeki64 (fOut, (int64_t)start, SEEK_SET);
+
+  size_t len;
+
+  while ((len = fread (chunk.data (), 1, chunk.size (), fOut)) > 0)
+    crc = CrcUpdate (crc, chunk.data (), len);
+
+  return CRC_GET_DIGEST (crc);
+}
+
+// Concatenates the block's textures; single-entry blocks skip the copy
+static void
+TZF_EncodePlannedBlock ( const std::vector <tzf_pack_input_s>&  inputs,
+                         const tzf_pack_block_plan_s&           plan,
+                         const tzf_pack_options_s&              opts,
+                         tzf_encoded_block_s&                   enc,
+                         size_t&                                len )
+{
+  if (plan.inputs.size () == 1)
+  {
+    const std::vector <uint8_t>& data = inputs [plan.inputs [0]].data;
+
+    len = data.size ();
+
+    TZF_EncodeBlock (data.data (), len, plan.codec, opts, enc);
+    return;
+  }
+
+  std::vector <uint8_t> joined;
+
+  for (uint32_t idx : plan.inputs)
+    joined.insert (joined.end (), inputs [idx].data.begin (), inputs [idx].data.end ());
+
+  len = joined.size ();
+
+  TZF_EncodeBlock (joined.data (), len, plan.codec, opts, enc);
+}
+
+//
+// Blocks are encoded by opts.threads workers and written in plan order as
+//   they finish.  Workers stay within a window of the writer so memory use
+//     does not grow with the size of the pack.  When there are fewer blocks
+//       than threads, the spare threads go to MtCoder inside each block.
+//
+class tzf_block_encoder_s {
+public:
+  tzf_block_encoder_s ( const std::vector <tzf_pack_input_s>&       inputs,
+                        const std::vector <tzf_pack_block_plan_s>&  plan,
+                        const tzf_pack_options_s&                   opts )
+    : inputs_ (inputs), plan_ (plan), opts_ (opts),
+      done_   (plan.size ()), lens_ (plan.size (), 0)
+  {
+    size_t workers =
+      std::max ((size_t)1, std::min ((size_t)opts.threads, plan.size ()));
+
+    opts_.threads = std::max (1, opts.threads / (int)workers);
+    window_       = workers * 2;
+
+    for (size_t i = 0; i < workers; i++)
+      threads_.emplace_back (&tzf_block_encoder_s::run, this);
+  }
+
+  ~tzf_block_encoder_s (void)
+  {
+    {
+      std::lock_guard <std::mutex> lock (mutex_);
+      stop_ = true;
+    }
+
+    cv_.notify_all ();
+
+    for (auto& thread : threads_)
+      thread.join ();
+  }
+
+  // Waits for block b and hands over its encoding
+  std::unique_ptr <tzf_encoded_block_s>
+  take (uint32_t b, size_t* len)
+  {
+    std::unique_lock <std::mutex> lock (mutex_);
+
+    cv_.wait (lock, [&] { return done_ [b] != nullptr; });
+
+    written_ = b + 1;
+    *len     = lens_ [b];
+
+    cv_.notify_all ();
+
+    return std::move (done_ [b]);
+  }
+
+private:
+  void run (void)
+  {
+    for (;;)
+    {
+      uint32_t b;
+
+      {
+        std::unique_lock <std::mutex> lock (mutex_);
+
+        cv_.wait (lock, [&] {
+          return stop_ || next_ >= plan_.size () ||
+                          next_ <  written_ + window_;
+        });
+
+        if (stop_ || next_ >= plan_.size ())
+          return;
+
+        b = next_++;
+      }
+
+      std::unique_ptr <tzf_encoded_block_s> enc (new tzf_encoded_block_s);
+      size_t                                len = 0;
+
+      TZF_EncodePlannedBlock (inputs_, plan_ [b], opts_, *enc, len);
+
+      {
+        std::lock_guard <std::mutex> lock (mutex_);
+
+        done_ [b] = std::move (enc);
+        lens_ [b] = len;
+      }
+
+      cv_.notify_all ();
+    }
+  }
+
+  const std::vector <tzf_pack_input_s>&               inputs_;
+  const std::vector <tzf_pack_block_plan_s>&          plan_;
+  tzf_pack_options_s                                  opts_;
+
+  std::vector <std::unique_ptr <tzf_encoded_block_s>> done_;
+  std::vector <size_t>                                lens_;
+
+  std::mutex                                          mutex_;
+  std::condition_variable                             cv_;
+  std::vector <std::thread>                           threads_;
+
+  size_t                                              next_    = 0;
+  size_t                                              written_ = 0;
+  size_t                                              window_  = 2;
+  bool                                                stop_    = false;
+};
+
+// Same bytes as the start of the pack: header, entries, blocks
+static bool
+TZF_WriteSidecar ( const wchar_t*                        wszPack,
+                   const tzf_pack_header_s&              hdr,
+                   const std::vector <tzf_pack_entry_s>& entries,
+                   const std::vector <tzf_pack_block_s>& blocks )
+{
+  std::wstring sidecar (wszPack);
+  size_t       ext = sidecar.find_last_of (L"./\\");
+
+  if (ext != std::wstring::npos && sidecar [ext] == L'.')
+    sidecar.resize (ext);
+
+  sidecar += TZF_PACK_SIDECAR_EXT;
+
+  FILE* fOut = _wfopen (sidecar.c_str (), L"wb");
+
+  if (fOut == nullptr)
+    return false;
+
+  bool ok =
+    fwrite (&hdr, sizeof (hdr), 1, fOut) == 1 &&
+    (entries.empty () || fwrite (entries.data (), entries.size () * sizeof (tzf_pack_entry_s), 1, fOut) == 1) &&
+    (blocks.empty  () || fwrite (blocks.data  (), blocks.size  () * sizeof (tzf_pack_block_s), 1, fOut) == 1);
+
+  ok = (fclose (fOut) == 0) && ok;
+
+  if (! ok)
+    _wremove (sidecar.c_str ());
+
+  return ok;
+}
+
+bool
+TZF_WritePack ( const wchar_t*                               wszPack,
+                const std::vector <tzf_pack_input_s>&        inputs,
+                const std::vector <tzf_pack_block_plan_s>&   plan,
+                const tzf_pack_options_s&                    opts,
+                      tzf_pack_stats_s*                      stats )
+{
+  FILE* fOut = _wfopen (wszPack, L"wb+");
+
+  if (fOut == nullptr)
+  {
+    fwprintf (stderr, L"Cannot create %s\n", wszPack);
+    return false;
+  }
+
+  tzf_pack_header_s hdr = { };
+
+  hdr.magic        = TZF_PACK_MAGIC;
+  hdr.version      = TZF_PACK_VERSION;
+  hdr.flags        = opts.crc ? TZF_PACK_FLAG_CRC : 0;
+  hdr.entry_count  = (uint32_t)inputs.size ();
+  hdr.block_count  = (uint32_t)plan.size   ();
+  hdr.entry_offset = sizeof (tzf_pack_header_s);
+  hdr.block_offset = hdr.entry_offset + (uint64_t)hdr.entry_count * sizeof (tzf_pack_entry_s);
+  hdr.data_offset  = hdr.block_offset + (uint64_t)hdr.block_count * sizeof (tzf_pack_block_s);
+  hdr.data_offset  = (hdr.data_offset + TZF_PACK_ALIGNMENT - 1) & ~(uint64_t)(TZF_PACK_ALIGNMENT - 1);
+
+  std::vector <tzf_pack_entry_s> entries (inputs.size ());
+  std::vector <tzf_pack_block_s> blocks  (plan.size   ());
+
+  static const uint8_t zero [TZF_PACK_ALIGNMENT] = { };
+
+  uint64_t pos = hdr.data_offset;
+  bool     ok  = true;
+
+  {
+    tzf_block_encoder_s encoder (inputs, plan, opts);
+
+    for (uint32_t b = 0; ok && b < (uint32_t)plan.size (); b++)
+    {
+      uint32_t offset = 0;
+
+      for (uint32_t idx : plan [b].inputs)
+      {
+        const tzf_pack_input_s& in    = inputs  [idx];
+        tzf_pack_entry_s&       entry = entries [idx];
+
+        entry.checksum = in.checksum;
+        entry.block    = b;
+        entry.offset   = offset;
+        entry.size     = (uint32_t)in.data.size ();
+        entry.crc32    = CrcCalc (in.data.data (), in.data.size ());
+        entry.method   = in.method;
+
+        offset += entry.size;
+      }
+
+      size_t len = 0;
+      auto   enc = encoder.take (b, &len);
+
+      tzf_pack_block_s& block = blocks [b];
+
+      block.offset        = pos;
+      block.packed_size   = (uint32_t)enc->packed.size ();
+      block.unpacked_size = (uint32_t)len;
+      block.crc32         = CrcCalc (enc->packed.data (), enc->packed.size ());
+      block.codec         = enc->codec;
+      memcpy (block.props, enc->props, sizeof (block.props));
+
+      ok = TZF_WriteAt (fOut, pos, enc->packed.data (), enc->packed.size ());
+
+      pos += enc->packed.size ();
+
+      // Pad up to the next block, but not past the last one
+      uint64_t pad = ((pos + TZF_PACK_ALIGNMENT - 1) & ~(uint64_t)(TZF_PACK_ALIGNMENT - 1)) - pos;
+
+      if (ok && b + 1 < (uint32_t)plan.size () && pad > 0)
+      {
+        ok   = fwrite (zero, (size_t)pad, 1, fOut) == 1;
+        pos += pad;
+      }
+
+      if (stats != nullptr)
+      {
+        stats->unpacked += len;
+        stats->packed   += enc->packed.size ();
+        stats->blocks_by_codec [enc->codec]++;
+      }
+    }
+  }
+
+  // Payloads shared with an earlier texture point at its bytes
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+  {
+    if (inputs [i].alias == UINT32_MAX)
+      continue;
+
+    entries [i]          = entries [inputs [i].alias];
+    entries [i].checksum = inputs  [i].checksum;
+    entries [i].method   = inputs  [i].method;
+  }
+
+  std::sort ( entries.begin (), entries.end (),
+                [](const tzf_pack_entry_s& a, const tzf_pack_entry_s& b) {
+                  return a.checksum < b.checksum;
+                } );
+
+  ok = ok && TZF_WriteAt (fOut, hdr.entry_offset, entries.data (), entries.size () * sizeof (tzf_pack_entry_s));
+  ok = ok && TZF_WriteAt (fOut, hdr.block_offset, blocks.data  (), blocks.size  () * sizeof (tzf_pack_block_s));
+
+  // The gap between the index and the first block
+  uint64_t index_end = hdr.block_offset + blocks.size () * sizeof (tzf_pack_block_s);
+
+  ok = ok && TZF_WriteAt (fOut, index_end, zero, (size_t)(hdr.data_offset - index_end));
+
+  if (ok && opts.crc)
+    hdr.pack_crc32 = TZF_ChecksumFile (fOut, sizeof (tzf_pack_header_s));
+
+  hdr.header_crc32 = CrcCalc (&hdr, sizeof (hdr));
+
+  ok = ok && TZF_WriteAt (fOut, 0, &hdr, sizeof (hdr));
+  ok = (fclose (fOut) == 0) && ok;
+
+  if (! ok)
+  {
+    fwprintf (stderr, L"Write error on %s\n", wszPack);
+    _wremove (wszPack);
+  }
+
+  else if (opts.sidecar && (! TZF_WriteSidecar (wszPack, hdr, entries, blocks)))
+    fwprintf (stderr, L"Could not write the index sidecar for %s\n", wszPack);
+
+  return ok;
+}
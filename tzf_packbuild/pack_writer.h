@@ -0,0 +1,103 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__PACK_WRITER_H__
+#define __TZF__PACK_WRITER_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "pack_format.h"
+
+// Values of tzf_load_method_t (textures.h); the tool does not pull in D3D
+#define TZF_METHOD_STREAMING  0
+#define TZF_METHOD_BLOCKING   1
+#define TZF_METHOD_DONTCARE   2
+
+// Not a codec that can appear in a pack; lets the writer pick per block
+#define TZF_PACK_CODEC_AUTO   0xFF
+
+struct tzf_pack_input_s {
+  uint32_t              checksum = 0;
+  uint8_t               method   = TZF_METHOD_DONTCARE;
+  std::vector <uint8_t> data;
+
+  // Where the texture came from: the runtime decodes source_block_size
+  //   bytes to get at it.  Used to compare layouts, not written anywhere.
+  uint64_t              source_block      = UINT64_MAX;
+  uint64_t              source_block_size = 0;
+
+  // FourCC or RGB layout from the DDS header; only used to order inputs
+  uint32_t              format            = 0;
+
+  // Byte-identical to inputs [alias]; the entry points at those bytes and
+  //   the input itself must not be placed in a block.
+  uint32_t              alias             = UINT32_MAX;
+};
+
+struct tzf_pack_block_plan_s {
+  std::vector <uint32_t> inputs; // Indices into the input list, in block order
+  int                    codec  = TZF_PACK_CODEC_AUTO;
+};
+
+struct tzf_pack_options_s {
+  bool crc     = false;
+  int  level   = 7;              // LZMA level, 0-9
+  int  threads = 1;              // Blocks encoded in parallel, MtCoder within
+  bool sidecar = false;          // Also write <pack>.tzi
+};
+
+struct tzf_pack_stats_s {
+  uint64_t unpacked = 0;
+  uint64_t packed   = 0;
+  uint32_t blocks_by_codec [4] = { };
+};
+
+// Keeps the first texture seen for every checksum, same as TZF_RefreshDataSources
+void
+TZF_DedupInputs      (std::vector <tzf_pack_input_s>& inputs);
+
+// One texture per block; every entry can be decoded on its own
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanRandomAccess (const std::vector <tzf_pack_input_s>& inputs, int codec);
+
+// Points later copies of a payload at the first one (sets alias).  Run after
+//   TZF_DedupInputs (...); removing inputs would invalidate the indices.
+void
+TZF_LinkIdenticalPayloads (std::vector <tzf_pack_input_s>& inputs);
+
+// Solid LZMA2 blocks of up to block_cap bytes holding textures of the same
+//   format, smallest first; larger textures get a block of their own.
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanBySimilarity (const std::vector <tzf_pack_input_s>& inputs, size_t block_cap);
+
+bool
+TZF_WritePack ( const wchar_t*                               wszPack,
+                const std::vector <tzf_pack_input_s>&        inputs,
+                const std::vector <tzf_pack_block_plan_s>&   plan,
+                const tzf_pack_options_s&                    opts,
+                      tzf_pack_stats_s*                      stats );
+
+const char*
+TZF_GetCodecName     (int codec);
+
+#endif /* __TZF__PACK_WRITER_H__ */
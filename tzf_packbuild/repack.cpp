@@ -0,0 +1,385 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#include "repack.h"
+#include "pack_reader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+bool
+TZF_LoadAccessTrace ( const wchar_t*                    wszTrace,
+                      std::vector <tzf_trace_scene_s>&  scenes )
+{
+  FILE* fTrace = _wfopen (wszTrace, L"r");
+
+  if (fTrace == nullptr)
+  {
+    fwprintf (stderr, L"Cannot open trace %s\n", wszTrace);
+    return false;
+  }
+
+  char line [512];
+
+  while (fgets (line, sizeof (line), fTrace) != nullptr)
+  {
+    line [strcspn (line, "\r\n")] = '\0';
+
+    if (line [0] == '#' || line [0] == '\0')
+      continue;
+
+    if (! strncmp (line, "scene", 5))
+    {
+      tzf_trace_scene_s scene;
+
+      // "scene <n> [name]"
+      const char* name = strchr (line + 5, ' ');
+
+      if (name != nullptr)
+        name = strchr (name + 1, ' ');
+
+      if (name != nullptr && *(name + 1) != '\0')
+        scene.name = name + 1;
+
+      scenes.push_back (scene);
+      continue;
+    }
+
+    uint32_t checksum;
+
+    if (sscanf (line, "%x", &checksum) != 1)
+      continue;
+
+    // Checksums before the first scene line
+    if (scenes.empty ())
+      scenes.push_back (tzf_trace_scene_s ());
+
+    scenes.back ().checksums.push_back (checksum);
+  }
+
+  fclose (fTrace);
+
+  // Sessions that ended without loading anything leave empty scenes
+  scenes.erase ( std::remove_if ( scenes.begin (), scenes.end (),
+                                    [](const tzf_trace_scene_s& scene) {
+                                      return scene.checksums.empty ();
+                                    } ),
+                   scenes.end () );
+
+  return true;
+}
+
+
+struct tzf_access_group_s {
+  std::vector <uint32_t> scenes;   // Sorted; identical for every member
+  std::vector <uint32_t> inputs;   // In order of first access
+};
+
+static double
+TZF_SceneOverlap (const std::vector <uint32_t>& a, const std::vector <uint32_t>& b)
+{
+  size_t shared = 0;
+
+  for (size_t i = 0, j = 0; i < a.size () && j < b.size (); )
+  {
+    if      (a [i] < b [j]) ++i;
+    else if (b [j] < a [i]) ++j;
+    else  { ++shared; ++i; ++j; }
+  }
+
+  return (double)shared / (double)(a.size () + b.size () - shared);
+}
+
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanByAccess ( const std::vector <tzf_pack_input_s>&  inputs,
+                   const std::vector <tzf_trace_scene_s>& scenes,
+                   size_t                                 block_cap )
+{
+  std::unordered_map <uint32_t, uint32_t> by_checksum;
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+    by_checksum.emplace (inputs [i].checksum, i);
+
+  // Scenes each texture appears in; first_seen keeps first-access order
+  std::vector <std::vector <uint32_t>> appears_in (inputs.size ());
+  std::vector <uint32_t>               first_seen;
+
+  for (uint32_t scene = 0; scene < (uint32_t)scenes.size (); scene++)
+  {
+    for (uint32_t checksum : scenes [scene].checksums)
+    {
+      auto it = by_checksum.find (checksum);
+
+      if (it == by_checksum.end ())
+        continue;
+
+      std::vector <uint32_t>& in_scenes = appears_in [it->second];
+
+      if (in_scenes.empty ())
+        first_seen.push_back (it->second);
+
+      if (in_scenes.empty () || in_scenes.back () != scene)
+        in_scenes.push_back (scene);
+    }
+  }
+
+  // Textures that always load together; groups come out in first-access order
+  std::vector <tzf_access_group_s>                     groups;
+  std::map    <std::vector <uint32_t>, uint32_t>       group_of;
+
+  for (uint32_t idx : first_seen)
+  {
+    auto it = group_of.find (appears_in [idx]);
+
+    if (it == group_of.end ())
+    {
+      it = group_of.emplace (appears_in [idx], (uint32_t)groups.size ()).first;
+
+      groups.push_back (tzf_access_group_s ());
+      groups.back ().scenes = appears_in [idx];
+    }
+
+    groups [it->second].inputs.push_back (idx);
+  }
+
+  std::vector <tzf_pack_block_plan_s> plan;
+
+  tzf_pack_block_plan_s         block;
+  size_t                        block_size   = 0;
+  const std::vector <uint32_t>* block_scenes = nullptr;
+
+  auto CloseBlock = [&](void) {
+    if (block.inputs.empty ())
+      return;
+
+    block.codec = block.inputs.size () > 1 ? TZF_PACK_CODEC_LZMA2 :
+                                             TZF_PACK_CODEC_AUTO;
+    plan.push_back (block);
+
+    block        = tzf_pack_block_plan_s ();
+    block_size   = 0;
+    block_scenes = nullptr;
+  };
+
+  for (const auto& group : groups)
+  {
+    // Neighbouring groups share a block only if they mostly load together
+    if ( block_scenes != nullptr &&
+         TZF_SceneOverlap (*block_scenes, group.scenes) < 0.5 )
+      CloseBlock ();
+
+    for (uint32_t idx : group.inputs)
+    {
+      size_t size = inputs [idx].data.size ();
+
+      if (size >= block_cap)
+      {
+        tzf_pack_block_plan_s alone;
+        alone.inputs.push_back (idx);
+
+        plan.push_back (alone);
+        continue;
+      }
+
+      if (block_size + size > block_cap)
+        CloseBlock ();
+
+      if (block_scenes == nullptr)
+        block_scenes = &group.scenes;
+
+      block.inputs.push_back (idx);
+      block_size += size;
+    }
+  }
+
+  CloseBlock ();
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+  {
+    if (appears_in [i].empty ())
+    {
+      tzf_pack_block_plan_s alone;
+      alone.inputs.push_back (i);
+
+      plan.push_back (alone);
+    }
+  }
+
+  return plan;
+}
+
+
+static double
+MiB (uint64_t bytes)
+{
+  return (double)bytes / (1024.0 * 1024.0);
+}
+
+//
+// Needed:    bytes of the textures the scene loads.
+// Source:    each distinct source block the scene touches, decoded once.
+// Predicted: the same, for the blocks of the new plan.
+// Measured:  the trace replayed in order against the written pack, the way
+//              tzf_dsound/pack.cpp reads it (one cached solid block, stored
+//                entries read in place).  Every scene starts cold.
+//
+bool
+TZF_ReportSceneCosts ( const wchar_t*                              wszPack,
+                       const std::vector <tzf_pack_input_s>&       inputs,
+                       const std::vector <tzf_trace_scene_s>&      scenes,
+                       const std::vector <tzf_pack_block_plan_s>&  plan )
+{
+  tzf_pack_file_s pack;
+
+  if (! TZF_LoadPackFile (wszPack, pack))
+    return false;
+
+  std::unordered_map <uint32_t, uint32_t> by_checksum;
+  std::vector        <uint32_t>           plan_block (inputs.size ());
+  std::vector        <uint64_t>           plan_size  (plan.size   (), 0);
+
+  for (uint32_t i = 0; i < (uint32_t)inputs.size (); i++)
+    by_checksum.emplace (inputs [i].checksum, i);
+
+  for (uint32_t b = 0; b < (uint32_t)plan.size (); b++)
+  {
+    for (uint32_t idx : plan [b].inputs)
+    {
+      plan_block [idx]  = b;
+      plan_size  [b]   += inputs [idx].data.size ();
+    }
+  }
+
+  wprintf ( L"\n%-6s %8s %11s %11s %11s %11s %9s  %s\n",
+              L"Scene", L"Textures", L"Needed MiB", L"Source MiB",
+                L"Pred. MiB", L"Meas. MiB", L"Decode ms", L"Name" );
+
+  uint64_t total_needed    = 0, total_source   = 0,
+           total_predicted = 0, total_measured = 0;
+  double   total_ms        = 0.0;
+  bool     ok              = true;
+
+  std::vector <uint8_t> decoded, entry_data;
+
+  for (size_t s = 0; ok && s < scenes.size (); s++)
+  {
+    std::unordered_set <uint64_t> source_seen;
+    std::unordered_set <uint32_t> plan_seen;
+
+    uint64_t needed   = 0, source   = 0,
+             predicted = 0, measured = 0;
+    uint32_t textures = 0;
+    uint32_t solid    = UINT32_MAX;
+
+    auto start = std::chrono::steady_clock::now ();
+
+    for (uint32_t checksum : scenes [s].checksums)
+    {
+      auto it = by_checksum.find (checksum);
+
+      if (it == by_checksum.end ())
+        continue;
+
+      const tzf_pack_input_s& in = inputs [it->second];
+
+      ++textures;
+      needed += in.data.size ();
+
+      if (source_seen.insert (in.source_block).second)
+        source += in.source_block == UINT64_MAX ? in.data.size () :
+                                                  in.source_block_size;
+
+      if (plan_seen.insert (plan_block [it->second]).second)
+        predicted += plan_size [plan_block [it->second]];
+
+      auto entry =
+        std::lower_bound ( pack.entries.begin (), pack.entries.end (), checksum,
+                             [](const tzf_pack_entry_s& e, uint32_t key) {
+                               return e.checksum < key;
+                             } );
+
+      if (entry == pack.entries.end () || entry->checksum != checksum)
+      {
+        fwprintf (stderr, L"%08x is missing from %s\n", checksum, wszPack);
+        ok = false;
+        break;
+      }
+
+      const tzf_pack_block_s& block = pack.blocks [entry->block];
+
+      if (block.codec == TZF_PACK_CODEC_STORED)
+      {
+        entry_data.resize (entry->size);
+
+        ok = entry->size == 0 ||
+             ( _fseeki64 (pack.fPack, (int64_t)(block.offset + entry->offset), SEEK_SET) == 0 &&
+               fread     (entry_data.data (), entry->size, 1, pack.fPack)               == 1 );
+
+        measured += entry->size;
+      }
+
+      else if (entry->block != solid)
+      {
+        ok        = TZF_DecodePackFileBlock (pack, entry->block, decoded);
+        measured += block.unpacked_size;
+
+        if (entry->size != block.unpacked_size)
+          solid = entry->block;
+      }
+
+      if (! ok)
+        fwprintf (stderr, L"Could not read %08x from %s\n", checksum, wszPack);
+    }
+
+    double ms =
+      std::chrono::duration <double, std::milli> (
+        std::chrono::steady_clock::now () - start
+      ).count ();
+
+    wprintf ( L"%-6zu %8lu %11.2f %11.2f %11.2f %11.2f %9.1f  %hs\n",
+                s + 1, textures,
+                  MiB (needed), MiB (source), MiB (predicted), MiB (measured),
+                    ms, scenes [s].name.c_str () );
+
+    total_needed    += needed;
+    total_source    += source;
+    total_predicted += predicted;
+    total_measured  += measured;
+    total_ms        += ms;
+  }
+
+  wprintf ( L"%-6s %8s %11.2f %11.2f %11.2f %11.2f %9.1f\n",
+              L"Total", L"",
+                MiB (total_needed),    MiB (total_source),
+                MiB (total_predicted), MiB (total_measured),
+                  total_ms );
+
+  TZF_ClosePackFile (pack);
+
+  return ok;
+}
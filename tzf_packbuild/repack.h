@@ -0,0 +1,60 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+
+#ifndef __TZF__REPACK_H__
+#define __TZF__REPACK_H__
+
+#include <string>
+#include <vector>
+
+#include "pack_writer.h"
+
+// One scene of TZFix_Res\access_trace.txt (written with RecordAccessTrace)
+struct tzf_trace_scene_s {
+  std::string            name;
+  std::vector <uint32_t> checksums;   // In order of first access
+};
+
+bool
+TZF_LoadAccessTrace  ( const wchar_t*                         wszTrace,
+                       std::vector <tzf_trace_scene_s>&       scenes );
+
+//
+// Textures loaded in the same set of scenes share LZMA2 solid blocks, laid
+//   out in the order they were first loaded.  No block grows past block_cap
+//     bytes, so a texture never costs more than that to decode.  Textures
+//       missing from the trace get a block of their own.
+//
+std::vector <tzf_pack_block_plan_s>
+TZF_PlanByAccess     ( const std::vector <tzf_pack_input_s>&  inputs,
+                       const std::vector <tzf_trace_scene_s>& scenes,
+                       size_t                                 block_cap );
+
+// Replays the trace against the written pack and prints decode cost per scene
+bool
+TZF_ReportSceneCosts ( const wchar_t*                              wszPack,
+                       const std::vector <tzf_pack_input_s>&       inputs,
+                       const std::vector <tzf_trace_scene_s>&      scenes,
+                       const std::vector <tzf_pack_block_plan_s>&  plan );
+
+#endif /* __TZF__REPACK_H__ */
@@ -0,0 +1,388 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "sources.h"
+#include "pack_reader.h"
+
+#define NOMINMAX
+
+#include <Windows.h>
+
+#include <cstdio>
+#include <cwchar>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "lzma/7z.h"
+#include "lzma/7zAlloc.h"
+#include "lzma/7zCrc.h"
+#include "lzma/7zFile.h"
+
+bool
+TZF_ParseTextureName (const wchar_t* wszPath, uint32_t* checksum, uint8_t* method)
+{
+  std::wstring path (wszPath);
+
+  std::transform (path.begin (), path.end (), path.begin (), towlower);
+
+  size_t ext = path.rfind (L".dds");
+
+  if (ext == std::wstring::npos || ext + 4 != path.length ())
+    return false;
+
+  size_t name = path.find_last_of (L"/\\");
+         name = (name == std::wstring::npos) ? 0 : name + 1;
+
+  if (swscanf (path.c_str () + name, L"%x.dds", checksum) != 1)
+    return false;
+
+  if (path.find (L"streaming") != std::wstring::npos)
+    *method = TZF_METHOD_STREAMING;
+  else if (path.find (L"blocking") != std::wstring::npos)
+    *method = TZF_METHOD_BLOCKING;
+  else
+    *method = TZF_METHOD_DONTCARE;
+
+  return true;
+}
+
+//
+// SzArEx_Extract (...) in this tree decodes the whole folder on every call,
+//   so walk the archive a folder at a time and slice files out of that.
+//
+bool
+TZF_ReadArchiveInputs ( const wchar_t*                   wszArchive,
+                        std::vector <tzf_pack_input_s>&  inputs )
+{
+  CFileInStream arc_stream;
+  CLookToRead   look_stream;
+
+  FileInStream_CreateVTable (&arc_stream);
+  LookToRead_CreateVTable   (&look_stream, False);
+
+  look_stream.realStream = &arc_stream.s;
+  LookToRead_Init         (&look_stream);
+
+  ISzAlloc alloc     = { SzAlloc,     SzFree     };
+  ISzAlloc alloc_tmp = { SzAllocTemp, SzFreeTemp };
+
+  if (InFile_OpenW (&arc_stream.file, wszArchive))
+  {
+    fwprintf (stderr, L"Cannot open archive file: %s\n", wszArchive);
+    return false;
+  }
+
+  CSzArEx arc;
+  SzArEx_Init (&arc);
+
+  SRes res =
+    SzArEx_Open (&arc, &look_stream.s, &alloc, &alloc_tmp);
+
+  std::vector <uint8_t> folder_data;
+  UInt32                folder = (UInt32)-1;
+
+  wchar_t wszEntry [MAX_PATH];
+
+  for (UInt32 i = 0; res == SZ_OK && i < arc.NumFiles; i++)
+  {
+    if (SzArEx_IsDir (&arc, i))
+      continue;
+
+    // Length includes the terminator
+    if (SzArEx_GetFileNameUtf16 (&arc, i, nullptr) > MAX_PATH)
+      continue;
+
+    SzArEx_GetFileNameUtf16 (&arc, i, (UInt16 *)wszEntry);
+
+    tzf_pack_input_s in;
+
+    if (! TZF_ParseTextureName (wszEntry, &in.checksum, &in.method))
+      continue;
+
+    UInt32 file_folder = arc.FileToFolder [i];
+    size_t size        = (size_t)SzArEx_GetFileSize (&arc, i);
+
+    // Empty files have no folder
+    if (file_folder != (UInt32)-1 && file_folder != folder)
+    {
+      folder_data.resize ((size_t)SzAr_GetFolderUnpackSize (&arc.db, file_folder));
+
+      res =
+        SzAr_DecodeFolder ( &arc.db, file_folder,
+                              &look_stream.s, arc.dataPos,
+                                folder_data.data (), folder_data.size (),
+                                  &alloc_tmp );
+
+      folder = file_folder;
+
+      if (res != SZ_OK)
+        break;
+    }
+
+    if (size > 0)
+    {
+      size_t offset =
+        (size_t)( arc.UnpackPositions [i] -
+                  arc.UnpackPositions [arc.FolderToFile [folder]] );
+
+      in.data.assign ( folder_data.begin () + offset,
+                       folder_data.begin () + offset + size );
+
+      in.source_block      = folder;
+      in.source_block_size = folder_data.size ();
+
+      if ( SzBitWithVals_Check (&arc.CRCs, i) &&
+           CrcCalc (in.data.data (), size) != arc.CRCs.Vals [i] )
+      {
+        res = SZ_ERROR_CRC;
+        break;
+      }
+    }
+
+    inputs.push_back (std::move (in));
+  }
+
+  if (res != SZ_OK)
+    fwprintf (stderr, L"Error %d reading %s\n", res, wszArchive);
+
+  SzArEx_Free (&arc, &alloc);
+  File_Close  (&arc_stream.file);
+
+  return res == SZ_OK;
+}
+
+bool
+TZF_ReadPackInputs ( const wchar_t*                   wszPack,
+                     std::vector <tzf_pack_input_s>&  inputs )
+{
+  tzf_pack_file_s pack;
+
+  if (! TZF_LoadPackFile (wszPack, pack))
+    return false;
+
+  // Entries are sorted by checksum, not by block; decode each block once
+  std::vector <uint32_t> order (pack.entries.size ());
+
+  for (uint32_t i = 0; i < (uint32_t)order.size (); i++)
+    order [i] = i;
+
+  std::stable_sort ( order.begin (), order.end (),
+                       [&](uint32_t a, uint32_t b) {
+                         return pack.entries [a].block < pack.entries [b].block;
+                       } );
+
+  std::vector <uint8_t> block_data;
+  uint32_t              block = UINT32_MAX;
+  bool                  ok    = true;
+
+  for (uint32_t idx : order)
+  {
+    const tzf_pack_entry_s& entry = pack.entries [idx];
+
+    if (entry.block != block)
+    {
+      block = entry.block;
+
+      if (! TZF_DecodePackFileBlock (pack, block, block_data))
+      {
+        fwprintf (stderr, L"Block %lu of %s is damaged\n", block, wszPack);
+        ok = false;
+        break;
+      }
+    }
+
+    tzf_pack_input_s in;
+
+    in.checksum          = entry.checksum;
+    in.method            = entry.method;
+    in.source_block      = block;
+    in.source_block_size = pack.blocks [block].codec == TZF_PACK_CODEC_STORED ?
+                             entry.size : block_data.size ();
+
+    in.data.assign ( block_data.begin () + entry.offset,
+                     block_data.begin () + entry.offset + entry.size );
+
+    inputs.push_back (std::move (in));
+  }
+
+  TZF_ClosePackFile (pack);
+
+  return ok;
+}
+
+bool
+TZF_ReadInputs ( const wchar_t*                   wszFile,
+                 uint32_t                         source_id,
+                 std::vector <tzf_pack_input_s>&  inputs )
+{
+  std::wstring name (wszFile);
+
+  std::transform (name.begin (), name.end (), name.begin (), towlower);
+
+  size_t first = inputs.size ();
+  bool   ok    = false;
+
+  if (name.length () > 4 && name.rfind (L".tzp") == name.length () - 4)
+    ok = TZF_ReadPackInputs (wszFile, inputs);
+  else
+    ok = TZF_ReadArchiveInputs (wszFile, inputs);
+
+  for (size_t i = first; i < inputs.size (); i++)
+  {
+    if (inputs [i].source_block != UINT64_MAX)
+      inputs [i].source_block |= (uint64_t)source_id << 32;
+  }
+
+  return ok;
+}
+
+void
+TZF_FindTreeFiles (const std::wstring& dir, std::vector <std::wstring>& files)
+{
+  WIN32_FIND_DATAW fd;
+  HANDLE           hFind =
+    FindFirstFileW ((dir + L"\\*").c_str (), &fd);
+
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+
+  do
+  {
+    if (! wcscmp (fd.cFileName, L".") || ! wcscmp (fd.cFileName, L".."))
+      continue;
+
+    std::wstring path = dir + L"\\" + fd.cFileName;
+
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      TZF_FindTreeFiles (path, files);
+    else
+      files.push_back (path);
+  } while (FindNextFileW (hFind, &fd));
+
+  FindClose (hFind);
+}
+
+uint32_t
+TZF_GetDDSFormatKey (const std::vector <uint8_t>& data)
+{
+  const uint32_t DDS_MAGIC     = 0x20534444; // "DDS "
+  const uint32_t DDPF_FOURCC   = 0x4;
+  const size_t   DDPF_OFFSET   = 80;         // Magic + DDS_HEADER up to ddspf.dwFlags
+
+  if (data.size () < DDPF_OFFSET + 12)
+    return 0;
+
+  uint32_t magic, flags, fourcc, bits;
+
+  memcpy (&magic,  data.data (),                   4);
+  memcpy (&flags,  data.data () + DDPF_OFFSET,     4);
+  memcpy (&fourcc, data.data () + DDPF_OFFSET + 4, 4);
+  memcpy (&bits,   data.data () + DDPF_OFFSET + 8, 4);
+
+  if (magic != DDS_MAGIC)
+    return 0;
+
+  if (flags & DDPF_FOURCC)
+    return fourcc;
+
+  // Uncompressed; FourCCs are printable, so this cannot collide with one
+  return (flags << 8) | (bits & 0xFF);
+}
+
+//
+// Walks a dump or inject tree and reads every <checksum>.dds in it.  The
+//   walk itself is cheap; the reads are spread over threads, and inputs come
+//     back in walk order so duplicates resolve the same way every time.
+//
+bool
+TZF_ReadTreeInputs ( const wchar_t*                   wszRoot,
+                     int                              threads,
+                     std::vector <tzf_pack_input_s>&  inputs )
+{
+  std::vector <std::wstring> files;
+
+  TZF_FindTreeFiles (wszRoot, files);
+
+  std::vector <tzf_pack_input_s> found  (files.size ());
+  std::vector <uint8_t>          usable (files.size (), 0);
+
+  std::atomic <size_t> next   (0);
+  std::atomic <bool>   failed (false);
+
+  auto worker = [&](void) {
+    for (size_t i = next++; i < files.size (); i = next++)
+    {
+      tzf_pack_input_s& in = found [i];
+
+      if (! TZF_ParseTextureName (files [i].c_str (), &in.checksum, &in.method))
+        continue;
+
+      FILE* fIn = _wfopen (files [i].c_str (), L"rb");
+
+      if (fIn == nullptr)
+      {
+        fwprintf (stderr, L"Cannot open %s\n", files [i].c_str ());
+        failed = true;
+        continue;
+      }
+
+      _fseeki64 (fIn, 0, SEEK_END);
+      in.data.resize ((size_t)_ftelli64 (fIn));
+      _fseeki64 (fIn, 0, SEEK_SET);
+
+      if (in.data.size () && fread (in.data.data (), in.data.size (), 1, fIn) != 1)
+      {
+        fwprintf (stderr, L"Cannot read %s\n", files [i].c_str ());
+        failed = true;
+      }
+
+      fclose (fIn);
+
+      in.format = TZF_GetDDSFormatKey (in.data);
+      usable [i] = 1;
+    }
+  };
+
+  std::vector <std::thread> pool;
+
+  for (int i = 1; i < threads; i++)
+    pool.emplace_back (worker);
+
+  worker ();
+
+  for (auto& thread : pool)
+    thread.join ();
+
+  for (size_t i = 0; i < files.size (); i++)
+  {
+    if (usable [i])
+      inputs.push_back (std::move (found [i]));
+  }
+
+  if (files.empty ())
+    fwprintf (stderr, L"No files under %s\n", wszRoot);
+
+  return (! failed) && (! files.empty ());
+}
@@ -0,0 +1,68 @@
+/**
+ * This file is part of Tales of Zestiria "Fix".
+ *
+ * Tales of Zestiria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Zestiria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Zestiria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TZF__SOURCES_H__
+#define __TZF__SOURCES_H__
+
+#include "pack_writer.h"
+
+#include <string>
+
+// Applies the mod's naming rules: <checksum>.dds, with "streaming" or
+//   "blocking" anywhere in the path selecting the load method.
+bool
+TZF_ParseTextureName   (const wchar_t* wszPath, uint32_t* checksum, uint8_t* method);
+
+// Every texture in a .7z the mod would load from inject\, in archive order
+bool
+TZF_ReadArchiveInputs  ( const wchar_t*                   wszArchive,
+                         std::vector <tzf_pack_input_s>&  inputs );
+
+// Every texture in an existing .tzp, in block order
+bool
+TZF_ReadPackInputs     ( const wchar_t*                   wszPack,
+                         std::vector <tzf_pack_input_s>&  inputs );
+
+// Picks one of the above by extension; source_block is tagged with
+//   source_id so blocks from different files never compare equal.
+bool
+TZF_ReadInputs         ( const wchar_t*                   wszFile,
+                         uint32_t                         source_id,
+                         std::vector <tzf_pack_input_s>&  inputs );
+
+// Every file below dir, in the order FindFirstFileW lists them
+void
+TZF_FindTreeFiles      (const std::wstring& dir, std::vector <std::wstring>& files);
+
+// Every <checksum>.dds below wszRoot (a dump or inject directory), read by
+//   up to threads threads
+bool
+TZF_ReadTreeInputs     ( const wchar_t*                   wszRoot,
+                         int                              threads,
+                         std::vector <tzf_pack_input_s>&  inputs );
+
+// Groups textures that compress alike: the DDS FourCC, or the RGB layout
+//   for uncompressed ones; 0 if it is not a DDS file
+uint32_t
+TZF_GetDDSFormatKey    (const std::vector <uint8_t>& data);
+
+#endif /* __TZF__SOURCES_H__ */